@@ -0,0 +1,474 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "quaternion.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  The keys of a single bone in an AnimationClip. The keys firstKey to firstKey + keyCount - 1 of the
+  clip belong to this track. Their times have to be strictly increasing.
+  */
+struct AnimationTrack {
+    unsigned int firstKey;
+    unsigned int keyCount;
+    unsigned int reserved1;
+    unsigned int reserved2;
+};
+
+/**
+  A keyframe animation with one track per bone. Each key stores a translation, a rotation and a
+  scale, so the sampled poses can be passed to Matrix4::transformation directly.
+
+  Keys are stored as separate arrays of times, translations, rotations and scales, in one
+  allocation. The clip can be written to memory with serialize and loaded with deserialize, which
+  is how the Animations chunk of a model file stores it.
+  */
+class AnimationClip {
+public:
+    /**
+      Changes whenever the layout written by serialize changes. deserialize rejects other versions.
+      */
+    static const unsigned int SerializationVersion = 1;
+
+    AnimationClip();
+    ~AnimationClip();
+
+    /**
+      Replaces the keys of this clip with copies of the given arrays, which have keyCount elements each.
+
+      @return False if a track has no keys, references keys outside of the arrays, or if the times of a
+      track are not strictly increasing. The clip is empty in that case.
+      */
+    bool create(const AnimationTrack *tracks, unsigned int trackCount, const float *times,
+                const Vector4 *translations, const Quaternion *rotations, const Vector4 *scales,
+                unsigned int keyCount);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    unsigned int trackCount() const;
+    const AnimationTrack *tracks() const;
+
+    unsigned int keyCount() const;
+    const float *times() const;
+    const Vector4 *translations() const;
+    const Quaternion *rotations() const;
+    const Vector4 *scales() const;
+
+    /**
+      Returns the time of the last key of all tracks.
+      */
+    float duration() const;
+
+    /**
+      Returns the number of bytes allocated for the tracks and keys of this clip.
+      */
+    size_t memoryUsage() const;
+
+    /**
+      Returns the number of bytes written by serialize. This is always a multiple of 16.
+      */
+    size_t serializedSize() const;
+
+    /**
+      Writes the clip to data, which has to have room for serializedSize() bytes.
+      */
+    void serialize(void *data) const;
+
+    /**
+      Replaces this clip with one written by serialize.
+
+      @return False if the data is truncated, has a different version or fails the checks of create.
+      The clip is empty in that case.
+      */
+    bool deserialize(const void *data, size_t size);
+
+private:
+    AnimationClip(const AnimationClip&);
+    AnimationClip &operator =(const AnimationClip&);
+
+    struct SerializedHeader {
+        unsigned int version;
+        unsigned int trackCount;
+        unsigned int keyCount;
+        unsigned int reserved;
+    };
+
+    static size_t paddedTimesSize(unsigned int keyCount);
+
+    void allocate(unsigned int trackCount, unsigned int keyCount);
+    bool validate();
+
+    // The vectors come first in the allocation, so the times don't break their alignment
+    void *mData;
+    AnimationTrack *mTracks;
+    unsigned int mTrackCount;
+    Vector4 *mTranslations;
+    Quaternion *mRotations;
+    Vector4 *mScales;
+    float *mTimes;
+    unsigned int mKeyCount;
+    float mDuration;
+};
+
+/**
+  Samples an AnimationClip into a local pose, with one translation, rotation and scale per track.
+
+  The sampler remembers the current key of every track, so playing a clip forward only looks at the
+  next key of each track. Sampling an earlier time, e.g. when a clip loops, searches the keys of each
+  track again. All tracks are interpolated together with the batch versions of Quaternion::nlerp or
+  Quaternion::slerp.
+  */
+class AnimationSampler {
+public:
+    enum RotationInterpolation {
+        Nlerp,
+        Slerp
+    };
+
+    AnimationSampler();
+    ~AnimationSampler();
+
+    /**
+      Sets the clip to sample and moves all cursors to the first key. The clip has to stay alive and
+      unchanged while it is set.
+      */
+    void setClip(const AnimationClip *clip);
+    const AnimationClip *clip() const;
+
+    /**
+      Nlerp by default, which is cheaper and close enough for keys that are close together.
+      */
+    void setRotationInterpolation(RotationInterpolation interpolation);
+    RotationInterpolation rotationInterpolation() const;
+
+    /**
+      Samples all tracks of the clip at the given time. Each output array needs one element per track.
+      Times before the first or after the last key of a track are clamped to that key.
+      */
+    void sample(float time, Vector4 *translations, Quaternion *rotations, Vector4 *scales);
+
+private:
+    AnimationSampler(const AnimationSampler&);
+    AnimationSampler &operator =(const AnimationSampler&);
+
+    void seek(const AnimationTrack &track, unsigned int &cursor, float time) const;
+
+    const AnimationClip *mClip;
+    RotationInterpolation mRotationInterpolation;
+
+    // Per track: the index of the current key within the track, the rotation of the next key and the
+    // weight of the next key
+    std::vector<unsigned int> mCursors;
+    Quaternion *mNextRotations;
+    std::vector<float> mWeights;
+};
+
+GAMEMATH_INLINE AnimationClip::AnimationClip()
+    : mData(0), mTracks(0), mTrackCount(0), mTranslations(0), mRotations(0), mScales(0), mTimes(0), mKeyCount(0),
+      mDuration(0)
+{
+}
+
+GAMEMATH_INLINE AnimationClip::~AnimationClip()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void AnimationClip::clear()
+{
+    if (mData)
+        ALIGNED_FREE(mData);
+    mData = 0;
+    mTracks = 0;
+    mTrackCount = 0;
+    mTranslations = 0;
+    mRotations = 0;
+    mScales = 0;
+    mTimes = 0;
+    mKeyCount = 0;
+    mDuration = 0;
+}
+
+GAMEMATH_INLINE size_t AnimationClip::paddedTimesSize(unsigned int keyCount)
+{
+    return (sizeof(float) * keyCount + 15) & ~(size_t)15;
+}
+
+GAMEMATH_INLINE void AnimationClip::allocate(unsigned int trackCount, unsigned int keyCount)
+{
+    clear();
+
+    const size_t vectorSize = sizeof(Vector4) * keyCount;
+    mData = ALIGNED_MALLOC(3 * vectorSize + paddedTimesSize(keyCount) + sizeof(AnimationTrack) * trackCount);
+    if (!mData)
+        throw std::bad_alloc();
+
+    char *ptr = static_cast<char*>(mData);
+    mTranslations = reinterpret_cast<Vector4*>(ptr);
+    mRotations = reinterpret_cast<Quaternion*>(ptr + vectorSize);
+    mScales = reinterpret_cast<Vector4*>(ptr + 2 * vectorSize);
+    mTimes = reinterpret_cast<float*>(ptr + 3 * vectorSize);
+    mTracks = reinterpret_cast<AnimationTrack*>(ptr + 3 * vectorSize + paddedTimesSize(keyCount));
+    mTrackCount = trackCount;
+    mKeyCount = keyCount;
+}
+
+GAMEMATH_INLINE bool AnimationClip::validate()
+{
+    mDuration = 0;
+    for (unsigned int i = 0; i < mTrackCount; ++i) {
+        const AnimationTrack &track = mTracks[i];
+        if (!track.keyCount || track.firstKey >= mKeyCount || track.keyCount > mKeyCount - track.firstKey) {
+            clear();
+            return false;
+        }
+
+        const float *times = mTimes + track.firstKey;
+        for (unsigned int j = 1; j < track.keyCount; ++j) {
+            if (!(times[j] > times[j - 1])) {
+                clear();
+                return false;
+            }
+        }
+        mDuration = std::max(mDuration, times[track.keyCount - 1]);
+    }
+    return true;
+}
+
+GAMEMATH_INLINE bool AnimationClip::create(const AnimationTrack *tracks, unsigned int trackCount, const float *times,
+                                           const Vector4 *translations, const Quaternion *rotations,
+                                           const Vector4 *scales, unsigned int keyCount)
+{
+    allocate(trackCount, keyCount);
+    memcpy(mTracks, tracks, sizeof(AnimationTrack) * trackCount);
+    memcpy(mTimes, times, sizeof(float) * keyCount);
+    for (unsigned int i = 0; i < keyCount; ++i) {
+        mTranslations[i] = translations[i];
+        mRotations[i] = rotations[i];
+        mScales[i] = scales[i];
+    }
+    return validate();
+}
+
+GAMEMATH_INLINE bool AnimationClip::isEmpty() const
+{
+    return !mTrackCount;
+}
+
+GAMEMATH_INLINE unsigned int AnimationClip::trackCount() const
+{
+    return mTrackCount;
+}
+
+GAMEMATH_INLINE const AnimationTrack *AnimationClip::tracks() const
+{
+    return mTracks;
+}
+
+GAMEMATH_INLINE unsigned int AnimationClip::keyCount() const
+{
+    return mKeyCount;
+}
+
+GAMEMATH_INLINE const float *AnimationClip::times() const
+{
+    return mTimes;
+}
+
+GAMEMATH_INLINE const Vector4 *AnimationClip::translations() const
+{
+    return mTranslations;
+}
+
+GAMEMATH_INLINE const Quaternion *AnimationClip::rotations() const
+{
+    return mRotations;
+}
+
+GAMEMATH_INLINE const Vector4 *AnimationClip::scales() const
+{
+    return mScales;
+}
+
+GAMEMATH_INLINE float AnimationClip::duration() const
+{
+    return mDuration;
+}
+
+GAMEMATH_INLINE size_t AnimationClip::memoryUsage() const
+{
+    if (!mData)
+        return 0;
+    return 3 * sizeof(Vector4) * mKeyCount + paddedTimesSize(mKeyCount) + sizeof(AnimationTrack) * mTrackCount;
+}
+
+GAMEMATH_INLINE size_t AnimationClip::serializedSize() const
+{
+    return sizeof(SerializedHeader) + sizeof(AnimationTrack) * mTrackCount + paddedTimesSize(mKeyCount)
+        + 3 * sizeof(Vector4) * mKeyCount;
+}
+
+GAMEMATH_INLINE void AnimationClip::serialize(void *data) const
+{
+    SerializedHeader header;
+    header.version = SerializationVersion;
+    header.trackCount = mTrackCount;
+    header.keyCount = mKeyCount;
+    header.reserved = 0;
+
+    char *ptr = static_cast<char*>(data);
+    memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    if (!mData)
+        return;
+
+    const size_t vectorSize = sizeof(Vector4) * mKeyCount;
+    memcpy(ptr, mTracks, sizeof(AnimationTrack) * mTrackCount);
+    ptr += sizeof(AnimationTrack) * mTrackCount;
+    memset(ptr, 0, paddedTimesSize(mKeyCount));
+    memcpy(ptr, mTimes, sizeof(float) * mKeyCount);
+    ptr += paddedTimesSize(mKeyCount);
+    memcpy(ptr, mTranslations, 3 * vectorSize);
+}
+
+GAMEMATH_INLINE bool AnimationClip::deserialize(const void *data, size_t size)
+{
+    clear();
+
+    SerializedHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    const char *ptr = static_cast<const char*>(data);
+    memcpy(&header, ptr, sizeof(header));
+    ptr += sizeof(header);
+
+    if (header.version != SerializationVersion)
+        return false;
+
+    const size_t vectorSize = sizeof(Vector4) * (size_t)header.keyCount;
+    if (size != sizeof(header) + sizeof(AnimationTrack) * (size_t)header.trackCount + paddedTimesSize(header.keyCount)
+        + 3 * vectorSize)
+        return false;
+
+    if (!header.trackCount)
+        return true;
+
+    allocate(header.trackCount, header.keyCount);
+    memcpy(mTracks, ptr, sizeof(AnimationTrack) * header.trackCount);
+    ptr += sizeof(AnimationTrack) * header.trackCount;
+    memcpy(mTimes, ptr, sizeof(float) * header.keyCount);
+    ptr += paddedTimesSize(header.keyCount);
+    memcpy(mTranslations, ptr, 3 * vectorSize);
+    return validate();
+}
+
+GAMEMATH_INLINE AnimationSampler::AnimationSampler()
+    : mClip(0), mRotationInterpolation(Nlerp), mNextRotations(0)
+{
+}
+
+GAMEMATH_INLINE AnimationSampler::~AnimationSampler()
+{
+    delete [] mNextRotations;
+}
+
+GAMEMATH_INLINE void AnimationSampler::setClip(const AnimationClip *clip)
+{
+    const unsigned int trackCount = clip ? clip->trackCount() : 0;
+    if (mWeights.size() != trackCount) {
+        delete [] mNextRotations;
+        mNextRotations = trackCount ? new Quaternion[trackCount] : 0;
+        mWeights.resize(trackCount);
+    }
+
+    mClip = clip;
+    mCursors.assign(trackCount, 0);
+}
+
+GAMEMATH_INLINE const AnimationClip *AnimationSampler::clip() const
+{
+    return mClip;
+}
+
+GAMEMATH_INLINE void AnimationSampler::setRotationInterpolation(RotationInterpolation interpolation)
+{
+    mRotationInterpolation = interpolation;
+}
+
+GAMEMATH_INLINE AnimationSampler::RotationInterpolation AnimationSampler::rotationInterpolation() const
+{
+    return mRotationInterpolation;
+}
+
+GAMEMATH_INLINE void AnimationSampler::seek(const AnimationTrack &track, unsigned int &cursor, float time) const
+{
+    // The cursor points to the first of the two keys surrounding time, so it stops at keyCount - 2
+    const float *times = mClip->times() + track.firstKey;
+    const unsigned int last = track.keyCount - 2;
+
+    if (time < times[cursor]) {
+        const unsigned int next = (unsigned int)(std::upper_bound(times, times + cursor, time) - times);
+        cursor = next ? next - 1 : 0;
+    } else {
+        while (cursor < last && times[cursor + 1] <= time)
+            ++cursor;
+    }
+}
+
+GAMEMATH_INLINE void AnimationSampler::sample(float time, Vector4 *translations, Quaternion *rotations, Vector4 *scales)
+{
+    if (!mClip)
+        return;
+
+    const AnimationTrack *tracks = mClip->tracks();
+    const float *times = mClip->times();
+    const Vector4 *keyTranslations = mClip->translations();
+    const Quaternion *keyRotations = mClip->rotations();
+    const Vector4 *keyScales = mClip->scales();
+    const unsigned int trackCount = mClip->trackCount();
+
+    // Find the surrounding keys of every track and gather the first rotation directly into the output
+    for (unsigned int i = 0; i < trackCount; ++i) {
+        const AnimationTrack &track = tracks[i];
+        unsigned int current = track.firstKey;
+        unsigned int next = current;
+        float weight = 0;
+
+        if (track.keyCount > 1) {
+            seek(track, mCursors[i], time);
+            current += mCursors[i];
+            next = current + 1;
+            weight = (time - times[current]) / (times[next] - times[current]);
+            weight = std::min(std::max(weight, 0.0f), 1.0f);
+        }
+
+        translations[i] = keyTranslations[current] + weight * (keyTranslations[next] - keyTranslations[current]);
+        scales[i] = keyScales[current] + weight * (keyScales[next] - keyScales[current]);
+        rotations[i] = keyRotations[current];
+        mNextRotations[i] = keyRotations[next];
+        mWeights[i] = weight;
+    }
+
+    if (!trackCount)
+        return;
+
+    if (mRotationInterpolation == Slerp)
+        Quaternion::slerp(rotations, mNextRotations, &mWeights[0], trackCount, rotations);
+    else
+        Quaternion::nlerp(rotations, mNextRotations, &mWeights[0], trackCount, rotations);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // ANIMATION_H
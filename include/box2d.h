@@ -12,6 +12,11 @@ GAMEMATH_NAMESPACE_BEGIN
  */
 GAMEMATH_ALIGNEDTYPE_PRE class GAMEMATH_ALIGNEDTYPE_MID Box2d : public AlignedAllocation {
 public:
+        /**
+         * Constructs an empty box at the origin.
+         */
+        Box2d();
+
         /**
          * Constructs a two-dimensional box from its bounds.
          *
@@ -24,6 +29,9 @@ public:
         float right() const;
         float bottom() const;
 
+        float width() const;
+        float height() const;
+
         /**
          * Determines whether this box intersects with another two-dimensional box.
          *
@@ -38,6 +46,11 @@ private:
         float mBottom;
 } GAMEMATH_ALIGNEDTYPE_POST;
 
+GAMEMATH_INLINE Box2d::Box2d()
+        : mLeft(0), mTop(0), mRight(0), mBottom(0)
+{
+}
+
 GAMEMATH_INLINE Box2d::Box2d(float left, float top, float right, float bottom)
         : mLeft(left), mTop(top), mRight(right), mBottom(bottom)
 {
@@ -78,6 +91,16 @@ GAMEMATH_INLINE float Box2d::bottom() const
         return mBottom;
 }
 
+GAMEMATH_INLINE float Box2d::width() const
+{
+        return mRight - mLeft;
+}
+
+GAMEMATH_INLINE float Box2d::height() const
+{
+        return mBottom - mTop;
+}
+
 GAMEMATH_NAMESPACE_END
 
 #endif // BOX2D_H
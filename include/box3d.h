@@ -3,6 +3,8 @@
 #define BOX3D_H
 
 #include "gamemath_internal.h"
+#include "gamemath_parallel.h"
+#include "box2d.h"
 #include "matrix4.h"
 #include "vector4.h"
 
@@ -13,6 +15,18 @@ public:
     Box3d(const Vector4 &minimum, const Vector4 &maximum);
     Box3d();
 
+    /**
+      Computes the smallest box that contains all of the given points.
+      If count is zero, a null box at the origin is returned.
+      */
+    static Box3d fromPoints(const Vector4 *points, size_t count);
+
+    /**
+      Same as fromPoints, but large arrays are split across all available cores and the
+      partial boxes are merged afterwards. Small arrays are processed on the calling thread.
+      */
+    static Box3d fromPointsParallel(const Vector4 *points, size_t count);
+
     const Vector4 &minimum() const;
     const Vector4 &maximum() const;
     void setMinimum(const Vector4 &minimum);
@@ -20,6 +34,12 @@ public:
 
     Vector4 center() const;
 
+    /**
+      Returns the surface area of this box. This is the basis of the surface area heuristic
+      used to build bounding volume hierarchies.
+      */
+    float surfaceArea() const;
+
     /**
       Under the assumption that the given matrix is an affine transform, this produces a new
       axis aligned bounding box.
@@ -42,6 +62,35 @@ public:
     bool intersects(const Box3d &other) const;
 
     bool contains(const Vector4 &point) const;
+
+    /**
+      Checks whether the given box lies completely within this box.
+      */
+    bool contains(const Box3d &other) const;
+
+    /**
+      Projects the corners of this box through a view-projection matrix and computes the rectangle
+      they cover in normalized device coordinates, clipped to [-1, 1]. Since Box2d orders its bounds,
+      top is the smaller y coordinate. nearestDepth receives the smallest z / w of the corners.
+
+      If the box reaches behind the eye, the rectangle is the whole screen and nearestDepth is
+      negative infinity, since its projection is unbounded.
+
+      @return False if the box lies completely outside of one of the clip planes, in which case
+              screenRect and nearestDepth are not written.
+      */
+    bool projectToScreen(const Matrix4 &viewProjection, Box2d &screenRect, float &nearestDepth) const;
+
+    /**
+      Same as projectToScreen, for an array of boxes. Bit i % 32 of visibleMasks[i / 32] is set if
+      box i is on screen. Boxes that are not have an empty rectangle and a depth of infinity.
+
+      visibleMasks needs room for (count + 31) / 32 words.
+
+      @return The number of boxes on screen.
+      */
+    static size_t projectToScreen(const Matrix4 &viewProjection, const Box3d *boxes, size_t count, Box2d *screenRects,
+                                  float *nearestDepths, unsigned int *visibleMasks);
 private:
     Vector4 mMinimum;
     Vector4 mMaximum;
@@ -57,41 +106,6 @@ GAMEMATH_INLINE Box3d::Box3d(const Vector4 &minimum, const Vector4 &maximum)
 {
 }
 
-GAMEMATH_INLINE void Box3d::merge(const Box3d &other)
-{
-    if (other.mMinimum.x() < mMinimum.x())
-        mMinimum.setX(other.mMinimum.x());
-    if (other.mMinimum.y() < mMinimum.y())
-        mMinimum.setY(other.mMinimum.y());
-    if (other.mMinimum.z() < mMinimum.z())
-        mMinimum.setZ(other.mMinimum.z());
-
-    if (other.mMaximum.x() > mMaximum.x())
-        mMaximum.setX(other.mMaximum.x());
-    if (other.mMaximum.y() > mMaximum.y())
-        mMaximum.setY(other.mMaximum.y());
-    if (other.mMaximum.z() > mMaximum.z())
-        mMaximum.setZ(other.mMaximum.z());
-}
-
-GAMEMATH_INLINE void Box3d::merge(const Vector4 &point)
-{
-    if (point.x() < mMinimum.x())
-        mMinimum.setX(point.x());
-    else if (point.x() > mMaximum.x()) 
-        mMaximum.setX(point.x());
-
-    if (point.y() < mMinimum.y())
-        mMinimum.setY(point.y());
-    else if (point.y() > mMaximum.y()) 
-        mMaximum.setY(point.y());
-
-    if (point.z() < mMinimum.z())
-        mMinimum.setZ(point.z());
-    else if (point.z() > mMaximum.z()) 
-        mMaximum.setZ(point.z());
-}
-
 GAMEMATH_INLINE Box3d operator *(const Matrix4 &matrix, const Box3d &box)
 {
     Vector4 tMin = matrix.mapPosition(box.minimum());
@@ -150,6 +164,18 @@ GAMEMATH_INLINE bool Box3d::contains(const Vector4 &point) const
         );
 }
 
+GAMEMATH_INLINE bool Box3d::contains(const Box3d &other) const
+{
+    return !(
+        mMinimum.x() > other.mMinimum.x() || 
+        mMinimum.y() > other.mMinimum.y() || 
+        mMinimum.z() > other.mMinimum.z() || 
+        other.mMaximum.x() > mMaximum.x() || 
+        other.mMaximum.y() > mMaximum.y() || 
+        other.mMaximum.z() > mMaximum.z()
+        );
+}
+
 GAMEMATH_INLINE bool Box3d::isInfinite() const
 {
     return mMinimum.isInfinite() || mMaximum.isInfinite();
@@ -160,6 +186,51 @@ GAMEMATH_INLINE Vector4 Box3d::center() const
     return 0.5f * (mMinimum + mMaximum);
 }
 
+GAMEMATH_INLINE float Box3d::surfaceArea() const
+{
+    const Vector4 extent = mMaximum - mMinimum;
+    return 2 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+class Box3dFromPointsKernel {
+public:
+    Box3dFromPointsKernel(const Vector4 *points, Box3d *partialBoxes)
+        : mPoints(points), mPartialBoxes(partialBoxes)
+    {
+    }
+
+    void operator()(int range, size_t begin, size_t end) const
+    {
+        mPartialBoxes[range] = Box3d::fromPoints(mPoints + begin, end - begin);
+    }
+
+private:
+    const Vector4 *mPoints;
+    Box3d *mPartialBoxes;
+};
+
+GAMEMATH_INLINE Box3d Box3d::fromPointsParallel(const Vector4 *points, size_t count)
+{
+    const int ranges = parallelRangeCount(count);
+
+    if (ranges <= 1)
+        return fromPoints(points, count);
+
+    Box3d *partialBoxes = new Box3d[ranges];
+    for (int i = 0; i < ranges; ++i)
+        partialBoxes[i] = Box3d(points[0], points[0]);
+
+    Box3dFromPointsKernel kernel(points, partialBoxes);
+    parallelForRanges(count, ranges, kernel);
+
+    Box3d result = partialBoxes[0];
+    for (int i = 1; i < ranges; ++i)
+        result.merge(partialBoxes[i]);
+
+    delete [] partialBoxes;
+    return result;
+}
+
 GAMEMATH_NAMESPACE_END
 
 #if !defined(GAMEMATH_NO_INTRINSICS)
@@ -2,10 +2,39 @@
 #include "gamemath_internal.h"
 #include "box3d.h"
 
+#include <algorithm>
 #include <limits>
 
 GAMEMATH_NAMESPACE_BEGIN
 
+GAMEMATH_INLINE void Box3d::merge(const Box3d &other)
+{
+    merge(other.mMinimum);
+    merge(other.mMaximum);
+}
+
+GAMEMATH_INLINE void Box3d::merge(const Vector4 &point)
+{
+    for (int i = 0; i < 4; ++i) {
+        const float value = point.data()[i];
+        if (value < mMinimum.data()[i])
+            mMinimum.data()[i] = value;
+        if (value > mMaximum.data()[i])
+            mMaximum.data()[i] = value;
+    }
+}
+
+GAMEMATH_INLINE Box3d Box3d::fromPoints(const Vector4 *points, size_t count)
+{
+    if (!count)
+        return Box3d();
+
+    Box3d result(points[0], points[0]);
+    for (size_t i = 1; i < count; ++i)
+        result.merge(points[i]);
+    return result;
+}
+
 GAMEMATH_INLINE Box3d Box3d::transformAffine(const Matrix4 &matrix) const
 {
     // Build a new box centered at the translated origin
@@ -43,4 +72,95 @@ GAMEMATH_INLINE void Box3d::setToInfinity()
     mMaximum.setZ(inf);
 }
 
+/**
+  Projects the corners of a box through a matrix. Returns 0 for boxes outside of a clip plane, 1 for
+  boxes in front of the eye and 2 for boxes reaching behind it, in which case rect and depth are
+  left alone. rect receives the clipped rectangle as (minimum x, minimum y, maximum x, maximum y).
+  */
+GAMEMATH_INLINE int _box3d_project(const Matrix4 &matrix, const Vector4 &minimum, const Vector4 &maximum, float *rect, float &depth)
+{
+    float clip[8][4];
+    int outside[5] = { 0, 0, 0, 0, 0 };
+    int behind = 0;
+
+    for (int i = 0; i < 8; ++i) {
+        const float corner[3] = { (i & 1) ? maximum.x() : minimum.x(), (i & 2) ? maximum.y() : minimum.y(),
+            (i & 4) ? maximum.z() : minimum.z() };
+        for (int row = 0; row < 4; ++row)
+            clip[i][row] = matrix(row, 0) * corner[0] + matrix(row, 1) * corner[1] + matrix(row, 2) * corner[2] + matrix(row, 3);
+
+        outside[0] += clip[i][0] > clip[i][3];
+        outside[1] += clip[i][0] < -clip[i][3];
+        outside[2] += clip[i][1] > clip[i][3];
+        outside[3] += clip[i][1] < -clip[i][3];
+        outside[4] += clip[i][2] > clip[i][3];
+        behind += clip[i][3] <= 0;
+    }
+
+    for (int plane = 0; plane < 5; ++plane) {
+        if (outside[plane] == 8)
+            return 0;
+    }
+    if (behind == 8)
+        return 0;
+    if (behind)
+        return 2;
+
+    rect[0] = rect[1] = depth = std::numeric_limits<float>::infinity();
+    rect[2] = rect[3] = -std::numeric_limits<float>::infinity();
+    for (int i = 0; i < 8; ++i) {
+        const float invW = 1.0f / clip[i][3];
+        const float x = clip[i][0] * invW;
+        const float y = clip[i][1] * invW;
+        rect[0] = std::min(rect[0], x);
+        rect[1] = std::min(rect[1], y);
+        rect[2] = std::max(rect[2], x);
+        rect[3] = std::max(rect[3], y);
+        depth = std::min(depth, clip[i][2] * invW);
+    }
+
+    for (int i = 0; i < 4; ++i)
+        rect[i] = std::max(std::min(rect[i], 1.0f), -1.0f);
+    return 1;
+}
+
+GAMEMATH_INLINE bool Box3d::projectToScreen(const Matrix4 &viewProjection, Box2d &screenRect, float &nearestDepth) const
+{
+    float rect[4];
+    float depth;
+    const int result = _box3d_project(viewProjection, mMinimum, mMaximum, rect, depth);
+    if (!result)
+        return false;
+
+    if (result == 2) {
+        screenRect = Box2d(-1, -1, 1, 1);
+        nearestDepth = -std::numeric_limits<float>::infinity();
+    } else {
+        screenRect = Box2d(rect[0], rect[1], rect[2], rect[3]);
+        nearestDepth = depth;
+    }
+    return true;
+}
+
+GAMEMATH_INLINE size_t Box3d::projectToScreen(const Matrix4 &viewProjection, const Box3d *boxes, size_t count,
+                                              Box2d *screenRects, float *nearestDepths, unsigned int *visibleMasks)
+{
+    for (size_t i = 0; i < (count + 31) / 32; ++i)
+        visibleMasks[i] = 0;
+
+    size_t visible = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!boxes[i].projectToScreen(viewProjection, screenRects[i], nearestDepths[i])) {
+            screenRects[i] = Box2d();
+            nearestDepths[i] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+
+        visibleMasks[i / 32] |= 1u << (i % 32);
+        ++visible;
+    }
+
+    return visible;
+}
+
 GAMEMATH_NAMESPACE_END
@@ -2,6 +2,8 @@
 #include "gamemath_internal.h"
 #include "box3d.h"
 
+#include <limits>
+
 GAMEMATH_NAMESPACE_BEGIN
 
 GAMEMATH_INLINE void Box3d::setToInfinity()
@@ -10,6 +12,86 @@ GAMEMATH_INLINE void Box3d::setToInfinity()
     mMaximum.mSse = _mm_load_ps(PositiveInfinity);
 }
 
+GAMEMATH_INLINE void Box3d::merge(const Box3d &other)
+{
+    mMinimum.mSse = _mm_min_ps(mMinimum.mSse, other.mMinimum.mSse);
+    mMaximum.mSse = _mm_max_ps(mMaximum.mSse, other.mMaximum.mSse);
+}
+
+GAMEMATH_INLINE void Box3d::merge(const Vector4 &point)
+{
+    mMinimum.mSse = _mm_min_ps(mMinimum.mSse, point.mSse);
+    mMaximum.mSse = _mm_max_ps(mMaximum.mSse, point.mSse);
+}
+
+GAMEMATH_INLINE Box3d Box3d::fromPoints(const Vector4 *points, size_t count)
+{
+    Box3d result;
+
+    if (!count)
+        return result;
+
+    size_t i = 0;
+
+#if defined(__AVX__)
+    // Two points per register. Vector4 is only guaranteed to be 16-byte aligned, hence the unaligned loads.
+    __m256 min0 = _mm256_castps128_ps256(points[0].mSse);
+    min0 = _mm256_insertf128_ps(min0, points[0].mSse, 1);
+    __m256 min1 = min0, min2 = min0, min3 = min0;
+    __m256 max0 = min0, max1 = min0, max2 = min0, max3 = min0;
+
+    const float *data = points[0].data();
+    for (; i + 8 <= count; i += 8) {
+        const __m256 p0 = _mm256_loadu_ps(data + i * 4);
+        const __m256 p1 = _mm256_loadu_ps(data + i * 4 + 8);
+        const __m256 p2 = _mm256_loadu_ps(data + i * 4 + 16);
+        const __m256 p3 = _mm256_loadu_ps(data + i * 4 + 24);
+        min0 = _mm256_min_ps(min0, p0);
+        max0 = _mm256_max_ps(max0, p0);
+        min1 = _mm256_min_ps(min1, p1);
+        max1 = _mm256_max_ps(max1, p1);
+        min2 = _mm256_min_ps(min2, p2);
+        max2 = _mm256_max_ps(max2, p2);
+        min3 = _mm256_min_ps(min3, p3);
+        max3 = _mm256_max_ps(max3, p3);
+    }
+
+    min0 = _mm256_min_ps(_mm256_min_ps(min0, min1), _mm256_min_ps(min2, min3));
+    max0 = _mm256_max_ps(_mm256_max_ps(max0, max1), _mm256_max_ps(max2, max3));
+
+    __m128 minimum = _mm_min_ps(_mm256_castps256_ps128(min0), _mm256_extractf128_ps(min0, 1));
+    __m128 maximum = _mm_max_ps(_mm256_castps256_ps128(max0), _mm256_extractf128_ps(max0, 1));
+#else
+    // Using four independent accumulators hides the latency of minps/maxps
+    __m128 min0 = points[0].mSse;
+    __m128 min1 = min0, min2 = min0, min3 = min0;
+    __m128 max0 = min0, max1 = min0, max2 = min0, max3 = min0;
+
+    for (; i + 4 <= count; i += 4) {
+        min0 = _mm_min_ps(min0, points[i].mSse);
+        max0 = _mm_max_ps(max0, points[i].mSse);
+        min1 = _mm_min_ps(min1, points[i + 1].mSse);
+        max1 = _mm_max_ps(max1, points[i + 1].mSse);
+        min2 = _mm_min_ps(min2, points[i + 2].mSse);
+        max2 = _mm_max_ps(max2, points[i + 2].mSse);
+        min3 = _mm_min_ps(min3, points[i + 3].mSse);
+        max3 = _mm_max_ps(max3, points[i + 3].mSse);
+    }
+
+    __m128 minimum = _mm_min_ps(_mm_min_ps(min0, min1), _mm_min_ps(min2, min3));
+    __m128 maximum = _mm_max_ps(_mm_max_ps(max0, max1), _mm_max_ps(max2, max3));
+#endif
+
+    for (; i < count; ++i) {
+        minimum = _mm_min_ps(minimum, points[i].mSse);
+        maximum = _mm_max_ps(maximum, points[i].mSse);
+    }
+
+    result.mMinimum.mSse = minimum;
+    result.mMaximum.mSse = maximum;
+    return result;
+}
+
 GAMEMATH_INLINE Box3d Box3d::transformAffine(const Matrix4 &matrix) const
 {
     // TODO: Accelerate this
@@ -37,4 +119,261 @@ GAMEMATH_INLINE Box3d Box3d::transformAffine(const Matrix4 &matrix) const
 	return Box3d(newMin, newMax);
 }
 
+/**
+  Broadcasts the elements of a matrix to the lanes of rows, in row-major order, so that a row can be
+  applied to four points stored as structure of arrays.
+  */
+GAMEMATH_INLINE void _box3d_broadcast_rows(const Matrix4 &matrix, __m128 *rows)
+{
+    for (int column = 0; column < 4; ++column) {
+        const __m128 c = matrix.column(column);
+        rows[column] = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0));
+        rows[4 + column] = _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1));
+        rows[8 + column] = _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2));
+        rows[12 + column] = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+/**
+  Projects the corners of a box with the broadcast matrix rows. rect receives the clipped rectangle as
+  (minimum x, minimum y, maximum x, maximum y). Returns 0 for boxes outside of a clip plane, 1 for
+  boxes in front of the eye and 2 for boxes reaching behind it, in which case rect and depth are
+  left alone.
+  */
+GAMEMATH_INLINE int _box3d_project(const __m128 *rows, const __m128 minimum, const __m128 maximum, __m128 &rect, float &depth)
+{
+    // The corners in lane order: x alternates fastest, then y, then z for the upper four corners
+    const __m128 xs = _mm_shuffle_ps(minimum, maximum, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 cornerX = _mm_shuffle_ps(xs, xs, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 cornerY = _mm_shuffle_ps(minimum, maximum, _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 minimumZ = _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 maximumZ = _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(2, 2, 2, 2));
+
+    __m128 lower[4];
+    __m128 upper[4];
+    for (int row = 0; row < 4; ++row) {
+        const __m128 *r = rows + 4 * row;
+        const __m128 base = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], cornerX), _mm_mul_ps(r[1], cornerY)), r[3]);
+        lower[row] = _mm_add_ps(base, _mm_mul_ps(r[2], minimumZ));
+        upper[row] = _mm_add_ps(base, _mm_mul_ps(r[2], maximumZ));
+    }
+
+    // The box is outside if all corners are on the outer side of the same clip plane
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 negativeLowerW = _mm_sub_ps(zero, lower[3]);
+    const __m128 negativeUpperW = _mm_sub_ps(zero, upper[3]);
+    const int outside = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(lower[0], lower[3]), _mm_cmpgt_ps(upper[0], upper[3]))) == 15
+        || _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(lower[0], negativeLowerW), _mm_cmplt_ps(upper[0], negativeUpperW))) == 15
+        || _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(lower[1], lower[3]), _mm_cmpgt_ps(upper[1], upper[3]))) == 15
+        || _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(lower[1], negativeLowerW), _mm_cmplt_ps(upper[1], negativeUpperW))) == 15
+        || _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(lower[2], lower[3]), _mm_cmpgt_ps(upper[2], upper[3]))) == 15;
+    if (outside)
+        return 0;
+
+    const __m128 lowerBehind = _mm_cmple_ps(lower[3], zero);
+    const __m128 upperBehind = _mm_cmple_ps(upper[3], zero);
+    if (_mm_movemask_ps(_mm_and_ps(lowerBehind, upperBehind)) == 15)
+        return 0;
+    if (_mm_movemask_ps(_mm_or_ps(lowerBehind, upperBehind)))
+        return 2;
+
+    const __m128 lowerInvW = _mm_div_ps(_mm_set1_ps(1.0f), lower[3]);
+    const __m128 upperInvW = _mm_div_ps(_mm_set1_ps(1.0f), upper[3]);
+    const __m128 lowerX = _mm_mul_ps(lower[0], lowerInvW);
+    const __m128 upperX = _mm_mul_ps(upper[0], upperInvW);
+    const __m128 lowerY = _mm_mul_ps(lower[1], lowerInvW);
+    const __m128 upperY = _mm_mul_ps(upper[1], upperInvW);
+
+    // Reduce to (min x, min y, max x, max y) and (min z) across all eight corners
+    __m128 minXY = _mm_min_ps(_mm_unpacklo_ps(lowerX, lowerY), _mm_unpackhi_ps(lowerX, lowerY));
+    minXY = _mm_min_ps(minXY, _mm_min_ps(_mm_unpacklo_ps(upperX, upperY), _mm_unpackhi_ps(upperX, upperY)));
+    __m128 maxXY = _mm_max_ps(_mm_unpacklo_ps(lowerX, lowerY), _mm_unpackhi_ps(lowerX, lowerY));
+    maxXY = _mm_max_ps(maxXY, _mm_max_ps(_mm_unpacklo_ps(upperX, upperY), _mm_unpackhi_ps(upperX, upperY)));
+    minXY = _mm_min_ps(minXY, _mm_movehl_ps(minXY, minXY));
+    maxXY = _mm_max_ps(maxXY, _mm_movehl_ps(maxXY, maxXY));
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    rect = _mm_movelh_ps(minXY, maxXY);
+    rect = _mm_max_ps(_mm_min_ps(rect, one), _mm_sub_ps(zero, one));
+
+    __m128 z = _mm_min_ps(_mm_mul_ps(lower[2], lowerInvW), _mm_mul_ps(upper[2], upperInvW));
+    z = _mm_min_ps(z, _mm_movehl_ps(z, z));
+    z = _mm_min_ss(z, _mm_shuffle_ps(z, z, _MM_SHUFFLE(1, 1, 1, 1)));
+    _mm_store_ss(&depth, z);
+    return 1;
+}
+
+/**
+  Projects four boxes at once, with one box per lane. Returns a mask of the boxes that are not
+  outside of a clip plane in the lower four bits, and of those among them reaching behind the eye
+  in the upper four bits. rect receives the clipped rectangle of each box as (minimum x, minimum y,
+  maximum x, maximum y).
+  */
+GAMEMATH_INLINE int _box3d_project4(const __m128 *rows, const Box3d *boxes, __m128 *rect, __m128 &depth)
+{
+    __m128 minimum[4] = { boxes[0].minimum(), boxes[1].minimum(), boxes[2].minimum(), boxes[3].minimum() };
+    __m128 maximum[4] = { boxes[0].maximum(), boxes[1].maximum(), boxes[2].maximum(), boxes[3].maximum() };
+    _MM_TRANSPOSE4_PS(minimum[0], minimum[1], minimum[2], minimum[3]);
+    _MM_TRANSPOSE4_PS(maximum[0], maximum[1], maximum[2], maximum[3]);
+
+    // The clip coordinates of corner i are planar[row][i & 3] + depthTerm[row][i >> 2]
+    __m128 planar[4][4];
+    __m128 depthTerm[4][2];
+    for (int row = 0; row < 4; ++row) {
+        const __m128 *r = rows + 4 * row;
+        const __m128 x0 = _mm_mul_ps(r[0], minimum[0]);
+        const __m128 x1 = _mm_mul_ps(r[0], maximum[0]);
+        const __m128 y0 = _mm_add_ps(_mm_mul_ps(r[1], minimum[1]), r[3]);
+        const __m128 y1 = _mm_add_ps(_mm_mul_ps(r[1], maximum[1]), r[3]);
+        planar[row][0] = _mm_add_ps(x0, y0);
+        planar[row][1] = _mm_add_ps(x1, y0);
+        planar[row][2] = _mm_add_ps(x0, y1);
+        planar[row][3] = _mm_add_ps(x1, y1);
+        depthTerm[row][0] = _mm_mul_ps(r[2], minimum[2]);
+        depthTerm[row][1] = _mm_mul_ps(r[2], maximum[2]);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 allSet = _mm_cmpeq_ps(zero, zero);
+    __m128 right = allSet, left = allSet, top = allSet, bottom = allSet, beyondFar = allSet;
+    __m128 allBehind = allSet, anyBehind = zero;
+    __m128 minX = _mm_load_ps(PositiveInfinity), minY = minX, minZ = minX;
+    __m128 maxX = _mm_sub_ps(zero, minX), maxY = maxX;
+
+    for (int i = 0; i < 8; ++i) {
+        const __m128 x = _mm_add_ps(planar[0][i & 3], depthTerm[0][i >> 2]);
+        const __m128 y = _mm_add_ps(planar[1][i & 3], depthTerm[1][i >> 2]);
+        const __m128 z = _mm_add_ps(planar[2][i & 3], depthTerm[2][i >> 2]);
+        const __m128 w = _mm_add_ps(planar[3][i & 3], depthTerm[3][i >> 2]);
+        const __m128 negativeW = _mm_sub_ps(zero, w);
+
+        right = _mm_and_ps(right, _mm_cmpgt_ps(x, w));
+        left = _mm_and_ps(left, _mm_cmplt_ps(x, negativeW));
+        top = _mm_and_ps(top, _mm_cmpgt_ps(y, w));
+        bottom = _mm_and_ps(bottom, _mm_cmplt_ps(y, negativeW));
+        beyondFar = _mm_and_ps(beyondFar, _mm_cmpgt_ps(z, w));
+        const __m128 behind = _mm_cmple_ps(w, zero);
+        allBehind = _mm_and_ps(allBehind, behind);
+        anyBehind = _mm_or_ps(anyBehind, behind);
+
+        // Lanes with corners behind the eye produce garbage here, which is replaced by the caller
+        const __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), w);
+        const __m128 projectedX = _mm_mul_ps(x, invW);
+        const __m128 projectedY = _mm_mul_ps(y, invW);
+        minX = _mm_min_ps(minX, projectedX);
+        maxX = _mm_max_ps(maxX, projectedX);
+        minY = _mm_min_ps(minY, projectedY);
+        maxY = _mm_max_ps(maxY, projectedY);
+        minZ = _mm_min_ps(minZ, _mm_mul_ps(z, invW));
+    }
+
+    const __m128 outside = _mm_or_ps(_mm_or_ps(_mm_or_ps(right, left), _mm_or_ps(top, bottom)), _mm_or_ps(beyondFar, allBehind));
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_sub_ps(zero, one);
+    rect[0] = _mm_max_ps(_mm_min_ps(minX, one), minusOne);
+    rect[1] = _mm_max_ps(_mm_min_ps(minY, one), minusOne);
+    rect[2] = _mm_max_ps(_mm_min_ps(maxX, one), minusOne);
+    rect[3] = _mm_max_ps(_mm_min_ps(maxY, one), minusOne);
+    _MM_TRANSPOSE4_PS(rect[0], rect[1], rect[2], rect[3]);
+    depth = minZ;
+
+    return _mm_movemask_ps(_mm_andnot_ps(outside, allSet)) | (_mm_movemask_ps(_mm_andnot_ps(outside, anyBehind)) << 4);
+}
+
+/**
+  Returns the number of bits set in a mask of four bits.
+  */
+GAMEMATH_INLINE unsigned int _box3d_lane_count(int mask)
+{
+    return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+}
+
+/**
+  Stores the result of _box3d_project into a rectangle and depth.
+  */
+GAMEMATH_INLINE void _box3d_store_projection(int result, const __m128 rect, float depth, Box2d &screenRect, float &nearestDepth)
+{
+    if (result == 2) {
+        screenRect = Box2d(-1, -1, 1, 1);
+        nearestDepth = -std::numeric_limits<float>::infinity();
+    } else {
+        GAMEMATH_ALIGN float bounds[4];
+        _mm_store_ps(bounds, rect);
+        screenRect = Box2d(bounds[0], bounds[1], bounds[2], bounds[3]);
+        nearestDepth = depth;
+    }
+}
+
+GAMEMATH_INLINE bool Box3d::projectToScreen(const Matrix4 &viewProjection, Box2d &screenRect, float &nearestDepth) const
+{
+    __m128 rows[16];
+    _box3d_broadcast_rows(viewProjection, rows);
+
+    __m128 rect;
+    float depth;
+    const int result = _box3d_project(rows, mMinimum.mSse, mMaximum.mSse, rect, depth);
+    if (!result)
+        return false;
+
+    _box3d_store_projection(result, rect, depth, screenRect, nearestDepth);
+    return true;
+}
+
+GAMEMATH_INLINE size_t Box3d::projectToScreen(const Matrix4 &viewProjection, const Box3d *boxes, size_t count,
+                                              Box2d *screenRects, float *nearestDepths, unsigned int *visibleMasks)
+{
+    for (size_t i = 0; i < (count + 31) / 32; ++i)
+        visibleMasks[i] = 0;
+
+    // The broadcasts are shared by all boxes
+    __m128 rows[16];
+    _box3d_broadcast_rows(viewProjection, rows);
+
+    size_t visible = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 rect[4];
+        __m128 depth;
+        const int mask = _box3d_project4(rows, boxes + i, rect, depth);
+
+        GAMEMATH_ALIGN float depths[4];
+        _mm_store_ps(depths, depth);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (mask & (16 << lane)) {
+                screenRects[i + lane] = Box2d(-1, -1, 1, 1);
+                nearestDepths[i + lane] = -std::numeric_limits<float>::infinity();
+            } else if (mask & (1 << lane)) {
+                GAMEMATH_ALIGN float bounds[4];
+                _mm_store_ps(bounds, rect[lane]);
+                screenRects[i + lane] = Box2d(bounds[0], bounds[1], bounds[2], bounds[3]);
+                nearestDepths[i + lane] = depths[lane];
+            } else {
+                screenRects[i + lane] = Box2d();
+                nearestDepths[i + lane] = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        visibleMasks[i / 32] |= (unsigned int)(mask & 15) << (i % 32);
+        visible += _box3d_lane_count(mask & 15);
+    }
+
+    for (; i < count; ++i) {
+        __m128 rect;
+        float depth;
+        const int result = _box3d_project(rows, boxes[i].mMinimum.mSse, boxes[i].mMaximum.mSse, rect, depth);
+        if (!result) {
+            screenRects[i] = Box2d();
+            nearestDepths[i] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+
+        _box3d_store_projection(result, rect, depth, screenRects[i], nearestDepths[i]);
+        visibleMasks[i / 32] |= 1u << (i % 32);
+        ++visible;
+    }
+
+    return visible;
+}
+
 GAMEMATH_NAMESPACE_END
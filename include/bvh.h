@@ -0,0 +1,747 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "box3d.h"
+#include "ray3d.h"
+#include "ray_packet.h"
+#include "frustum.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A single node of a bounding volume hierarchy. Nodes are 32 bytes large, so two of them
+  share a cache line. The otherwise unused fourth component of each bound stores the tree
+  structure.
+  */
+GAMEMATH_ALIGNEDTYPE_PRE struct GAMEMATH_ALIGNEDTYPE_MID BvhNode {
+    float minimum[3];
+
+    /**
+      For inner nodes, this is the index of the left child. The right child immediately follows it.
+      For leaves, this is the index of the first primitive in Bvh::primitiveIndices.
+      */
+    unsigned int leftFirst;
+
+    float maximum[3];
+
+    /**
+      The number of primitives in this leaf, or zero if this is an inner node.
+      */
+    unsigned int count;
+
+    bool isLeaf() const;
+
+    /**
+      Returns the bounds of this node as a box. The w components of the box are zero.
+      */
+    Box3d bounds() const;
+
+    /**
+      Changes the bounds of this node without touching the tree structure.
+      */
+    void setBounds(const Box3d &box);
+
+    /**
+      Changes the bounds of this node to enclose both given nodes, without touching the tree structure.
+      */
+    void setBoundsToUnion(const BvhNode &a, const BvhNode &b);
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+/**
+  A bounding volume hierarchy over an array of boxes, built using the binned surface area heuristic.
+  The hierarchy is stored as a flat array of nodes, with siblings stored next to each other.
+
+  Queries report the index of every box (as passed to build) that passes the query test.
+  */
+class Bvh {
+public:
+    /**
+      The maximum number of primitives that will be stored in a single leaf, unless the
+      hierarchy is degenerate and exceeds MaxDepth.
+      */
+    static const unsigned int MaxLeafSize = 8;
+
+    /**
+      The maximum depth of a hierarchy built with the surface area heuristic.
+      */
+    static const unsigned int MaxDepth = 64;
+
+    /**
+      The size of the traversal stack. Linear hierarchies are not depth-limited, but their depth
+      is bounded by the number of Morton code bits plus 32 bits used to break ties.
+      */
+    static const unsigned int TraversalStackSize = 128;
+
+    /**
+      The number of bins the centers are sorted into along each axis while searching for a split.
+      */
+    static const int Bins = 16;
+    /**
+      The precision of the Morton codes used by buildLinear.
+      */
+    enum MortonPrecision {
+        Morton30, // 10 bits per axis
+        Morton63  // 21 bits per axis
+    };
+
+    Bvh();
+    ~Bvh();
+
+    /**
+      Builds the hierarchy over the given boxes, replacing the previous hierarchy.
+      The boxes are copied, the array doesn't need to be kept alive. Memory is reused
+      between builds as long as the number of boxes doesn't grow.
+      */
+    void build(const Box3d *boxes, unsigned int count);
+
+    /**
+      Builds the hierarchy by sorting the box centers along a Morton curve and emitting the
+      hierarchy from the sorted codes (Karras 2012). This is an order of magnitude faster than build,
+      and is spread across all cores, but produces hierarchies of lower quality with one box per leaf.
+      Use it for sets of boxes that change every frame.
+      */
+    void buildLinear(const Box3d *boxes, unsigned int count, MortonPrecision precision = Morton30);
+
+    /**
+      Removes all boxes and releases all memory held by this hierarchy.
+      */
+    void clear();
+
+    /**
+      Changes the box with the given index (as passed to build) and marks the path from its leaf
+      to the root as dirty. The hierarchy is only updated by the next call to refit.
+      */
+    void updatePrimitive(unsigned int index, const Box3d &box);
+
+    /**
+      Recomputes the bounds of all nodes that have been marked dirty by updatePrimitive,
+      without changing the topology of the hierarchy. Clean subtrees are skipped entirely.
+      */
+    void refit();
+
+    /**
+      Replaces all boxes with those from the given array, which must be indexed like the array
+      passed to build, and recomputes the bounds of all nodes.
+      */
+    void refit(const Box3d *boxes);
+
+    /**
+      Refits the hierarchy to the given boxes like refit(boxes), but rebuilds it from scratch using
+      the same method as the last build if the quality has degraded by more than the given factor.
+
+      @return True if the hierarchy was rebuilt.
+      */
+    bool refitOrRebuild(const Box3d *boxes, float rebuildThreshold = 1.5f);
+
+    /**
+      Returns the cost of this hierarchy according to the surface area heuristic, relative to the
+      surface area of the root. This is the expected number of node and box tests for a random ray
+      that hits the root.
+      */
+    float cost() const;
+
+    /**
+      Returns the ratio between the current cost and the cost right after the last build.
+      Refitting moving boxes makes nodes overlap more and more, which increases this ratio.
+      */
+    float costRatio() const;
+
+    /**
+      Returns true if the cost has degraded by more than the given factor since the last build.
+      */
+    bool needsRebuild(float rebuildThreshold = 1.5f) const;
+
+    bool isEmpty() const;
+
+    /**
+      Returns the bounds of all boxes in this hierarchy.
+      */
+    Box3d bounds() const;
+
+    const BvhNode *nodes() const;
+    unsigned int nodeCount() const;
+
+    /**
+      Returns the number of boxes in this hierarchy.
+      */
+    unsigned int primitiveCount() const;
+
+    /**
+      Maps the primitive ranges of leaf nodes to the indices of the boxes passed to build.
+      */
+    const unsigned int *primitiveIndices() const;
+
+    /**
+      Returns the boxes stored in this hierarchy, in the order referenced by the leaf nodes.
+      */
+    const Box3d *primitiveBoxes() const;
+
+    /**
+      Calls visitor(index) for every box that is intersected by the given ray.
+      */
+    template<typename Visitor>
+    void visit(const Ray3d &ray, Visitor &visitor) const;
+
+    /**
+      Calls visitor(index, mask) for every box that is hit by at least one ray of the packet.
+      Bit i of mask is set if ray i hits the box. The whole packet traverses the hierarchy together,
+      so this is much faster than tracing the rays one by one if they are coherent.
+      */
+    template<int Size, typename Visitor>
+    void visit(const RayPacket<Size> &packet, Visitor &visitor) const;
+
+    /**
+      Calls visitor(index) for every box that intersects the given box.
+      */
+    template<typename Visitor>
+    void visit(const Box3d &box, Visitor &visitor) const;
+
+    /**
+      Calls visitor(index) for every box that is visible within the given frustum.
+      */
+    template<typename Visitor>
+    void visit(const Frustum &frustum, Visitor &visitor) const;
+
+    /**
+      Appends the index of every box intersected by the given ray to result.
+      */
+    void query(const Ray3d &ray, std::vector<unsigned int> &result) const;
+
+    /**
+      Appends the index of every box intersecting the given box to result.
+      */
+    void query(const Box3d &box, std::vector<unsigned int> &result) const;
+
+    /**
+      Appends the index of every box visible within the given frustum to result.
+      */
+    void query(const Frustum &frustum, std::vector<unsigned int> &result) const;
+
+private:
+    Bvh(const Bvh&);
+    Bvh &operator =(const Bvh&);
+
+    struct BuildTask {
+        unsigned int node;
+        unsigned int depth;
+    };
+
+    static Box3d emptyBox();
+
+    void allocate(unsigned int count);
+    void *scratch(size_t size);
+
+    void subdivide(const BuildTask &task, const Box3d *boxes, const Vector4 *centers, std::vector<BuildTask> &tasks);
+
+    void prepareRefit() const;
+    double nodeCost(const BvhNode &node) const;
+
+    template<typename Test, typename Visitor>
+    void traverse(const Test &test, Visitor &visitor) const;
+
+    BvhNode *mNodes;
+    unsigned int mNodeCount;
+    unsigned int *mIndices;
+    Box3d *mPrimitiveBoxes;
+    unsigned int mPrimitiveCount;
+    unsigned int mCapacity;
+    void *mScratch;
+    size_t mScratchSize;
+
+    bool mLinear;
+    MortonPrecision mPrecision;
+
+    // The following are only set up once the hierarchy is refitted for the first time
+    mutable bool mRefitPrepared;
+    mutable std::vector<unsigned int> mParents;
+    mutable std::vector<unsigned int> mLeaves;
+    mutable std::vector<unsigned int> mPositions;
+    mutable std::vector<unsigned char> mDirty;
+    mutable double mCostSum;
+    mutable float mBuildCost;
+};
+
+GAMEMATH_INLINE bool BvhNode::isLeaf() const
+{
+    return count != 0;
+}
+
+GAMEMATH_INLINE Box3d BvhNode::bounds() const
+{
+#if !defined(GAMEMATH_NO_INTRINSICS)
+    // Mask out the tree structure stored in the w components
+    const __m128 mask = _mm_load_ps(reinterpret_cast<const float*>(CoordinateMaskXYZ));
+    return Box3d(_mm_and_ps(_mm_load_ps(minimum), mask), _mm_and_ps(_mm_load_ps(maximum), mask));
+#else
+    return Box3d(Vector4(minimum[0], minimum[1], minimum[2], 0), Vector4(maximum[0], maximum[1], maximum[2], 0));
+#endif
+}
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+
+/**
+  Replaces the x, y and z components of the node data at the given address while keeping w.
+  */
+GAMEMATH_INLINE void _store_bounds_xyz(float *destination, const __m128 bounds)
+{
+    const __m128 mask = _mm_load_ps(reinterpret_cast<const float*>(CoordinateMaskXYZ));
+    const __m128 structure = _mm_andnot_ps(mask, _mm_load_ps(destination));
+    _mm_store_ps(destination, _mm_or_ps(_mm_and_ps(bounds, mask), structure));
+}
+
+GAMEMATH_INLINE void BvhNode::setBounds(const Box3d &box)
+{
+    _store_bounds_xyz(minimum, box.minimum());
+    _store_bounds_xyz(maximum, box.maximum());
+}
+
+GAMEMATH_INLINE void BvhNode::setBoundsToUnion(const BvhNode &a, const BvhNode &b)
+{
+    _store_bounds_xyz(minimum, _mm_min_ps(_mm_load_ps(a.minimum), _mm_load_ps(b.minimum)));
+    _store_bounds_xyz(maximum, _mm_max_ps(_mm_load_ps(a.maximum), _mm_load_ps(b.maximum)));
+}
+
+#else
+
+GAMEMATH_INLINE void BvhNode::setBounds(const Box3d &box)
+{
+    minimum[0] = box.minimum().x();
+    minimum[1] = box.minimum().y();
+    minimum[2] = box.minimum().z();
+    maximum[0] = box.maximum().x();
+    maximum[1] = box.maximum().y();
+    maximum[2] = box.maximum().z();
+}
+
+GAMEMATH_INLINE void BvhNode::setBoundsToUnion(const BvhNode &a, const BvhNode &b)
+{
+    for (int i = 0; i < 3; ++i) {
+        minimum[i] = std::min(a.minimum[i], b.minimum[i]);
+        maximum[i] = std::max(a.maximum[i], b.maximum[i]);
+    }
+}
+
+#endif
+
+class BvhRayTest {
+public:
+    BvhRayTest(const Ray3d &ray) : mRay(ray) {}
+    bool operator()(const Box3d &box) const { return mRay.intersects(box); }
+private:
+    const Ray3d &mRay;
+};
+
+class BvhBoxTest {
+public:
+    BvhBoxTest(const Box3d &box) : mBox(box) {}
+    bool operator()(const Box3d &box) const { return mBox.intersects(box); }
+private:
+    const Box3d &mBox;
+};
+
+class BvhFrustumTest {
+public:
+    BvhFrustumTest(const Frustum &frustum) : mFrustum(frustum) {}
+    bool operator()(const Box3d &box) const { return mFrustum.isVisible(box); }
+private:
+    const Frustum &mFrustum;
+};
+
+class BvhResultCollector {
+public:
+    BvhResultCollector(std::vector<unsigned int> &result) : mResult(result) {}
+    void operator()(unsigned int index) { mResult.push_back(index); }
+private:
+    std::vector<unsigned int> &mResult;
+};
+
+GAMEMATH_INLINE Bvh::Bvh()
+    : mNodes(0), mNodeCount(0), mIndices(0), mPrimitiveBoxes(0), mPrimitiveCount(0), mCapacity(0),
+    mScratch(0), mScratchSize(0), mLinear(false), mPrecision(Morton30), mRefitPrepared(false), mCostSum(0), mBuildCost(0)
+{
+}
+
+GAMEMATH_INLINE Bvh::~Bvh()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void Bvh::clear()
+{
+    if (mNodes)
+        ALIGNED_FREE(mNodes);
+    delete [] mIndices;
+    delete [] mPrimitiveBoxes;
+    if (mScratch)
+        ALIGNED_FREE(mScratch);
+
+    mNodes = 0;
+    mNodeCount = 0;
+    mIndices = 0;
+    mPrimitiveBoxes = 0;
+    mPrimitiveCount = 0;
+    mCapacity = 0;
+    mScratch = 0;
+    mScratchSize = 0;
+
+    mRefitPrepared = false;
+    std::vector<unsigned int>().swap(mParents);
+    std::vector<unsigned int>().swap(mLeaves);
+    std::vector<unsigned int>().swap(mPositions);
+    std::vector<unsigned char>().swap(mDirty);
+}
+
+GAMEMATH_INLINE bool Bvh::isEmpty() const
+{
+    return mNodeCount == 0;
+}
+
+GAMEMATH_INLINE Box3d Bvh::bounds() const
+{
+    if (!mNodeCount)
+        return Box3d();
+    return mNodes[0].bounds();
+}
+
+GAMEMATH_INLINE const BvhNode *Bvh::nodes() const
+{
+    return mNodes;
+}
+
+GAMEMATH_INLINE unsigned int Bvh::nodeCount() const
+{
+    return mNodeCount;
+}
+
+GAMEMATH_INLINE unsigned int Bvh::primitiveCount() const
+{
+    return mPrimitiveCount;
+}
+
+GAMEMATH_INLINE const unsigned int *Bvh::primitiveIndices() const
+{
+    return mIndices;
+}
+
+GAMEMATH_INLINE const Box3d *Bvh::primitiveBoxes() const
+{
+    return mPrimitiveBoxes;
+}
+
+GAMEMATH_INLINE Box3d Bvh::emptyBox()
+{
+#if !defined(GAMEMATH_NO_INTRINSICS)
+    return Box3d(_mm_load_ps(PositiveInfinity), _mm_load_ps(NegativeInfinity));
+#else
+    const float inf = std::numeric_limits<float>::infinity();
+    return Box3d(Vector4(inf, inf, inf, inf), Vector4(-inf, -inf, -inf, -inf));
+#endif
+}
+
+GAMEMATH_INLINE void Bvh::allocate(unsigned int count)
+{
+    mNodeCount = 0;
+    mPrimitiveCount = count;
+    mRefitPrepared = false;
+
+    if (count <= mCapacity)
+        return;
+
+    if (mNodes)
+        ALIGNED_FREE(mNodes);
+    delete [] mIndices;
+    delete [] mPrimitiveBoxes;
+    mNodes = 0;
+    mIndices = 0;
+    mPrimitiveBoxes = 0;
+    mCapacity = 0;
+
+    mIndices = new unsigned int[count];
+    mPrimitiveBoxes = new Box3d[count];
+    mNodes = static_cast<BvhNode*>(ALIGNED_MALLOC(sizeof(BvhNode) * (2 * count - 1)));
+    if (!mNodes)
+        throw std::bad_alloc();
+    mCapacity = count;
+}
+
+GAMEMATH_INLINE void *Bvh::scratch(size_t size)
+{
+    if (size > mScratchSize) {
+        if (mScratch)
+            ALIGNED_FREE(mScratch);
+        mScratchSize = 0;
+        mScratch = ALIGNED_MALLOC(size);
+        if (!mScratch)
+            throw std::bad_alloc();
+        mScratchSize = size;
+    }
+    return mScratch;
+}
+
+GAMEMATH_INLINE void Bvh::build(const Box3d *boxes, unsigned int count)
+{
+    allocate(count);
+    mLinear = false;
+
+    if (!count)
+        return;
+
+    Vector4 *centers = static_cast<Vector4*>(scratch(sizeof(Vector4) * count));
+    for (unsigned int i = 0; i < count; ++i) {
+        mIndices[i] = i;
+        centers[i] = boxes[i].center();
+    }
+
+    mNodeCount = 1;
+    mNodes[0].leftFirst = 0;
+    mNodes[0].count = count;
+
+    std::vector<BuildTask> tasks;
+    BuildTask root = { 0, 0 };
+    tasks.push_back(root);
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+        subdivide(task, boxes, centers, tasks);
+    }
+
+    // Store the boxes in leaf order, so leaves can be tested without an indirection
+    for (unsigned int i = 0; i < count; ++i)
+        mPrimitiveBoxes[i] = boxes[mIndices[i]];
+}
+
+GAMEMATH_INLINE void Bvh::subdivide(const BuildTask &task, const Box3d *boxes, const Vector4 *centers, std::vector<BuildTask> &tasks)
+{
+    BvhNode &node = mNodes[task.node];
+    const unsigned int first = node.leftFirst;
+    const unsigned int count = node.count;
+
+    Box3d bounds = boxes[mIndices[first]];
+    Box3d centerBounds(centers[mIndices[first]], centers[mIndices[first]]);
+    for (unsigned int i = first + 1; i < first + count; ++i) {
+        bounds.merge(boxes[mIndices[i]]);
+        centerBounds.merge(centers[mIndices[i]]);
+    }
+    node.setBounds(bounds);
+
+    if (count == 1 || task.depth + 1 >= MaxDepth)
+        return;
+
+    // Find the cheapest split using the surface area heuristic. The cost of traversing
+    // an inner node is assumed to be the same as intersecting a single primitive.
+    float bestCost = count * bounds.surfaceArea();
+    int bestAxis = -1;
+    int bestSplit = 0;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const float lower = centerBounds.minimum().data()[axis];
+        const float upper = centerBounds.maximum().data()[axis];
+
+        if (upper <= lower)
+            continue;
+
+        Box3d binBounds[Bins];
+        unsigned int binCounts[Bins];
+        for (int i = 0; i < Bins; ++i) {
+            binBounds[i] = emptyBox();
+            binCounts[i] = 0;
+        }
+
+        const float scale = Bins / (upper - lower);
+        for (unsigned int i = first; i < first + count; ++i) {
+            int bin = (int)((centers[mIndices[i]].data()[axis] - lower) * scale);
+            if (bin > Bins - 1)
+                bin = Bins - 1;
+            binBounds[bin].merge(boxes[mIndices[i]]);
+            binCounts[bin]++;
+        }
+
+        // Sweep from the left to get the area and count left of each split plane
+        float leftAreas[Bins - 1];
+        unsigned int leftCounts[Bins - 1];
+        Box3d accumulated = emptyBox();
+        unsigned int accumulatedCount = 0;
+        for (int i = 0; i < Bins - 1; ++i) {
+            accumulated.merge(binBounds[i]);
+            accumulatedCount += binCounts[i];
+            leftCounts[i] = accumulatedCount;
+            leftAreas[i] = accumulatedCount ? accumulated.surfaceArea() : 0;
+        }
+
+        // Then sweep from the right and evaluate the cost of each split plane
+        accumulated = emptyBox();
+        accumulatedCount = 0;
+        for (int i = Bins - 1; i > 0; --i) {
+            accumulated.merge(binBounds[i]);
+            accumulatedCount += binCounts[i];
+
+            if (!accumulatedCount || !leftCounts[i - 1])
+                continue;
+
+            const float cost = bounds.surfaceArea() + leftCounts[i - 1] * leftAreas[i - 1]
+                + accumulatedCount * accumulated.surfaceArea();
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    unsigned int leftCount;
+
+    if (bestAxis != -1) {
+        const float lower = centerBounds.minimum().data()[bestAxis];
+        const float scale = Bins / (centerBounds.maximum().data()[bestAxis] - lower);
+
+        unsigned int *left = mIndices + first;
+        unsigned int *right = mIndices + first + count - 1;
+        while (left <= right) {
+            int bin = (int)((centers[*left].data()[bestAxis] - lower) * scale);
+            if (bin > Bins - 1)
+                bin = Bins - 1;
+            if (bin < bestSplit) {
+                ++left;
+            } else {
+                std::swap(*left, *right);
+                --right;
+            }
+        }
+        leftCount = (unsigned int)(left - (mIndices + first));
+    } else if (count > MaxLeafSize) {
+        // Splitting doesn't pay off, but the leaf would be too large. This happens when
+        // all centers coincide, in which case the order is arbitrary anyway.
+        leftCount = count / 2;
+    } else {
+        return;
+    }
+
+    const unsigned int leftChild = mNodeCount;
+    mNodeCount += 2;
+
+    mNodes[leftChild].leftFirst = first;
+    mNodes[leftChild].count = leftCount;
+    mNodes[leftChild + 1].leftFirst = first + leftCount;
+    mNodes[leftChild + 1].count = count - leftCount;
+
+    node.leftFirst = leftChild;
+    node.count = 0;
+
+    BuildTask leftTask = { leftChild, task.depth + 1 };
+    BuildTask rightTask = { leftChild + 1, task.depth + 1 };
+    tasks.push_back(rightTask);
+    tasks.push_back(leftTask);
+}
+
+template<typename Test, typename Visitor>
+GAMEMATH_INLINE void Bvh::traverse(const Test &test, Visitor &visitor) const
+{
+    if (!mNodeCount)
+        return;
+
+    unsigned int stack[TraversalStackSize];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize) {
+        const BvhNode &node = mNodes[stack[--stackSize]];
+
+        if (!test(node.bounds()))
+            continue;
+
+        if (node.isLeaf()) {
+            for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+                if (test(mPrimitiveBoxes[i]))
+                    visitor(mIndices[i]);
+            }
+        } else {
+            stack[stackSize++] = node.leftFirst + 1;
+            stack[stackSize++] = node.leftFirst;
+        }
+    }
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void Bvh::visit(const Ray3d &ray, Visitor &visitor) const
+{
+    traverse(BvhRayTest(ray), visitor);
+}
+
+template<int Size, typename Visitor>
+GAMEMATH_INLINE void Bvh::visit(const RayPacket<Size> &packet, Visitor &visitor) const
+{
+    if (!mNodeCount)
+        return;
+
+    // Rays that miss a node can't hit its children, so the mask of the parent is kept on the stack
+    unsigned int stack[TraversalStackSize];
+    int stackMasks[TraversalStackSize];
+    unsigned int stackSize = 0;
+    stack[stackSize] = 0;
+    stackMasks[stackSize++] = RayPacket<Size>::AllRays;
+
+    while (stackSize) {
+        --stackSize;
+        const BvhNode &node = mNodes[stack[stackSize]];
+
+        const int mask = packet.intersects(node.bounds()) & stackMasks[stackSize];
+        if (!mask)
+            continue;
+
+        if (node.isLeaf()) {
+            for (unsigned int i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+                const int hits = packet.intersects(mPrimitiveBoxes[i]) & mask;
+                if (hits)
+                    visitor(mIndices[i], hits);
+            }
+        } else {
+            stack[stackSize] = node.leftFirst + 1;
+            stackMasks[stackSize++] = mask;
+            stack[stackSize] = node.leftFirst;
+            stackMasks[stackSize++] = mask;
+        }
+    }
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void Bvh::visit(const Box3d &box, Visitor &visitor) const
+{
+    traverse(BvhBoxTest(box), visitor);
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void Bvh::visit(const Frustum &frustum, Visitor &visitor) const
+{
+    traverse(BvhFrustumTest(frustum), visitor);
+}
+
+GAMEMATH_INLINE void Bvh::query(const Ray3d &ray, std::vector<unsigned int> &result) const
+{
+    BvhResultCollector collector(result);
+    visit(ray, collector);
+}
+
+GAMEMATH_INLINE void Bvh::query(const Box3d &box, std::vector<unsigned int> &result) const
+{
+    BvhResultCollector collector(result);
+    visit(box, collector);
+}
+
+GAMEMATH_INLINE void Bvh::query(const Frustum &frustum, std::vector<unsigned int> &result) const
+{
+    BvhResultCollector collector(result);
+    visit(frustum, collector);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#include "bvh_linear.h"
+#include "bvh_refit.h"
+
+#endif // BVH_H
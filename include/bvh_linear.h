@@ -0,0 +1,514 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "gamemath_parallel.h"
+#include "bvh.h"
+
+#if !defined(BVH_H)
+#error "Do not include this file directly, only include bvh.h"
+#endif
+
+#include <cstring>
+
+GAMEMATH_NAMESPACE_BEGIN
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 MortonCode64;
+#else
+typedef unsigned long long MortonCode64;
+#endif
+
+GAMEMATH_INLINE int _count_leading_zeros(unsigned int value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    if (!_BitScanReverse(&index, value))
+        return 32;
+    return 31 - (int)index;
+#else
+    return value ? __builtin_clz(value) : 32;
+#endif
+}
+
+GAMEMATH_INLINE int _count_leading_zeros(MortonCode64 value)
+{
+    const unsigned int high = (unsigned int)(value >> 32);
+    if (high)
+        return _count_leading_zeros(high);
+    return 32 + _count_leading_zeros((unsigned int)value);
+}
+
+/**
+  Spreads the lower 21 bits of a value, so that two zero bits follow each of them.
+  */
+GAMEMATH_INLINE MortonCode64 _expand_bits_21(MortonCode64 v)
+{
+    v &= 0x1FFFFF;
+    v = (v | (v << 32)) & 0x1F00000000FFFFULL;
+    v = (v | (v << 16)) & 0x1F0000FF0000FFULL;
+    v = (v | (v << 8)) & 0x100F00F00F00F00FULL;
+    v = (v | (v << 4)) & 0x10C30C30C30C30C3ULL;
+    v = (v | (v << 2)) & 0x1249249249249249ULL;
+    return v;
+}
+
+GAMEMATH_INLINE unsigned int _expand_bits_10(unsigned int v)
+{
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+
+/**
+  Spreads the lower 10 bits of each 32-bit lane, so that two zero bits follow each of them.
+  */
+GAMEMATH_INLINE __m128i _expand_bits_10(__m128i v)
+{
+    v = _mm_and_si128(v, _mm_set1_epi32(0x3FF));
+    v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 16)), _mm_set1_epi32(0x030000FF));
+    v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 8)), _mm_set1_epi32(0x0300F00F));
+    v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 4)), _mm_set1_epi32(0x030C30C3));
+    v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 2)), _mm_set1_epi32(0x09249249));
+    return v;
+}
+
+#endif
+
+/**
+  Computes the Morton codes of the box centers, quantized to the given grid.
+  */
+class MortonCodeKernel {
+public:
+    MortonCodeKernel(const Box3d *boxes, const Box3d &centerBounds, unsigned int *codes30, MortonCode64 *codes63)
+        : mBoxes(boxes), mCodes30(codes30), mCodes63(codes63)
+    {
+        const float gridSize = codes30 ? 1023.0f : 2097151.0f;
+        const Vector4 extent = centerBounds.maximum() - centerBounds.minimum();
+
+        mOffset = centerBounds.minimum();
+        mScale = Vector4(extent.x() > 0 ? gridSize / extent.x() : 0,
+                         extent.y() > 0 ? gridSize / extent.y() : 0,
+                         extent.z() > 0 ? gridSize / extent.z() : 0,
+                         0);
+        mGridSize = Vector4(gridSize, gridSize, gridSize, 0);
+    }
+
+    void operator()(int, size_t begin, size_t end) const
+    {
+        size_t i = begin;
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 zero = _mm_setzero_ps();
+
+        // Quantize four centers at once and transpose them, so each register holds one axis
+        for (; i + 4 <= end; i += 4) {
+            __m128 c0 = _mm_mul_ps(_mm_add_ps(mBoxes[i].minimum(), mBoxes[i].maximum()), half);
+            __m128 c1 = _mm_mul_ps(_mm_add_ps(mBoxes[i + 1].minimum(), mBoxes[i + 1].maximum()), half);
+            __m128 c2 = _mm_mul_ps(_mm_add_ps(mBoxes[i + 2].minimum(), mBoxes[i + 2].maximum()), half);
+            __m128 c3 = _mm_mul_ps(_mm_add_ps(mBoxes[i + 3].minimum(), mBoxes[i + 3].maximum()), half);
+
+            c0 = quantize(c0, zero);
+            c1 = quantize(c1, zero);
+            c2 = quantize(c2, zero);
+            c3 = quantize(c3, zero);
+
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+            const __m128i x = _mm_cvttps_epi32(c0);
+            const __m128i y = _mm_cvttps_epi32(c1);
+            const __m128i z = _mm_cvttps_epi32(c2);
+
+            if (mCodes30) {
+                __m128i code = _mm_slli_epi32(_expand_bits_10(x), 2);
+                code = _mm_or_si128(code, _mm_slli_epi32(_expand_bits_10(y), 1));
+                code = _mm_or_si128(code, _expand_bits_10(z));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(mCodes30 + i), code);
+            } else {
+                GAMEMATH_ALIGN unsigned int cells[3][4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(cells[0]), x);
+                _mm_store_si128(reinterpret_cast<__m128i*>(cells[1]), y);
+                _mm_store_si128(reinterpret_cast<__m128i*>(cells[2]), z);
+                for (int j = 0; j < 4; ++j)
+                    mCodes63[i + j] = (_expand_bits_21(cells[0][j]) << 2) | (_expand_bits_21(cells[1][j]) << 1) | _expand_bits_21(cells[2][j]);
+            }
+        }
+#endif
+
+        for (; i < end; ++i) {
+            const Vector4 center = mBoxes[i].center();
+            unsigned int cells[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                float cell = (center.data()[axis] - mOffset.data()[axis]) * mScale.data()[axis];
+                cell = std::min(std::max(cell, 0.0f), mGridSize.data()[axis]);
+                cells[axis] = (unsigned int)cell;
+            }
+
+            if (mCodes30)
+                mCodes30[i] = (_expand_bits_10(cells[0]) << 2) | (_expand_bits_10(cells[1]) << 1) | _expand_bits_10(cells[2]);
+            else
+                mCodes63[i] = (_expand_bits_21(cells[0]) << 2) | (_expand_bits_21(cells[1]) << 1) | _expand_bits_21(cells[2]);
+        }
+    }
+
+private:
+#if !defined(GAMEMATH_NO_INTRINSICS)
+    __m128 quantize(__m128 center, __m128 zero) const
+    {
+        const __m128 cell = _mm_mul_ps(_mm_sub_ps(center, mOffset), mScale);
+        return _mm_min_ps(_mm_max_ps(cell, zero), mGridSize);
+    }
+#endif
+
+    const Box3d *mBoxes;
+    unsigned int *mCodes30;
+    MortonCode64 *mCodes63;
+    Vector4 mOffset;
+    Vector4 mScale;
+    Vector4 mGridSize;
+};
+
+/**
+  The number of key bits sorted per radix sort pass. 30-bit Morton codes are sorted in three passes.
+  */
+const int RadixDigitBits = 11;
+const unsigned int RadixDigits = 1 << RadixDigitBits;
+
+/**
+  Counts the occurrences of each radix digit within a range of keys.
+  */
+template<typename Key>
+class RadixHistogramKernel {
+public:
+    RadixHistogramKernel(const Key *keys, unsigned int *histograms, int shift)
+        : mKeys(keys), mHistograms(histograms), mShift(shift)
+    {
+    }
+
+    void operator()(int range, size_t begin, size_t end) const
+    {
+        unsigned int *histogram = mHistograms + range * RadixDigits;
+        for (size_t i = begin; i < end; ++i)
+            histogram[(mKeys[i] >> mShift) & (RadixDigits - 1)]++;
+    }
+
+private:
+    const Key *mKeys;
+    unsigned int *mHistograms;
+    int mShift;
+};
+
+/**
+  Moves a range of keys and values to their sorted position. The histograms must have been
+  converted to output offsets beforehand.
+  */
+template<typename Key>
+class RadixScatterKernel {
+public:
+    RadixScatterKernel(const Key *keys, const unsigned int *values, Key *sortedKeys, unsigned int *sortedValues,
+                       unsigned int *offsets, int shift)
+        : mKeys(keys), mValues(values), mSortedKeys(sortedKeys), mSortedValues(sortedValues), mOffsets(offsets), mShift(shift)
+    {
+    }
+
+    void operator()(int range, size_t begin, size_t end) const
+    {
+        unsigned int *offsets = mOffsets + range * RadixDigits;
+        for (size_t i = begin; i < end; ++i) {
+            const unsigned int target = offsets[(mKeys[i] >> mShift) & (RadixDigits - 1)]++;
+            mSortedKeys[target] = mKeys[i];
+            mSortedValues[target] = mValues[i];
+        }
+    }
+
+private:
+    const Key *mKeys;
+    const unsigned int *mValues;
+    Key *mSortedKeys;
+    unsigned int *mSortedValues;
+    unsigned int *mOffsets;
+    int mShift;
+};
+
+/**
+  Sorts keys and their associated values using a parallel least-significant-digit radix sort.
+  Only the lower bits of the keys are considered. The sorted data ends up in keys and values,
+  the temporary arrays must be of the same size.
+  */
+template<typename Key>
+GAMEMATH_INLINE void _radix_sort(Key *keys, unsigned int *values, Key *tempKeys, unsigned int *tempValues, size_t count, int bits)
+{
+    const int ranges = parallelRangeCount(count);
+    unsigned int *histograms = new unsigned int[ranges * RadixDigits];
+
+    const int passes = (bits + RadixDigitBits - 1) / RadixDigitBits;
+    for (int pass = 0; pass < passes; ++pass) {
+        const int shift = pass * RadixDigitBits;
+
+        std::memset(histograms, 0, sizeof(unsigned int) * ranges * RadixDigits);
+        RadixHistogramKernel<Key> histogramKernel(keys, histograms, shift);
+        parallelForRanges(count, ranges, histogramKernel);
+
+        // Turn the per-range counts into output offsets. Ranges with the same digit are placed
+        // in order, which keeps the sort stable.
+        unsigned int offset = 0;
+        for (unsigned int digit = 0; digit < RadixDigits; ++digit) {
+            for (int range = 0; range < ranges; ++range) {
+                const unsigned int digitCount = histograms[range * RadixDigits + digit];
+                histograms[range * RadixDigits + digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        RadixScatterKernel<Key> scatterKernel(keys, values, tempKeys, tempValues, histograms, shift);
+        parallelForRanges(count, ranges, scatterKernel);
+
+        std::swap(keys, tempKeys);
+        std::swap(values, tempValues);
+    }
+
+    // An odd number of passes leaves the result in the temporary arrays
+    if (passes % 2) {
+        std::memcpy(tempKeys, keys, sizeof(Key) * count);
+        std::memcpy(tempValues, values, sizeof(unsigned int) * count);
+    }
+
+    delete [] histograms;
+}
+
+/**
+  Emits the inner nodes of a linear hierarchy from sorted Morton codes, following
+  "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees" by Tero Karras.
+
+  The children of inner node i are stored in node slots 2i+1 and 2i+2, so siblings are adjacent
+  as required by BvhNode. Inner node 0 is the root and occupies slot 0.
+  */
+template<typename Key>
+class KarrasKernel {
+public:
+    KarrasKernel(const Key *codes, int count, BvhNode *nodes, unsigned int *innerSlots, unsigned int *leafSlots)
+        : mCodes(codes), mCount(count), mNodes(nodes), mInnerSlots(innerSlots), mLeafSlots(leafSlots)
+    {
+    }
+
+    void operator()(int, size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+            emit((int)i);
+    }
+
+private:
+    /**
+      Returns the length of the common prefix of the codes at i and j, or -1 if j is out of range.
+      Duplicate codes are made unique by appending their index.
+      */
+    int commonPrefix(int i, int j) const
+    {
+        if (j < 0 || j >= mCount)
+            return -1;
+        if (mCodes[i] == mCodes[j])
+            return (int)sizeof(Key) * 8 + _count_leading_zeros((unsigned int)(i ^ j));
+        return _count_leading_zeros(mCodes[i] ^ mCodes[j]);
+    }
+
+    void emit(int i) const
+    {
+        // Determine the direction of the range covered by this node
+        const int direction = commonPrefix(i, i + 1) - commonPrefix(i, i - 1) >= 0 ? 1 : -1;
+        const int minimumPrefix = commonPrefix(i, i - direction);
+
+        // Find the other end of the range using an exponential, then a binary search
+        int maximumLength = 2;
+        while (commonPrefix(i, i + maximumLength * direction) > minimumPrefix)
+            maximumLength *= 2;
+
+        int length = 0;
+        for (int step = maximumLength / 2; step >= 1; step /= 2) {
+            if (commonPrefix(i, i + (length + step) * direction) > minimumPrefix)
+                length += step;
+        }
+        const int j = i + length * direction;
+
+        // Find the split position using a binary search
+        const int nodePrefix = commonPrefix(i, j);
+        int split = 0;
+        int step = length;
+        do {
+            step = (step + 1) / 2;
+            if (commonPrefix(i, i + (split + step) * direction) > nodePrefix)
+                split += step;
+        } while (step > 1);
+
+        const int gamma = i + split * direction + (direction < 0 ? -1 : 0);
+        const int first = std::min(i, j);
+        const int last = std::max(i, j);
+
+        const unsigned int leftSlot = 2 * i + 1;
+        BvhNode &left = mNodes[leftSlot];
+        BvhNode &right = mNodes[leftSlot + 1];
+
+        if (first == gamma) {
+            left.leftFirst = gamma;
+            left.count = 1;
+            mLeafSlots[gamma] = leftSlot;
+        } else {
+            left.leftFirst = 2 * gamma + 1;
+            left.count = 0;
+            mInnerSlots[gamma] = leftSlot;
+        }
+
+        if (last == gamma + 1) {
+            right.leftFirst = gamma + 1;
+            right.count = 1;
+            mLeafSlots[gamma + 1] = leftSlot + 1;
+        } else {
+            right.leftFirst = 2 * (gamma + 1) + 1;
+            right.count = 0;
+            mInnerSlots[gamma + 1] = leftSlot + 1;
+        }
+    }
+
+    const Key *mCodes;
+    int mCount;
+    BvhNode *mNodes;
+    unsigned int *mInnerSlots;
+    unsigned int *mLeafSlots;
+};
+
+/**
+  Copies the boxes into the leaves and propagates the bounds towards the root. The second
+  thread to arrive at an inner node computes its bounds, the first one stops there.
+  If only a single thread is used, the visit counters don't need to be atomic.
+  */
+class LinearBvhBoundsKernel {
+public:
+    LinearBvhBoundsKernel(const Box3d *boxes, const unsigned int *indices, BvhNode *nodes, Box3d *primitiveBoxes,
+                          const unsigned int *innerSlots, const unsigned int *leafSlots, volatile long *visits,
+                          bool atomic)
+        : mBoxes(boxes), mIndices(indices), mNodes(nodes), mPrimitiveBoxes(primitiveBoxes),
+        mInnerSlots(innerSlots), mLeafSlots(leafSlots), mVisits(visits), mAtomic(atomic)
+    {
+    }
+
+    void operator()(int, size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i) {
+            const Box3d &box = mBoxes[mIndices[i]];
+            mPrimitiveBoxes[i] = box;
+
+            unsigned int slot = mLeafSlots[i];
+            mNodes[slot].setBounds(box);
+
+            while (slot != 0) {
+                const unsigned int parent = (slot - 1) / 2;
+                const long visits = mAtomic ? parallelAtomicIncrement(mVisits + parent) : ++mVisits[parent];
+                if (visits == 1)
+                    break;
+
+                slot = mInnerSlots[parent];
+                mNodes[slot].setBoundsToUnion(mNodes[2 * parent + 1], mNodes[2 * parent + 2]);
+            }
+        }
+    }
+
+private:
+    const Box3d *mBoxes;
+    const unsigned int *mIndices;
+    BvhNode *mNodes;
+    Box3d *mPrimitiveBoxes;
+    const unsigned int *mInnerSlots;
+    const unsigned int *mLeafSlots;
+    volatile long *mVisits;
+    bool mAtomic;
+};
+
+template<typename Key>
+GAMEMATH_INLINE void _build_linear_hierarchy(const Key *codes, unsigned int count, BvhNode *nodes,
+                                             unsigned int *innerSlots, unsigned int *leafSlots)
+{
+    innerSlots[0] = 0;
+    nodes[0].leftFirst = 1;
+    nodes[0].count = 0;
+
+    KarrasKernel<Key> kernel(codes, (int)count, nodes, innerSlots, leafSlots);
+    parallelForRanges(count - 1, parallelRangeCount(count - 1, ParallelMinimumGrain / 16), kernel);
+}
+
+/**
+  Rounds the size of an array in the scratch buffer up to a multiple of eight bytes, so the array
+  after it is aligned for 64-bit elements.
+  */
+GAMEMATH_INLINE size_t _scratch_align(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+GAMEMATH_INLINE void Bvh::buildLinear(const Box3d *boxes, unsigned int count, MortonPrecision precision)
+{
+    allocate(count);
+    mLinear = true;
+    mPrecision = precision;
+
+    if (!count)
+        return;
+
+    mNodeCount = 2 * count - 1;
+
+    if (count == 1) {
+        mIndices[0] = 0;
+        mPrimitiveBoxes[0] = boxes[0];
+        mNodes[0].leftFirst = 0;
+        mNodes[0].count = 1;
+        mNodes[0].setBounds(boxes[0]);
+        return;
+    }
+
+    // The Morton grid spans the bounds of the box centers
+    Box3d centerBounds(boxes[0].center(), boxes[0].center());
+    for (unsigned int i = 1; i < count; ++i)
+        centerBounds.merge(boxes[i].center());
+
+    for (unsigned int i = 0; i < count; ++i)
+        mIndices[i] = i;
+
+    // All temporary arrays are carved out of the scratch buffer, which is kept for the next build. Every
+    // array starts at a multiple of eight bytes, which keeps the 64-bit codes and the atomic counters
+    // aligned regardless of the size of long.
+    const size_t keySize = precision == Morton30 ? sizeof(unsigned int) : sizeof(MortonCode64);
+    const size_t keyBytes = _scratch_align(keySize * count);
+    const size_t visitBytes = _scratch_align(sizeof(long) * count);
+    const size_t slotBytes = _scratch_align(sizeof(unsigned int) * count);
+    char *scratchData = static_cast<char*>(scratch(2 * keyBytes + visitBytes + 3 * slotBytes));
+    void *codes = scratchData;
+    void *tempCodes = scratchData + keyBytes;
+    volatile long *visits = reinterpret_cast<volatile long*>(scratchData + 2 * keyBytes);
+    unsigned int *tempIndices = reinterpret_cast<unsigned int*>(scratchData + 2 * keyBytes + visitBytes);
+    unsigned int *innerSlots = reinterpret_cast<unsigned int*>(scratchData + 2 * keyBytes + visitBytes + slotBytes);
+    unsigned int *leafSlots = reinterpret_cast<unsigned int*>(scratchData + 2 * keyBytes + visitBytes + 2 * slotBytes);
+
+    const int ranges = parallelRangeCount(count);
+
+    if (precision == Morton30) {
+        MortonCodeKernel codeKernel(boxes, centerBounds, static_cast<unsigned int*>(codes), 0);
+        parallelForRanges(count, ranges, codeKernel);
+        _radix_sort(static_cast<unsigned int*>(codes), mIndices, static_cast<unsigned int*>(tempCodes), tempIndices, count, 30);
+        _build_linear_hierarchy(static_cast<unsigned int*>(codes), count, mNodes, innerSlots, leafSlots);
+    } else {
+        MortonCodeKernel codeKernel(boxes, centerBounds, 0, static_cast<MortonCode64*>(codes));
+        parallelForRanges(count, ranges, codeKernel);
+        _radix_sort(static_cast<MortonCode64*>(codes), mIndices, static_cast<MortonCode64*>(tempCodes), tempIndices, count, 63);
+        _build_linear_hierarchy(static_cast<MortonCode64*>(codes), count, mNodes, innerSlots, leafSlots);
+    }
+
+    std::memset((void*)visits, 0, sizeof(long) * (count - 1));
+
+    LinearBvhBoundsKernel boundsKernel(boxes, mIndices, mNodes, mPrimitiveBoxes, innerSlots, leafSlots, visits, ranges > 1);
+    parallelForRanges(count, ranges, boundsKernel);
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,175 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "bvh.h"
+
+#if !defined(BVH_H)
+#error "Do not include this file directly, only include bvh.h"
+#endif
+
+#include <algorithm>
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE double Bvh::nodeCost(const BvhNode &node) const
+{
+    // Same cost model as the builder: traversing a node costs as much as testing a box
+    return (double)node.bounds().surfaceArea() * (node.isLeaf() ? node.count : 1);
+}
+
+GAMEMATH_INLINE void Bvh::prepareRefit() const
+{
+    mParents.assign(mNodeCount, 0);
+    mLeaves.resize(mPrimitiveCount);
+    mPositions.resize(mPrimitiveCount);
+    mDirty.assign(mNodeCount, 0);
+    mCostSum = 0;
+
+    for (unsigned int i = 0; i < mNodeCount; ++i) {
+        const BvhNode &node = mNodes[i];
+        mCostSum += nodeCost(node);
+
+        if (node.isLeaf()) {
+            for (unsigned int j = node.leftFirst; j < node.leftFirst + node.count; ++j)
+                mLeaves[j] = i;
+        } else {
+            mParents[node.leftFirst] = i;
+            mParents[node.leftFirst + 1] = i;
+        }
+    }
+
+    for (unsigned int i = 0; i < mPrimitiveCount; ++i)
+        mPositions[mIndices[i]] = i;
+
+    mRefitPrepared = true;
+    mBuildCost = cost();
+}
+
+GAMEMATH_INLINE void Bvh::updatePrimitive(unsigned int index, const Box3d &box)
+{
+    if (!mRefitPrepared)
+        prepareRefit();
+
+    const unsigned int position = mPositions[index];
+    mPrimitiveBoxes[position] = box;
+
+    // Stop at the first dirty node, the path above it has already been marked
+    unsigned int node = mLeaves[position];
+    while (!mDirty[node]) {
+        mDirty[node] = 1;
+        if (node == 0)
+            break;
+        node = mParents[node];
+    }
+}
+
+GAMEMATH_INLINE void Bvh::refit()
+{
+    if (!mNodeCount)
+        return;
+
+    if (!mRefitPrepared)
+        prepareRefit();
+
+    if (!mDirty[0])
+        return;
+
+    // Post-order traversal of the dirty nodes. The high bit marks inner nodes whose
+    // children have already been pushed.
+    const unsigned int Expanded = 0x80000000;
+    unsigned int stack[2 * TraversalStackSize];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize) {
+        const unsigned int entry = stack[stackSize - 1];
+        const unsigned int index = entry & ~Expanded;
+        BvhNode &node = mNodes[index];
+
+        if (!node.isLeaf() && !(entry & Expanded)) {
+            stack[stackSize - 1] = entry | Expanded;
+            if (mDirty[node.leftFirst + 1])
+                stack[stackSize++] = node.leftFirst + 1;
+            if (mDirty[node.leftFirst])
+                stack[stackSize++] = node.leftFirst;
+            continue;
+        }
+
+        --stackSize;
+
+        const double oldCost = nodeCost(node);
+
+        if (node.isLeaf()) {
+            Box3d bounds = mPrimitiveBoxes[node.leftFirst];
+            for (unsigned int i = node.leftFirst + 1; i < node.leftFirst + node.count; ++i)
+                bounds.merge(mPrimitiveBoxes[i]);
+            node.setBounds(bounds);
+        } else {
+            node.setBoundsToUnion(mNodes[node.leftFirst], mNodes[node.leftFirst + 1]);
+        }
+
+        mCostSum += nodeCost(node) - oldCost;
+        mDirty[index] = 0;
+    }
+}
+
+GAMEMATH_INLINE void Bvh::refit(const Box3d *boxes)
+{
+    if (!mNodeCount)
+        return;
+
+    if (!mRefitPrepared)
+        prepareRefit();
+
+    for (unsigned int i = 0; i < mPrimitiveCount; ++i)
+        mPrimitiveBoxes[i] = boxes[mIndices[i]];
+
+    std::fill(mDirty.begin(), mDirty.end(), 1);
+    refit();
+}
+
+GAMEMATH_INLINE bool Bvh::refitOrRebuild(const Box3d *boxes, float rebuildThreshold)
+{
+    refit(boxes);
+
+    if (!needsRebuild(rebuildThreshold))
+        return false;
+
+    if (mLinear)
+        buildLinear(boxes, mPrimitiveCount, mPrecision);
+    else
+        build(boxes, mPrimitiveCount);
+    return true;
+}
+
+GAMEMATH_INLINE float Bvh::cost() const
+{
+    if (!mNodeCount)
+        return 0;
+
+    if (!mRefitPrepared)
+        prepareRefit();
+
+    const float rootArea = mNodes[0].bounds().surfaceArea();
+    if (rootArea <= 0)
+        return 0;
+
+    return (float)(mCostSum / rootArea);
+}
+
+GAMEMATH_INLINE float Bvh::costRatio() const
+{
+    const float currentCost = cost();
+
+    if (mBuildCost <= 0)
+        return 1;
+
+    return currentCost / mBuildCost;
+}
+
+GAMEMATH_INLINE bool Bvh::needsRebuild(float rebuildThreshold) const
+{
+    return costRatio() > rebuildThreshold;
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,198 @@
+#ifndef DUAL_QUATERNION_H
+#define DUAL_QUATERNION_H
+
+#include <cstddef>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "quaternion.h"
+#include "matrix4.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A rigid transformation, a rotation followed by a translation, stored as a pair of quaternions.
+  The real part is the rotation and the dual part is half the translation times the rotation.
+
+  At 32 bytes this is half the size of a Matrix4, and blending dual quaternions keeps the blended
+  transformation rigid. This makes them a good fit for skinning palettes, see skinVertices.
+  Dual quaternions can't represent scaling.
+
+  This doesn't derive from AlignedAllocation, since the first Quaternion member already does and two
+  AlignedAllocation bases can't share an address, which would pad the class to 48 bytes. The aligned
+  allocation operators are forwarded instead.
+  */
+GAMEMATH_ALIGNEDTYPE_PRE class GAMEMATH_ALIGNEDTYPE_MID DualQuaternion {
+friend GAMEMATH_INLINE DualQuaternion operator *(const DualQuaternion &a, const DualQuaternion &b);
+public:
+    GAMEMATH_INLINE void* operator new(size_t size)
+    {
+        return AlignedAllocation::operator new(size);
+    }
+
+    GAMEMATH_INLINE void operator delete(void *ptr)
+    {
+        AlignedAllocation::operator delete(ptr);
+    }
+
+    GAMEMATH_INLINE void* operator new[](size_t size)
+    {
+        return AlignedAllocation::operator new[](size);
+    }
+
+    GAMEMATH_INLINE void operator delete[](void *ptr)
+    {
+        AlignedAllocation::operator delete[](ptr);
+    }
+
+    GAMEMATH_INLINE void* operator new(size_t, void *ptr) {
+        return ptr;
+    }
+
+    /**
+      Creates an uninitialized dual quaternion.
+      */
+    DualQuaternion();
+
+    DualQuaternion(const Quaternion &real, const Quaternion &dual);
+
+    /**
+      Returns the dual quaternion that doesn't move anything.
+      */
+    static DualQuaternion identity();
+
+    /**
+      Creates a transformation that rotates and then translates, like Matrix4::transformation with a
+      scale of one. The w component of the translation is ignored.
+      */
+    static DualQuaternion transformation(const Quaternion &rotation, const Vector4 &translation);
+
+    /**
+      Same as transformation for arrays of rotations and translations.
+      */
+    static void transformation(const Quaternion *rotations, const Vector4 *translations, size_t count,
+                               DualQuaternion *results);
+
+    const Quaternion &real() const;
+    const Quaternion &dual() const;
+
+    /**
+      Returns the rotation of this transformation, which is the real part.
+      */
+    const Quaternion &rotation() const;
+
+    /**
+      Returns the translation of this transformation. The w component is zero.
+      */
+    Vector4 translation() const;
+
+    /**
+      Returns the inverse of this transformation. Both parts are conjugated, which is only the inverse
+      if the real part is normalized.
+      */
+    DualQuaternion conjugated() const;
+
+    /**
+      Rotates and translates the x, y and z components of a position. The w component is passed through.
+      */
+    Vector4 mapPosition(const Vector4 &position) const;
+
+    /**
+      Rotates the x, y and z components of a normal. The w component is passed through.
+      */
+    Vector4 mapNormal(const Vector4 &normal) const;
+
+    /**
+      Converts this transformation to a matrix, which is the same as the one created by
+      Matrix4::transformation with a scale of one.
+      */
+    Matrix4 toMatrix() const;
+
+    /**
+      Blends two transformations linearly and normalizes the result. b is negated if its rotation is
+      more than 180 degrees away from a. Unlike interpolating matrices, the result is always rigid.
+      */
+    static DualQuaternion nlerp(const DualQuaternion &a, const DualQuaternion &b, float weight);
+
+    /**
+      Same as nlerp for arrays of pairs, with one weight per pair. results may be the same array as a or b.
+      */
+    static void nlerp(const DualQuaternion *a, const DualQuaternion *b, const float *weights, size_t count,
+                      DualQuaternion *results);
+
+private:
+    Quaternion mReal;
+    Quaternion mDual;
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+GAMEMATH_INLINE DualQuaternion::DualQuaternion()
+{
+}
+
+GAMEMATH_INLINE DualQuaternion::DualQuaternion(const Quaternion &real, const Quaternion &dual)
+    : mReal(real), mDual(dual)
+{
+}
+
+GAMEMATH_INLINE DualQuaternion DualQuaternion::identity()
+{
+    return DualQuaternion(Quaternion(0, 0, 0, 1), Quaternion(0, 0, 0, 0));
+}
+
+GAMEMATH_INLINE DualQuaternion DualQuaternion::transformation(const Quaternion &rotation, const Vector4 &translation)
+{
+    const Quaternion halfTranslation(0.5f * translation.x(), 0.5f * translation.y(), 0.5f * translation.z(), 0);
+    return DualQuaternion(rotation, halfTranslation * rotation);
+}
+
+GAMEMATH_INLINE void DualQuaternion::transformation(const Quaternion *rotations, const Vector4 *translations,
+                                                    size_t count, DualQuaternion *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = transformation(rotations[i], translations[i]);
+}
+
+GAMEMATH_INLINE const Quaternion &DualQuaternion::real() const
+{
+    return mReal;
+}
+
+GAMEMATH_INLINE const Quaternion &DualQuaternion::dual() const
+{
+    return mDual;
+}
+
+GAMEMATH_INLINE const Quaternion &DualQuaternion::rotation() const
+{
+    return mReal;
+}
+
+GAMEMATH_INLINE DualQuaternion DualQuaternion::conjugated() const
+{
+    return DualQuaternion(mReal.conjugated(), mDual.conjugated());
+}
+
+GAMEMATH_INLINE DualQuaternion operator *(const DualQuaternion &a, const DualQuaternion &b)
+{
+    return DualQuaternion(a.mReal * b.mReal, a.mReal * b.mDual + a.mDual * b.mReal);
+}
+
+GAMEMATH_INLINE Vector4 DualQuaternion::mapNormal(const Vector4 &normal) const
+{
+    return mReal.rotate(normal);
+}
+
+GAMEMATH_INLINE Matrix4 DualQuaternion::toMatrix() const
+{
+    return Matrix4::transformation(Vector4(1, 1, 1, 0), mReal, translation());
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "dual_quaternion_sse.h"
+#else
+#include "dual_quaternion_sisd.h"
+#endif
+
+#endif // DUAL_QUATERNION_H
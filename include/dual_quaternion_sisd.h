@@ -0,0 +1,59 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "dual_quaternion.h"
+
+#if !defined(DUAL_QUATERNION_H)
+#error "Do not include this file directly, only include dual_quaternion.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE Vector4 DualQuaternion::translation() const
+{
+    // 2 (real.w dual.xyz - dual.w real.xyz + real.xyz x dual.xyz)
+    const Quaternion &r = mReal;
+    const Quaternion &d = mDual;
+    return Vector4(2 * (r.w() * d.x() - d.w() * r.x() + r.y() * d.z() - r.z() * d.y()),
+        2 * (r.w() * d.y() - d.w() * r.y() + r.z() * d.x() - r.x() * d.z()),
+        2 * (r.w() * d.z() - d.w() * r.z() + r.x() * d.y() - r.y() * d.x()),
+        0);
+}
+
+GAMEMATH_INLINE Vector4 DualQuaternion::mapPosition(const Vector4 &position) const
+{
+    const Vector4 rotated = mReal.rotate(position);
+    const Vector4 offset = translation();
+    return Vector4(rotated.x() + offset.x(), rotated.y() + offset.y(), rotated.z() + offset.z(), rotated.w());
+}
+
+GAMEMATH_INLINE DualQuaternion DualQuaternion::nlerp(const DualQuaternion &a, const DualQuaternion &b, float weight)
+{
+    const float *realA = a.mReal.data();
+    const float *dualA = a.mDual.data();
+    const float *realB = b.mReal.data();
+    const float *dualB = b.mDual.data();
+
+    const float cosAngle = realA[0] * realB[0] + realA[1] * realB[1] + realA[2] * realB[2] + realA[3] * realB[3];
+    const float weightA = 1 - weight;
+    const float weightB = cosAngle < 0 ? -weight : weight;
+
+    float real[4], dual[4];
+    for (int i = 0; i < 4; ++i) {
+        real[i] = weightA * realA[i] + weightB * realB[i];
+        dual[i] = weightA * dualA[i] + weightB * dualB[i];
+    }
+
+    const float invLength = 1 / sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+    return DualQuaternion(Quaternion(real[0] * invLength, real[1] * invLength, real[2] * invLength, real[3] * invLength),
+        Quaternion(dual[0] * invLength, dual[1] * invLength, dual[2] * invLength, dual[3] * invLength));
+}
+
+GAMEMATH_INLINE void DualQuaternion::nlerp(const DualQuaternion *a, const DualQuaternion *b, const float *weights,
+                                           size_t count, DualQuaternion *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = nlerp(a[i], b[i], weights[i]);
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,97 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "dual_quaternion.h"
+
+#if !defined(DUAL_QUATERNION_H)
+#error "Do not include this file directly, only include dual_quaternion.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Computes the translation 2 (dual * conjugated(real)) of a dual quaternion from its parts, which is
+  2 (real.w dual.xyz - dual.w real.xyz + real.xyz x dual.xyz). The w component of the result is zero.
+  */
+GAMEMATH_INLINE __m128 _dual_quaternion_translation(const __m128 real, const __m128 dual)
+{
+    const __m128 realW = _mm_shuffle_ps(real, real, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 dualW = _mm_shuffle_ps(dual, dual, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 translation = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(realW, dual), _mm_mul_ps(dualW, real)),
+        _quaternion_cross(real, dual));
+    return _mm_add_ps(translation, translation);
+}
+
+/**
+  Rotates the x, y and z components of vector by the normalized quaternion real and adds translation.
+  */
+GAMEMATH_INLINE __m128 _dual_quaternion_transform(const __m128 real, const __m128 translation, const __m128 vector)
+{
+    const __m128 realW = _mm_shuffle_ps(real, real, _MM_SHUFFLE(3, 3, 3, 3));
+
+    // t = 2 (q x v), v' = v + w t + q x t, as in Quaternion::rotate
+    __m128 t = _quaternion_cross(real, vector);
+    t = _mm_add_ps(t, t);
+    return _mm_add_ps(_mm_add_ps(vector, translation), _mm_add_ps(_mm_mul_ps(realW, t), _quaternion_cross(real, t)));
+}
+
+/**
+  Divides both parts of a blended dual quaternion by the length of the real part.
+  */
+GAMEMATH_INLINE void _dual_quaternion_normalize(__m128 &real, __m128 &dual)
+{
+    const __m128 lengthSquared = _dot_product(real, real);
+    const __m128 estimate = _mm_rsqrt_ss(lengthSquared);
+    __m128 scale = _mm_mul_ss(estimate, _mm_sub_ss(_mm_set_ss(1.5f),
+        _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), lengthSquared), _mm_mul_ss(estimate, estimate))));
+    scale = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0));
+    real = _mm_mul_ps(real, scale);
+    dual = _mm_mul_ps(dual, scale);
+}
+
+GAMEMATH_INLINE Vector4 DualQuaternion::translation() const
+{
+    return _dual_quaternion_translation(_mm_load_ps(mReal.data()), _mm_load_ps(mDual.data()));
+}
+
+GAMEMATH_INLINE Vector4 DualQuaternion::mapPosition(const Vector4 &position) const
+{
+    const __m128 real = _mm_load_ps(mReal.data());
+    return _dual_quaternion_transform(real, _dual_quaternion_translation(real, _mm_load_ps(mDual.data())), position);
+}
+
+GAMEMATH_INLINE DualQuaternion DualQuaternion::nlerp(const DualQuaternion &a, const DualQuaternion &b, float weight)
+{
+    DualQuaternion result;
+    nlerp(&a, &b, &weight, 1, &result);
+    return result;
+}
+
+GAMEMATH_INLINE void DualQuaternion::nlerp(const DualQuaternion *a, const DualQuaternion *b, const float *weights,
+                                           size_t count, DualQuaternion *results)
+{
+    const __m128 signMask = _mm_load_ps((const float*)SignMask);
+
+    for (size_t i = 0; i < count; ++i) {
+        const __m128 realA = _mm_load_ps(a[i].mReal.data());
+        const __m128 dualA = _mm_load_ps(a[i].mDual.data());
+        const __m128 realB = _mm_load_ps(b[i].mReal.data());
+        const __m128 dualB = _mm_load_ps(b[i].mDual.data());
+
+        // Take the sign of the dot product of the rotations over to the weight of b
+        const __m128 cosAngle = _dot_product(realA, realB);
+        const __m128 sign = _mm_and_ps(_mm_shuffle_ps(cosAngle, cosAngle, _MM_SHUFFLE(0, 0, 0, 0)), signMask);
+        const __m128 weightB = _mm_set1_ps(weights[i]);
+        const __m128 weightA = _mm_sub_ps(_mm_set1_ps(1.0f), weightB);
+        const __m128 signedWeightB = _mm_xor_ps(weightB, sign);
+
+        __m128 real = _mm_add_ps(_mm_mul_ps(realA, weightA), _mm_mul_ps(realB, signedWeightB));
+        __m128 dual = _mm_add_ps(_mm_mul_ps(dualA, weightA), _mm_mul_ps(dualB, signedWeightB));
+        _dual_quaternion_normalize(real, dual);
+
+        _mm_store_ps(results[i].mReal.data(), real);
+        _mm_store_ps(results[i].mDual.data(), dual);
+    }
+}
+
+GAMEMATH_NAMESPACE_END
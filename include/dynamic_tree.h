@@ -0,0 +1,673 @@
+#ifndef DYNAMIC_TREE_H
+#define DYNAMIC_TREE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "box3d.h"
+#include "ray3d.h"
+#include "bvh.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A node of a dynamic tree. Leaves hold a single proxy, inner nodes always have two children.
+  */
+class DynamicTreeNode : public AlignedAllocation {
+public:
+    bool isLeaf() const;
+
+    /**
+      For leaves, this is the fattened box of the proxy. For inner nodes, it encloses both children.
+      */
+    Box3d box;
+
+    union {
+        int parent;
+        int next; // Used while the node is on the free list
+    };
+
+    int child1;
+    int child2;
+
+    /**
+      Leaves have a height of zero. Nodes on the free list have a height of -1.
+      */
+    int height;
+
+    unsigned int userData;
+};
+
+/**
+  A pair of proxies whose fattened boxes overlap. proxyA is always smaller than proxyB.
+  */
+struct DynamicTreePair {
+    int proxyA;
+    int proxyB;
+};
+
+/**
+  A bounding volume hierarchy for moving boxes, which supports inserting, removing and moving
+  individual boxes (called proxies) at any time.
+
+  Every proxy is stored with a fattened box, which is enlarged by a fixed margin and by the expected
+  displacement of the proxy. Moving a proxy only touches the tree once it leaves its fattened box.
+  Tree rotations keep the hierarchy balanced while proxies are inserted and removed.
+
+  Queries are performed against the fattened boxes, so they report a superset of the proxies whose
+  actual boxes pass the query.
+  */
+class DynamicTree {
+public:
+    /**
+      The handle returned by the tree for missing nodes.
+      */
+    static const int NullNode = -1;
+
+    /**
+      The size of the traversal stack. The height of a balanced tree stays far below this.
+      */
+    static const unsigned int TraversalStackSize = 128;
+
+    /**
+      Creates an empty tree. Boxes are enlarged by margin on all sides, and are extended by
+      displacementFactor times the displacement passed to moveProxy.
+      */
+    DynamicTree(float margin = 0.1f, float displacementFactor = 2.0f);
+    ~DynamicTree();
+
+    /**
+      Inserts a box into the tree and returns a handle for it. The handle stays valid until the
+      proxy is destroyed, and is reused for proxies created afterwards.
+      */
+    int createProxy(const Box3d &box, unsigned int userData);
+
+    void destroyProxy(int proxy);
+
+    /**
+      Moves a proxy to the given box. displacement is the distance the proxy is expected to move
+      until the next call, and is used to predict the fattened box.
+
+      @return True if the proxy has left its fattened box and was reinserted into the tree.
+      */
+    bool moveProxy(int proxy, const Box3d &box, const Vector4 &displacement);
+
+    /**
+      Removes all proxies and releases the node storage.
+      */
+    void clear();
+
+    const Box3d &fatBox(int proxy) const;
+    unsigned int userData(int proxy) const;
+
+    bool isEmpty() const;
+    int proxyCount() const;
+
+    /**
+      Returns the height of the tree. A tree with a single proxy has a height of zero.
+      */
+    int height() const;
+
+    /**
+      Returns the bounds of all fattened boxes in this tree.
+      */
+    Box3d bounds() const;
+
+    /**
+      Returns the sum of the surface areas of all inner nodes relative to the surface area of
+      the root. Lower values mean less overlap between nodes and faster queries.
+      */
+    float areaRatio() const;
+
+    /**
+      Calls visitor(proxy) for every proxy whose fattened box intersects the given box.
+      */
+    template<typename Visitor>
+    void visit(const Box3d &box, Visitor &visitor) const;
+
+    /**
+      Calls visitor(proxy) for every proxy whose fattened box is intersected by the given ray.
+      */
+    template<typename Visitor>
+    void visit(const Ray3d &ray, Visitor &visitor) const;
+
+    /**
+      Calls visitor(proxyA, proxyB) once for every pair of proxies whose fattened boxes overlap,
+      with proxyA < proxyB.
+      */
+    template<typename Visitor>
+    void visitPairs(Visitor &visitor) const;
+
+    /**
+      Appends every proxy whose fattened box intersects the given box to result.
+      */
+    void query(const Box3d &box, std::vector<int> &result) const;
+
+    /**
+      Appends every proxy whose fattened box is intersected by the given ray to result.
+      */
+    void query(const Ray3d &ray, std::vector<int> &result) const;
+
+    /**
+      Appends every pair of proxies whose fattened boxes overlap to result.
+      */
+    void queryPairs(std::vector<DynamicTreePair> &result) const;
+
+private:
+    DynamicTree(const DynamicTree&);
+    DynamicTree &operator =(const DynamicTree&);
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void updateAncestors(int node);
+
+    Box3d enlarge(const Box3d &box, const Vector4 &displacement) const;
+
+    template<typename Test, typename Visitor>
+    void traverse(const Test &test, Visitor &visitor) const;
+
+    DynamicTreeNode *mNodes;
+    int mNodeCapacity;
+    int mFreeList;
+    int mRoot;
+    int mProxyCount;
+    float mMargin;
+    float mDisplacementFactor;
+};
+
+GAMEMATH_INLINE bool DynamicTreeNode::isLeaf() const
+{
+    return child1 == DynamicTree::NullNode;
+}
+
+class DynamicTreeResultCollector {
+public:
+    DynamicTreeResultCollector(std::vector<int> &result) : mResult(result) {}
+    void operator()(int proxy) { mResult.push_back(proxy); }
+private:
+    std::vector<int> &mResult;
+};
+
+class DynamicTreePairCollector {
+public:
+    DynamicTreePairCollector(std::vector<DynamicTreePair> &result) : mResult(result) {}
+    void operator()(int proxyA, int proxyB)
+    {
+        DynamicTreePair pair = { proxyA, proxyB };
+        mResult.push_back(pair);
+    }
+private:
+    std::vector<DynamicTreePair> &mResult;
+};
+
+/**
+  Forwards the proxies found by the query of a single proxy as pairs, skipping the proxy itself
+  and proxies with smaller handles, so every pair is reported exactly once.
+  */
+template<typename Visitor>
+class DynamicTreePairForwarder {
+public:
+    DynamicTreePairForwarder(int proxy, Visitor &visitor) : mProxy(proxy), mVisitor(visitor) {}
+    void operator()(int other)
+    {
+        if (other > mProxy)
+            mVisitor(mProxy, other);
+    }
+private:
+    int mProxy;
+    Visitor &mVisitor;
+};
+
+GAMEMATH_INLINE DynamicTree::DynamicTree(float margin, float displacementFactor)
+    : mNodes(0), mNodeCapacity(0), mFreeList(NullNode), mRoot(NullNode), mProxyCount(0),
+    mMargin(margin), mDisplacementFactor(displacementFactor)
+{
+}
+
+GAMEMATH_INLINE DynamicTree::~DynamicTree()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void DynamicTree::clear()
+{
+    delete [] mNodes;
+    mNodes = 0;
+    mNodeCapacity = 0;
+    mFreeList = NullNode;
+    mRoot = NullNode;
+    mProxyCount = 0;
+}
+
+GAMEMATH_INLINE int DynamicTree::allocateNode()
+{
+    if (mFreeList == NullNode) {
+        // Grow the pool. Handles are indices, so they stay valid.
+        const int capacity = mNodeCapacity ? 2 * mNodeCapacity : 16;
+        DynamicTreeNode *nodes = new DynamicTreeNode[capacity];
+        std::copy(mNodes, mNodes + mNodeCapacity, nodes);
+        delete [] mNodes;
+        mNodes = nodes;
+
+        for (int i = mNodeCapacity; i < capacity - 1; ++i) {
+            mNodes[i].next = i + 1;
+            mNodes[i].height = -1;
+        }
+        mNodes[capacity - 1].next = NullNode;
+        mNodes[capacity - 1].height = -1;
+
+        mFreeList = mNodeCapacity;
+        mNodeCapacity = capacity;
+    }
+
+    const int node = mFreeList;
+    mFreeList = mNodes[node].next;
+
+    mNodes[node].parent = NullNode;
+    mNodes[node].child1 = NullNode;
+    mNodes[node].child2 = NullNode;
+    mNodes[node].height = 0;
+    mNodes[node].userData = 0;
+    return node;
+}
+
+GAMEMATH_INLINE void DynamicTree::freeNode(int node)
+{
+    mNodes[node].next = mFreeList;
+    mNodes[node].height = -1;
+    mFreeList = node;
+}
+
+GAMEMATH_INLINE Box3d DynamicTree::enlarge(const Box3d &box, const Vector4 &displacement) const
+{
+    const Vector4 margin(mMargin, mMargin, mMargin, 0);
+    Vector4 minimum = box.minimum() - margin;
+    Vector4 maximum = box.maximum() + margin;
+
+    // Only extend the box in the direction of the movement
+    const Vector4 predicted = mDisplacementFactor * displacement;
+    for (int i = 0; i < 3; ++i) {
+        const float d = predicted.data()[i];
+        if (d < 0)
+            minimum.data()[i] += d;
+        else
+            maximum.data()[i] += d;
+    }
+
+    return Box3d(minimum, maximum);
+}
+
+GAMEMATH_INLINE int DynamicTree::createProxy(const Box3d &box, unsigned int userData)
+{
+    const int proxy = allocateNode();
+    mNodes[proxy].box = enlarge(box, Vector4(0, 0, 0, 0));
+    mNodes[proxy].userData = userData;
+
+    insertLeaf(proxy);
+    ++mProxyCount;
+    return proxy;
+}
+
+GAMEMATH_INLINE void DynamicTree::destroyProxy(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --mProxyCount;
+}
+
+GAMEMATH_INLINE bool DynamicTree::moveProxy(int proxy, const Box3d &box, const Vector4 &displacement)
+{
+    if (mNodes[proxy].box.contains(box))
+        return false;
+
+    removeLeaf(proxy);
+    mNodes[proxy].box = enlarge(box, displacement);
+    insertLeaf(proxy);
+    return true;
+}
+
+GAMEMATH_INLINE const Box3d &DynamicTree::fatBox(int proxy) const
+{
+    return mNodes[proxy].box;
+}
+
+GAMEMATH_INLINE unsigned int DynamicTree::userData(int proxy) const
+{
+    return mNodes[proxy].userData;
+}
+
+GAMEMATH_INLINE bool DynamicTree::isEmpty() const
+{
+    return mRoot == NullNode;
+}
+
+GAMEMATH_INLINE int DynamicTree::proxyCount() const
+{
+    return mProxyCount;
+}
+
+GAMEMATH_INLINE int DynamicTree::height() const
+{
+    if (mRoot == NullNode)
+        return 0;
+    return mNodes[mRoot].height;
+}
+
+GAMEMATH_INLINE Box3d DynamicTree::bounds() const
+{
+    if (mRoot == NullNode)
+        return Box3d();
+    return mNodes[mRoot].box;
+}
+
+GAMEMATH_INLINE float DynamicTree::areaRatio() const
+{
+    if (mRoot == NullNode)
+        return 0;
+
+    const float rootArea = mNodes[mRoot].box.surfaceArea();
+    if (rootArea <= 0)
+        return 0;
+
+    float totalArea = 0;
+    for (int i = 0; i < mNodeCapacity; ++i) {
+        if (mNodes[i].height > 0)
+            totalArea += mNodes[i].box.surfaceArea();
+    }
+
+    return totalArea / rootArea;
+}
+
+GAMEMATH_INLINE void DynamicTree::insertLeaf(int leaf)
+{
+    if (mRoot == NullNode) {
+        mRoot = leaf;
+        mNodes[leaf].parent = NullNode;
+        return;
+    }
+
+    // Descend towards the sibling that minimizes the increase in surface area. Every node whose
+    // box grows on the way down to the sibling adds to the cost.
+    const Box3d leafBox = mNodes[leaf].box;
+    int index = mRoot;
+
+    while (!mNodes[index].isLeaf()) {
+        const DynamicTreeNode &node = mNodes[index];
+
+        Box3d combined = node.box;
+        combined.merge(leafBox);
+        const float combinedArea = combined.surfaceArea();
+
+        // Cost of pairing the leaf with this node
+        const float cost = 2 * combinedArea;
+
+        // Minimum cost of pushing the leaf further down
+        const float inheritanceCost = 2 * (combinedArea - node.box.surfaceArea());
+
+        float childCosts[2];
+        const int children[2] = { node.child1, node.child2 };
+        for (int i = 0; i < 2; ++i) {
+            const DynamicTreeNode &child = mNodes[children[i]];
+            Box3d childCombined = child.box;
+            childCombined.merge(leafBox);
+            childCosts[i] = childCombined.surfaceArea() + inheritanceCost;
+            if (!child.isLeaf())
+                childCosts[i] -= child.box.surfaceArea();
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+            break;
+
+        index = (childCosts[0] < childCosts[1]) ? children[0] : children[1];
+    }
+
+    const int sibling = index;
+
+    // Allocating may move the node pool, so no references are held across this call
+    const int oldParent = mNodes[sibling].parent;
+    const int newParent = allocateNode();
+
+    mNodes[newParent].parent = oldParent;
+    mNodes[newParent].box = leafBox;
+    mNodes[newParent].box.merge(mNodes[sibling].box);
+    mNodes[newParent].height = mNodes[sibling].height + 1;
+    mNodes[newParent].child1 = sibling;
+    mNodes[newParent].child2 = leaf;
+    mNodes[sibling].parent = newParent;
+    mNodes[leaf].parent = newParent;
+
+    if (oldParent == NullNode) {
+        mRoot = newParent;
+    } else if (mNodes[oldParent].child1 == sibling) {
+        mNodes[oldParent].child1 = newParent;
+    } else {
+        mNodes[oldParent].child2 = newParent;
+    }
+
+    updateAncestors(mNodes[leaf].parent);
+}
+
+GAMEMATH_INLINE void DynamicTree::removeLeaf(int leaf)
+{
+    if (leaf == mRoot) {
+        mRoot = NullNode;
+        return;
+    }
+
+    const int parent = mNodes[leaf].parent;
+    const int grandParent = mNodes[parent].parent;
+    const int sibling = (mNodes[parent].child1 == leaf) ? mNodes[parent].child2 : mNodes[parent].child1;
+
+    // The sibling takes the place of the parent
+    mNodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == NullNode) {
+        mRoot = sibling;
+        return;
+    }
+
+    if (mNodes[grandParent].child1 == parent)
+        mNodes[grandParent].child1 = sibling;
+    else
+        mNodes[grandParent].child2 = sibling;
+
+    updateAncestors(grandParent);
+}
+
+GAMEMATH_INLINE void DynamicTree::updateAncestors(int node)
+{
+    while (node != NullNode) {
+        node = balance(node);
+
+        DynamicTreeNode &current = mNodes[node];
+        const DynamicTreeNode &child1 = mNodes[current.child1];
+        const DynamicTreeNode &child2 = mNodes[current.child2];
+
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.box = child1.box;
+        current.box.merge(child2.box);
+
+        node = current.parent;
+    }
+}
+
+GAMEMATH_INLINE int DynamicTree::balance(int iA)
+{
+    DynamicTreeNode &a = mNodes[iA];
+    if (a.isLeaf() || a.height < 2)
+        return iA;
+
+    const int iB = a.child1;
+    const int iC = a.child2;
+    DynamicTreeNode &b = mNodes[iB];
+    DynamicTreeNode &c = mNodes[iC];
+
+    const int difference = c.height - b.height;
+
+    if (difference > 1) {
+        // Rotate C up, its taller child replaces it
+        const int iF = c.child1;
+        const int iG = c.child2;
+        DynamicTreeNode &f = mNodes[iF];
+        DynamicTreeNode &g = mNodes[iG];
+
+        c.child1 = iA;
+        c.parent = a.parent;
+        a.parent = iC;
+
+        if (c.parent == NullNode)
+            mRoot = iC;
+        else if (mNodes[c.parent].child1 == iA)
+            mNodes[c.parent].child1 = iC;
+        else
+            mNodes[c.parent].child2 = iC;
+
+        if (f.height > g.height) {
+            c.child2 = iF;
+            a.child2 = iG;
+            g.parent = iA;
+            a.box = b.box;
+            a.box.merge(g.box);
+            c.box = a.box;
+            c.box.merge(f.box);
+            a.height = 1 + std::max(b.height, g.height);
+            c.height = 1 + std::max(a.height, f.height);
+        } else {
+            c.child2 = iG;
+            a.child2 = iF;
+            f.parent = iA;
+            a.box = b.box;
+            a.box.merge(f.box);
+            c.box = a.box;
+            c.box.merge(g.box);
+            a.height = 1 + std::max(b.height, f.height);
+            c.height = 1 + std::max(a.height, g.height);
+        }
+
+        return iC;
+    }
+
+    if (difference < -1) {
+        // Rotate B up, its taller child replaces it
+        const int iD = b.child1;
+        const int iE = b.child2;
+        DynamicTreeNode &d = mNodes[iD];
+        DynamicTreeNode &e = mNodes[iE];
+
+        b.child1 = iA;
+        b.parent = a.parent;
+        a.parent = iB;
+
+        if (b.parent == NullNode)
+            mRoot = iB;
+        else if (mNodes[b.parent].child1 == iA)
+            mNodes[b.parent].child1 = iB;
+        else
+            mNodes[b.parent].child2 = iB;
+
+        if (d.height > e.height) {
+            b.child2 = iD;
+            a.child1 = iE;
+            e.parent = iA;
+            a.box = c.box;
+            a.box.merge(e.box);
+            b.box = a.box;
+            b.box.merge(d.box);
+            a.height = 1 + std::max(c.height, e.height);
+            b.height = 1 + std::max(a.height, d.height);
+        } else {
+            b.child2 = iE;
+            a.child1 = iD;
+            d.parent = iA;
+            a.box = c.box;
+            a.box.merge(d.box);
+            b.box = a.box;
+            b.box.merge(e.box);
+            a.height = 1 + std::max(c.height, d.height);
+            b.height = 1 + std::max(a.height, e.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+template<typename Test, typename Visitor>
+GAMEMATH_INLINE void DynamicTree::traverse(const Test &test, Visitor &visitor) const
+{
+    if (mRoot == NullNode)
+        return;
+
+    int stack[TraversalStackSize];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = mRoot;
+
+    while (stackSize) {
+        const int index = stack[--stackSize];
+        const DynamicTreeNode &node = mNodes[index];
+
+        if (!test(node.box))
+            continue;
+
+        if (node.isLeaf()) {
+            visitor(index);
+        } else {
+            stack[stackSize++] = node.child2;
+            stack[stackSize++] = node.child1;
+        }
+    }
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void DynamicTree::visit(const Box3d &box, Visitor &visitor) const
+{
+    traverse(BvhBoxTest(box), visitor);
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void DynamicTree::visit(const Ray3d &ray, Visitor &visitor) const
+{
+    traverse(BvhRayTest(ray), visitor);
+}
+
+template<typename Visitor>
+GAMEMATH_INLINE void DynamicTree::visitPairs(Visitor &visitor) const
+{
+    for (int i = 0; i < mNodeCapacity; ++i) {
+        if (mNodes[i].height != 0)
+            continue;
+
+        DynamicTreePairForwarder<Visitor> forwarder(i, visitor);
+        traverse(BvhBoxTest(mNodes[i].box), forwarder);
+    }
+}
+
+GAMEMATH_INLINE void DynamicTree::query(const Box3d &box, std::vector<int> &result) const
+{
+    DynamicTreeResultCollector collector(result);
+    visit(box, collector);
+}
+
+GAMEMATH_INLINE void DynamicTree::query(const Ray3d &ray, std::vector<int> &result) const
+{
+    DynamicTreeResultCollector collector(result);
+    visit(ray, collector);
+}
+
+GAMEMATH_INLINE void DynamicTree::queryPairs(std::vector<DynamicTreePair> &result) const
+{
+    DynamicTreePairCollector collector(result);
+    visitPairs(collector);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // DYNAMIC_TREE_H
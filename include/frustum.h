@@ -1,7 +1,12 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cmath>
 
 #include "gamemath_internal.h"
 #include "vector4.h"
 #include "matrix4.h"
+#include "quaternion.h"
 #include "box3d.h"
 
 GAMEMATH_NAMESPACE_BEGIN
@@ -25,6 +30,23 @@ public:
         Plane_Far
     };
 
+    /**
+      Constructs a frustum whose planes all pass through the origin. Call extract before using it.
+      */
+    Frustum();
+
+    /**
+      Constructs the view frustum of a perspective camera directly from its parameters, which is
+      cheaper and more precise than extracting it from a view-projection matrix.
+
+      @param eye The position of the camera in world space.
+      @param orientation Rotates the camera from looking down the negative z axis, with the positive
+                         y axis up, into its world space orientation. It must be normalized.
+      @param fovY The vertical field of view in radians.
+      @param aspect The ratio of the width of the view to its height.
+      */
+    Frustum(const Vector4 &eye, const Quaternion &orientation, float fovY, float aspect, float nearVal, float farVal);
+
     /**
       Extracts a frustum from a given transformation matrix.
       The space in which the planes are given depends on the matrix.
@@ -40,6 +62,12 @@ public:
       */
     bool isVisible(const Box3d &boundingBox) const;
 
+    /**
+      Returns one of the planes of this frustum. The normals of the planes point into the frustum
+      and are normalized, with the negative distance of the plane from the origin in w.
+      */
+    const Vector4 &plane(ClippingPlane plane) const;
+
 private:
     Vector4 mPlanes[6];
 
@@ -56,20 +84,53 @@ GAMEMATH_INLINE Vector4 normalizePlane(const Vector4 &plane)
     return result;
 }
 
-GAMEMATH_INLINE void Frustum::extract(const Matrix4 &transformMatrix)
+GAMEMATH_INLINE Frustum::Frustum()
 {
-    const Matrix4 matrix = transformMatrix.transposed();
-
-    /*
-    This is inspired by: "Fast Extraction of Viewing Frustum Planes from the World-
-    View-Projection Matrix" by Gil Gribb and Klaus Hartmann.
-    */
-    mPlanes[Plane_Left] = normalizePlane(matrix.column(3) + matrix.column(0));
-    mPlanes[Plane_Right] = normalizePlane(matrix.column(3) - matrix.column(0));
-    mPlanes[Plane_Top] = normalizePlane(matrix.column(3) + matrix.column(1));
-    mPlanes[Plane_Bottom] = normalizePlane(matrix.column(3) - matrix.column(1));
-    mPlanes[Plane_Near] = normalizePlane(matrix.column(3) + matrix.column(2));
-    mPlanes[Plane_Far] = normalizePlane(matrix.column(3) - matrix.column(2));
+    for (int i = Plane_Left; i <= Plane_Far; ++i)
+        mPlanes[i] = Vector4(0, 0, 0, 0);
+}
+
+GAMEMATH_INLINE Frustum::Frustum(const Vector4 &eye, const Quaternion &orientation, float fovY, float aspect,
+                                 float nearVal, float farVal)
+{
+    // The axes of the camera are the columns of the rotation matrix of its orientation
+    const float x = orientation.x();
+    const float y = orientation.y();
+    const float z = orientation.z();
+    const float w = orientation.w();
+    const Vector4 right(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0);
+    const Vector4 up(2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0);
+    const Vector4 forward(-2 * (x * z + w * y), -2 * (y * z - w * x), 2 * (x * x + y * y) - 1, 0);
+
+    // The side planes contain the eye, so their normals are tilted from the axes towards forward
+    const float tanY = tan(fovY * 0.5f);
+    const float tanX = tanY * aspect;
+    const float scaleX = 1 / sqrt(1 + tanX * tanX);
+    const float scaleY = 1 / sqrt(1 + tanY * tanY);
+    const Vector4 forwardX = (tanX * scaleX) * forward;
+    const Vector4 forwardY = (tanY * scaleY) * forward;
+
+    Vector4 normals[6] = {
+        forwardX + scaleX * right,
+        forwardX - scaleX * right,
+        forwardY - scaleY * up,
+        forwardY + scaleY * up,
+        forward,
+        -forward
+    };
+
+    for (int i = Plane_Left; i <= Plane_Far; ++i) {
+        normals[i].setW(-normals[i].dot(eye));
+        mPlanes[i] = normals[i];
+    }
+
+    mPlanes[Plane_Near].setW(mPlanes[Plane_Near].w() - nearVal);
+    mPlanes[Plane_Far].setW(mPlanes[Plane_Far].w() + farVal);
+}
+
+GAMEMATH_INLINE const Vector4 &Frustum::plane(ClippingPlane plane) const
+{
+    return mPlanes[plane];
 }
 
 GAMEMATH_INLINE bool Frustum::isVisible(const Box3d &boundingBox) const
@@ -98,3 +159,11 @@ GAMEMATH_INLINE bool Frustum::isVisible(const Box3d &boundingBox) const
 }
 
 GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "frustum_sse.h"
+#else
+#include "frustum_sisd.h"
+#endif
+
+#endif // FRUSTUM_H
@@ -0,0 +1,28 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "frustum.h"
+
+#if !defined(FRUSTUM_H)
+#error "Do not include this file directly, only include frustum.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE void Frustum::extract(const Matrix4 &transformMatrix)
+{
+    const Matrix4 matrix = transformMatrix.transposed();
+
+    /*
+    This is inspired by: "Fast Extraction of Viewing Frustum Planes from the World-
+    View-Projection Matrix" by Gil Gribb and Klaus Hartmann.
+    */
+    mPlanes[Plane_Left] = normalizePlane(matrix.column(3) + matrix.column(0));
+    mPlanes[Plane_Right] = normalizePlane(matrix.column(3) - matrix.column(0));
+    mPlanes[Plane_Top] = normalizePlane(matrix.column(3) - matrix.column(1));
+    mPlanes[Plane_Bottom] = normalizePlane(matrix.column(3) + matrix.column(1));
+    mPlanes[Plane_Near] = normalizePlane(matrix.column(3) + matrix.column(2));
+    mPlanes[Plane_Far] = normalizePlane(matrix.column(3) - matrix.column(2));
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,82 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "frustum.h"
+
+#if !defined(FRUSTUM_H)
+#error "Do not include this file directly, only include frustum.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Normalizes four planes at once, given as structure of arrays. The reciprocal square root estimate
+  is refined with a Newton-Raphson step, which gives almost full single precision.
+  */
+GAMEMATH_INLINE void _frustum_normalize_planes(__m128 &x, __m128 &y, __m128 &z, __m128 &w)
+{
+    const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    const __m128 estimate = _mm_rsqrt_ps(lengthSquared);
+
+    // estimate * (1.5 - 0.5 * lengthSquared * estimate^2)
+    const __m128 halfLengthSquared = _mm_mul_ps(_mm_set1_ps(0.5f), lengthSquared);
+    const __m128 scale = _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f),
+        _mm_mul_ps(halfLengthSquared, _mm_mul_ps(estimate, estimate))));
+
+    x = _mm_mul_ps(x, scale);
+    y = _mm_mul_ps(y, scale);
+    z = _mm_mul_ps(z, scale);
+    w = _mm_mul_ps(w, scale);
+}
+
+GAMEMATH_INLINE void Frustum::extract(const Matrix4 &transformMatrix)
+{
+    /*
+    This is inspired by: "Fast Extraction of Viewing Frustum Planes from the World-
+    View-Projection Matrix" by Gil Gribb and Klaus Hartmann.
+
+    Since the planes are sums of rows, the columns of the matrix already hold the planes as
+    structure of arrays: column j contains component j of all rows. No transpose is needed
+    until the planes are stored.
+    */
+    const __m128 column0 = transformMatrix.column(0);
+    const __m128 column1 = transformMatrix.column(1);
+    const __m128 column2 = transformMatrix.column(2);
+    const __m128 column3 = transformMatrix.column(3);
+
+    // Broadcast rows 0, 1 and 3 as (row 0, -row 0, -row 1, row 1) for the side planes
+    const __m128 signs = _mm_set_ps(1, -1, -1, 1);
+    __m128 sideX = _mm_mul_ps(_mm_shuffle_ps(column0, column0, _MM_SHUFFLE(1, 1, 0, 0)), signs);
+    __m128 sideY = _mm_mul_ps(_mm_shuffle_ps(column1, column1, _MM_SHUFFLE(1, 1, 0, 0)), signs);
+    __m128 sideZ = _mm_mul_ps(_mm_shuffle_ps(column2, column2, _MM_SHUFFLE(1, 1, 0, 0)), signs);
+    __m128 sideW = _mm_mul_ps(_mm_shuffle_ps(column3, column3, _MM_SHUFFLE(1, 1, 0, 0)), signs);
+    sideX = _mm_add_ps(sideX, _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(3, 3, 3, 3)));
+    sideY = _mm_add_ps(sideY, _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(3, 3, 3, 3)));
+    sideZ = _mm_add_ps(sideZ, _mm_shuffle_ps(column2, column2, _MM_SHUFFLE(3, 3, 3, 3)));
+    sideW = _mm_add_ps(sideW, _mm_shuffle_ps(column3, column3, _MM_SHUFFLE(3, 3, 3, 3)));
+
+    // Near and far are row 3 +- row 2, padded with copies of themselves
+    const __m128 depthSigns = _mm_set_ps(-1, 1, -1, 1);
+    __m128 depthX = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(column0, column0, _MM_SHUFFLE(2, 2, 2, 2)), depthSigns),
+        _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 depthY = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(column1, column1, _MM_SHUFFLE(2, 2, 2, 2)), depthSigns),
+        _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 depthZ = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(column2, column2, _MM_SHUFFLE(2, 2, 2, 2)), depthSigns),
+        _mm_shuffle_ps(column2, column2, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 depthW = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(column3, column3, _MM_SHUFFLE(2, 2, 2, 2)), depthSigns),
+        _mm_shuffle_ps(column3, column3, _MM_SHUFFLE(3, 3, 3, 3)));
+
+    _frustum_normalize_planes(sideX, sideY, sideZ, sideW);
+    _frustum_normalize_planes(depthX, depthY, depthZ, depthW);
+
+    _MM_TRANSPOSE4_PS(sideX, sideY, sideZ, sideW);
+    _MM_TRANSPOSE4_PS(depthX, depthY, depthZ, depthW);
+    mPlanes[Plane_Left] = sideX;
+    mPlanes[Plane_Right] = sideY;
+    mPlanes[Plane_Top] = sideZ;
+    mPlanes[Plane_Bottom] = sideW;
+    mPlanes[Plane_Near] = depthX;
+    mPlanes[Plane_Far] = depthY;
+}
+
+GAMEMATH_NAMESPACE_END
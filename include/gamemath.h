@@ -5,9 +5,23 @@
 #include "vector4.h"
 #include "quaternion.h"
 #include "matrix4.h"
+#include "matrix3x4.h"
 #include "box2d.h"
 #include "box3d.h"
 #include "ray3d.h"
+#include "ray_packet.h"
+#include "triangle_batch.h"
+#include "sphere_batch.h"
 #include "frustum.h"
+#include "bvh.h"
+#include "triangle_bvh.h"
+#include "dynamic_tree.h"
+#include "sweep_and_prune.h"
+#include "occlusion_buffer.h"
+#include "animation.h"
+#include "skeleton.h"
+#include "transform.h"
+#include "dual_quaternion.h"
+#include "skinning.h"
 
 #endif // GAMEMATH_H
@@ -17,6 +17,11 @@ GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int SignMask[4] = { 0x80000000, 0x8000
 // Applies sign-bit masking only to the X, Y, and Z components
 GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int SignMaskXYZ[4] = { 0x80000000, 0x80000000, 0x80000000, 0x00000000 };
 
+// Sign masks that negate the terms of a quaternion product, see operator *(Quaternion, Quaternion)
+GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int SignMaskYW[4] = { 0x00000000, 0x80000000, 0x00000000, 0x80000000 };
+GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int SignMaskZW[4] = { 0x00000000, 0x00000000, 0x80000000, 0x80000000 };
+GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int SignMaskXW[4] = { 0x80000000, 0x00000000, 0x00000000, 0x80000000 };
+
 // All bits except the first bit (Sign Bit) are set. Can be used to make a floating point number absolute.
 GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int InvertedSignmask[4] = { 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF };
 
@@ -38,6 +43,12 @@ GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int CoordinateMaskY[4] = { 0x00000000,
 // A mask for the Z coordinate of a Vector4
 GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int CoordinateMaskZ[4] = { 0x00000000, 0x00000000, 0xFFFFFFFF, 0x00000000 };
 
+// A mask for the W coordinate of a Vector4
+GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int CoordinateMaskW[4] = { 0x00000000, 0x00000000, 0x00000000, 0xFFFFFFFF };
+
+// A mask for the X, Y and Z coordinates of a Vector4
+GAMEMATH_ALIGN GAMEMATH_CONSTANT unsigned int CoordinateMaskXYZ[4] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x00000000 };
+
 // Positive infinity
 GAMEMATH_ALIGN GAMEMATH_CONSTANT float PositiveInfinity[4] = { std::numeric_limits<float>::infinity(), 
                                                                                 std::numeric_limits<float>::infinity(), 
@@ -41,6 +41,9 @@
 
 #if !defined(GAMEMATH_NO_INTRINSICS)
 #include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 #endif
 
 GAMEMATH_NAMESPACE_BEGIN
@@ -0,0 +1,94 @@
+#ifndef GAMEMATH_PARALLEL_H
+#define GAMEMATH_PARALLEL_H
+
+#include "gamemath_internal.h"
+
+#include <cstddef>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Work is only split across threads if every thread receives at least this many elements.
+  Below that, the cost of waking up the worker threads outweighs the gain.
+  */
+const size_t ParallelMinimumGrain = 64 * 1024;
+
+/**
+  Returns the number of worker threads that parallel algorithms of this library will use.
+  Threading is provided by OpenMP. If the library is compiled without OpenMP support
+  (/openmp or -fopenmp), this is always 1 and all algorithms run serially.
+  */
+GAMEMATH_INLINE int parallelThreadCount()
+{
+#if defined(_OPENMP)
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/**
+  Computes how many ranges an array of count elements should be split into, so that
+  each range contains at least grain elements and no more ranges than threads are used.
+  */
+GAMEMATH_INLINE int parallelRangeCount(size_t count, size_t grain = ParallelMinimumGrain)
+{
+    size_t ranges = count / (grain ? grain : 1);
+    const size_t threads = (size_t)parallelThreadCount();
+
+    if (ranges > threads)
+        ranges = threads;
+    if (ranges < 1)
+        ranges = 1;
+
+    return (int)ranges;
+}
+
+/**
+  Splits [0, count) into rangeCount contiguous ranges of roughly equal size and calls
+  kernel(rangeIndex, begin, end) for each of them. The ranges are processed in parallel if
+  OpenMP is available. rangeCount should be obtained from parallelRangeCount, so callers can
+  allocate one slot per range for partial results beforehand.
+  */
+template<typename Kernel>
+GAMEMATH_INLINE void parallelForRanges(size_t count, int rangeCount, Kernel &kernel)
+{
+    const size_t rangeSize = (count + rangeCount - 1) / rangeCount;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static) if(rangeCount > 1)
+#endif
+    for (int i = 0; i < rangeCount; ++i) {
+        const size_t begin = i * rangeSize;
+        size_t end = begin + rangeSize;
+        if (end > count)
+            end = count;
+        if (begin < end)
+            kernel(i, begin, end);
+    }
+}
+
+/**
+  Atomically increments the given value and returns the incremented value.
+  This acts as a full memory barrier.
+  */
+GAMEMATH_INLINE long parallelAtomicIncrement(volatile long *value)
+{
+#if defined(_MSC_VER)
+    return _InterlockedIncrement(value);
+#else
+    return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // GAMEMATH_PARALLEL_H
@@ -0,0 +1,169 @@
+#ifndef MATRIX3X4_H
+#define MATRIX3X4_H
+
+#include <cstddef>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "quaternion.h"
+#include "matrix4.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  An affine transformation stored as the upper three rows of a Matrix4. The fourth row is always
+  (0, 0, 0, 1) and isn't stored, so the matrix takes 48 bytes instead of 64.
+
+  Unlike Matrix4, the elements are stored row by row, so every row holds one output component of a
+  transformed vector. This is also the layout of a mat3x4 in a std140 uniform block, so palettes of
+  these can be uploaded without conversion.
+  */
+GAMEMATH_ALIGNEDTYPE_PRE class GAMEMATH_ALIGNEDTYPE_MID Matrix3x4 : public AlignedAllocation {
+friend GAMEMATH_INLINE Matrix3x4 operator *(const Matrix3x4 &a, const Matrix3x4 &b);
+public:
+    /**
+      Creates an uninitialized matrix.
+      */
+    Matrix3x4();
+
+    /**
+      Creates a matrix from the upper three rows of matrix. The fourth row of matrix is assumed to be
+      (0, 0, 0, 1), which is the case for matrices created by transformation, translation or lookAt.
+      */
+    explicit Matrix3x4(const Matrix4 &matrix);
+
+    /**
+      Returns this matrix as a Matrix4 with a fourth row of (0, 0, 0, 1).
+      */
+    Matrix4 toMatrix4() const;
+
+    /**
+      Same as the Matrix4 constructor for an array of matrices.
+      */
+    static void fromMatrix4(const Matrix4 *matrices, size_t count, Matrix3x4 *results);
+
+    /**
+      Same as toMatrix4 for an array of matrices.
+      */
+    static void toMatrix4(const Matrix3x4 *matrices, size_t count, Matrix4 *results);
+
+    void setToIdentity();
+
+    static Matrix3x4 identity();
+
+    /**
+      Creates a matrix that scales, rotates and translates, in that order. This is the same as the
+      matrix created by Matrix4::transformation.
+      */
+    static Matrix3x4 transformation(const Vector4 &scale, const Quaternion &rotation, const Vector4 &translation);
+
+    /**
+      Returns the internal data of this matrix as a row-major array of 12 floating point values.
+      */
+    const float *data() const;
+    float *data();
+
+    float operator()(int row, int col) const;
+    float &operator()(int row, int col);
+
+    /**
+      Multiplies this matrix with a vector, using (0, 0, 0, 1) as the fourth row. The w component of the
+      result is the w component of vector.
+      */
+    Vector4 operator *(const Vector4 &vector) const;
+
+    /**
+      Transforms the x, y and z components of a position. The w component of the result is one.
+      */
+    Vector4 mapPosition(const Vector4 &vector) const;
+
+    /**
+      Transforms the x, y and z components of a normal, without the translation. The w component of the
+      result is zero.
+      */
+    Vector4 mapNormal(const Vector4 &vector) const;
+
+    /**
+      Returns the inverse of this matrix. The upper left 3x3 part is inverted by its adjugate, and the
+      translation is rotated back by the result, which is much cheaper than Matrix4::inverted.
+      */
+    Matrix3x4 inverted() const;
+
+    void print() const;
+
+private:
+#if !defined(GAMEMATH_NO_INTRINSICS)
+    union {
+        __m128 rows[3];
+        float m[3][4];
+    };
+#else
+    float m[3][4];
+#endif
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+GAMEMATH_INLINE Matrix3x4::Matrix3x4()
+{
+}
+
+GAMEMATH_INLINE Matrix3x4 Matrix3x4::identity()
+{
+    Matrix3x4 result;
+    result.setToIdentity();
+    return result;
+}
+
+GAMEMATH_INLINE Matrix3x4 Matrix3x4::transformation(const Vector4 &scale, const Quaternion &rotation,
+                                                    const Vector4 &translation)
+{
+    return Matrix3x4(Matrix4::transformation(scale, rotation, translation));
+}
+
+GAMEMATH_INLINE void Matrix3x4::fromMatrix4(const Matrix4 *matrices, size_t count, Matrix3x4 *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = Matrix3x4(matrices[i]);
+}
+
+GAMEMATH_INLINE void Matrix3x4::toMatrix4(const Matrix3x4 *matrices, size_t count, Matrix4 *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = matrices[i].toMatrix4();
+}
+
+GAMEMATH_INLINE const float *Matrix3x4::data() const
+{
+    return &m[0][0];
+}
+
+GAMEMATH_INLINE float *Matrix3x4::data()
+{
+    return &m[0][0];
+}
+
+GAMEMATH_INLINE float Matrix3x4::operator()(int row, int col) const
+{
+    return m[row][col];
+}
+
+GAMEMATH_INLINE float &Matrix3x4::operator()(int row, int col)
+{
+    return m[row][col];
+}
+
+GAMEMATH_INLINE void Matrix3x4::print() const
+{
+    for (int i = 0; i < 3; ++i)
+        printf("%f %f %f %f\n", m[i][0], m[i][1], m[i][2], m[i][3]);
+    printf("%f %f %f %f\n", 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "matrix3x4_sse.h"
+#else
+#include "matrix3x4_sisd.h"
+#endif
+
+#endif // MATRIX3X4_H
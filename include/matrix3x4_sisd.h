@@ -0,0 +1,105 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "matrix3x4.h"
+
+#if !defined(MATRIX3X4_H)
+#error "Do not include this file directly, only include matrix3x4.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE Matrix3x4::Matrix3x4(const Matrix4 &matrix)
+{
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col)
+            m[row][col] = matrix(row, col);
+    }
+}
+
+GAMEMATH_INLINE Matrix4 Matrix3x4::toMatrix4() const
+{
+    Matrix4 result;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col)
+            result(row, col) = m[row][col];
+    }
+    result(3, 0) = 0;
+    result(3, 1) = 0;
+    result(3, 2) = 0;
+    result(3, 3) = 1;
+    return result;
+}
+
+GAMEMATH_INLINE void Matrix3x4::setToIdentity()
+{
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col)
+            m[row][col] = row == col ? 1.0f : 0.0f;
+    }
+}
+
+GAMEMATH_INLINE Matrix3x4 operator *(const Matrix3x4 &a, const Matrix3x4 &b)
+{
+    Matrix3x4 result;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            result.m[row][col] = a.m[row][0] * b.m[0][col] + a.m[row][1] * b.m[1][col] + a.m[row][2] * b.m[2][col];
+        }
+        result.m[row][3] += a.m[row][3];
+    }
+    return result;
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::operator *(const Vector4 &vector) const
+{
+    float result[3];
+    for (int row = 0; row < 3; ++row) {
+        result[row] = m[row][0] * vector.x() + m[row][1] * vector.y() + m[row][2] * vector.z()
+            + m[row][3] * vector.w();
+    }
+    return Vector4(result[0], result[1], result[2], vector.w());
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::mapPosition(const Vector4 &vector) const
+{
+    float result[3];
+    for (int row = 0; row < 3; ++row)
+        result[row] = m[row][0] * vector.x() + m[row][1] * vector.y() + m[row][2] * vector.z() + m[row][3];
+    return Vector4(result[0], result[1], result[2], 1);
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::mapNormal(const Vector4 &vector) const
+{
+    float result[3];
+    for (int row = 0; row < 3; ++row)
+        result[row] = m[row][0] * vector.x() + m[row][1] * vector.y() + m[row][2] * vector.z();
+    return Vector4(result[0], result[1], result[2], 0);
+}
+
+GAMEMATH_INLINE Matrix3x4 Matrix3x4::inverted() const
+{
+    Matrix3x4 result;
+
+    // Adjugate of the upper left 3x3 part
+    result.m[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    result.m[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+    result.m[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+    result.m[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    result.m[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+    result.m[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+    result.m[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    result.m[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+    result.m[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+    const float invDeterminant = 1 / (m[0][0] * result.m[0][0] + m[0][1] * result.m[1][0] + m[0][2] * result.m[2][0]);
+
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col)
+            result.m[row][col] *= invDeterminant;
+        result.m[row][3] = -(result.m[row][0] * m[0][3] + result.m[row][1] * m[1][3] + result.m[row][2] * m[2][3]);
+    }
+    return result;
+}
+
+GAMEMATH_NAMESPACE_END
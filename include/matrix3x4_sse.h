@@ -0,0 +1,135 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "matrix3x4.h"
+
+#if !defined(MATRIX3X4_H)
+#error "Do not include this file directly, only include matrix3x4.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Multiplies the three rows with vector and adds up the products of each row. fourth is added up into
+  the w component of the result, which is how the implicit fourth row is applied.
+  */
+GAMEMATH_INLINE __m128 _matrix3x4_transform(const __m128 row0, const __m128 row1, const __m128 row2,
+                                            const __m128 vector, const __m128 fourth)
+{
+    __m128 x = _mm_mul_ps(row0, vector);
+    __m128 y = _mm_mul_ps(row1, vector);
+    __m128 z = _mm_mul_ps(row2, vector);
+    __m128 w = fourth;
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    return _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
+}
+
+/**
+  Multiplies a row of a matrix with the rows of b, with (0, 0, 0, 1) as the fourth row of b.
+  */
+GAMEMATH_INLINE __m128 _matrix3x4_multiply_row(const __m128 row, const Matrix3x4 &b, const __m128 maskW)
+{
+    __m128 result = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), _mm_load_ps(b.data()));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), _mm_load_ps(b.data() + 4)));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), _mm_load_ps(b.data() + 8)));
+    return _mm_add_ps(result, _mm_and_ps(row, maskW));
+}
+
+GAMEMATH_INLINE Matrix3x4::Matrix3x4(const Matrix4 &matrix)
+{
+    const float *data = matrix.data();
+    __m128 column0 = _mm_load_ps(data);
+    __m128 column1 = _mm_load_ps(data + 4);
+    __m128 column2 = _mm_load_ps(data + 8);
+    __m128 column3 = _mm_load_ps(data + 12);
+    _MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+    rows[0] = column0;
+    rows[1] = column1;
+    rows[2] = column2;
+}
+
+GAMEMATH_INLINE Matrix4 Matrix3x4::toMatrix4() const
+{
+    __m128 row0 = rows[0];
+    __m128 row1 = rows[1];
+    __m128 row2 = rows[2];
+    __m128 row3 = _mm_load_ps(IdentityCol4);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+    Matrix4 result;
+    float *data = result.data();
+    _mm_store_ps(data, row0);
+    _mm_store_ps(data + 4, row1);
+    _mm_store_ps(data + 8, row2);
+    _mm_store_ps(data + 12, row3);
+    return result;
+}
+
+GAMEMATH_INLINE void Matrix3x4::setToIdentity()
+{
+    rows[0] = _mm_load_ps(IdentityCol1);
+    rows[1] = _mm_load_ps(IdentityCol2);
+    rows[2] = _mm_load_ps(IdentityCol3);
+}
+
+GAMEMATH_INLINE Matrix3x4 operator *(const Matrix3x4 &a, const Matrix3x4 &b)
+{
+    const __m128 maskW = _mm_load_ps((const float*)CoordinateMaskW);
+
+    Matrix3x4 result;
+    result.rows[0] = _matrix3x4_multiply_row(a.rows[0], b, maskW);
+    result.rows[1] = _matrix3x4_multiply_row(a.rows[1], b, maskW);
+    result.rows[2] = _matrix3x4_multiply_row(a.rows[2], b, maskW);
+    return result;
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::operator *(const Vector4 &vector) const
+{
+    return _matrix3x4_transform(rows[0], rows[1], rows[2], vector,
+                                _mm_and_ps(vector, _mm_load_ps((const float*)CoordinateMaskW)));
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::mapPosition(const Vector4 &vector) const
+{
+    const __m128 one = _mm_load_ps(IdentityCol4);
+    const __m128 position = _mm_or_ps(_mm_and_ps(vector, _mm_load_ps((const float*)CoordinateMaskXYZ)), one);
+    return _matrix3x4_transform(rows[0], rows[1], rows[2], position, one);
+}
+
+GAMEMATH_INLINE Vector4 Matrix3x4::mapNormal(const Vector4 &vector) const
+{
+    const __m128 normal = _mm_and_ps(vector, _mm_load_ps((const float*)CoordinateMaskXYZ));
+    return _matrix3x4_transform(rows[0], rows[1], rows[2], normal, _mm_setzero_ps());
+}
+
+GAMEMATH_INLINE Matrix3x4 Matrix3x4::inverted() const
+{
+    // The columns of the inverse of the upper left 3x3 part are the cross products of its rows,
+    // divided by the determinant. The w components of the rows drop out of the cross products.
+    __m128 column0 = _quaternion_cross(rows[1], rows[2]);
+    __m128 column1 = _quaternion_cross(rows[2], rows[0]);
+    __m128 column2 = _quaternion_cross(rows[0], rows[1]);
+
+    __m128 determinant = _dot_product(rows[0], column0);
+    determinant = _mm_shuffle_ps(determinant, determinant, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 invDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+    column0 = _mm_mul_ps(column0, invDeterminant);
+    column1 = _mm_mul_ps(column1, invDeterminant);
+    column2 = _mm_mul_ps(column2, invDeterminant);
+
+    // The translation of the inverse is the negated translation transformed by the inverse
+    __m128 translation = _mm_mul_ps(column0, _mm_shuffle_ps(rows[0], rows[0], _MM_SHUFFLE(3, 3, 3, 3)));
+    translation = _mm_add_ps(translation, _mm_mul_ps(column1, _mm_shuffle_ps(rows[1], rows[1], _MM_SHUFFLE(3, 3, 3, 3))));
+    translation = _mm_add_ps(translation, _mm_mul_ps(column2, _mm_shuffle_ps(rows[2], rows[2], _MM_SHUFFLE(3, 3, 3, 3))));
+    translation = _mm_xor_ps(translation, _mm_load_ps((const float*)SignMask));
+
+    _MM_TRANSPOSE4_PS(column0, column1, column2, translation);
+
+    Matrix3x4 result;
+    result.rows[0] = column0;
+    result.rows[1] = column1;
+    result.rows[2] = column2;
+    return result;
+}
+
+GAMEMATH_NAMESPACE_END
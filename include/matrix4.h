@@ -1,6 +1,7 @@
 #ifndef MATRIX4_H
 #define MATRIX4_H
 
+#include <cmath>
 #include <cstdio>
 
 #include "gamemath_internal.h"
@@ -88,11 +89,45 @@ public:
          */
         static Matrix4 transformation(const Vector4 &scale, const Quaternion &rotation, const Vector4 &translation);
 
+        /**
+         * Same as transformation for arrays of scales, rotations and translations:
+         * results[i] = transformation(scales[i], rotations[i], translations[i]).
+         *
+         * With SSE, four matrices are computed at once, with one matrix per register lane.
+         */
+        static void transformation(const Vector4 *scales, const Quaternion *rotations, const Vector4 *translations,
+                                   size_t count, Matrix4 *results);
+
         /**
          * Creates a 3D scaling matrix from the given quaternion.
          */
         static Matrix4 rotation(const Quaternion &rotation);
 
+        /**
+         * Splits this matrix into the scale, rotation and translation that transformation would build it from.
+         * The fourth row is assumed to be (0, 0, 0, 1).
+         *
+         * The scale is the length of the first three columns. If the determinant is negative, the matrix
+         * contains a mirroring, which is returned as a negative x scale. If the columns aren't orthogonal
+         * because the matrix contains a shear, the rotation is the one closest to the upper 3x3 part, found by
+         * polar decomposition, and the scale is what remains along its axes. Transforming with the result is
+         * then only an approximation of this matrix.
+         *
+         * @param translation Receives the fourth column, with a w component of zero.
+         * @return False if one of the first three columns has a length of zero, in which case the rotation is
+         *         the identity.
+         */
+        bool decompose(Vector4 &scale, Quaternion &rotation, Vector4 &translation) const;
+
+        /**
+         * Same as decompose for an array of matrices.
+         *
+         * With SSE, four matrices are decomposed at once, with one matrix per register lane. Only sheared
+         * matrices fall back to decomposing one at a time.
+         */
+        static void decompose(const Matrix4 *matrices, size_t count, Vector4 *scales, Quaternion *rotations,
+                              Vector4 *translations);
+
         /**
          * Creates a viewing matrix, that is equivalent to the matrix created by gluLookAt.
          *
@@ -135,6 +170,60 @@ public:
          */
         static Matrix4 ortho(float left, float right, float bottom, float top, float nearVal, float farVal);
 
+        /**
+         * This method behaves exactly like glFrustum and will return a perspective projection matrix for the
+         * given values.
+         *
+         * @param inverse If not null, receives the inverse of the resulting matrix. It is computed in closed form,
+         *                which is both cheaper and more precise than calling inverted() on the result.
+         */
+        static Matrix4 frustum(float left, float right, float bottom, float top, float nearVal, float farVal,
+                               Matrix4 *inverse = 0);
+
+        /**
+         * This method behaves like gluPerspective, except that the vertical field of view is given in radians.
+         *
+         * @param inverse If not null, receives the inverse of the resulting matrix.
+         */
+        static Matrix4 perspective(float fovY, float aspect, float nearVal, float farVal, Matrix4 *inverse = 0);
+
+        /**
+         * Same as perspective, with the far plane moved to infinity. This avoids clipping distant geometry
+         * at the cost of some depth precision. Points at a depth of 1 lie at infinity and can't be unprojected.
+         *
+         * @param inverse If not null, receives the inverse of the resulting matrix.
+         */
+        static Matrix4 infinitePerspective(float fovY, float aspect, float nearVal, Matrix4 *inverse = 0);
+
+        /**
+         * Same as perspective, but maps the near plane to a depth of 1 and the far plane to a depth of 0,
+         * for a depth range of [0, 1] as used by Direct3D or glClipControl. Together with a floating point
+         * depth buffer, this distributes depth precision almost evenly across the view distance.
+         *
+         * @param inverse If not null, receives the inverse of the resulting matrix.
+         */
+        static Matrix4 reversedPerspective(float fovY, float aspect, float nearVal, float farVal, Matrix4 *inverse = 0);
+
+        /**
+         * Same as reversedPerspective, with the far plane moved to infinity, where the depth reaches 0.
+         * Points at a depth of 0 lie at infinity and can't be unprojected.
+         *
+         * @param inverse If not null, receives the inverse of the resulting matrix.
+         */
+        static Matrix4 reversedInfinitePerspective(float fovY, float aspect, float nearVal, Matrix4 *inverse = 0);
+
+        /**
+         * Transforms a point in normalized device coordinates by this matrix and divides the result by its
+         * w component. This matrix is usually the inverse of a view-projection matrix.
+         */
+        Vector4 unproject(const Vector4 &point) const;
+
+        /**
+         * Same as unproject, for an array of points. Only the x, y and z components of the points are used.
+         * Building picking rays this way only requires a single inverse per frame.
+         */
+        void unproject(const Vector4 *points, size_t count, Vector4 *results) const;
+
         /**
          * Creates a translation matrix with the given translation offsets, and returns it.
          */
@@ -164,6 +253,13 @@ public:
          */
         Matrix4 transposed() const;
 private:
+        /**
+         * Creates a projection matrix of the form produced by glFrustum, with the x and y scale and offset in
+         * elements (0,0), (0,2), (1,1) and (1,2), and the depth mapping in elements (2,2) and (2,3).
+         */
+        static Matrix4 projection(float scaleX, float offsetX, float scaleY, float offsetY, float depthScale,
+                                  float depthOffset, Matrix4 *inverse);
+
         float matrixDet3(int col0, int col1, int col2, int row0, int row1, int row2) const;
         float matrixDet4() const;
 
@@ -246,6 +342,67 @@ GAMEMATH_INLINE Matrix4 Matrix4::ortho(float left, float right, float bottom, fl
         return result;
 }
 
+GAMEMATH_INLINE Matrix4 Matrix4::projection(float scaleX, float offsetX, float scaleY, float offsetY, float depthScale,
+                                            float depthOffset, Matrix4 *inverse)
+{
+        Matrix4 result;
+        result.setToZero();
+        result.m[0][0] = scaleX;
+        result.m[2][0] = offsetX;
+        result.m[1][1] = scaleY;
+        result.m[2][1] = offsetY;
+        result.m[2][2] = depthScale;
+        result.m[3][2] = depthOffset;
+        result.m[2][3] = -1;
+
+        // Solving the rows of the projection for the view space coordinates gives the inverse directly
+        if (inverse) {
+                inverse->setToZero();
+                inverse->m[0][0] = 1.0f / scaleX;
+                inverse->m[3][0] = offsetX / scaleX;
+                inverse->m[1][1] = 1.0f / scaleY;
+                inverse->m[3][1] = offsetY / scaleY;
+                inverse->m[3][2] = -1;
+                inverse->m[2][3] = 1.0f / depthOffset;
+                inverse->m[3][3] = depthScale / depthOffset;
+        }
+
+        return result;
+}
+
+GAMEMATH_INLINE Matrix4 Matrix4::frustum(float left, float right, float bottom, float top, float nearVal, float farVal,
+                                         Matrix4 *inverse)
+{
+        return projection(2 * nearVal / (right - left), (right + left) / (right - left),
+                2 * nearVal / (top - bottom), (top + bottom) / (top - bottom),
+                - (farVal + nearVal) / (farVal - nearVal), - 2 * farVal * nearVal / (farVal - nearVal), inverse);
+}
+
+GAMEMATH_INLINE Matrix4 Matrix4::perspective(float fovY, float aspect, float nearVal, float farVal, Matrix4 *inverse)
+{
+        const float f = 1.0f / tan(fovY * 0.5f);
+        return projection(f / aspect, 0, f, 0, - (farVal + nearVal) / (farVal - nearVal),
+                - 2 * farVal * nearVal / (farVal - nearVal), inverse);
+}
+
+GAMEMATH_INLINE Matrix4 Matrix4::infinitePerspective(float fovY, float aspect, float nearVal, Matrix4 *inverse)
+{
+        const float f = 1.0f / tan(fovY * 0.5f);
+        return projection(f / aspect, 0, f, 0, -1, - 2 * nearVal, inverse);
+}
+
+GAMEMATH_INLINE Matrix4 Matrix4::reversedPerspective(float fovY, float aspect, float nearVal, float farVal, Matrix4 *inverse)
+{
+        const float f = 1.0f / tan(fovY * 0.5f);
+        return projection(f / aspect, 0, f, 0, nearVal / (farVal - nearVal), farVal * nearVal / (farVal - nearVal), inverse);
+}
+
+GAMEMATH_INLINE Matrix4 Matrix4::reversedInfinitePerspective(float fovY, float aspect, float nearVal, Matrix4 *inverse)
+{
+        const float f = 1.0f / tan(fovY * 0.5f);
+        return projection(f / aspect, 0, f, 0, 0, nearVal, inverse);
+}
+
 // The 4x4 matrix inverse algorithm is based on that described at:
 // http://www.j3d.org/matrix_faq/matrfaq_latest.html#Q24
 // Some optimization has been done to avoid making copies of 3x3
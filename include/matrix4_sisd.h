@@ -7,6 +7,7 @@
 #error "Do not include this file directly, only include matrix4.h"
 #endif
 
+#include <algorithm>
 #include <cstring>
 
 GAMEMATH_NAMESPACE_BEGIN
@@ -95,6 +96,128 @@ GAMEMATH_INLINE Matrix4 Matrix4::transformation(const Vector4 &scale,
 	return result;
 }
 
+GAMEMATH_INLINE void Matrix4::transformation(const Vector4 *scales, const Quaternion *rotations,
+									   const Vector4 *translations, size_t count, Matrix4 *results)
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = transformation(scales[i], rotations[i], translations[i]);
+}
+
+GAMEMATH_INLINE bool Matrix4::decompose(Vector4 &scale, Quaternion &rotation, Vector4 &translation) const
+{
+	translation = Vector4(m[3][0], m[3][1], m[3][2], 0);
+
+	float scales[3];
+	for (int col = 0; col < 3; ++col)
+		scales[col] = std::sqrt(m[col][0] * m[col][0] + m[col][1] * m[col][1] + m[col][2] * m[col][2]);
+
+	// A negative determinant means the matrix mirrors, which is moved onto the x scale
+	const float determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+		+ m[0][1] * (m[1][2] * m[2][0] - m[1][0] * m[2][2])
+		+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	if (determinant < 0)
+		scales[0] = -scales[0];
+
+	if (scales[0] * scales[0] <= 1e-24f || scales[1] * scales[1] <= 1e-24f || scales[2] * scales[2] <= 1e-24f) {
+		scale = Vector4(scales[0], scales[1], scales[2], 0);
+		rotation = Quaternion(0, 0, 0, 1);
+		return false;
+	}
+
+	// The normalized columns, r[col][row]
+	float r[3][3];
+	for (int col = 0; col < 3; ++col)
+		for (int row = 0; row < 3; ++row)
+			r[col][row] = m[col][row] / scales[col];
+
+	const float dot01 = r[0][0] * r[1][0] + r[0][1] * r[1][1] + r[0][2] * r[1][2];
+	const float dot02 = r[0][0] * r[2][0] + r[0][1] * r[2][1] + r[0][2] * r[2][2];
+	const float dot12 = r[1][0] * r[2][0] + r[1][1] * r[2][1] + r[1][2] * r[2][2];
+
+	if (std::fabs(dot01) > 1e-4f || std::fabs(dot02) > 1e-4f || std::fabs(dot12) > 1e-4f) {
+		// Polar decomposition by Newton's iteration R = (R + R^-T) / 2, see the SSE version. It starts
+		// with the matrix divided by its average scale, without the mirroring.
+		const float invScale = 3 / (std::fabs(scales[0]) + scales[1] + scales[2]);
+		for (int col = 0; col < 3; ++col)
+			for (int row = 0; row < 3; ++row)
+				r[col][row] = m[col][row] * invScale;
+		if (determinant < 0)
+			r[0][0] = -r[0][0], r[0][1] = -r[0][1], r[0][2] = -r[0][2];
+
+		for (int i = 0; i < 20; ++i) {
+			float cross[3][3];
+			for (int col = 0; col < 3; ++col) {
+				const float *a = r[(col + 1) % 3];
+				const float *b = r[(col + 2) % 3];
+				cross[col][0] = a[1] * b[2] - a[2] * b[1];
+				cross[col][1] = a[2] * b[0] - a[0] * b[2];
+				cross[col][2] = a[0] * b[1] - a[1] * b[0];
+			}
+			const float factor = 0.5f / (r[0][0] * cross[0][0] + r[0][1] * cross[0][1] + r[0][2] * cross[0][2]);
+
+			float change = 0;
+			for (int col = 0; col < 3; ++col) {
+				for (int row = 0; row < 3; ++row) {
+					const float next = 0.5f * r[col][row] + factor * cross[col][row];
+					change = std::max(change, std::fabs(next - r[col][row]));
+					r[col][row] = next;
+				}
+			}
+			if (change <= 1e-6f)
+				break;
+		}
+
+		// The scale is the diagonal of the remaining stretch, rotation^T * matrix. The x scale comes out
+		// negative again for a mirroring matrix.
+		for (int col = 0; col < 3; ++col)
+			scales[col] = r[col][0] * m[col][0] + r[col][1] * m[col][1] + r[col][2] * m[col][2];
+	}
+
+	scale = Vector4(scales[0], scales[1], scales[2], 0);
+
+	// Start with the component that has the largest diagonal term, which is at least one
+	const float diagonal[4] = {
+		1 + r[0][0] - r[1][1] - r[2][2],
+		1 - r[0][0] + r[1][1] - r[2][2],
+		1 - r[0][0] - r[1][1] + r[2][2],
+		1 + r[0][0] + r[1][1] + r[2][2]
+	};
+	const float sumXY = r[0][1] + r[1][0];
+	const float sumXZ = r[2][0] + r[0][2];
+	const float sumYZ = r[1][2] + r[2][1];
+	const float differenceX = r[1][2] - r[2][1];
+	const float differenceY = r[2][0] - r[0][2];
+	const float differenceZ = r[0][1] - r[1][0];
+
+	float x, y, z, w;
+	if (diagonal[3] >= diagonal[0] && diagonal[3] >= diagonal[1] && diagonal[3] >= diagonal[2]) {
+		const float factor = 0.5f / std::sqrt(diagonal[3]);
+		x = differenceX * factor; y = differenceY * factor; z = differenceZ * factor; w = diagonal[3] * factor;
+	} else if (diagonal[0] >= diagonal[1] && diagonal[0] >= diagonal[2]) {
+		const float factor = 0.5f / std::sqrt(diagonal[0]);
+		x = diagonal[0] * factor; y = sumXY * factor; z = sumXZ * factor; w = differenceX * factor;
+	} else if (diagonal[1] >= diagonal[2]) {
+		const float factor = 0.5f / std::sqrt(diagonal[1]);
+		x = sumXY * factor; y = diagonal[1] * factor; z = sumYZ * factor; w = differenceY * factor;
+	} else {
+		const float factor = 0.5f / std::sqrt(diagonal[2]);
+		x = sumXZ * factor; y = sumYZ * factor; z = diagonal[2] * factor; w = differenceZ * factor;
+	}
+
+	if (w < 0)
+		rotation = Quaternion(-x, -y, -z, -w);
+	else
+		rotation = Quaternion(x, y, z, w);
+	return true;
+}
+
+GAMEMATH_INLINE void Matrix4::decompose(const Matrix4 *matrices, size_t count, Vector4 *scales, Quaternion *rotations,
+	Vector4 *translations)
+{
+	for (size_t i = 0; i < count; ++i)
+		matrices[i].decompose(scales[i], rotations[i], translations[i]);
+}
+
 GAMEMATH_INLINE Matrix4 Matrix4::translation(float x, float y, float z, float w)
 {
 	Matrix4 result;
@@ -106,4 +229,17 @@ GAMEMATH_INLINE Matrix4 Matrix4::translation(float x, float y, float z, float w)
 	return result;
 }
 
+GAMEMATH_INLINE Vector4 Matrix4::unproject(const Vector4 &point) const
+{
+	const Vector4 result = *this * Vector4(point.x(), point.y(), point.z(), 1);
+	const float invW = 1.0f / result.w();
+	return Vector4(result.x() * invW, result.y() * invW, result.z() * invW, 1);
+}
+
+GAMEMATH_INLINE void Matrix4::unproject(const Vector4 *points, size_t count, Vector4 *results) const
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = unproject(points[i]);
+}
+
 GAMEMATH_NAMESPACE_END
@@ -133,66 +133,404 @@ GAMEMATH_INLINE void Matrix4::print() const
 	}
 }
 
+/**
+  Computes the first three columns of the rotation matrix of a normalized quaternion, without leaving
+  the registers. The w components of the columns are zero.
+  */
+GAMEMATH_INLINE void _matrix4_rotation_columns(const __m128 rotation, __m128 &column0, __m128 &column1, __m128 &column2)
+{
+	const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+	// (2xx, 2yy, 2zz, 2ww)
+	const __m128 doubled = _mm_add_ps(rotation, rotation);
+	const __m128 squares = _mm_mul_ps(rotation, doubled);
+
+	// The diagonal (1 - 2yy - 2zz, 1 - 2xx - 2zz, 1 - 2xx - 2yy, 0)
+	const __m128 squares0 = _mm_and_ps(_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 0, 0, 1)), maskXYZ);
+	const __m128 squares1 = _mm_and_ps(_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(3, 1, 2, 2)), maskXYZ);
+	const __m128 diagonal = _mm_sub_ps(_mm_sub_ps(_mm_and_ps(_mm_set1_ps(1.0f), maskXYZ), squares0), squares1);
+
+	// (2xz, 2xy, 2yz) and (2wy, 2wz, 2wx)
+	const __m128 products = _mm_mul_ps(_mm_shuffle_ps(rotation, rotation, _MM_SHUFFLE(3, 1, 0, 0)),
+		_mm_shuffle_ps(doubled, doubled, _MM_SHUFFLE(3, 2, 1, 2)));
+	const __m128 wProducts = _mm_mul_ps(_mm_shuffle_ps(doubled, doubled, _MM_SHUFFLE(3, 3, 3, 3)),
+		_mm_shuffle_ps(rotation, rotation, _MM_SHUFFLE(3, 0, 2, 1)));
+
+	// (2xz + 2wy, 2xy + 2wz, 2yz + 2wx) and (2xz - 2wy, 2xy - 2wz, 2yz - 2wx)
+	const __m128 sums = _mm_add_ps(products, wProducts);
+	const __m128 differences = _mm_sub_ps(products, wProducts);
+
+	// (2xy + 2wz, 2yz + 2wx, 2xz - 2wy, 2xy - 2wz) and (2xz + 2wy, 2xz + 2wy, 2yz - 2wx, 2yz - 2wx)
+	const __m128 mixed0 = _mm_shuffle_ps(sums, differences, _MM_SHUFFLE(1, 0, 2, 1));
+	const __m128 mixed1 = _mm_shuffle_ps(sums, differences, _MM_SHUFFLE(2, 2, 0, 0));
+
+	// (diagonal.x, 0, 2xy + 2wz, 2xz - 2wy) -> (1 - 2yy - 2zz, 2xy + 2wz, 2xz - 2wy, 0)
+	column0 = _mm_shuffle_ps(diagonal, mixed0, _MM_SHUFFLE(2, 0, 3, 0));
+	column0 = _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(1, 3, 2, 0));
+
+	// (diagonal.y, 0, 2yz + 2wx, 2xy - 2wz) -> (2xy - 2wz, 1 - 2xx - 2zz, 2yz + 2wx, 0)
+	column1 = _mm_shuffle_ps(diagonal, mixed0, _MM_SHUFFLE(3, 1, 3, 1));
+	column1 = _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(1, 2, 0, 3));
+
+	// (2xz + 2wy, 2yz - 2wx, 1 - 2xx - 2yy, 0)
+	column2 = _mm_shuffle_ps(mixed1, diagonal, _MM_SHUFFLE(3, 2, 2, 0));
+}
+
 GAMEMATH_INLINE Matrix4 Matrix4::transformation(const Vector4 &scale, 
 	const Quaternion &rotation, 
 	const Vector4 &translation)
 {
-    Matrix4 result;
-
-    __m128 doubledScale = _mm_mul_ps(_mm_load_ps(FactorTwo), scale);
+	Matrix4 result;
+	__m128 column0, column1, column2;
+	_matrix4_rotation_columns(_mm_load_ps(rotation.data()), column0, column1, column2);
 
-    // Splat X scale into vector
-    __m128 scaleFac = _mm_shuffle_ps(doubledScale, doubledScale, _MM_SHUFFLE(0, 0, 0, 0));
+	result.columns[0] = _mm_mul_ps(column0, _mm_shuffle_ps(scale.mSse, scale.mSse, _MM_SHUFFLE(0, 0, 0, 0)));
+	result.columns[1] = _mm_mul_ps(column1, _mm_shuffle_ps(scale.mSse, scale.mSse, _MM_SHUFFLE(1, 1, 1, 1)));
+	result.columns[2] = _mm_mul_ps(column2, _mm_shuffle_ps(scale.mSse, scale.mSse, _MM_SHUFFLE(2, 2, 2, 2)));
+	result.columns[3] = _mm_or_ps(_mm_and_ps(translation.mSse, _mm_load_ps((const float*)CoordinateMaskXYZ)),
+		_mm_load_ps(IdentityCol4));
 
-    // Rotation
-    result.m[0][0] = 0.5f - rotation.y() * rotation.y() - rotation.z() * rotation.z();
-    result.m[0][1] = rotation.x() * rotation.y() + rotation.w() * rotation.z();
-    result.m[0][2] = rotation.x() * rotation.z() - rotation.w() * rotation.y();
-    result.m[0][3] = 0;
-    result.columns[0] = _mm_mul_ps(result.columns[0], scaleFac);
+	return result;
+}
 
-    scaleFac = _mm_shuffle_ps(doubledScale, doubledScale, _MM_SHUFFLE(1, 1, 1, 1));
-    result.m[1][0] = rotation.x() * rotation.y() - rotation.w() * rotation.z();
-    result.m[1][1] = 0.5f - rotation.x() * rotation.x() - rotation.z() * rotation.z();
-    result.m[1][2] = rotation.y() * rotation.z() + rotation.w() * rotation.x();
-    result.m[1][3] = 0;
-    result.columns[1] = _mm_mul_ps(result.columns[1], scaleFac);
+/**
+  Transposes three elements of a column of four matrices, with one matrix per lane, and stores the
+  column into each of the matrices.
+  */
+GAMEMATH_INLINE void _matrix4_store_column4(__m128 row0, __m128 row1, __m128 row2, int col, Matrix4 *results)
+{
+	__m128 row3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+	_mm_store_ps(results[0].data() + 4 * col, row0);
+	_mm_store_ps(results[1].data() + 4 * col, row1);
+	_mm_store_ps(results[2].data() + 4 * col, row2);
+	_mm_store_ps(results[3].data() + 4 * col, row3);
+}
 
-    scaleFac = _mm_shuffle_ps(doubledScale, doubledScale, _MM_SHUFFLE(2, 2, 2, 2));
-    result.m[2][0] = rotation.x() * rotation.z() + rotation.w() * rotation.y();
-    result.m[2][1] = rotation.y() * rotation.z() - rotation.w() * rotation.x();
-    result.m[2][2] = 0.5f - rotation.x() * rotation.x() - rotation.y() * rotation.y();
-    result.m[2][3] = 0;
-    result.columns[2] = _mm_mul_ps(result.columns[2], scaleFac);
+/**
+  Computes the upper 3x3 elements of four transformation matrices, with one matrix per lane. The
+  rotations and scales are passed transposed, with one component of all four in each register, so
+  every element is computed for four matrices with the same instructions. elements[col][row]
+  receives the elements in the same layout.
+  */
+GAMEMATH_INLINE void _matrix4_transformation4(const __m128 x, const __m128 y, const __m128 z, const __m128 w,
+	const __m128 scaleX, const __m128 scaleY, const __m128 scaleZ, __m128 elements[3][3])
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 x2 = _mm_add_ps(x, x);
+	const __m128 y2 = _mm_add_ps(y, y);
+	const __m128 z2 = _mm_add_ps(z, z);
+	const __m128 xx = _mm_mul_ps(x, x2);
+	const __m128 yy = _mm_mul_ps(y, y2);
+	const __m128 zz = _mm_mul_ps(z, z2);
+	const __m128 xy = _mm_mul_ps(x, y2);
+	const __m128 xz = _mm_mul_ps(x, z2);
+	const __m128 yz = _mm_mul_ps(y, z2);
+	const __m128 wx = _mm_mul_ps(w, x2);
+	const __m128 wy = _mm_mul_ps(w, y2);
+	const __m128 wz = _mm_mul_ps(w, z2);
+
+	elements[0][0] = _mm_mul_ps(scaleX, _mm_sub_ps(_mm_sub_ps(one, yy), zz));
+	elements[0][1] = _mm_mul_ps(scaleX, _mm_add_ps(xy, wz));
+	elements[0][2] = _mm_mul_ps(scaleX, _mm_sub_ps(xz, wy));
+
+	elements[1][0] = _mm_mul_ps(scaleY, _mm_sub_ps(xy, wz));
+	elements[1][1] = _mm_mul_ps(scaleY, _mm_sub_ps(_mm_sub_ps(one, xx), zz));
+	elements[1][2] = _mm_mul_ps(scaleY, _mm_add_ps(yz, wx));
+
+	elements[2][0] = _mm_mul_ps(scaleZ, _mm_add_ps(xz, wy));
+	elements[2][1] = _mm_mul_ps(scaleZ, _mm_sub_ps(yz, wx));
+	elements[2][2] = _mm_mul_ps(scaleZ, _mm_sub_ps(_mm_sub_ps(one, xx), yy));
+}
 
-    // Translation
-    result.columns[3] = translation.mSse;
-    result.m[3][3] = 1;
+GAMEMATH_INLINE void Matrix4::transformation(const Vector4 *scales, const Quaternion *rotations,
+	const Vector4 *translations, size_t count, Matrix4 *results)
+{
+	const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+	const __m128 identityCol4 = _mm_load_ps(IdentityCol4);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_load_ps(rotations[i].data());
+		__m128 y = _mm_load_ps(rotations[i + 1].data());
+		__m128 z = _mm_load_ps(rotations[i + 2].data());
+		__m128 w = _mm_load_ps(rotations[i + 3].data());
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		__m128 scaleX = scales[i].mSse;
+		__m128 scaleY = scales[i + 1].mSse;
+		__m128 scaleZ = scales[i + 2].mSse;
+		__m128 scaleW = scales[i + 3].mSse;
+		_MM_TRANSPOSE4_PS(scaleX, scaleY, scaleZ, scaleW);
+
+		__m128 elements[3][3];
+		_matrix4_transformation4(x, y, z, w, scaleX, scaleY, scaleZ, elements);
+		_matrix4_store_column4(elements[0][0], elements[0][1], elements[0][2], 0, results + i);
+		_matrix4_store_column4(elements[1][0], elements[1][1], elements[1][2], 1, results + i);
+		_matrix4_store_column4(elements[2][0], elements[2][1], elements[2][2], 2, results + i);
+
+		for (int j = 0; j < 4; ++j)
+			results[i + j].columns[3] = _mm_or_ps(_mm_and_ps(translations[i + j].mSse, maskXYZ), identityCol4);
+	}
 
-    return result;
+	for (; i < count; ++i)
+		results[i] = transformation(scales[i], rotations[i], translations[i]);
 }
 
 GAMEMATH_INLINE Matrix4 Matrix4::rotation(const Quaternion &rotation)
 {
 	Matrix4 result;
-	result.setToZero();
+	_matrix4_rotation_columns(_mm_load_ps(rotation.data()), result.columns[0], result.columns[1], result.columns[2]);
+	result.columns[3] = _mm_load_ps(IdentityCol4);
 
-	// Rotation
-	result.m[0][0] = (1 - 2 * rotation.y() * rotation.y() - 2 * rotation.z() * rotation.z());
-	result.m[0][1] = (2 * rotation.x() * rotation.y() + 2 * rotation.w() * rotation.z());
-	result.m[0][2] = (2 * rotation.x() * rotation.z() - 2 * rotation.w() * rotation.y());
+	return result;
+}
 
-	result.m[1][0] = (2 * rotation.x() * rotation.y() - 2 * rotation.w() * rotation.z());
-	result.m[1][1] = (1 - 2 * rotation.x() * rotation.x() - 2 * rotation.z() * rotation.z());
-	result.m[1][2] = (2 * rotation.y() * rotation.z() + 2 * rotation.w() * rotation.x());
+/**
+  Returns the value of a, b, c or d in every lane, depending on which of the masks is set in that lane.
+  At most one of the masks may be set per lane.
+  */
+GAMEMATH_INLINE __m128 _matrix4_select4(const __m128 maskA, const __m128 a, const __m128 maskB, const __m128 b,
+	const __m128 maskC, const __m128 c, const __m128 maskD, const __m128 d)
+{
+	return _mm_or_ps(_mm_or_ps(_mm_and_ps(maskA, a), _mm_and_ps(maskB, b)),
+		_mm_or_ps(_mm_and_ps(maskC, c), _mm_and_ps(maskD, d)));
+}
 
-	result.m[2][0] = (2 * rotation.x() * rotation.z() + 2 * rotation.w() * rotation.y());
-	result.m[2][1] = (2 * rotation.y() * rotation.z() - 2 * rotation.w() * rotation.x());
-	result.m[2][2] = (1 - 2 * rotation.x() * rotation.x() - 2 * rotation.y() * rotation.y());
+/**
+  The inverse of _matrix4_transformation4: splits the upper 3x3 elements of four matrices, with one matrix
+  per lane, into their scales and rotations, both transposed like the inputs of _matrix4_transformation4.
 
-	result.m[3][3] = 1;
+  The rotations are converted from the normalized columns without branches. Each of the four quaternion
+  components can be computed from the diagonal, and the others from it and the off-diagonal elements.
+  The component with the largest diagonal term is used, which is at least one for a rotation matrix, so
+  the division by it never loses precision. The w components of the results are positive.
 
-	return result;
+  degenerate receives the lanes with a column of length zero, which get the identity rotation. The
+  return value has the lanes set whose normalized columns aren't orthogonal, i.e. sheared matrices.
+  */
+GAMEMATH_INLINE __m128 _matrix4_decompose4(const __m128 elements[3][3], __m128 &scaleX, __m128 &scaleY,
+	__m128 &scaleZ, __m128 &x, __m128 &y, __m128 &z, __m128 &w, __m128 &degenerate)
+{
+	const __m128 signMask = _mm_load_ps((const float*)SignMask);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	const __m128 lengthSquared0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(elements[0][0], elements[0][0]),
+		_mm_mul_ps(elements[0][1], elements[0][1])), _mm_mul_ps(elements[0][2], elements[0][2]));
+	const __m128 lengthSquared1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(elements[1][0], elements[1][0]),
+		_mm_mul_ps(elements[1][1], elements[1][1])), _mm_mul_ps(elements[1][2], elements[1][2]));
+	const __m128 lengthSquared2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(elements[2][0], elements[2][0]),
+		_mm_mul_ps(elements[2][1], elements[2][1])), _mm_mul_ps(elements[2][2], elements[2][2]));
+
+	const __m128 epsilon = _mm_set1_ps(1e-24f);
+	degenerate = _mm_or_ps(_mm_or_ps(_mm_cmple_ps(lengthSquared0, epsilon), _mm_cmple_ps(lengthSquared1, epsilon)),
+		_mm_cmple_ps(lengthSquared2, epsilon));
+
+	// determinant = column0 . (column1 x column2), its sign is moved onto the x scale
+	const __m128 cross0 = _mm_sub_ps(_mm_mul_ps(elements[1][1], elements[2][2]), _mm_mul_ps(elements[1][2], elements[2][1]));
+	const __m128 cross1 = _mm_sub_ps(_mm_mul_ps(elements[1][2], elements[2][0]), _mm_mul_ps(elements[1][0], elements[2][2]));
+	const __m128 cross2 = _mm_sub_ps(_mm_mul_ps(elements[1][0], elements[2][1]), _mm_mul_ps(elements[1][1], elements[2][0]));
+	const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(elements[0][0], cross0),
+		_mm_mul_ps(elements[0][1], cross1)), _mm_mul_ps(elements[0][2], cross2));
+
+	scaleX = _mm_xor_ps(_mm_sqrt_ps(lengthSquared0), _mm_and_ps(determinant, signMask));
+	scaleY = _mm_sqrt_ps(lengthSquared1);
+	scaleZ = _mm_sqrt_ps(lengthSquared2);
+
+	// The rotation matrix, mRowCol
+	const __m128 invScaleX = _mm_div_ps(one, scaleX);
+	const __m128 invScaleY = _mm_div_ps(one, scaleY);
+	const __m128 invScaleZ = _mm_div_ps(one, scaleZ);
+	const __m128 m00 = _mm_mul_ps(elements[0][0], invScaleX);
+	const __m128 m10 = _mm_mul_ps(elements[0][1], invScaleX);
+	const __m128 m20 = _mm_mul_ps(elements[0][2], invScaleX);
+	const __m128 m01 = _mm_mul_ps(elements[1][0], invScaleY);
+	const __m128 m11 = _mm_mul_ps(elements[1][1], invScaleY);
+	const __m128 m21 = _mm_mul_ps(elements[1][2], invScaleY);
+	const __m128 m02 = _mm_mul_ps(elements[2][0], invScaleZ);
+	const __m128 m12 = _mm_mul_ps(elements[2][1], invScaleZ);
+	const __m128 m22 = _mm_mul_ps(elements[2][2], invScaleZ);
+
+	const __m128 dot01 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, m01), _mm_mul_ps(m10, m11)), _mm_mul_ps(m20, m21));
+	const __m128 dot02 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, m02), _mm_mul_ps(m10, m12)), _mm_mul_ps(m20, m22));
+	const __m128 dot12 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, m02), _mm_mul_ps(m11, m12)), _mm_mul_ps(m21, m22));
+	const __m128 maxDot = _mm_max_ps(_mm_max_ps(_mm_andnot_ps(signMask, dot01), _mm_andnot_ps(signMask, dot02)),
+		_mm_andnot_ps(signMask, dot12));
+	const __m128 sheared = _mm_andnot_ps(degenerate, _mm_cmpgt_ps(maxDot, _mm_set1_ps(1e-4f)));
+
+	// The diagonal terms (4xx, 4yy, 4zz, 4ww)
+	const __m128 diagonalX = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m00), m11), m22);
+	const __m128 diagonalY = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(one, m00), m11), m22);
+	const __m128 diagonalZ = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(one, m00), m11), m22);
+	const __m128 diagonalW = _mm_add_ps(_mm_add_ps(_mm_add_ps(one, m00), m11), m22);
+
+	// (4xy, 4xz, 4yz) and (4wx, 4wy, 4wz)
+	const __m128 sumXY = _mm_add_ps(m10, m01);
+	const __m128 sumXZ = _mm_add_ps(m02, m20);
+	const __m128 sumYZ = _mm_add_ps(m21, m12);
+	const __m128 differenceX = _mm_sub_ps(m21, m12);
+	const __m128 differenceY = _mm_sub_ps(m02, m20);
+	const __m128 differenceZ = _mm_sub_ps(m10, m01);
+
+	const __m128 largest = _mm_max_ps(_mm_max_ps(diagonalX, diagonalY), _mm_max_ps(diagonalZ, diagonalW));
+	const __m128 selectW = _mm_cmpeq_ps(diagonalW, largest);
+	const __m128 selectX = _mm_andnot_ps(selectW, _mm_cmpeq_ps(diagonalX, largest));
+	const __m128 selectY = _mm_andnot_ps(_mm_or_ps(selectW, selectX), _mm_cmpeq_ps(diagonalY, largest));
+	const __m128 selectZ = _mm_andnot_ps(_mm_or_ps(_mm_or_ps(selectW, selectX), selectY),
+		_mm_cmpeq_ps(diagonalZ, largest));
+
+	// Every component is 4 times the largest one times itself, so dividing by 2 sqrt(largest) leaves it
+	const __m128 factor = _mm_div_ps(_mm_set1_ps(0.5f), _mm_sqrt_ps(largest));
+	x = _mm_mul_ps(factor, _matrix4_select4(selectX, diagonalX, selectY, sumXY, selectZ, sumXZ, selectW, differenceX));
+	y = _mm_mul_ps(factor, _matrix4_select4(selectX, sumXY, selectY, diagonalY, selectZ, sumYZ, selectW, differenceY));
+	z = _mm_mul_ps(factor, _matrix4_select4(selectX, sumXZ, selectY, sumYZ, selectZ, diagonalZ, selectW, differenceZ));
+	w = _mm_mul_ps(factor, _matrix4_select4(selectX, differenceX, selectY, differenceY, selectZ, differenceZ,
+		selectW, diagonalW));
+
+	const __m128 sign = _mm_and_ps(w, signMask);
+	x = _mm_andnot_ps(degenerate, _mm_xor_ps(x, sign));
+	y = _mm_andnot_ps(degenerate, _mm_xor_ps(y, sign));
+	z = _mm_andnot_ps(degenerate, _mm_xor_ps(z, sign));
+	w = _mm_or_ps(_mm_andnot_ps(degenerate, _mm_xor_ps(w, sign)), _mm_and_ps(degenerate, one));
+
+	return sheared;
+}
+
+/**
+  Replaces three columns with the rotation closest to them, the orthogonal factor of their polar
+  decomposition. This uses Newton's iteration R = (R + R^-T) / 2, where the columns of R^-T are the cross
+  products of the columns of R divided by the determinant, as in Matrix3x4::inverted. The determinant
+  must be positive, and the columns should have a length of about one for the iteration to converge quickly.
+  */
+GAMEMATH_INLINE void _matrix4_polar_rotation(__m128 &column0, __m128 &column1, __m128 &column2)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 tolerance = _mm_set1_ps(1e-6f);
+	const __m128 signMask = _mm_load_ps((const float*)SignMask);
+
+	for (int i = 0; i < 20; ++i) {
+		const __m128 cross0 = _quaternion_cross(column1, column2);
+		const __m128 cross1 = _quaternion_cross(column2, column0);
+		const __m128 cross2 = _quaternion_cross(column0, column1);
+		__m128 determinant = _dot_product(column0, cross0);
+		determinant = _mm_shuffle_ps(determinant, determinant, _MM_SHUFFLE(0, 0, 0, 0));
+		const __m128 factor = _mm_div_ps(half, determinant);
+
+		const __m128 next0 = _mm_add_ps(_mm_mul_ps(half, column0), _mm_mul_ps(factor, cross0));
+		const __m128 next1 = _mm_add_ps(_mm_mul_ps(half, column1), _mm_mul_ps(factor, cross1));
+		const __m128 next2 = _mm_add_ps(_mm_mul_ps(half, column2), _mm_mul_ps(factor, cross2));
+
+		const __m128 change = _mm_max_ps(_mm_max_ps(_mm_andnot_ps(signMask, _mm_sub_ps(next0, column0)),
+			_mm_andnot_ps(signMask, _mm_sub_ps(next1, column1))), _mm_andnot_ps(signMask, _mm_sub_ps(next2, column2)));
+		column0 = next0;
+		column1 = next1;
+		column2 = next2;
+		if (!_mm_movemask_ps(_mm_cmpgt_ps(change, tolerance)))
+			break;
+	}
+}
+
+/**
+  Broadcasts the upper 3x3 elements of one matrix to all lanes, in the layout of _matrix4_decompose4.
+  */
+GAMEMATH_INLINE void _matrix4_splat_elements(const __m128 column0, const __m128 column1, const __m128 column2,
+	__m128 elements[3][3])
+{
+	elements[0][0] = _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(0, 0, 0, 0));
+	elements[0][1] = _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(1, 1, 1, 1));
+	elements[0][2] = _mm_shuffle_ps(column0, column0, _MM_SHUFFLE(2, 2, 2, 2));
+	elements[1][0] = _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(0, 0, 0, 0));
+	elements[1][1] = _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(1, 1, 1, 1));
+	elements[1][2] = _mm_shuffle_ps(column1, column1, _MM_SHUFFLE(2, 2, 2, 2));
+	elements[2][0] = _mm_shuffle_ps(column2, column2, _MM_SHUFFLE(0, 0, 0, 0));
+	elements[2][1] = _mm_shuffle_ps(column2, column2, _MM_SHUFFLE(1, 1, 1, 1));
+	elements[2][2] = _mm_shuffle_ps(column2, column2, _MM_SHUFFLE(2, 2, 2, 2));
+}
+
+GAMEMATH_INLINE bool Matrix4::decompose(Vector4 &scale, Quaternion &rotation, Vector4 &translation) const
+{
+	const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+	// A single matrix goes through the same kernel as four, with every lane holding the same values
+	__m128 elements[3][3];
+	_matrix4_splat_elements(columns[0], columns[1], columns[2], elements);
+
+	__m128 scaleX, scaleY, scaleZ, x, y, z, w, degenerate;
+	const __m128 sheared = _matrix4_decompose4(elements, scaleX, scaleY, scaleZ, x, y, z, w, degenerate);
+
+	if (_mm_movemask_ps(sheared) & 1) {
+		const __m128 column0 = _mm_and_ps(columns[0], maskXYZ);
+		const __m128 column1 = _mm_and_ps(columns[1], maskXYZ);
+		const __m128 column2 = _mm_and_ps(columns[2], maskXYZ);
+
+		// The iteration starts with the matrix divided by its average scale, and the mirroring moved onto
+		// the x scale is taken out of the first column, so the determinant is positive
+		const __m128 signX = _mm_and_ps(scaleX, _mm_load_ps((const float*)SignMask));
+		const __m128 invScale = _mm_div_ps(_mm_set1_ps(3.0f),
+			_mm_add_ps(_mm_add_ps(_mm_xor_ps(scaleX, signX), scaleY), scaleZ));
+		__m128 rotation0 = _mm_xor_ps(_mm_mul_ps(column0, invScale), signX);
+		__m128 rotation1 = _mm_mul_ps(column1, invScale);
+		__m128 rotation2 = _mm_mul_ps(column2, invScale);
+		_matrix4_polar_rotation(rotation0, rotation1, rotation2);
+
+		// The scale is the diagonal of the remaining stretch, rotation^T * matrix. The x scale comes out
+		// negative again for a mirroring matrix.
+		scaleX = _dot_product(rotation0, column0);
+		scaleY = _dot_product(rotation1, column1);
+		scaleZ = _dot_product(rotation2, column2);
+
+		__m128 unused[3];
+		_matrix4_splat_elements(rotation0, rotation1, rotation2, elements);
+		_matrix4_decompose4(elements, unused[0], unused[1], unused[2], x, y, z, w, degenerate);
+	}
+
+	scale.mSse = _mm_movelh_ps(_mm_unpacklo_ps(scaleX, scaleY), _mm_unpacklo_ps(scaleZ, _mm_setzero_ps()));
+	_mm_store_ps(rotation.data(), _mm_movelh_ps(_mm_unpacklo_ps(x, y), _mm_unpacklo_ps(z, w)));
+	translation.mSse = _mm_and_ps(columns[3], maskXYZ);
+
+	return !(_mm_movemask_ps(degenerate) & 1);
+}
+
+GAMEMATH_INLINE void Matrix4::decompose(const Matrix4 *matrices, size_t count, Vector4 *scales, Quaternion *rotations,
+	Vector4 *translations)
+{
+	const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 elements[3][3];
+		for (int col = 0; col < 3; ++col) {
+			__m128 row0 = matrices[i].columns[col];
+			__m128 row1 = matrices[i + 1].columns[col];
+			__m128 row2 = matrices[i + 2].columns[col];
+			__m128 row3 = matrices[i + 3].columns[col];
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			elements[col][0] = row0;
+			elements[col][1] = row1;
+			elements[col][2] = row2;
+		}
+
+		__m128 scaleX, scaleY, scaleZ, x, y, z, w, degenerate;
+		const int sheared = _mm_movemask_ps(_matrix4_decompose4(elements, scaleX, scaleY, scaleZ, x, y, z, w,
+			degenerate));
+
+		__m128 scaleW = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(scaleX, scaleY, scaleZ, scaleW);
+		scales[i].mSse = scaleX;
+		scales[i + 1].mSse = scaleY;
+		scales[i + 2].mSse = scaleZ;
+		scales[i + 3].mSse = scaleW;
+		_quaternion_store4(x, y, z, w, rotations + i);
+
+		for (int j = 0; j < 4; ++j) {
+			translations[i + j].mSse = _mm_and_ps(matrices[i + j].columns[3], maskXYZ);
+			if (sheared & (1 << j))
+				matrices[i + j].decompose(scales[i + j], rotations[i + j], translations[i + j]);
+		}
+	}
+
+	for (; i < count; ++i)
+		matrices[i].decompose(scales[i], rotations[i], translations[i]);
 }
 
 GAMEMATH_INLINE Matrix4 operator *(const Matrix4 &m1, const Matrix4 &m2)
@@ -248,4 +586,28 @@ GAMEMATH_INLINE Matrix4 Matrix4::translation(float x, float y, float z, float w)
 	return result;
 }
 
+GAMEMATH_INLINE Vector4 Matrix4::unproject(const Vector4 &point) const
+{
+	Vector4 result = mapPosition(point);
+	result.mSse = _mm_div_ps(result.mSse, _mm_shuffle_ps(result.mSse, result.mSse, _MM_SHUFFLE(3, 3, 3, 3)));
+	return result;
+}
+
+GAMEMATH_INLINE void Matrix4::unproject(const Vector4 *points, size_t count, Vector4 *results) const
+{
+	// Keep the columns in registers across the whole array
+	const __m128 column0 = columns[0];
+	const __m128 column1 = columns[1];
+	const __m128 column2 = columns[2];
+	const __m128 column3 = columns[3];
+
+	for (size_t i = 0; i < count; ++i) {
+		const __m128 point = points[i].mSse;
+		__m128 result = _mm_add_ps(_mm_mul_ps(column0, _mm_shuffle_ps(point, point, _MM_SHUFFLE(0, 0, 0, 0))), column3);
+		result = _mm_add_ps(result, _mm_mul_ps(column1, _mm_shuffle_ps(point, point, _MM_SHUFFLE(1, 1, 1, 1))));
+		result = _mm_add_ps(result, _mm_mul_ps(column2, _mm_shuffle_ps(point, point, _MM_SHUFFLE(2, 2, 2, 2))));
+		results[i].mSse = _mm_div_ps(result, _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+}
+
 GAMEMATH_NAMESPACE_END
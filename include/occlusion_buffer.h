@@ -0,0 +1,485 @@
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "gamemath_parallel.h"
+#include "vector4.h"
+#include "matrix4.h"
+#include "box3d.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Counters collected by an OcclusionBuffer until resetStatistics is called.
+  */
+struct OcclusionStatistics {
+    /**
+      The number of calls to addOccluder, and the number of triangles passed to it.
+      */
+    long occluders;
+    long occluderTriangles;
+
+    /**
+      The number of triangles that were actually rasterized, after clipping against the near
+      plane and rejecting degenerate and off-screen triangles.
+      */
+    long rasterizedTriangles;
+
+    /**
+      The number of boxes tested with isVisible, and the number of those found to be hidden.
+      */
+    long occludees;
+    long culled;
+};
+
+/**
+  Points closer to the eye than this clip space w are clipped off occluders.
+  Boxes reaching closer than this are always visible.
+  */
+const float OcclusionNearClipW = 1e-4f;
+
+/**
+  A triangle of an occluder, set up for rasterization. Edge functions are stored as ax + by + c and
+  are non-negative inside the triangle. The depth is the reciprocal of the clip space w, which is
+  linear in screen space and larger for closer points.
+  */
+struct OcclusionTriangle {
+    float edges[3][3];
+    float depth[3];
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+};
+
+/**
+  A low resolution depth buffer that is rendered on the CPU and used to cull objects hidden behind
+  large occluders, such as buildings and terrain, after frustum culling.
+
+  Occluder meshes are transformed, clipped against the near plane and queued with addOccluder. rasterize
+  renders all queued triangles, splitting the buffer into horizontal strips that are rendered in parallel,
+  and then stores the farthest depth of every tile of TileWidth x TileHeight pixels. isVisible tests a box
+  against the tiles first, and only looks at individual pixels in tiles that can't decide.
+
+  The depth stored per pixel is 1 / w in clip space, so zero means that nothing has been drawn. This
+  requires a perspective projection. The test is conservative: boxes are only reported as hidden if
+  every pixel they might cover is closer.
+  */
+class OcclusionBuffer {
+public:
+    static const int TileWidth = 8;
+    static const int TileHeight = 8;
+
+    /**
+      Creates a buffer of the given size in pixels, rounded up to whole tiles.
+      */
+    OcclusionBuffer(int width = 320, int height = 192);
+    ~OcclusionBuffer();
+
+    void resize(int width, int height);
+
+    int width() const;
+    int height() const;
+
+    /**
+      Clears the depth buffer and removes all queued occluders. Call this at the start of every frame.
+      */
+    void clear();
+
+    /**
+      Transforms an occluder mesh with the given model view projection matrix and queues its triangles.
+      Both sides of the triangles occlude.
+      */
+    void addOccluder(const Matrix4 &modelViewProjection, const Vector4 *positions, unsigned int vertexCount,
+                     const unsigned short *indices, unsigned int triangleCount);
+
+    void addOccluder(const Matrix4 &modelViewProjection, const Vector4 *positions, unsigned int vertexCount,
+                     const unsigned int *indices, unsigned int triangleCount);
+
+    /**
+      Rasterizes all queued occluders into the depth buffer and updates the tile depths.
+      Occluders added afterwards need another call to rasterize.
+      */
+    void rasterize();
+
+    /**
+      Tests whether a box, transformed by the given model view projection matrix, might be visible.
+      Boxes outside of the screen or behind the eye are reported as hidden.
+      */
+    bool isVisible(const Matrix4 &modelViewProjection, const Box3d &box) const;
+
+    /**
+      Returns the depth of every pixel, row by row from the top, as 1 / w. Rows are width() floats long.
+      */
+    const float *depth() const;
+
+    /**
+      Returns the farthest depth of every tile, row by row from the top.
+      */
+    const float *tileDepth() const;
+
+    /**
+      The counters are updated atomically, so isVisible may be called from several threads at once.
+      */
+    OcclusionStatistics statistics() const;
+    void resetStatistics();
+
+private:
+    OcclusionBuffer(const OcclusionBuffer&);
+    OcclusionBuffer &operator =(const OcclusionBuffer&);
+
+    friend class OcclusionRasterKernel;
+
+    template<typename Index>
+    void addOccluderIndexed(const Matrix4 &modelViewProjection, const Vector4 *positions, unsigned int vertexCount,
+                            const Index *indices, unsigned int triangleCount);
+
+    void addClipSpaceTriangle(const Vector4 &a, const Vector4 &b, const Vector4 &c);
+    void setupTriangle(const Vector4 &a, const Vector4 &b, const Vector4 &c);
+
+    void rasterizeStrip(int firstTileRow, int endTileRow);
+    bool isRegionVisible(int minX, int minY, int maxX, int maxY, float depth) const;
+
+    int mWidth;
+    int mHeight;
+    int mTilesX;
+    int mTilesY;
+    float *mDepth;
+    float *mTileDepth;
+
+    Vector4 *mTransformed;
+    unsigned int mTransformedCapacity;
+
+    std::vector<OcclusionTriangle> mTriangles;
+
+    volatile long mOccluders;
+    volatile long mOccluderTriangles;
+    volatile long mRasterizedTriangles;
+    mutable volatile long mOccludees;
+    mutable volatile long mCulled;
+};
+
+/**
+  Rasterizes a range of tile rows. Each range only writes to its own rows, so ranges can run in parallel.
+  */
+class OcclusionRasterKernel {
+public:
+    OcclusionRasterKernel(OcclusionBuffer *buffer) : mBuffer(buffer) {}
+    void operator()(int, size_t begin, size_t end) const
+    {
+        mBuffer->rasterizeStrip((int)begin, (int)end);
+    }
+private:
+    OcclusionBuffer *mBuffer;
+};
+
+GAMEMATH_INLINE OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : mWidth(0), mHeight(0), mTilesX(0), mTilesY(0), mDepth(0), mTileDepth(0), mTransformed(0), mTransformedCapacity(0)
+{
+    resetStatistics();
+    resize(width, height);
+}
+
+GAMEMATH_INLINE OcclusionBuffer::~OcclusionBuffer()
+{
+    if (mDepth)
+        ALIGNED_FREE(mDepth);
+    if (mTileDepth)
+        ALIGNED_FREE(mTileDepth);
+    if (mTransformed)
+        ALIGNED_FREE(mTransformed);
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::resize(int width, int height)
+{
+    if (mDepth)
+        ALIGNED_FREE(mDepth);
+    if (mTileDepth)
+        ALIGNED_FREE(mTileDepth);
+    mDepth = 0;
+    mTileDepth = 0;
+
+    mTilesX = (std::max(width, 1) + TileWidth - 1) / TileWidth;
+    mTilesY = (std::max(height, 1) + TileHeight - 1) / TileHeight;
+    mWidth = mTilesX * TileWidth;
+    mHeight = mTilesY * TileHeight;
+
+    mDepth = static_cast<float*>(ALIGNED_MALLOC(sizeof(float) * mWidth * mHeight));
+    mTileDepth = static_cast<float*>(ALIGNED_MALLOC(sizeof(float) * mTilesX * mTilesY));
+    if (!mDepth || !mTileDepth)
+        throw std::bad_alloc();
+
+    clear();
+}
+
+GAMEMATH_INLINE int OcclusionBuffer::width() const
+{
+    return mWidth;
+}
+
+GAMEMATH_INLINE int OcclusionBuffer::height() const
+{
+    return mHeight;
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::clear()
+{
+    std::fill(mDepth, mDepth + mWidth * mHeight, 0.0f);
+    std::fill(mTileDepth, mTileDepth + mTilesX * mTilesY, 0.0f);
+    mTriangles.clear();
+}
+
+GAMEMATH_INLINE const float *OcclusionBuffer::depth() const
+{
+    return mDepth;
+}
+
+GAMEMATH_INLINE const float *OcclusionBuffer::tileDepth() const
+{
+    return mTileDepth;
+}
+
+GAMEMATH_INLINE OcclusionStatistics OcclusionBuffer::statistics() const
+{
+    OcclusionStatistics result;
+    result.occluders = mOccluders;
+    result.occluderTriangles = mOccluderTriangles;
+    result.rasterizedTriangles = mRasterizedTriangles;
+    result.occludees = mOccludees;
+    result.culled = mCulled;
+    return result;
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::resetStatistics()
+{
+    mOccluders = 0;
+    mOccluderTriangles = 0;
+    mRasterizedTriangles = 0;
+    mOccludees = 0;
+    mCulled = 0;
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::addOccluder(const Matrix4 &modelViewProjection, const Vector4 *positions, unsigned int vertexCount,
+                                                  const unsigned short *indices, unsigned int triangleCount)
+{
+    addOccluderIndexed(modelViewProjection, positions, vertexCount, indices, triangleCount);
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::addOccluder(const Matrix4 &modelViewProjection, const Vector4 *positions, unsigned int vertexCount,
+                                                  const unsigned int *indices, unsigned int triangleCount)
+{
+    addOccluderIndexed(modelViewProjection, positions, vertexCount, indices, triangleCount);
+}
+
+template<typename Index>
+GAMEMATH_INLINE void OcclusionBuffer::addOccluderIndexed(const Matrix4 &modelViewProjection, const Vector4 *positions,
+                                                         unsigned int vertexCount, const Index *indices, unsigned int triangleCount)
+{
+    mOccluders++;
+    mOccluderTriangles += triangleCount;
+
+    if (vertexCount > mTransformedCapacity) {
+        if (mTransformed)
+            ALIGNED_FREE(mTransformed);
+        mTransformedCapacity = 0;
+        mTransformed = static_cast<Vector4*>(ALIGNED_MALLOC(sizeof(Vector4) * vertexCount));
+        if (!mTransformed)
+            throw std::bad_alloc();
+        mTransformedCapacity = vertexCount;
+    }
+
+    // Every vertex is shared by several triangles, so transform them only once
+    for (unsigned int i = 0; i < vertexCount; ++i)
+        mTransformed[i] = modelViewProjection.mapPosition(positions[i]);
+
+    for (unsigned int i = 0; i < triangleCount; ++i)
+        addClipSpaceTriangle(mTransformed[indices[i * 3]], mTransformed[indices[i * 3 + 1]], mTransformed[indices[i * 3 + 2]]);
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::addClipSpaceTriangle(const Vector4 &a, const Vector4 &b, const Vector4 &c)
+{
+    const Vector4 *input[3] = { &a, &b, &c };
+    int inside = 0;
+    for (int i = 0; i < 3; ++i)
+        inside += input[i]->w() >= OcclusionNearClipW;
+
+    if (inside == 3) {
+        setupTriangle(a, b, c);
+        return;
+    }
+    if (inside == 0)
+        return;
+
+    // Clip the triangle against the near plane, which leaves a triangle or a quad
+    Vector4 clipped[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const Vector4 &current = *input[i];
+        const Vector4 &next = *input[(i + 1) % 3];
+        const bool currentInside = current.w() >= OcclusionNearClipW;
+        const bool nextInside = next.w() >= OcclusionNearClipW;
+
+        if (currentInside)
+            clipped[count++] = current;
+        if (currentInside != nextInside) {
+            const float t = (OcclusionNearClipW - current.w()) / (next.w() - current.w());
+            Vector4 intersection = current + t * (next - current);
+            intersection.setW(OcclusionNearClipW);
+            clipped[count++] = intersection;
+        }
+    }
+
+    setupTriangle(clipped[0], clipped[1], clipped[2]);
+    if (count == 4)
+        setupTriangle(clipped[0], clipped[2], clipped[3]);
+}
+
+/**
+  Clamps a pixel coordinate to [minimum, maximum] before it is converted to an integer. Points just in
+  front of the near plane can project far outside the range of int, where the conversion is undefined.
+  NaN becomes maximum.
+  */
+GAMEMATH_INLINE float _occlusion_clamp(float value, float minimum, float maximum)
+{
+    return std::max(minimum, std::min(maximum, value));
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::setupTriangle(const Vector4 &a, const Vector4 &b, const Vector4 &c)
+{
+    // Project to pixel coordinates with y pointing down
+    const Vector4 *vertices[3] = { &a, &b, &c };
+    float x[3], y[3], depth[3];
+    for (int i = 0; i < 3; ++i) {
+        depth[i] = 1.0f / vertices[i]->w();
+        x[i] = (vertices[i]->x() * depth[i] * 0.5f + 0.5f) * mWidth;
+        y[i] = (0.5f - vertices[i]->y() * depth[i] * 0.5f) * mHeight;
+    }
+
+    const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area != 0))
+        return;
+
+    OcclusionTriangle triangle;
+
+    // Pixels are covered if their center lies within the triangle
+    const float minX = std::min(x[0], std::min(x[1], x[2]));
+    const float maxX = std::max(x[0], std::max(x[1], x[2]));
+    const float minY = std::min(y[0], std::min(y[1], y[2]));
+    const float maxY = std::max(y[0], std::max(y[1], y[2]));
+    if (maxX < 0.5f || maxY < 0.5f || minX > mWidth - 0.5f || minY > mHeight - 0.5f)
+        return;
+
+    const float screenWidth = (float)mWidth, screenHeight = (float)mHeight;
+    triangle.minX = std::max((int)floor(_occlusion_clamp(minX - 0.5f, -1, screenWidth)) + 1, 0);
+    triangle.minY = std::max((int)floor(_occlusion_clamp(minY - 0.5f, -1, screenHeight)) + 1, 0);
+    triangle.maxX = std::min((int)floor(_occlusion_clamp(maxX - 0.5f, -1, screenWidth)), mWidth - 1);
+    triangle.maxY = std::min((int)floor(_occlusion_clamp(maxY - 0.5f, -1, screenHeight)), mHeight - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // Orient the edges so that they are positive inside, regardless of the winding
+    const float sign = area > 0 ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        triangle.edges[i][0] = sign * (y[i] - y[j]);
+        triangle.edges[i][1] = sign * (x[j] - x[i]);
+        triangle.edges[i][2] = sign * (x[i] * y[j] - y[i] * x[j]);
+    }
+
+    // The plane through the depths of the three vertices
+    const float invArea = 1.0f / area;
+    triangle.depth[0] = ((depth[1] - depth[0]) * (y[2] - y[0]) - (depth[2] - depth[0]) * (y[1] - y[0])) * invArea;
+    triangle.depth[1] = ((depth[2] - depth[0]) * (x[1] - x[0]) - (depth[1] - depth[0]) * (x[2] - x[0])) * invArea;
+    triangle.depth[2] = depth[0] - triangle.depth[0] * x[0] - triangle.depth[1] * y[0];
+
+    mTriangles.push_back(triangle);
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::rasterize()
+{
+    mRasterizedTriangles += (long)mTriangles.size();
+
+    if (!mTriangles.empty()) {
+        // Split the buffer into one strip of tile rows per thread
+        const int ranges = parallelRangeCount(mTilesY, 1);
+        OcclusionRasterKernel kernel(this);
+        parallelForRanges(mTilesY, ranges, kernel);
+    }
+
+    mTriangles.clear();
+}
+
+GAMEMATH_INLINE bool OcclusionBuffer::isVisible(const Matrix4 &modelViewProjection, const Box3d &box) const
+{
+    parallelAtomicIncrement(&mOccludees);
+
+    float minX = std::numeric_limits<float>::infinity();
+    float minY = minX;
+    float maxX = -minX;
+    float maxY = -minX;
+    float nearest = 0;
+    int behind = 0;
+
+    const Vector4 &minimum = box.minimum();
+    const Vector4 &maximum = box.maximum();
+    for (int i = 0; i < 8; ++i) {
+        const Vector4 corner((i & 1) ? maximum.x() : minimum.x(), (i & 2) ? maximum.y() : minimum.y(),
+            (i & 4) ? maximum.z() : minimum.z(), 1);
+        const Vector4 clip = modelViewProjection.mapPosition(corner);
+
+        if (clip.w() < OcclusionNearClipW) {
+            ++behind;
+            continue;
+        }
+
+        const float invW = 1.0f / clip.w();
+        const float x = (clip.x() * invW * 0.5f + 0.5f) * mWidth;
+        const float y = (0.5f - clip.y() * invW * 0.5f) * mHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::max(nearest, invW);
+    }
+
+    // Boxes reaching behind the near plane can cover the whole screen
+    if (behind == 8) {
+        parallelAtomicIncrement(&mCulled);
+        return false;
+    }
+    if (behind)
+        return true;
+
+    // Every pixel touched by the projected box
+    const float screenWidth = (float)mWidth, screenHeight = (float)mHeight;
+    const int pixelMinX = std::max((int)floor(_occlusion_clamp(minX, -1, screenWidth)), 0);
+    const int pixelMinY = std::max((int)floor(_occlusion_clamp(minY, -1, screenHeight)), 0);
+    const int pixelMaxX = std::min((int)ceil(_occlusion_clamp(maxX, -1, screenWidth)), mWidth) - 1;
+    const int pixelMaxY = std::min((int)ceil(_occlusion_clamp(maxY, -1, screenHeight)), mHeight) - 1;
+
+    if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) {
+        parallelAtomicIncrement(&mCulled);
+        return false;
+    }
+
+    if (isRegionVisible(pixelMinX, pixelMinY, pixelMaxX, pixelMaxY, nearest))
+        return true;
+
+    parallelAtomicIncrement(&mCulled);
+    return false;
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "occlusion_buffer_sse.h"
+#else
+#include "occlusion_buffer_sisd.h"
+#endif
+
+#endif // OCCLUSION_BUFFER_H
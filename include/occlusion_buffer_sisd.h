@@ -0,0 +1,77 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "occlusion_buffer.h"
+
+#if !defined(OCCLUSION_BUFFER_H)
+#error "Do not include this file directly, only include occlusion_buffer.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE void OcclusionBuffer::rasterizeStrip(int firstTileRow, int endTileRow)
+{
+    const int stripMinY = firstTileRow * TileHeight;
+    const int stripMaxY = endTileRow * TileHeight - 1;
+
+    for (size_t i = 0; i < mTriangles.size(); ++i) {
+        const OcclusionTriangle &triangle = mTriangles[i];
+
+        const int minY = std::max(triangle.minY, stripMinY);
+        const int maxY = std::min(triangle.maxY, stripMaxY);
+
+        for (int y = minY; y <= maxY; ++y) {
+            const float centerY = y + 0.5f;
+            float *row = mDepth + y * mWidth;
+
+            for (int x = triangle.minX; x <= triangle.maxX; ++x) {
+                const float centerX = x + 0.5f;
+                if (triangle.edges[0][0] * centerX + triangle.edges[0][1] * centerY + triangle.edges[0][2] < 0
+                    || triangle.edges[1][0] * centerX + triangle.edges[1][1] * centerY + triangle.edges[1][2] < 0
+                    || triangle.edges[2][0] * centerX + triangle.edges[2][1] * centerY + triangle.edges[2][2] < 0)
+                    continue;
+
+                const float depth = triangle.depth[0] * centerX + triangle.depth[1] * centerY + triangle.depth[2];
+                row[x] = std::max(row[x], depth);
+            }
+        }
+    }
+
+    for (int tileY = firstTileRow; tileY < endTileRow; ++tileY) {
+        for (int tileX = 0; tileX < mTilesX; ++tileX) {
+            const float *pixels = mDepth + tileY * TileHeight * mWidth + tileX * TileWidth;
+            float farthest = pixels[0];
+            for (int y = 0; y < TileHeight; ++y) {
+                for (int x = 0; x < TileWidth; ++x)
+                    farthest = std::min(farthest, pixels[y * mWidth + x]);
+            }
+            mTileDepth[tileY * mTilesX + tileX] = farthest;
+        }
+    }
+}
+
+GAMEMATH_INLINE bool OcclusionBuffer::isRegionVisible(int minX, int minY, int maxX, int maxY, float depth) const
+{
+    for (int tileY = minY / TileHeight; tileY <= maxY / TileHeight; ++tileY) {
+        for (int tileX = minX / TileWidth; tileX <= maxX / TileWidth; ++tileX) {
+            if (mTileDepth[tileY * mTilesX + tileX] >= depth)
+                continue;
+
+            const int x0 = std::max(minX, tileX * TileWidth);
+            const int x1 = std::min(maxX, tileX * TileWidth + TileWidth - 1);
+            const int y0 = std::max(minY, tileY * TileHeight);
+            const int y1 = std::min(maxY, tileY * TileHeight + TileHeight - 1);
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    if (mDepth[y * mWidth + x] < depth)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+GAMEMATH_NAMESPACE_END
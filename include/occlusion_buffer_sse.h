@@ -0,0 +1,117 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "occlusion_buffer.h"
+
+#if !defined(OCCLUSION_BUFFER_H)
+#error "Do not include this file directly, only include occlusion_buffer.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Returns the smallest of the four components of v.
+  */
+GAMEMATH_INLINE float _horizontal_min(const __m128 v)
+{
+    __m128 result = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = _mm_min_ps(result, _mm_shuffle_ps(result, result, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(result);
+}
+
+GAMEMATH_INLINE void OcclusionBuffer::rasterizeStrip(int firstTileRow, int endTileRow)
+{
+    const int stripMinY = firstTileRow * TileHeight;
+    const int stripMaxY = endTileRow * TileHeight - 1;
+    const __m128 pixelCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < mTriangles.size(); ++i) {
+        const OcclusionTriangle &triangle = mTriangles[i];
+
+        const int minY = std::max(triangle.minY, stripMinY);
+        const int maxY = std::min(triangle.maxY, stripMaxY);
+        if (minY > maxY)
+            continue;
+
+        // Rows are processed four pixels at a time. The buffer width is a multiple of the tile width,
+        // so the last group of a row never reaches past it.
+        const int minX = triangle.minX & ~3;
+        const int maxX = triangle.maxX;
+
+        const __m128 edgeX0 = _mm_set1_ps(triangle.edges[0][0]);
+        const __m128 edgeX1 = _mm_set1_ps(triangle.edges[1][0]);
+        const __m128 edgeX2 = _mm_set1_ps(triangle.edges[2][0]);
+        const __m128 depthX = _mm_set1_ps(triangle.depth[0]);
+
+        for (int y = minY; y <= maxY; ++y) {
+            const float centerY = y + 0.5f;
+            const __m128 rowEdge0 = _mm_set1_ps(triangle.edges[0][1] * centerY + triangle.edges[0][2]);
+            const __m128 rowEdge1 = _mm_set1_ps(triangle.edges[1][1] * centerY + triangle.edges[1][2]);
+            const __m128 rowEdge2 = _mm_set1_ps(triangle.edges[2][1] * centerY + triangle.edges[2][2]);
+            const __m128 rowDepth = _mm_set1_ps(triangle.depth[1] * centerY + triangle.depth[2]);
+
+            float *row = mDepth + y * mWidth;
+            for (int x = minX; x <= maxX; x += 4) {
+                const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), pixelCenters);
+
+                __m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX0, centerX), rowEdge0), zero);
+                covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX1, centerX), rowEdge1), zero));
+                covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX2, centerX), rowEdge2), zero));
+
+                // Uncovered pixels get a depth of zero, which never replaces anything
+                const __m128 depth = _mm_and_ps(covered, _mm_add_ps(_mm_mul_ps(depthX, centerX), rowDepth));
+                _mm_store_ps(row + x, _mm_max_ps(_mm_load_ps(row + x), depth));
+            }
+        }
+    }
+
+    // Store the farthest depth of every tile in the strip
+    for (int tileY = firstTileRow; tileY < endTileRow; ++tileY) {
+        for (int tileX = 0; tileX < mTilesX; ++tileX) {
+            const float *pixels = mDepth + tileY * TileHeight * mWidth + tileX * TileWidth;
+            __m128 farthest = _mm_load_ps(pixels);
+            for (int y = 0; y < TileHeight; ++y) {
+                for (int x = 0; x < TileWidth; x += 4)
+                    farthest = _mm_min_ps(farthest, _mm_load_ps(pixels + y * mWidth + x));
+            }
+            mTileDepth[tileY * mTilesX + tileX] = _horizontal_min(farthest);
+        }
+    }
+}
+
+GAMEMATH_INLINE bool OcclusionBuffer::isRegionVisible(int minX, int minY, int maxX, int maxY, float depth) const
+{
+    const __m128 boxDepth = _mm_set1_ps(depth);
+    const __m128 laneOffsets = _mm_setr_ps(0, 1, 2, 3);
+
+    for (int tileY = minY / TileHeight; tileY <= maxY / TileHeight; ++tileY) {
+        for (int tileX = minX / TileWidth; tileX <= maxX / TileWidth; ++tileX) {
+            // Every pixel of the tile is at least as close as the box
+            if (mTileDepth[tileY * mTilesX + tileX] >= depth)
+                continue;
+
+            const int x0 = std::max(minX, tileX * TileWidth);
+            const int x1 = std::min(maxX, tileX * TileWidth + TileWidth - 1);
+            const int y0 = std::max(minY, tileY * TileHeight);
+            const int y1 = std::min(maxY, tileY * TileHeight + TileHeight - 1);
+            const __m128 first = _mm_set1_ps((float)x0);
+            const __m128 last = _mm_set1_ps((float)x1);
+
+            for (int x = x0 & ~3; x <= x1; x += 4) {
+                const __m128 lanes = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+                const __m128 inside = _mm_and_ps(_mm_cmpge_ps(lanes, first), _mm_cmple_ps(lanes, last));
+
+                for (int y = y0; y <= y1; ++y) {
+                    const __m128 farther = _mm_cmplt_ps(_mm_load_ps(mDepth + y * mWidth + x), boxDepth);
+                    if (_mm_movemask_ps(_mm_and_ps(farther, inside)))
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+GAMEMATH_NAMESPACE_END
@@ -1,7 +1,11 @@
 #ifndef QUATERNION_H
 #define QUATERNION_H
 
+#include <cmath>
+#include <cstddef>
+
 #include "gamemath_internal.h"
+#include "vector4.h"
 
 GAMEMATH_NAMESPACE_BEGIN
 
@@ -10,6 +14,7 @@ friend GAMEMATH_INLINE Quaternion operator +(const Quaternion &a, const Quaterni
 friend GAMEMATH_INLINE Quaternion operator -(const Quaternion &a, const Quaternion &b);
 friend GAMEMATH_INLINE Quaternion operator *(const float, const Quaternion &vector);
 friend GAMEMATH_INLINE Quaternion operator *(const Quaternion &vector, const float);
+friend GAMEMATH_INLINE Quaternion operator *(const Quaternion &a, const Quaternion &b);
 public:
 
 	/**
@@ -124,6 +129,62 @@ public:
 	 */
 	float angle() const;
 
+	/**
+	 * Returns the conjugate of this quaternion, which has the vector part negated. For unit quaternions, this is
+	 * the inverse rotation.
+	 */
+	Quaternion conjugated() const;
+
+	/**
+	 * Returns the inverse of this quaternion, which is the conjugate divided by the squared length.
+	 * Prefer conjugated() for unit quaternions.
+	 */
+	Quaternion inverted() const;
+
+	/**
+	 * Rotates the x, y and z components of a vector by this quaternion, which must be normalized.
+	 * The w component of the vector is passed through unchanged.
+	 *
+	 * This uses the form v + 2w(q x v) + 2q x (q x v), which is cheaper than converting to a matrix
+	 * for a single vector.
+	 */
+	Vector4 rotate(const Vector4 &vector) const;
+
+	/**
+	 * Same as rotate, for an array of vectors. vectors and results may be the same array.
+	 */
+	void rotate(const Vector4 *vectors, size_t count, Vector4 *results) const;
+
+	/**
+	 * Multiplies two arrays of quaternions element by element, so that results[i] = a[i] * b[i].
+	 * results may be the same array as a or b.
+	 */
+	static void multiply(const Quaternion *a, const Quaternion *b, size_t count, Quaternion *results);
+
+	/**
+	 * Interpolates linearly between two rotations and normalizes the result. Takes the shorter path by
+	 * negating b if the rotations are more than 180 degrees apart. Unlike slerp, the angular velocity
+	 * isn't constant, but the result is close enough for blending animation keys that are close together.
+	 */
+	static Quaternion nlerp(const Quaternion &a, const Quaternion &b, float weight);
+
+	/**
+	 * Interpolates between two unit quaternions along the shorter great arc, with constant angular velocity.
+	 */
+	static Quaternion slerp(const Quaternion &a, const Quaternion &b, float weight);
+
+	/**
+	 * Same as nlerp for arrays of quaternion pairs, with one weight per pair:
+	 * results[i] = nlerp(a[i], b[i], weights[i]). results may be the same array as a or b.
+	 */
+	static void nlerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count, Quaternion *results);
+
+	/**
+	 * Same as slerp for arrays of quaternion pairs, with one weight per pair. The SSE version replaces acos and
+	 * sin with polynomials, which stay within 1e-6 of the exact result. results may be the same array as a or b.
+	 */
+	static void slerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count, Quaternion *results);
+
 private:
 
 #if !defined(GAMEMATH_NO_INTRINSICS)
@@ -197,6 +258,39 @@ GAMEMATH_INLINE float *Quaternion::data() {
         return &mX;
 }
 
+GAMEMATH_INLINE Quaternion Quaternion::nlerp(const Quaternion &a, const Quaternion &b, float weight)
+{
+	const float cosAngle = a.mX * b.mX + a.mY * b.mY + a.mZ * b.mZ + a.mW * b.mW;
+	const float weightA = 1 - weight;
+	const float weightB = cosAngle < 0 ? -weight : weight;
+
+	const float x = weightA * a.mX + weightB * b.mX;
+	const float y = weightA * a.mY + weightB * b.mY;
+	const float z = weightA * a.mZ + weightB * b.mZ;
+	const float w = weightA * a.mW + weightB * b.mW;
+	const float invLength = 1 / std::sqrt(x * x + y * y + z * z + w * w);
+	return Quaternion(x * invLength, y * invLength, z * invLength, w * invLength);
+}
+
+GAMEMATH_INLINE Quaternion Quaternion::slerp(const Quaternion &a, const Quaternion &b, float weight)
+{
+	float cosAngle = a.mX * b.mX + a.mY * b.mY + a.mZ * b.mZ + a.mW * b.mW;
+	const float sign = cosAngle < 0 ? -1.0f : 1.0f;
+	cosAngle *= sign;
+
+	// Nearly identical rotations would divide by almost zero
+	if (cosAngle > 0.9999f)
+		return nlerp(a, b, weight);
+
+	const float angle = std::acos(cosAngle);
+	const float invSinAngle = 1 / std::sin(angle);
+	const float weightA = std::sin((1 - weight) * angle) * invSinAngle;
+	const float weightB = std::sin(weight * angle) * invSinAngle * sign;
+
+	return Quaternion(weightA * a.mX + weightB * b.mX, weightA * a.mY + weightB * b.mY,
+		weightA * a.mZ + weightB * b.mZ, weightA * a.mW + weightB * b.mW);
+}
+
 GAMEMATH_NAMESPACE_END
 
 #if !defined(GAMEMATH_NO_INTRINSICS)
@@ -36,4 +36,67 @@ GAMEMATH_INLINE Quaternion Quaternion::fromAxisAndAngle(const float x, const flo
 	return Quaternion(x * sinAngle, y * sinAngle, z * sinAngle, cosAngle);
 }
 
+GAMEMATH_INLINE Quaternion operator +(const Quaternion &a, const Quaternion &b)
+{
+	return Quaternion(a.mX + b.mX, a.mY + b.mY, a.mZ + b.mZ, a.mW + b.mW);
+}
+
+GAMEMATH_INLINE Quaternion operator *(const Quaternion &a, const Quaternion &b)
+{
+	return Quaternion(a.mW * b.mX + a.mX * b.mW + a.mY * b.mZ - a.mZ * b.mY,
+		a.mW * b.mY - a.mX * b.mZ + a.mY * b.mW + a.mZ * b.mX,
+		a.mW * b.mZ + a.mX * b.mY - a.mY * b.mX + a.mZ * b.mW,
+		a.mW * b.mW - a.mX * b.mX - a.mY * b.mY - a.mZ * b.mZ);
+}
+
+GAMEMATH_INLINE Quaternion Quaternion::conjugated() const
+{
+	return Quaternion(-mX, -mY, -mZ, mW);
+}
+
+GAMEMATH_INLINE Quaternion Quaternion::inverted() const
+{
+	const float invLengthSquared = 1.0f / (mX * mX + mY * mY + mZ * mZ + mW * mW);
+	return Quaternion(-mX * invLengthSquared, -mY * invLengthSquared, -mZ * invLengthSquared, mW * invLengthSquared);
+}
+
+GAMEMATH_INLINE Vector4 Quaternion::rotate(const Vector4 &vector) const
+{
+	// t = 2 (q x v), v' = v + w t + q x t
+	const float tx = 2 * (mY * vector.z() - mZ * vector.y());
+	const float ty = 2 * (mZ * vector.x() - mX * vector.z());
+	const float tz = 2 * (mX * vector.y() - mY * vector.x());
+
+	return Vector4(vector.x() + mW * tx + mY * tz - mZ * ty,
+		vector.y() + mW * ty + mZ * tx - mX * tz,
+		vector.z() + mW * tz + mX * ty - mY * tx,
+		vector.w());
+}
+
+GAMEMATH_INLINE void Quaternion::rotate(const Vector4 *vectors, size_t count, Vector4 *results) const
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = rotate(vectors[i]);
+}
+
+GAMEMATH_INLINE void Quaternion::multiply(const Quaternion *a, const Quaternion *b, size_t count, Quaternion *results)
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = a[i] * b[i];
+}
+
+GAMEMATH_INLINE void Quaternion::nlerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count,
+									  Quaternion *results)
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = nlerp(a[i], b[i], weights[i]);
+}
+
+GAMEMATH_INLINE void Quaternion::slerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count,
+									  Quaternion *results)
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = slerp(a[i], b[i], weights[i]);
+}
+
 GAMEMATH_NAMESPACE_END
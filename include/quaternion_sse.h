@@ -144,4 +144,283 @@ GAMEMATH_INLINE float Quaternion::dot(const Quaternion &vector) const
 	return _get_lower_register(dotProduct);
 }
 
+GAMEMATH_INLINE Quaternion operator *(const Quaternion &a, const Quaternion &b)
+{
+	// Each component of a scales a permutation of b, with signs taken from the Hamilton product
+	const __m128 x = _mm_shuffle_ps(a.mSse, a.mSse, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128 y = _mm_shuffle_ps(a.mSse, a.mSse, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128 z = _mm_shuffle_ps(a.mSse, a.mSse, _MM_SHUFFLE(2, 2, 2, 2));
+	const __m128 w = _mm_shuffle_ps(a.mSse, a.mSse, _MM_SHUFFLE(3, 3, 3, 3));
+
+	const __m128 bWZYX = _mm_xor_ps(_mm_shuffle_ps(b.mSse, b.mSse, _MM_SHUFFLE(0, 1, 2, 3)), _mm_load_ps((const float*)SignMaskYW));
+	const __m128 bZWXY = _mm_xor_ps(_mm_shuffle_ps(b.mSse, b.mSse, _MM_SHUFFLE(1, 0, 3, 2)), _mm_load_ps((const float*)SignMaskZW));
+	const __m128 bYXWZ = _mm_xor_ps(_mm_shuffle_ps(b.mSse, b.mSse, _MM_SHUFFLE(2, 3, 0, 1)), _mm_load_ps((const float*)SignMaskXW));
+
+	Quaternion result;
+	result.mSse = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, b.mSse), _mm_mul_ps(x, bWZYX)),
+		_mm_add_ps(_mm_mul_ps(y, bZWXY), _mm_mul_ps(z, bYXWZ)));
+	return result;
+}
+
+GAMEMATH_INLINE Quaternion Quaternion::conjugated() const
+{
+	Quaternion result;
+	result.mSse = _mm_xor_ps(mSse, _mm_load_ps((const float*)SignMaskXYZ));
+	return result;
+}
+
+GAMEMATH_INLINE Quaternion Quaternion::inverted() const
+{
+	const __m128 lengthSquared = _dot_product(mSse, mSse);
+
+	Quaternion result;
+	result.mSse = _mm_div_ps(_mm_xor_ps(mSse, _mm_load_ps((const float*)SignMaskXYZ)),
+		_mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(0, 0, 0, 0)));
+	return result;
+}
+
+/**
+  Computes the cross product of the x, y and z components of a and b. The w component of the
+  result is zero.
+  */
+GAMEMATH_INLINE __m128 _quaternion_cross(const __m128 a, const __m128 b)
+{
+	// (a * b.yzx - a.yzx * b).yzx saves two shuffles over the textbook form
+	const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+GAMEMATH_INLINE Vector4 Quaternion::rotate(const Vector4 &vector) const
+{
+	const __m128 v = vector;
+	const __m128 w = _mm_shuffle_ps(mSse, mSse, _MM_SHUFFLE(3, 3, 3, 3));
+
+	// t = 2 (q x v), v' = v + w t + q x t
+	__m128 t = _quaternion_cross(mSse, v);
+	t = _mm_add_ps(t, t);
+	return _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(w, t)), _quaternion_cross(mSse, t));
+}
+
+GAMEMATH_INLINE void Quaternion::rotate(const Vector4 *vectors, size_t count, Vector4 *results) const
+{
+	// Four vectors at a time as structure of arrays, so the cross products need no shuffles
+	const __m128 qx = _mm_shuffle_ps(mSse, mSse, _MM_SHUFFLE(0, 0, 0, 0));
+	const __m128 qy = _mm_shuffle_ps(mSse, mSse, _MM_SHUFFLE(1, 1, 1, 1));
+	const __m128 qz = _mm_shuffle_ps(mSse, mSse, _MM_SHUFFLE(2, 2, 2, 2));
+	const __m128 qw = _mm_shuffle_ps(mSse, mSse, _MM_SHUFFLE(3, 3, 3, 3));
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = vectors[i];
+		__m128 y = vectors[i + 1];
+		__m128 z = vectors[i + 2];
+		__m128 w = vectors[i + 3];
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		__m128 tx = _mm_sub_ps(_mm_mul_ps(qy, z), _mm_mul_ps(qz, y));
+		__m128 ty = _mm_sub_ps(_mm_mul_ps(qz, x), _mm_mul_ps(qx, z));
+		__m128 tz = _mm_sub_ps(_mm_mul_ps(qx, y), _mm_mul_ps(qy, x));
+		tx = _mm_add_ps(tx, tx);
+		ty = _mm_add_ps(ty, ty);
+		tz = _mm_add_ps(tz, tz);
+
+		x = _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(qw, tx)), _mm_sub_ps(_mm_mul_ps(qy, tz), _mm_mul_ps(qz, ty)));
+		y = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(qw, ty)), _mm_sub_ps(_mm_mul_ps(qz, tx), _mm_mul_ps(qx, tz)));
+		z = _mm_add_ps(_mm_add_ps(z, _mm_mul_ps(qw, tz)), _mm_sub_ps(_mm_mul_ps(qx, ty), _mm_mul_ps(qy, tx)));
+
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		results[i] = x;
+		results[i + 1] = y;
+		results[i + 2] = z;
+		results[i + 3] = w;
+	}
+
+	for (; i < count; ++i)
+		results[i] = rotate(vectors[i]);
+}
+
+GAMEMATH_INLINE void Quaternion::multiply(const Quaternion *a, const Quaternion *b, size_t count, Quaternion *results)
+{
+	for (size_t i = 0; i < count; ++i)
+		results[i] = a[i] * b[i];
+}
+
+/**
+  Normalizes four quaternions stored as structure of arrays, using a reciprocal square root estimate
+  refined by a Newton-Raphson step.
+  */
+GAMEMATH_INLINE void _quaternion_normalize4(__m128 &x, __m128 &y, __m128 &z, __m128 &w)
+{
+	const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+		_mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+	const __m128 estimate = _mm_rsqrt_ps(lengthSquared);
+	const __m128 scale = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+		_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(lengthSquared, _mm_mul_ps(estimate, estimate))));
+
+	x = _mm_mul_ps(x, scale);
+	y = _mm_mul_ps(y, scale);
+	z = _mm_mul_ps(z, scale);
+	w = _mm_mul_ps(w, scale);
+}
+
+/**
+  Approximates acos(x) for x in [0, 1] with the polynomial of Abramowitz and Stegun 4.4.46, whose
+  error is below 2e-8.
+  */
+GAMEMATH_INLINE __m128 _quaternion_acos(const __m128 x)
+{
+	__m128 result = _mm_set1_ps(-0.0012624911f);
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(0.0066700901f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(-0.0170881256f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(0.0308918810f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(-0.0501743046f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(0.0889789874f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(-0.2145988016f));
+	result = _mm_add_ps(_mm_mul_ps(result, x), _mm_set1_ps(1.5707963050f));
+
+	const __m128 oneMinusX = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x), _mm_setzero_ps());
+	return _mm_mul_ps(result, _mm_sqrt_ps(oneMinusX));
+}
+
+/**
+  Approximates sin(x) / x for x in [0, pi / 2], given x squared, with its Taylor series. The first
+  omitted term is below 4e-8 in that range.
+  */
+GAMEMATH_INLINE __m128 _quaternion_sinc(const __m128 x2)
+{
+	__m128 result = _mm_set1_ps(-1.0f / 39916800);
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(1.0f / 362880));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(-1.0f / 5040));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(1.0f / 120));
+	result = _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(-1.0f / 6));
+	return _mm_add_ps(_mm_mul_ps(result, x2), _mm_set1_ps(1.0f));
+}
+
+/**
+  Loads four pairs of quaternions as structure of arrays and flips the sign of b where the pair is
+  more than 180 degrees apart. Returns the absolute cosine of the angle between the pairs.
+  */
+GAMEMATH_INLINE __m128 _quaternion_load_pairs(const Quaternion *a, const Quaternion *b, __m128 *pairA, __m128 *pairB)
+{
+	pairA[0] = _mm_load_ps(a[0].data());
+	pairA[1] = _mm_load_ps(a[1].data());
+	pairA[2] = _mm_load_ps(a[2].data());
+	pairA[3] = _mm_load_ps(a[3].data());
+	pairB[0] = _mm_load_ps(b[0].data());
+	pairB[1] = _mm_load_ps(b[1].data());
+	pairB[2] = _mm_load_ps(b[2].data());
+	pairB[3] = _mm_load_ps(b[3].data());
+	_MM_TRANSPOSE4_PS(pairA[0], pairA[1], pairA[2], pairA[3]);
+	_MM_TRANSPOSE4_PS(pairB[0], pairB[1], pairB[2], pairB[3]);
+
+	__m128 cosAngle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pairA[0], pairB[0]), _mm_mul_ps(pairA[1], pairB[1])),
+		_mm_add_ps(_mm_mul_ps(pairA[2], pairB[2]), _mm_mul_ps(pairA[3], pairB[3])));
+
+	// Moving the sign bit of the cosine onto b takes the shorter path without branches
+	const __m128 sign = _mm_and_ps(cosAngle, _mm_load_ps((const float*)SignMask));
+	for (int i = 0; i < 4; ++i)
+		pairB[i] = _mm_xor_ps(pairB[i], sign);
+	return _mm_xor_ps(cosAngle, sign);
+}
+
+GAMEMATH_INLINE void _quaternion_store4(__m128 x, __m128 y, __m128 z, __m128 w, Quaternion *results)
+{
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_store_ps(results[0].data(), x);
+	_mm_store_ps(results[1].data(), y);
+	_mm_store_ps(results[2].data(), z);
+	_mm_store_ps(results[3].data(), w);
+}
+
+/**
+  Blends four pairs of quaternions with the blend weights of a and b and normalizes the results.
+  */
+GAMEMATH_INLINE void _quaternion_blend4(const __m128 *a, const __m128 *b, const __m128 weightA, const __m128 weightB,
+										Quaternion *results)
+{
+	__m128 x = _mm_add_ps(_mm_mul_ps(a[0], weightA), _mm_mul_ps(b[0], weightB));
+	__m128 y = _mm_add_ps(_mm_mul_ps(a[1], weightA), _mm_mul_ps(b[1], weightB));
+	__m128 z = _mm_add_ps(_mm_mul_ps(a[2], weightA), _mm_mul_ps(b[2], weightB));
+	__m128 w = _mm_add_ps(_mm_mul_ps(a[3], weightA), _mm_mul_ps(b[3], weightB));
+	_quaternion_normalize4(x, y, z, w);
+	_quaternion_store4(x, y, z, w, results);
+}
+
+struct _quaternion_nlerp4 {
+	GAMEMATH_INLINE void operator()(const Quaternion *a, const Quaternion *b, const __m128 weight, Quaternion *results) const
+	{
+		__m128 pairA[4];
+		__m128 pairB[4];
+		_quaternion_load_pairs(a, b, pairA, pairB);
+		_quaternion_blend4(pairA, pairB, _mm_sub_ps(_mm_set1_ps(1.0f), weight), weight, results);
+	}
+};
+
+struct _quaternion_slerp4 {
+	GAMEMATH_INLINE void operator()(const Quaternion *a, const Quaternion *b, const __m128 weight, Quaternion *results) const
+	{
+		__m128 pairA[4];
+		__m128 pairB[4];
+		const __m128 cosAngle = _quaternion_load_pairs(a, b, pairA, pairB);
+
+		/*
+		  slerp = (sin((1 - t) angle) a + sin(t angle) b) / sin(angle). The common factor 1 / sin(angle) is
+		  replaced by 1 / angle, which the normalization removes again. Written with sinc(x) = sin(x) / x,
+		  the weights become (1 - t) sinc((1 - t) angle) and t sinc(t angle), which stay finite as the
+		  angle goes to zero, where they turn into the weights of a linear interpolation.
+		 */
+		const __m128 angle = _quaternion_acos(cosAngle);
+		const __m128 inverseWeight = _mm_sub_ps(_mm_set1_ps(1.0f), weight);
+		const __m128 angleA = _mm_mul_ps(inverseWeight, angle);
+		const __m128 angleB = _mm_mul_ps(weight, angle);
+		const __m128 weightA = _mm_mul_ps(inverseWeight, _quaternion_sinc(_mm_mul_ps(angleA, angleA)));
+		const __m128 weightB = _mm_mul_ps(weight, _quaternion_sinc(_mm_mul_ps(angleB, angleB)));
+
+		_quaternion_blend4(pairA, pairB, weightA, weightB, results);
+	}
+};
+
+/**
+  Runs a kernel over four pairs at a time. The last few pairs are copied into padded arrays, so
+  they get exactly the same treatment as the others.
+  */
+template<typename Kernel>
+GAMEMATH_INLINE void _quaternion_interpolate(const Quaternion *a, const Quaternion *b, const float *weights, size_t count,
+											 Quaternion *results, const Kernel &kernel)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		kernel(a + i, b + i, _mm_loadu_ps(weights + i), results + i);
+
+	if (i < count) {
+		Quaternion paddedA[4], paddedB[4], paddedResults[4];
+		GAMEMATH_ALIGN float paddedWeights[4];
+		for (size_t j = 0; j < 4; ++j) {
+			const bool valid = i + j < count;
+			paddedA[j] = valid ? a[i + j] : Quaternion(0, 0, 0, 1);
+			paddedB[j] = valid ? b[i + j] : Quaternion(0, 0, 0, 1);
+			paddedWeights[j] = valid ? weights[i + j] : 0;
+		}
+
+		kernel(paddedA, paddedB, _mm_load_ps(paddedWeights), paddedResults);
+
+		for (size_t j = 0; i + j < count; ++j)
+			results[i + j] = paddedResults[j];
+	}
+}
+
+GAMEMATH_INLINE void Quaternion::nlerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count,
+									  Quaternion *results)
+{
+	_quaternion_interpolate(a, b, weights, count, results, _quaternion_nlerp4());
+}
+
+GAMEMATH_INLINE void Quaternion::slerp(const Quaternion *a, const Quaternion *b, const float *weights, size_t count,
+									  Quaternion *results)
+{
+	_quaternion_interpolate(a, b, weights, count, results, _quaternion_slerp4());
+}
+
 GAMEMATH_NAMESPACE_END
@@ -2,15 +2,29 @@
 #ifndef RAY3D_H
 #define RAY3D_H
 
+#include <cmath>
+
 #include "gamemath_internal.h"
 #include "vector4.h"
 #include "matrix4.h"
 
 GAMEMATH_NAMESPACE_BEGIN
 
+/**
+  The result of intersecting a ray with a volume. distance is where the ray enters the volume and
+  exitDistance where it leaves it, both measured in multiples of the ray direction. If the origin
+  of the ray lies within the volume, distance is negative.
+
+  Triangle tests set both distances to the distance of the hit, and additionally report the
+  barycentric coordinates of the hit (u, v) and the index of the triangle that was hit.
+  */
 struct IntersectionResult {
     bool intersects;
     float distance;
+    float exitDistance;
+    float u;
+    float v;
+    unsigned int triangle;
 };
 
 /**
@@ -30,6 +44,18 @@ public:
 
     bool intersectsSphere(const Vector4 &sphereOrigin, float sphereRadiusSquare) const;
     bool intersects(const Box3d &box) const;
+
+    /**
+      Intersects this ray with a sphere and returns the distances at which the ray enters and
+      leaves it. Spheres that lie completely behind the origin are not intersected.
+      */
+    IntersectionResult intersectSphere(const Vector4 &sphereOrigin, float sphereRadiusSquare) const;
+
+    /**
+      Intersects this ray with a box and returns the distances at which the ray enters and leaves
+      it. This is the same slab test as intersects, but the distances are needed to find the closest hit.
+      */
+    IntersectionResult intersect(const Box3d &box) const;
     
 private:
     Vector4 mOrigin;
@@ -39,20 +65,56 @@ private:
 
 GAMEMATH_INLINE bool Ray3d::intersectsSphere(const Vector4 &sphereOrigin, float sphereRadiusSquare) const
 {
-    Vector4 sphereToOrigin = sphereOrigin - mOrigin;
-    float distanceToSphereCenter = sphereToOrigin.lengthSquared();
+    // Same test as intersectSphere, without the square root needed for the distances
+    Vector4 originToSphere = mOrigin - sphereOrigin;
+    originToSphere.setW(0);
 
-    if (distanceToSphereCenter < sphereRadiusSquare) {
-        return true; // Origin of the ray is within the sphere -> ofcourse it intersects
-    }
+    const float b = originToSphere.dot(mDirection);
+    const float c = originToSphere.lengthSquared() - sphereRadiusSquare;
 
-    float angle = mDirection.dot(sphereToOrigin);
+    if (c <= 0) {
+        return true; // Origin of the ray is within the sphere
+    }
 
-    if (angle >= 0) {
-        return false; // The direction points away from the sphere.
+    if (b > 0) {
+        return false; // The direction points away from the sphere
     }
 
-    return angle * angle >= distanceToSphereCenter; // TODO: Not entirely sure why this works
+    // The ray passes the center closer than the radius
+    return b * b >= mDirection.dot(mDirection) * c;
+}
+
+GAMEMATH_INLINE IntersectionResult Ray3d::intersectSphere(const Vector4 &sphereOrigin, float sphereRadiusSquare) const
+{
+    IntersectionResult result;
+    result.intersects = false;
+    result.distance = 0;
+    result.exitDistance = 0;
+    result.u = 0;
+    result.v = 0;
+    result.triangle = 0;
+
+    // Solve |origin + t * direction - sphereOrigin|^2 = radius^2 for t
+    Vector4 originToSphere = mOrigin - sphereOrigin;
+    originToSphere.setW(0);
+
+    const float a = mDirection.dot(mDirection);
+    const float b = originToSphere.dot(mDirection);
+    const float c = originToSphere.lengthSquared() - sphereRadiusSquare;
+
+    // The origin is outside of the sphere and the ray points away from it
+    if (c > 0 && b > 0)
+        return result;
+
+    const float discriminant = b * b - a * c;
+    if (discriminant < 0 || a <= 0)
+        return result;
+
+    const float root = sqrt(discriminant);
+    result.intersects = true;
+    result.distance = (-b - root) / a;
+    result.exitDistance = (-b + root) / a;
+    return result;
 }
 
 /**
@@ -82,6 +144,11 @@ GAMEMATH_INLINE const Vector4 &Ray3d::direction() const
     return mDirection;
 }
 
+GAMEMATH_INLINE const Vector4 &Ray3d::invertedDirection() const
+{
+    return mInvDirection;
+}
+
 GAMEMATH_INLINE void Ray3d::setOrigin(const Vector4 &origin)
 {
     mOrigin = origin;
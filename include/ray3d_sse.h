@@ -5,26 +5,43 @@
 
 GAMEMATH_NAMESPACE_BEGIN
 
+/**
+  Computes 1 / value using the reciprocal estimate, refined by one Newton-Raphson step.
+  The estimate only has 12 bits of precision, the refined value has about 23 bits.
+  Components that are zero produce infinity like the estimate itself.
+  */
+GAMEMATH_INLINE __m128 _refined_reciprocal(const __m128 value)
+{
+    const __m128 estimate = _mm_rcp_ps(value);
+
+    // x' = x * (2 - value * x) = 2x - value * x^2
+    const __m128 refined = _mm_sub_ps(_mm_add_ps(estimate, estimate), _mm_mul_ps(value, _mm_mul_ps(estimate, estimate)));
+
+    // The refinement computes 0 * inf for zero components, which must keep the estimate
+    const __m128 valid = _mm_cmpord_ps(refined, refined);
+    return _mm_or_ps(_mm_and_ps(valid, refined), _mm_andnot_ps(valid, estimate));
+}
+
 GAMEMATH_INLINE Ray3d::Ray3d(const Vector4 &origin, const Vector4 &direction)
     : mOrigin(origin), mDirection(direction)
 {
-    mInvDirection.mSse = _mm_rcp_ps(direction.mSse);
+    mInvDirection.mSse = _refined_reciprocal(direction.mSse);
 }
 
 GAMEMATH_INLINE void Ray3d::setDirection(const Vector4 &direction)
 {
     mDirection = direction;
-    mInvDirection.mSse = _mm_rcp_ps(direction.mSse);
+    mInvDirection.mSse = _refined_reciprocal(direction.mSse);
 }
 
-/*
-  Based on work @ http://www.flipcode.com/archives/SSE_RayBox_Intersection_Test.shtml
-  && http://www.uni-koblenz.de/~cg/publikationen/cp_raytrace.pdf
-*/
-GAMEMATH_INLINE bool Ray3d::intersects(const Box3d &box) const
+/**
+  Performs the slab test of a ray against a box and stores the distance at which the ray enters
+  the box in r0 of tNear, and the distance at which it leaves the box in r0 of tFar.
+  */
+GAMEMATH_INLINE void _ray_box_slab(const __m128 origin, const __m128 invDirection, const Box3d &box, __m128 &tNear, __m128 &tFar)
 {
-    const __m128 temp1 = _mm_mul_ps(_mm_sub_ps(box.minimum(), mOrigin), mInvDirection);
-    const __m128 temp2 = _mm_mul_ps(_mm_sub_ps(box.maximum(), mOrigin), mInvDirection);
+    const __m128 temp1 = _mm_mul_ps(_mm_sub_ps(box.minimum(), origin), invDirection);
+    const __m128 temp2 = _mm_mul_ps(_mm_sub_ps(box.maximum(), origin), invDirection);
 
     __m128 minVec = _mm_min_ps(temp1, temp2);
     __m128 maxVec = _mm_max_ps(temp1, temp2);
@@ -39,10 +56,20 @@ GAMEMATH_INLINE bool Ray3d::intersects(const Box3d &box) const
     maxVec = _mm_min_ss(maxVec, maxVecY); // r0 is min(maxX,maxY)
 
     const __m128 minVecZ = _mm_movehl_ps(minVec, minVec); // r0 is now r3 (which is minZ)
-    minVec = _mm_max_ss(minVec, minVecZ); // r0 is max(max(minX,minY),minZ)
+    tNear = _mm_max_ss(minVec, minVecZ); // r0 is max(max(minX,minY),minZ)
 
     const __m128 maxVecZ = _mm_movehl_ps(maxVec, maxVec); // r0 is now r3 (which is maxZ)
-    maxVec = _mm_min_ss(maxVec, maxVecZ); // r0 is min(min(maxX,maxY),maxZ)
+    tFar = _mm_min_ss(maxVec, maxVecZ); // r0 is min(min(maxX,maxY),maxZ)
+}
+
+/*
+  Based on work @ http://www.flipcode.com/archives/SSE_RayBox_Intersection_Test.shtml
+  && http://www.uni-koblenz.de/~cg/publikationen/cp_raytrace.pdf
+*/
+GAMEMATH_INLINE bool Ray3d::intersects(const Box3d &box) const
+{
+    __m128 minVec, maxVec;
+    _ray_box_slab(mOrigin.mSse, mInvDirection.mSse, box, minVec, maxVec);
 
     if (_mm_comigt_ss(minVec, maxVec) || _mm_comilt_ss(maxVec, _mm_setzero_ps()))
         return false;
@@ -50,4 +77,19 @@ GAMEMATH_INLINE bool Ray3d::intersects(const Box3d &box) const
     return true;
 }
 
+GAMEMATH_INLINE IntersectionResult Ray3d::intersect(const Box3d &box) const
+{
+    __m128 minVec, maxVec;
+    _ray_box_slab(mOrigin.mSse, mInvDirection.mSse, box, minVec, maxVec);
+
+    IntersectionResult result;
+    result.intersects = !(_mm_comigt_ss(minVec, maxVec) || _mm_comilt_ss(maxVec, _mm_setzero_ps()));
+    result.distance = _mm_cvtss_f32(minVec);
+    result.exitDistance = _mm_cvtss_f32(maxVec);
+    result.u = 0;
+    result.v = 0;
+    result.triangle = 0;
+    return result;
+}
+
 GAMEMATH_NAMESPACE_END
@@ -0,0 +1,159 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include <limits>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "box3d.h"
+#include "ray3d.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A packet of Size rays stored as structure of arrays, which are tested against a box at once.
+  Each SIMD lane holds a different ray, so all lanes do useful work, unlike Ray3d::intersects which
+  spends its lanes on the x, y and z axes of a single ray.
+
+  Packets pay off for coherent rays (picking, shadow probes) that mostly hit the same boxes.
+  Size has to be a multiple of four. Use the RayPacket4 and RayPacket8 typedefs.
+  */
+template<int Size>
+class GAMEMATH_ALIGNEDTYPE_PRE RayPacket GAMEMATH_ALIGNEDTYPE_MID : public AlignedAllocation {
+public:
+    /**
+      A bit mask with one bit set for every ray of the packet.
+      */
+    static const int AllRays = (1 << Size) - 1;
+
+    /**
+      Creates a packet of degenerate rays, use setRay to fill it.
+      */
+    RayPacket();
+
+    /**
+      Creates a packet from the first Size rays of the given array.
+      */
+    explicit RayPacket(const Ray3d *rays);
+
+    /**
+      Replaces a ray of this packet. The inverse direction is computed with a full-precision division.
+      The maximum distance of the ray is reset to infinity.
+      */
+    void setRay(int index, const Ray3d &ray);
+
+    Vector4 origin(int index) const;
+    Vector4 direction(int index) const;
+
+    /**
+      Limits the distance along the ray within which boxes are reported as hit. This is used for
+      shadow probes with a known light distance, or to cull boxes behind the closest hit so far.
+      */
+    void setMaximumDistance(int index, float distance);
+    float maximumDistance(int index) const;
+
+    /**
+      Tests all rays of this packet against the given box.
+
+      @return A bit mask with bit i set if ray i hits the box.
+      */
+    int intersects(const Box3d &box) const;
+
+    /**
+      Tests all rays of this packet against the given box, and stores the distance at which each
+      ray enters the box in distances, which has to have room for Size floats. Rays starting inside
+      the box have a distance of zero, rays missing the box have a distance of infinity.
+
+      @return A bit mask with bit i set if ray i hits the box.
+      */
+    int intersect(const Box3d &box, float *distances) const;
+
+    /**
+      Tests all rays of this packet against the given sphere, and stores the distance at which each
+      ray enters the sphere in distances, like intersect does for boxes.
+
+      @return A bit mask with bit i set if ray i hits the sphere.
+      */
+    int intersectSphere(const Vector4 &center, float radiusSquare, float *distances) const;
+
+private:
+    GAMEMATH_ALIGN float mOrigin[3][Size];
+    GAMEMATH_ALIGN float mInvDirection[3][Size];
+    GAMEMATH_ALIGN float mDirection[3][Size];
+    GAMEMATH_ALIGN float mMaximumDistance[Size];
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+typedef RayPacket<4> RayPacket4;
+typedef RayPacket<8> RayPacket8;
+
+template<int Size>
+GAMEMATH_INLINE RayPacket<Size>::RayPacket()
+{
+    for (int i = 0; i < Size; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            mOrigin[axis][i] = 0;
+            mDirection[axis][i] = 0;
+            mInvDirection[axis][i] = std::numeric_limits<float>::infinity();
+        }
+        mMaximumDistance[i] = std::numeric_limits<float>::infinity();
+    }
+}
+
+template<int Size>
+GAMEMATH_INLINE RayPacket<Size>::RayPacket(const Ray3d *rays)
+{
+    for (int i = 0; i < Size; ++i)
+        setRay(i, rays[i]);
+}
+
+template<int Size>
+GAMEMATH_INLINE void RayPacket<Size>::setRay(int index, const Ray3d &ray)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        mOrigin[axis][index] = ray.origin().data()[axis];
+        mDirection[axis][index] = ray.direction().data()[axis];
+        mInvDirection[axis][index] = 1.0f / ray.direction().data()[axis];
+    }
+    mMaximumDistance[index] = std::numeric_limits<float>::infinity();
+}
+
+template<int Size>
+GAMEMATH_INLINE Vector4 RayPacket<Size>::origin(int index) const
+{
+    return Vector4(mOrigin[0][index], mOrigin[1][index], mOrigin[2][index], 1);
+}
+
+template<int Size>
+GAMEMATH_INLINE Vector4 RayPacket<Size>::direction(int index) const
+{
+    return Vector4(mDirection[0][index], mDirection[1][index], mDirection[2][index], 0);
+}
+
+template<int Size>
+GAMEMATH_INLINE void RayPacket<Size>::setMaximumDistance(int index, float distance)
+{
+    mMaximumDistance[index] = distance;
+}
+
+template<int Size>
+GAMEMATH_INLINE float RayPacket<Size>::maximumDistance(int index) const
+{
+    return mMaximumDistance[index];
+}
+
+template<int Size>
+GAMEMATH_INLINE int RayPacket<Size>::intersects(const Box3d &box) const
+{
+    float distances[Size];
+    return intersect(box, distances);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "ray_packet_sse.h"
+#else
+#include "ray_packet_sisd.h"
+#endif
+
+#endif // RAY_PACKET_H
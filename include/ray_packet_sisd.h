@@ -0,0 +1,73 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "ray_packet.h"
+
+#if !defined(RAY_PACKET_H)
+#error "Do not include this file directly, only include ray_packet.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+GAMEMATH_NAMESPACE_BEGIN
+
+template<int Size>
+GAMEMATH_INLINE int RayPacket<Size>::intersect(const Box3d &box, float *distances) const
+{
+    int mask = 0;
+
+    for (int i = 0; i < Size; ++i) {
+        float tNear = 0;
+        float tFar = mMaximumDistance[i];
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const float t1 = (box.minimum().data()[axis] - mOrigin[axis][i]) * mInvDirection[axis][i];
+            const float t2 = (box.maximum().data()[axis] - mOrigin[axis][i]) * mInvDirection[axis][i];
+            tNear = std::max(tNear, std::min(t1, t2));
+            tFar = std::min(tFar, std::max(t1, t2));
+        }
+
+        if (tNear <= tFar) {
+            distances[i] = tNear;
+            mask |= 1 << i;
+        } else {
+            distances[i] = std::numeric_limits<float>::infinity();
+        }
+    }
+
+    return mask;
+}
+
+template<int Size>
+GAMEMATH_INLINE int RayPacket<Size>::intersectSphere(const Vector4 &center, float radiusSquare, float *distances) const
+{
+    int mask = 0;
+
+    for (int i = 0; i < Size; ++i) {
+        float a = 0;
+        float b = 0;
+        float c = -radiusSquare;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float oc = mOrigin[axis][i] - center.data()[axis];
+            a += mDirection[axis][i] * mDirection[axis][i];
+            b += oc * mDirection[axis][i];
+            c += oc * oc;
+        }
+
+        const float discriminant = b * b - a * c;
+        distances[i] = std::numeric_limits<float>::infinity();
+        if ((c > 0 && b > 0) || discriminant < 0)
+            continue;
+
+        const float entry = std::max((-b - std::sqrt(discriminant)) / a, 0.0f);
+        if (entry <= mMaximumDistance[i]) {
+            distances[i] = entry;
+            mask |= 1 << i;
+        }
+    }
+
+    return mask;
+}
+
+GAMEMATH_NAMESPACE_END
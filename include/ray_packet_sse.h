@@ -0,0 +1,221 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "ray_packet.h"
+
+#if !defined(RAY_PACKET_H)
+#error "Do not include this file directly, only include ray_packet.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Slab test of four rays given as structure of arrays against a box whose minimum and maximum
+  have been broadcast to all lanes, one register per axis. Returns the entry distances in
+  distances and a lane mask of the rays that hit the box.
+  */
+GAMEMATH_INLINE __m128 _ray_packet_slab(const float *origins, const float *invDirections, size_t stride,
+                                        const float *maximumDistances, const __m128 *minimum,
+                                        const __m128 *maximum, __m128 &distances)
+{
+    __m128 tNear = _mm_setzero_ps();
+    __m128 tFar = _mm_loadu_ps(maximumDistances);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m128 origin = _mm_loadu_ps(origins + axis * stride);
+        const __m128 invDirection = _mm_loadu_ps(invDirections + axis * stride);
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(minimum[axis], origin), invDirection);
+        const __m128 t2 = _mm_mul_ps(_mm_sub_ps(maximum[axis], origin), invDirection);
+        // The accumulated value comes second, so NaN slab distances (0 * inf) are not propagated
+        tNear = _mm_max_ps(_mm_min_ps(t1, t2), tNear);
+        tFar = _mm_min_ps(_mm_max_ps(t1, t2), tFar);
+    }
+
+    const __m128 hit = _mm_cmple_ps(tNear, tFar);
+    distances = _mm_or_ps(_mm_and_ps(hit, tNear), _mm_andnot_ps(hit, _mm_load_ps(PositiveInfinity)));
+    return hit;
+}
+
+#if defined(__AVX__)
+
+/**
+  Same as _ray_packet_slab, but for eight rays at once.
+  */
+GAMEMATH_INLINE __m256 _ray_packet_slab8(const float *origins, const float *invDirections, size_t stride,
+                                         const float *maximumDistances, const __m256 *minimum,
+                                         const __m256 *maximum, __m256 &distances)
+{
+    __m256 tNear = _mm256_setzero_ps();
+    __m256 tFar = _mm256_loadu_ps(maximumDistances);
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m256 origin = _mm256_loadu_ps(origins + axis * stride);
+        const __m256 invDirection = _mm256_loadu_ps(invDirections + axis * stride);
+        const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(minimum[axis], origin), invDirection);
+        const __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(maximum[axis], origin), invDirection);
+        tNear = _mm256_max_ps(_mm256_min_ps(t1, t2), tNear);
+        tFar = _mm256_min_ps(_mm256_max_ps(t1, t2), tFar);
+    }
+
+    const __m256 hit = _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ);
+    distances = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), tNear, hit);
+    return hit;
+}
+
+#endif
+
+/**
+  Intersects four rays given as structure of arrays with a sphere whose center and squared radius
+  have been broadcast to all lanes. Returns the entry distances, clamped to zero, in distances and
+  a lane mask of the rays that hit the sphere.
+  */
+GAMEMATH_INLINE __m128 _ray_packet_sphere(const float *origins, const float *directions, size_t stride,
+                                          const float *maximumDistances, const __m128 *center,
+                                          const __m128 radiusSquare, __m128 &distances)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 a = zero;
+    __m128 b = zero;
+    __m128 c = zero;
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m128 direction = _mm_loadu_ps(directions + axis * stride);
+        const __m128 oc = _mm_sub_ps(_mm_loadu_ps(origins + axis * stride), center[axis]);
+        a = _mm_add_ps(a, _mm_mul_ps(direction, direction));
+        b = _mm_add_ps(b, _mm_mul_ps(oc, direction));
+        c = _mm_add_ps(c, _mm_mul_ps(oc, oc));
+    }
+    c = _mm_sub_ps(c, radiusSquare);
+
+    const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+    const __m128 behind = _mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmpgt_ps(b, zero));
+    const __m128 entry = _mm_max_ps(_mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(discriminant)), a), zero);
+
+    __m128 hit = _mm_andnot_ps(behind, _mm_cmpge_ps(discriminant, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(entry, _mm_loadu_ps(maximumDistances)));
+    distances = _mm_or_ps(_mm_and_ps(hit, entry), _mm_andnot_ps(hit, _mm_load_ps(PositiveInfinity)));
+    return hit;
+}
+
+#if defined(__AVX__)
+
+/**
+  Same as _ray_packet_sphere, but for eight rays at once.
+  */
+GAMEMATH_INLINE __m256 _ray_packet_sphere8(const float *origins, const float *directions, size_t stride,
+                                           const float *maximumDistances, const __m256 *center,
+                                           const __m256 radiusSquare, __m256 &distances)
+{
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 a = zero;
+    __m256 b = zero;
+    __m256 c = zero;
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m256 direction = _mm256_loadu_ps(directions + axis * stride);
+        const __m256 oc = _mm256_sub_ps(_mm256_loadu_ps(origins + axis * stride), center[axis]);
+        a = _mm256_add_ps(a, _mm256_mul_ps(direction, direction));
+        b = _mm256_add_ps(b, _mm256_mul_ps(oc, direction));
+        c = _mm256_add_ps(c, _mm256_mul_ps(oc, oc));
+    }
+    c = _mm256_sub_ps(c, radiusSquare);
+
+    const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+    const __m256 behind = _mm256_and_ps(_mm256_cmp_ps(c, zero, _CMP_GT_OQ), _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+    const __m256 entry = _mm256_max_ps(_mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(discriminant)), a), zero);
+
+    __m256 hit = _mm256_andnot_ps(behind, _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(entry, _mm256_loadu_ps(maximumDistances), _CMP_LE_OQ));
+    distances = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), entry, hit);
+    return hit;
+}
+
+#endif
+
+template<int Size>
+GAMEMATH_INLINE int RayPacket<Size>::intersectSphere(const Vector4 &sphereCenter, float radiusSquare, float *distances) const
+{
+    const __m128 centerVector = sphereCenter;
+
+    __m128 center[3];
+    center[0] = _mm_shuffle_ps(centerVector, centerVector, _MM_SHUFFLE(0, 0, 0, 0));
+    center[1] = _mm_shuffle_ps(centerVector, centerVector, _MM_SHUFFLE(1, 1, 1, 1));
+    center[2] = _mm_shuffle_ps(centerVector, centerVector, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 radius = _mm_set1_ps(radiusSquare);
+
+    int mask = 0;
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256 center8[3];
+    for (int axis = 0; axis < 3; ++axis)
+        center8[axis] = _mm256_insertf128_ps(_mm256_castps128_ps256(center[axis]), center[axis], 1);
+    const __m256 radius8 = _mm256_set1_ps(radiusSquare);
+
+    for (; i + 8 <= Size; i += 8) {
+        __m256 entry;
+        const __m256 hit = _ray_packet_sphere8(&mOrigin[0][i], &mDirection[0][i], Size,
+            mMaximumDistance + i, center8, radius8, entry);
+        _mm256_storeu_ps(distances + i, entry);
+        mask |= _mm256_movemask_ps(hit) << i;
+    }
+#endif
+
+    for (; i < Size; i += 4) {
+        __m128 entry;
+        const __m128 hit = _ray_packet_sphere(&mOrigin[0][i], &mDirection[0][i], Size,
+            mMaximumDistance + i, center, radius, entry);
+        _mm_storeu_ps(distances + i, entry);
+        mask |= _mm_movemask_ps(hit) << i;
+    }
+
+    return mask;
+}
+
+template<int Size>
+GAMEMATH_INLINE int RayPacket<Size>::intersect(const Box3d &box, float *distances) const
+{
+    const __m128 boxMinimum = box.minimum();
+    const __m128 boxMaximum = box.maximum();
+
+    __m128 minimum[3];
+    __m128 maximum[3];
+    minimum[0] = _mm_shuffle_ps(boxMinimum, boxMinimum, _MM_SHUFFLE(0, 0, 0, 0));
+    minimum[1] = _mm_shuffle_ps(boxMinimum, boxMinimum, _MM_SHUFFLE(1, 1, 1, 1));
+    minimum[2] = _mm_shuffle_ps(boxMinimum, boxMinimum, _MM_SHUFFLE(2, 2, 2, 2));
+    maximum[0] = _mm_shuffle_ps(boxMaximum, boxMaximum, _MM_SHUFFLE(0, 0, 0, 0));
+    maximum[1] = _mm_shuffle_ps(boxMaximum, boxMaximum, _MM_SHUFFLE(1, 1, 1, 1));
+    maximum[2] = _mm_shuffle_ps(boxMaximum, boxMaximum, _MM_SHUFFLE(2, 2, 2, 2));
+
+    int mask = 0;
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256 minimum8[3];
+    __m256 maximum8[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        minimum8[axis] = _mm256_insertf128_ps(_mm256_castps128_ps256(minimum[axis]), minimum[axis], 1);
+        maximum8[axis] = _mm256_insertf128_ps(_mm256_castps128_ps256(maximum[axis]), maximum[axis], 1);
+    }
+
+    for (; i + 8 <= Size; i += 8) {
+        __m256 tNear;
+        const __m256 hit = _ray_packet_slab8(&mOrigin[0][i], &mInvDirection[0][i], Size,
+            mMaximumDistance + i, minimum8, maximum8, tNear);
+        _mm256_storeu_ps(distances + i, tNear);
+        mask |= _mm256_movemask_ps(hit) << i;
+    }
+#endif
+
+    for (; i < Size; i += 4) {
+        __m128 tNear;
+        const __m128 hit = _ray_packet_slab(&mOrigin[0][i], &mInvDirection[0][i], Size,
+            mMaximumDistance + i, minimum, maximum, tNear);
+        _mm_storeu_ps(distances + i, tNear);
+        mask |= _mm_movemask_ps(hit) << i;
+    }
+
+    return mask;
+}
+
+GAMEMATH_NAMESPACE_END
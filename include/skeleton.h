@@ -0,0 +1,270 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "quaternion.h"
+#include "matrix4.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  The bone hierarchy of a model, given by the parent index of every bone and the inverse of the
+  matrix of every bone in the bind pose.
+
+  Bones are sorted so that every parent comes before its children. This lets a pose be converted from
+  local to model space in a single pass over the bones, since the model space matrix of the parent is
+  always known by the time a child is visited. The skeleton can be written to memory with serialize
+  and loaded with deserialize, which is how the Bones chunk of a model file stores it.
+  */
+class Skeleton {
+public:
+    /**
+      The parent index of root bones.
+      */
+    static const int NoParent = -1;
+
+    /**
+      Changes whenever the layout written by serialize changes. deserialize rejects other versions.
+      */
+    static const unsigned int SerializationVersion = 1;
+
+    Skeleton();
+    ~Skeleton();
+
+    /**
+      Replaces this skeleton with copies of the given arrays, which have boneCount elements each.
+
+      @return False if a bone has a parent that doesn't come before it. The skeleton is empty in that case.
+      */
+    bool create(const int *parents, const Matrix4 *inverseBindMatrices, unsigned int boneCount);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    unsigned int boneCount() const;
+    const int *parents() const;
+    const Matrix4 *inverseBindMatrices() const;
+
+    /**
+      Converts a local pose, as produced by AnimationSampler, to model space matrices. The local matrices
+      are built in one batch with Matrix4::transformation and then concatenated with their parents in place.
+      Each array has one element per bone.
+      */
+    void localToModel(const Vector4 *translations, const Quaternion *rotations, const Vector4 *scales,
+                      Matrix4 *modelMatrices) const;
+
+    /**
+      Multiplies the model space matrices of a pose with the inverse bind matrices, which gives the
+      matrices that move skinned vertices from the bind pose into that pose. palette may be the same
+      array as modelMatrices.
+      */
+    void skinningPalette(const Matrix4 *modelMatrices, Matrix4 *palette) const;
+
+    /**
+      Does both of the above. modelMatrices receives the model space matrices, which attachments need.
+      */
+    void evaluate(const Vector4 *translations, const Quaternion *rotations, const Vector4 *scales,
+                  Matrix4 *modelMatrices, Matrix4 *palette) const;
+
+    /**
+      Returns the number of bytes written by serialize. This is always a multiple of 16.
+      */
+    size_t serializedSize() const;
+
+    /**
+      Writes the skeleton to data, which has to have room for serializedSize() bytes.
+      */
+    void serialize(void *data) const;
+
+    /**
+      Replaces this skeleton with one written by serialize.
+
+      @return False if the data is truncated, has a different version or fails the checks of create.
+      The skeleton is empty in that case.
+      */
+    bool deserialize(const void *data, size_t size);
+
+private:
+    Skeleton(const Skeleton&);
+    Skeleton &operator =(const Skeleton&);
+
+    struct SerializedHeader {
+        unsigned int version;
+        unsigned int boneCount;
+        unsigned int reserved1;
+        unsigned int reserved2;
+    };
+
+    static size_t paddedParentsSize(unsigned int boneCount);
+
+    void allocate(unsigned int boneCount);
+    bool validate();
+
+    std::vector<int> mParents;
+    Matrix4 *mInverseBindMatrices;
+    unsigned int mBoneCount;
+};
+
+GAMEMATH_INLINE Skeleton::Skeleton()
+    : mInverseBindMatrices(0), mBoneCount(0)
+{
+}
+
+GAMEMATH_INLINE Skeleton::~Skeleton()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void Skeleton::clear()
+{
+    if (mInverseBindMatrices)
+        ALIGNED_FREE(mInverseBindMatrices);
+    mInverseBindMatrices = 0;
+    mParents.clear();
+    mBoneCount = 0;
+}
+
+GAMEMATH_INLINE size_t Skeleton::paddedParentsSize(unsigned int boneCount)
+{
+    return (sizeof(int) * boneCount + 15) & ~(size_t)15;
+}
+
+GAMEMATH_INLINE void Skeleton::allocate(unsigned int boneCount)
+{
+    clear();
+
+    mInverseBindMatrices = static_cast<Matrix4*>(ALIGNED_MALLOC(sizeof(Matrix4) * boneCount));
+    if (!mInverseBindMatrices)
+        throw std::bad_alloc();
+    mParents.resize(boneCount);
+    mBoneCount = boneCount;
+}
+
+GAMEMATH_INLINE bool Skeleton::validate()
+{
+    for (unsigned int i = 0; i < mBoneCount; ++i) {
+        if (mParents[i] != NoParent && (mParents[i] < 0 || (unsigned int)mParents[i] >= i)) {
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+GAMEMATH_INLINE bool Skeleton::create(const int *parents, const Matrix4 *inverseBindMatrices, unsigned int boneCount)
+{
+    if (!boneCount) {
+        clear();
+        return true;
+    }
+
+    allocate(boneCount);
+    memcpy(&mParents[0], parents, sizeof(int) * boneCount);
+    memcpy(mInverseBindMatrices, inverseBindMatrices, sizeof(Matrix4) * boneCount);
+    return validate();
+}
+
+GAMEMATH_INLINE bool Skeleton::isEmpty() const
+{
+    return !mBoneCount;
+}
+
+GAMEMATH_INLINE unsigned int Skeleton::boneCount() const
+{
+    return mBoneCount;
+}
+
+GAMEMATH_INLINE const int *Skeleton::parents() const
+{
+    return mBoneCount ? &mParents[0] : 0;
+}
+
+GAMEMATH_INLINE const Matrix4 *Skeleton::inverseBindMatrices() const
+{
+    return mInverseBindMatrices;
+}
+
+GAMEMATH_INLINE void Skeleton::localToModel(const Vector4 *translations, const Quaternion *rotations,
+                                            const Vector4 *scales, Matrix4 *modelMatrices) const
+{
+    Matrix4::transformation(scales, rotations, translations, mBoneCount, modelMatrices);
+
+    for (unsigned int i = 0; i < mBoneCount; ++i) {
+        const int parent = mParents[i];
+        if (parent != NoParent)
+            modelMatrices[i] = modelMatrices[parent] * modelMatrices[i];
+    }
+}
+
+GAMEMATH_INLINE void Skeleton::skinningPalette(const Matrix4 *modelMatrices, Matrix4 *palette) const
+{
+    for (unsigned int i = 0; i < mBoneCount; ++i)
+        palette[i] = modelMatrices[i] * mInverseBindMatrices[i];
+}
+
+GAMEMATH_INLINE void Skeleton::evaluate(const Vector4 *translations, const Quaternion *rotations, const Vector4 *scales,
+                                        Matrix4 *modelMatrices, Matrix4 *palette) const
+{
+    localToModel(translations, rotations, scales, modelMatrices);
+    skinningPalette(modelMatrices, palette);
+}
+
+GAMEMATH_INLINE size_t Skeleton::serializedSize() const
+{
+    return sizeof(SerializedHeader) + paddedParentsSize(mBoneCount) + sizeof(Matrix4) * mBoneCount;
+}
+
+GAMEMATH_INLINE void Skeleton::serialize(void *data) const
+{
+    SerializedHeader header;
+    header.version = SerializationVersion;
+    header.boneCount = mBoneCount;
+    header.reserved1 = 0;
+    header.reserved2 = 0;
+
+    char *ptr = static_cast<char*>(data);
+    memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    if (!mBoneCount)
+        return;
+
+    memset(ptr, 0, paddedParentsSize(mBoneCount));
+    memcpy(ptr, &mParents[0], sizeof(int) * mBoneCount);
+    ptr += paddedParentsSize(mBoneCount);
+    memcpy(ptr, mInverseBindMatrices, sizeof(Matrix4) * mBoneCount);
+}
+
+GAMEMATH_INLINE bool Skeleton::deserialize(const void *data, size_t size)
+{
+    clear();
+
+    SerializedHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    const char *ptr = static_cast<const char*>(data);
+    memcpy(&header, ptr, sizeof(header));
+    ptr += sizeof(header);
+
+    if (header.version != SerializationVersion)
+        return false;
+
+    if (size != sizeof(header) + paddedParentsSize(header.boneCount) + sizeof(Matrix4) * (size_t)header.boneCount)
+        return false;
+
+    if (!header.boneCount)
+        return true;
+
+    return create(reinterpret_cast<const int*>(ptr),
+                  reinterpret_cast<const Matrix4*>(ptr + paddedParentsSize(header.boneCount)), header.boneCount);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // SKELETON_H
@@ -0,0 +1,135 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <cstddef>
+
+#include "gamemath_internal.h"
+#include "gamemath_parallel.h"
+#include "vector4.h"
+#include "matrix4.h"
+#include "matrix3x4.h"
+#include "dual_quaternion.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  The bones that move a vertex, as stored in the BoneAttachments chunk of a model file. Vertices
+  with fewer than four bones use a weight of zero for the others. The weights have to add up to one.
+  */
+struct SkinningInfluences {
+    float weights[4];
+    unsigned short bones[4];
+};
+
+/**
+  Moves count vertices from the bind pose into the pose given by palette, which is usually
+  produced by Skeleton::skinningPalette, with linear blend skinning. The palette matrices of the
+  bones of a vertex are blended by their weights, and the result transforms the position and the
+  normal of the vertex.
+
+  Skinned positions have a w of one, skinned normals are normalized and have a w of zero. Normals are
+  only skinned if both normals and skinnedNormals are given, either may be null to skin positions only.
+  The skinned arrays may be the same as the input arrays.
+  */
+GAMEMATH_INLINE void skinVertices(const Matrix4 *palette, const SkinningInfluences *influences, const Vector4 *positions,
+                                  const Vector4 *normals, size_t count, Vector4 *skinnedPositions,
+                                  Vector4 *skinnedNormals);
+
+/**
+  Same as skinVertices, with a palette of 3x4 matrices. These are 16 bytes smaller per bone than Matrix4,
+  which reduces the memory traffic when many palettes are skinned.
+  */
+GAMEMATH_INLINE void skinVertices(const Matrix3x4 *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals);
+
+/**
+  Same as skinVertices, but with dual quaternion skinning. The dual quaternions of the bones of a
+  vertex are blended by their weights and normalized, which keeps the blended transformation rigid
+  and avoids the collapsing joints of linear blend skinning. The palette is half the size of a Matrix4
+  palette, but can't scale vertices.
+  */
+GAMEMATH_INLINE void skinVertices(const DualQuaternion *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals);
+
+/**
+  Same as skinVertices, but splits the vertices into ranges that are skinned in parallel if the
+  library is compiled with OpenMP and there are enough vertices.
+  */
+GAMEMATH_INLINE void skinVerticesParallel(const Matrix4 *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals);
+
+GAMEMATH_INLINE void skinVerticesParallel(const Matrix3x4 *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals);
+
+GAMEMATH_INLINE void skinVerticesParallel(const DualQuaternion *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals);
+
+/**
+  Skinning costs about as much per vertex as computing the bounds of 16 points, so ranges are smaller
+  than ParallelMinimumGrain.
+  */
+const size_t SkinningMinimumGrain = ParallelMinimumGrain / 16;
+
+template<typename PaletteEntry> class SkinVerticesKernel {
+public:
+    SkinVerticesKernel(const PaletteEntry *palette, const SkinningInfluences *influences, const Vector4 *positions,
+                       const Vector4 *normals, Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+        : mPalette(palette), mInfluences(influences), mPositions(positions), mNormals(normals),
+          mSkinnedPositions(skinnedPositions), mSkinnedNormals(skinnedNormals)
+    {
+    }
+
+    void operator()(int, size_t begin, size_t end) const
+    {
+        skinVertices(mPalette, mInfluences + begin, mPositions + begin, mNormals ? mNormals + begin : 0, end - begin,
+                     mSkinnedPositions + begin, mSkinnedNormals ? mSkinnedNormals + begin : 0);
+    }
+
+private:
+    const PaletteEntry *mPalette;
+    const SkinningInfluences *mInfluences;
+    const Vector4 *mPositions;
+    const Vector4 *mNormals;
+    Vector4 *mSkinnedPositions;
+    Vector4 *mSkinnedNormals;
+};
+
+GAMEMATH_INLINE void skinVerticesParallel(const Matrix4 *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    SkinVerticesKernel<Matrix4> kernel(palette, influences, positions, normals, skinnedPositions, skinnedNormals);
+    parallelForRanges(count, parallelRangeCount(count, SkinningMinimumGrain), kernel);
+}
+
+GAMEMATH_INLINE void skinVerticesParallel(const Matrix3x4 *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    SkinVerticesKernel<Matrix3x4> kernel(palette, influences, positions, normals, skinnedPositions, skinnedNormals);
+    parallelForRanges(count, parallelRangeCount(count, SkinningMinimumGrain), kernel);
+}
+
+GAMEMATH_INLINE void skinVerticesParallel(const DualQuaternion *palette, const SkinningInfluences *influences,
+                                          const Vector4 *positions, const Vector4 *normals, size_t count,
+                                          Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    SkinVerticesKernel<DualQuaternion> kernel(palette, influences, positions, normals, skinnedPositions,
+                                              skinnedNormals);
+    parallelForRanges(count, parallelRangeCount(count, SkinningMinimumGrain), kernel);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "skinning_sse.h"
+#else
+#include "skinning_sisd.h"
+#endif
+
+#endif // SKINNING_H
@@ -0,0 +1,119 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "skinning.h"
+
+#if !defined(SKINNING_H)
+#error "Do not include this file directly, only include skinning.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE void skinVertices(const Matrix4 *palette, const SkinningInfluences *influences, const Vector4 *positions,
+                                  const Vector4 *normals, size_t count, Vector4 *skinnedPositions,
+                                  Vector4 *skinnedNormals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        // Blend the upper three rows of the palette matrices
+        float matrix[3][4] = { { 0 } };
+        for (int bone = 0; bone < 4; ++bone) {
+            const Matrix4 &boneMatrix = palette[influences[i].bones[bone]];
+            const float weight = influences[i].weights[bone];
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 4; ++col)
+                    matrix[row][col] += weight * boneMatrix(row, col);
+            }
+        }
+
+        const float *position = positions[i].data();
+        float skinned[3];
+        for (int row = 0; row < 3; ++row) {
+            skinned[row] = matrix[row][0] * position[0] + matrix[row][1] * position[1] + matrix[row][2] * position[2]
+                + matrix[row][3];
+        }
+        skinnedPositions[i] = Vector4(skinned[0], skinned[1], skinned[2], 1);
+
+        if (normals && skinnedNormals) {
+            const float *normal = normals[i].data();
+            for (int row = 0; row < 3; ++row)
+                skinned[row] = matrix[row][0] * normal[0] + matrix[row][1] * normal[1] + matrix[row][2] * normal[2];
+
+            const float invLength = 1 / sqrt(skinned[0] * skinned[0] + skinned[1] * skinned[1] + skinned[2] * skinned[2]);
+            skinnedNormals[i] = Vector4(skinned[0] * invLength, skinned[1] * invLength, skinned[2] * invLength, 0);
+        }
+    }
+}
+
+GAMEMATH_INLINE void skinVertices(const Matrix3x4 *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float matrix[3][4] = { { 0 } };
+        for (int bone = 0; bone < 4; ++bone) {
+            const Matrix3x4 &boneMatrix = palette[influences[i].bones[bone]];
+            const float weight = influences[i].weights[bone];
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 4; ++col)
+                    matrix[row][col] += weight * boneMatrix(row, col);
+            }
+        }
+
+        const float *position = positions[i].data();
+        float skinned[3];
+        for (int row = 0; row < 3; ++row) {
+            skinned[row] = matrix[row][0] * position[0] + matrix[row][1] * position[1] + matrix[row][2] * position[2]
+                + matrix[row][3];
+        }
+        skinnedPositions[i] = Vector4(skinned[0], skinned[1], skinned[2], 1);
+
+        if (normals && skinnedNormals) {
+            const float *normal = normals[i].data();
+            for (int row = 0; row < 3; ++row)
+                skinned[row] = matrix[row][0] * normal[0] + matrix[row][1] * normal[1] + matrix[row][2] * normal[2];
+
+            const float invLength = 1 / sqrt(skinned[0] * skinned[0] + skinned[1] * skinned[1] + skinned[2] * skinned[2]);
+            skinnedNormals[i] = Vector4(skinned[0] * invLength, skinned[1] * invLength, skinned[2] * invLength, 0);
+        }
+    }
+}
+
+GAMEMATH_INLINE void skinVertices(const DualQuaternion *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float *firstReal = palette[influences[i].bones[0]].real().data();
+
+        // Blend the parts, flipping bones whose rotation is more than 180 degrees away from the first
+        float real[4] = { 0 }, dual[4] = { 0 };
+        for (int bone = 0; bone < 4; ++bone) {
+            const DualQuaternion &boneDualQuaternion = palette[influences[i].bones[bone]];
+            const float *boneReal = boneDualQuaternion.real().data();
+            const float *boneDual = boneDualQuaternion.dual().data();
+            const float cosAngle = firstReal[0] * boneReal[0] + firstReal[1] * boneReal[1] + firstReal[2] * boneReal[2]
+                + firstReal[3] * boneReal[3];
+            const float weight = cosAngle < 0 ? -influences[i].weights[bone] : influences[i].weights[bone];
+            for (int j = 0; j < 4; ++j) {
+                real[j] += weight * boneReal[j];
+                dual[j] += weight * boneDual[j];
+            }
+        }
+
+        const float invLength = 1 / sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+        const DualQuaternion blended(Quaternion(real[0] * invLength, real[1] * invLength, real[2] * invLength,
+                                                real[3] * invLength),
+                                     Quaternion(dual[0] * invLength, dual[1] * invLength, dual[2] * invLength,
+                                                dual[3] * invLength));
+
+        const Vector4 position = blended.mapPosition(positions[i]);
+        skinnedPositions[i] = Vector4(position.x(), position.y(), position.z(), 1);
+
+        if (normals && skinnedNormals) {
+            const Vector4 normal = blended.mapNormal(normals[i]);
+            skinnedNormals[i] = Vector4(normal.x(), normal.y(), normal.z(), 0);
+        }
+    }
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,196 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "skinning.h"
+
+#if !defined(SKINNING_H)
+#error "Do not include this file directly, only include skinning.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Adds the columns of a palette matrix, scaled by the weight of its bone, to the blended columns.
+  The columns are passed separately, so they stay in registers.
+  */
+GAMEMATH_INLINE void _skinning_accumulate(const Matrix4 &matrix, const __m128 weight, __m128 &column0, __m128 &column1,
+                                          __m128 &column2, __m128 &column3)
+{
+    const float *data = matrix.data();
+    column0 = _mm_add_ps(column0, _mm_mul_ps(_mm_load_ps(data), weight));
+    column1 = _mm_add_ps(column1, _mm_mul_ps(_mm_load_ps(data + 4), weight));
+    column2 = _mm_add_ps(column2, _mm_mul_ps(_mm_load_ps(data + 8), weight));
+    column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_load_ps(data + 12), weight));
+}
+
+/**
+  Blends the columns of the palette matrices of the four bones of a vertex by their weights.
+  */
+GAMEMATH_INLINE void _skinning_blend(const Matrix4 *palette, const SkinningInfluences &influences, __m128 &column0,
+                                     __m128 &column1, __m128 &column2, __m128 &column3)
+{
+    const __m128 weights = _mm_loadu_ps(influences.weights);
+
+    const __m128 weight = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0));
+    const float *data = palette[influences.bones[0]].data();
+    column0 = _mm_mul_ps(_mm_load_ps(data), weight);
+    column1 = _mm_mul_ps(_mm_load_ps(data + 4), weight);
+    column2 = _mm_mul_ps(_mm_load_ps(data + 8), weight);
+    column3 = _mm_mul_ps(_mm_load_ps(data + 12), weight);
+
+    _skinning_accumulate(palette[influences.bones[1]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)),
+                         column0, column1, column2, column3);
+    _skinning_accumulate(palette[influences.bones[2]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)),
+                         column0, column1, column2, column3);
+    _skinning_accumulate(palette[influences.bones[3]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)),
+                         column0, column1, column2, column3);
+}
+
+/**
+  Transforms the x, y and z components of vector by the first three columns.
+  */
+GAMEMATH_INLINE __m128 _skinning_transform(const __m128 column0, const __m128 column1, const __m128 column2,
+                                            const __m128 vector)
+{
+    __m128 result = _mm_mul_ps(column0, _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(0, 0, 0, 0)));
+    result = _mm_add_ps(result, _mm_mul_ps(column1, _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(1, 1, 1, 1))));
+    return _mm_add_ps(result, _mm_mul_ps(column2, _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+/**
+  Transforms a position by the blended columns. The blended translation has a w of one, since the
+  weights add up to one, but it's set exactly anyway.
+  */
+GAMEMATH_INLINE __m128 _skinning_map_position(const __m128 column0, const __m128 column1, const __m128 column2,
+                                               const __m128 column3, const __m128 position)
+{
+    const __m128 result = _mm_add_ps(_skinning_transform(column0, column1, column2, position), column3);
+    return _mm_or_ps(_mm_and_ps(result, _mm_load_ps((const float*)CoordinateMaskXYZ)), _mm_load_ps(IdentityCol4));
+}
+
+/**
+  Transforms a normal by the blended columns and renormalizes it with a Newton-Raphson step on the
+  reciprocal square root estimate.
+  */
+GAMEMATH_INLINE __m128 _skinning_map_normal(const __m128 column0, const __m128 column1, const __m128 column2,
+                                             const __m128 normal)
+{
+    const __m128 result = _mm_and_ps(_skinning_transform(column0, column1, column2, normal),
+                                     _mm_load_ps((const float*)CoordinateMaskXYZ));
+    const __m128 lengthSquared = _dot_product(result, result);
+    const __m128 estimate = _mm_rsqrt_ss(lengthSquared);
+    __m128 scale = _mm_mul_ss(estimate, _mm_sub_ss(_mm_set_ss(1.5f),
+        _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), lengthSquared), _mm_mul_ss(estimate, estimate))));
+    scale = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0));
+    return _mm_mul_ps(result, scale);
+}
+
+GAMEMATH_INLINE void skinVertices(const Matrix4 *palette, const SkinningInfluences *influences, const Vector4 *positions,
+                                  const Vector4 *normals, size_t count, Vector4 *skinnedPositions,
+                                  Vector4 *skinnedNormals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        __m128 column0, column1, column2, column3;
+        _skinning_blend(palette, influences[i], column0, column1, column2, column3);
+
+        skinnedPositions[i] = _skinning_map_position(column0, column1, column2, column3, positions[i]);
+        if (normals && skinnedNormals)
+            skinnedNormals[i] = _skinning_map_normal(column0, column1, column2, normals[i]);
+    }
+}
+
+/**
+  Adds the rows of a palette matrix, scaled by the weight of its bone, to the blended rows.
+  */
+GAMEMATH_INLINE void _skinning_accumulate(const Matrix3x4 &matrix, const __m128 weight, __m128 &row0, __m128 &row1,
+                                          __m128 &row2)
+{
+    const float *data = matrix.data();
+    row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_load_ps(data), weight));
+    row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_load_ps(data + 4), weight));
+    row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_load_ps(data + 8), weight));
+}
+
+GAMEMATH_INLINE void skinVertices(const Matrix3x4 *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const __m128 weights = _mm_loadu_ps(influences[i].weights);
+
+        const __m128 weight = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0));
+        const float *data = palette[influences[i].bones[0]].data();
+        __m128 row0 = _mm_mul_ps(_mm_load_ps(data), weight);
+        __m128 row1 = _mm_mul_ps(_mm_load_ps(data + 4), weight);
+        __m128 row2 = _mm_mul_ps(_mm_load_ps(data + 8), weight);
+
+        _skinning_accumulate(palette[influences[i].bones[1]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)),
+                             row0, row1, row2);
+        _skinning_accumulate(palette[influences[i].bones[2]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)),
+                             row0, row1, row2);
+        _skinning_accumulate(palette[influences[i].bones[3]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)),
+                             row0, row1, row2);
+
+        // Once per vertex, transposing the blended rows is cheaper than transforming by dot products
+        __m128 row3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+        skinnedPositions[i] = _skinning_map_position(row0, row1, row2, row3, positions[i]);
+        if (normals && skinnedNormals)
+            skinnedNormals[i] = _skinning_map_normal(row0, row1, row2, normals[i]);
+    }
+}
+
+/**
+  Adds the parts of a palette dual quaternion, scaled by the weight of its bone, to the blended parts.
+  The sign of the weight is flipped if the rotation is more than 180 degrees away from the first bone.
+  */
+GAMEMATH_INLINE void _skinning_accumulate(const DualQuaternion &dualQuaternion, const __m128 weight,
+                                          const __m128 firstReal, __m128 &real, __m128 &dual)
+{
+    const __m128 boneReal = _mm_load_ps(dualQuaternion.real().data());
+    const __m128 cosAngle = _dot_product(firstReal, boneReal);
+    const __m128 sign = _mm_and_ps(_mm_shuffle_ps(cosAngle, cosAngle, _MM_SHUFFLE(0, 0, 0, 0)),
+                                   _mm_load_ps((const float*)SignMask));
+    const __m128 signedWeight = _mm_xor_ps(weight, sign);
+    real = _mm_add_ps(real, _mm_mul_ps(boneReal, signedWeight));
+    dual = _mm_add_ps(dual, _mm_mul_ps(_mm_load_ps(dualQuaternion.dual().data()), signedWeight));
+}
+
+GAMEMATH_INLINE void skinVertices(const DualQuaternion *palette, const SkinningInfluences *influences,
+                                  const Vector4 *positions, const Vector4 *normals, size_t count,
+                                  Vector4 *skinnedPositions, Vector4 *skinnedNormals)
+{
+    const __m128 one = _mm_load_ps(IdentityCol4);
+    const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+    for (size_t i = 0; i < count; ++i) {
+        const __m128 weights = _mm_loadu_ps(influences[i].weights);
+
+        const DualQuaternion &first = palette[influences[i].bones[0]];
+        const __m128 firstReal = _mm_load_ps(first.real().data());
+        const __m128 weight = _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 real = _mm_mul_ps(firstReal, weight);
+        __m128 dual = _mm_mul_ps(_mm_load_ps(first.dual().data()), weight);
+
+        _skinning_accumulate(palette[influences[i].bones[1]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)),
+                             firstReal, real, dual);
+        _skinning_accumulate(palette[influences[i].bones[2]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)),
+                             firstReal, real, dual);
+        _skinning_accumulate(palette[influences[i].bones[3]], _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)),
+                             firstReal, real, dual);
+
+        _dual_quaternion_normalize(real, dual);
+
+        const __m128 translation = _dual_quaternion_translation(real, dual);
+        const __m128 position = _dual_quaternion_transform(real, translation, _mm_and_ps(positions[i], maskXYZ));
+        skinnedPositions[i] = _mm_or_ps(_mm_and_ps(position, maskXYZ), one);
+
+        if (normals && skinnedNormals) {
+            // The blended rotation is normalized, so the rotated normal keeps its length
+            skinnedNormals[i] = _dual_quaternion_transform(real, _mm_setzero_ps(), _mm_and_ps(normals[i], maskXYZ));
+        }
+    }
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,196 @@
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+#include <cstring>
+#include <limits>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "ray3d.h"
+#include "ray_packet.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  An array of spheres stored as structure of arrays, which is tested against a ray four or eight
+  spheres at a time. This replaces looping over the bounding spheres of objects one by one, when
+  picking or testing projectiles against many sphere-bounded objects.
+
+  The arrays are padded to a multiple of eight, so the last spheres can be read four or eight at a
+  time. Hits in the padding are masked off, so it never shows up in results.
+  */
+class SphereBatch {
+public:
+    SphereBatch();
+    ~SphereBatch();
+
+    /**
+      Appends a sphere and returns its index.
+      */
+    unsigned int add(const Vector4 &center, float radius);
+
+    void set(unsigned int index, const Vector4 &center, float radius);
+
+    /**
+      Removes a sphere by moving the last sphere into its place, so only the index of the last
+      sphere changes.
+      */
+    void remove(unsigned int index);
+
+    void clear();
+
+    unsigned int size() const;
+
+    Vector4 center(unsigned int index) const;
+    float radius(unsigned int index) const;
+
+    /**
+      Tests the ray against all spheres. Bit i % 32 of hitMasks[i / 32] is set if sphere i is hit
+      within maximumDistance, and distances[i] receives the distance at which the ray enters it.
+      Rays starting inside a sphere have a distance of zero, missed spheres have a distance of infinity.
+
+      hitMasks needs room for (size() + 31) / 32 words and distances for size() floats.
+
+      @return The number of spheres hit.
+      */
+    unsigned int intersect(const Ray3d &ray, unsigned int *hitMasks, float *distances,
+                           float maximumDistance = std::numeric_limits<float>::infinity()) const;
+
+    /**
+      Finds the sphere that the ray enters first within maximumDistance.
+
+      @return The index of the sphere, or -1 if no sphere is hit.
+      */
+    int closest(const Ray3d &ray, float *distance = 0, float maximumDistance = std::numeric_limits<float>::infinity()) const;
+
+    /**
+      Tests all rays of the packet against all spheres. rayMasks[i] receives a bit mask of the rays
+      hitting sphere i, and distances[i * Size + j] the distance at which ray j enters sphere i.
+      The maximum distances of the packet are respected.
+      */
+    template<int Size>
+    void intersect(const RayPacket<Size> &packet, int *rayMasks, float *distances) const;
+
+private:
+    SphereBatch(const SphereBatch&);
+    SphereBatch &operator =(const SphereBatch&);
+
+    void reserve(unsigned int capacity);
+    void setPadding(unsigned int index);
+
+    // Planes of mCapacity floats each: center x, y, z and the squared radius
+    float *mData;
+    unsigned int mSize;
+    unsigned int mCapacity;
+};
+
+GAMEMATH_INLINE SphereBatch::SphereBatch()
+    : mData(0), mSize(0), mCapacity(0)
+{
+}
+
+GAMEMATH_INLINE SphereBatch::~SphereBatch()
+{
+    if (mData)
+        ALIGNED_FREE(mData);
+}
+
+GAMEMATH_INLINE void SphereBatch::clear()
+{
+    for (unsigned int i = 0; i < mSize; ++i)
+        setPadding(i);
+    mSize = 0;
+}
+
+GAMEMATH_INLINE unsigned int SphereBatch::size() const
+{
+    return mSize;
+}
+
+GAMEMATH_INLINE void SphereBatch::setPadding(unsigned int index)
+{
+    // A negative squared radius makes the discriminant negative for most rays. Rounding can still let
+    // rays far from the origin pass, so the queries mask off the padding as well.
+    mData[index] = 0;
+    mData[mCapacity + index] = 0;
+    mData[2 * mCapacity + index] = 0;
+    mData[3 * mCapacity + index] = -1;
+}
+
+GAMEMATH_INLINE void SphereBatch::reserve(unsigned int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    float *data = static_cast<float*>(ALIGNED_MALLOC(sizeof(float) * 4 * capacity));
+    if (!data)
+        throw std::bad_alloc();
+
+    for (int plane = 0; plane < 4; ++plane) {
+        if (mCapacity)
+            memcpy(data + plane * capacity, mData + plane * mCapacity, sizeof(float) * mCapacity);
+    }
+
+    if (mData)
+        ALIGNED_FREE(mData);
+
+    const unsigned int oldCapacity = mCapacity;
+    mData = data;
+    mCapacity = capacity;
+    for (unsigned int i = oldCapacity; i < capacity; ++i)
+        setPadding(i);
+}
+
+GAMEMATH_INLINE unsigned int SphereBatch::add(const Vector4 &center, float radius)
+{
+    if (mSize == mCapacity)
+        reserve(mCapacity ? 2 * mCapacity : 32);
+
+    set(mSize, center, radius);
+    return mSize++;
+}
+
+GAMEMATH_INLINE void SphereBatch::set(unsigned int index, const Vector4 &center, float radius)
+{
+    mData[index] = center.x();
+    mData[mCapacity + index] = center.y();
+    mData[2 * mCapacity + index] = center.z();
+    mData[3 * mCapacity + index] = radius * radius;
+}
+
+GAMEMATH_INLINE void SphereBatch::remove(unsigned int index)
+{
+    const unsigned int last = mSize - 1;
+    for (int plane = 0; plane < 4; ++plane)
+        mData[plane * mCapacity + index] = mData[plane * mCapacity + last];
+    setPadding(last);
+    mSize = last;
+}
+
+GAMEMATH_INLINE Vector4 SphereBatch::center(unsigned int index) const
+{
+    return Vector4(mData[index], mData[mCapacity + index], mData[2 * mCapacity + index], 1);
+}
+
+GAMEMATH_INLINE float SphereBatch::radius(unsigned int index) const
+{
+    return sqrt(mData[3 * mCapacity + index]);
+}
+
+template<int Size>
+GAMEMATH_INLINE void SphereBatch::intersect(const RayPacket<Size> &packet, int *rayMasks, float *distances) const
+{
+    // The rays occupy the SIMD lanes here, since a packet is usually tested against few spheres
+    for (unsigned int i = 0; i < mSize; ++i)
+        rayMasks[i] = packet.intersectSphere(center(i), mData[3 * mCapacity + i], distances + i * Size);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "sphere_batch_sse.h"
+#else
+#include "sphere_batch_sisd.h"
+#endif
+
+#endif // SPHERE_BATCH_H
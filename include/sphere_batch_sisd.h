@@ -0,0 +1,84 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "sphere_batch.h"
+
+#if !defined(SPHERE_BATCH_H)
+#error "Do not include this file directly, only include sphere_batch.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Intersects a ray with a single sphere of the batch. Returns false for misses, otherwise stores the
+  entry distance, clamped to zero, in distance.
+  */
+GAMEMATH_INLINE bool _sphere_batch_intersect(const float *origin, const float *direction, float a,
+                                             const float *spheres, size_t stride, float &distance)
+{
+    const float oc[3] = { origin[0] - spheres[0], origin[1] - spheres[stride], origin[2] - spheres[2 * stride] };
+    const float b = oc[0] * direction[0] + oc[1] * direction[1] + oc[2] * direction[2];
+    const float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - spheres[3 * stride];
+
+    if (c > 0 && b > 0)
+        return false;
+
+    const float discriminant = b * b - a * c;
+    if (discriminant < 0)
+        return false;
+
+    distance = (-b - sqrt(discriminant)) / a;
+    if (distance < 0)
+        distance = 0;
+    return true;
+}
+
+GAMEMATH_INLINE unsigned int SphereBatch::intersect(const Ray3d &ray, unsigned int *hitMasks, float *distances,
+                                                    float maximumDistance) const
+{
+    for (unsigned int i = 0; i < (mSize + 31) / 32; ++i)
+        hitMasks[i] = 0;
+
+    const float *origin = ray.origin().data();
+    const float *direction = ray.direction().data();
+    const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+
+    unsigned int hits = 0;
+    for (unsigned int i = 0; i < mSize; ++i) {
+        float entry;
+        if (_sphere_batch_intersect(origin, direction, a, mData + i, mCapacity, entry) && entry <= maximumDistance) {
+            distances[i] = entry;
+            hitMasks[i / 32] |= 1u << (i % 32);
+            ++hits;
+        } else {
+            distances[i] = std::numeric_limits<float>::infinity();
+        }
+    }
+
+    return hits;
+}
+
+GAMEMATH_INLINE int SphereBatch::closest(const Ray3d &ray, float *distance, float maximumDistance) const
+{
+    const float *origin = ray.origin().data();
+    const float *direction = ray.direction().data();
+    const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+
+    int closestIndex = -1;
+    float closestDistance = maximumDistance;
+
+    for (unsigned int i = 0; i < mSize; ++i) {
+        float entry;
+        if (_sphere_batch_intersect(origin, direction, a, mData + i, mCapacity, entry)
+            && (closestIndex == -1 ? entry <= closestDistance : entry < closestDistance)) {
+            closestIndex = i;
+            closestDistance = entry;
+        }
+    }
+
+    if (distance)
+        *distance = closestIndex == -1 ? std::numeric_limits<float>::infinity() : closestDistance;
+    return closestIndex;
+}
+
+GAMEMATH_NAMESPACE_END
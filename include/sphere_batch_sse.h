@@ -0,0 +1,208 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "sphere_batch.h"
+
+#if !defined(SPHERE_BATCH_H)
+#error "Do not include this file directly, only include sphere_batch.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Intersects a ray, whose components have been broadcast to all lanes, with four spheres stored as
+  structure of arrays at spheres, with planes stride floats apart. a is the squared length of the
+  ray direction and invA its reciprocal. Returns the clamped entry distances in distances and a
+  lane mask of the spheres that are hit within maximumDistance.
+  */
+GAMEMATH_INLINE __m128 _sphere_batch_intersect4(const __m128 *origin, const __m128 *direction, const __m128 a,
+                                                const __m128 invA, const __m128 maximumDistance,
+                                                const float *spheres, size_t stride, __m128 &distances)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    // Solve |origin + t * direction - center|^2 = radius^2 for t, with b being half the linear term
+    const __m128 ocX = _mm_sub_ps(origin[0], _mm_load_ps(spheres));
+    const __m128 ocY = _mm_sub_ps(origin[1], _mm_load_ps(spheres + stride));
+    const __m128 ocZ = _mm_sub_ps(origin[2], _mm_load_ps(spheres + 2 * stride));
+    const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, direction[0]), _mm_mul_ps(ocY, direction[1])),
+        _mm_mul_ps(ocZ, direction[2]));
+    const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ)),
+        _mm_load_ps(spheres + 3 * stride));
+    const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+
+    // The origin is outside of the sphere (c > 0) and the ray points away from it (b > 0)
+    const __m128 behind = _mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmpgt_ps(b, zero));
+
+    // Negative discriminants produce NaNs here, but those lanes are masked out below
+    const __m128 entry = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(discriminant)), invA), zero);
+
+    __m128 hit = _mm_andnot_ps(behind, _mm_cmpge_ps(discriminant, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(entry, maximumDistance));
+    distances = _mm_or_ps(_mm_and_ps(hit, entry), _mm_andnot_ps(hit, _mm_load_ps(PositiveInfinity)));
+    return hit;
+}
+
+#if defined(__AVX__)
+
+/**
+  Same as _sphere_batch_intersect4, but for eight spheres at once.
+  */
+GAMEMATH_INLINE __m256 _sphere_batch_intersect8(const __m256 *origin, const __m256 *direction, const __m256 a,
+                                                const __m256 invA, const __m256 maximumDistance,
+                                                const float *spheres, size_t stride, __m256 &distances)
+{
+    const __m256 zero = _mm256_setzero_ps();
+
+    const __m256 ocX = _mm256_sub_ps(origin[0], _mm256_loadu_ps(spheres));
+    const __m256 ocY = _mm256_sub_ps(origin[1], _mm256_loadu_ps(spheres + stride));
+    const __m256 ocZ = _mm256_sub_ps(origin[2], _mm256_loadu_ps(spheres + 2 * stride));
+    const __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, direction[0]), _mm256_mul_ps(ocY, direction[1])),
+        _mm256_mul_ps(ocZ, direction[2]));
+    const __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, ocX), _mm256_mul_ps(ocY, ocY)),
+        _mm256_mul_ps(ocZ, ocZ)), _mm256_loadu_ps(spheres + 3 * stride));
+    const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+
+    const __m256 behind = _mm256_and_ps(_mm256_cmp_ps(c, zero, _CMP_GT_OQ), _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+    const __m256 entry = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(discriminant)), invA), zero);
+
+    __m256 hit = _mm256_andnot_ps(behind, _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(entry, maximumDistance, _CMP_LE_OQ));
+    distances = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), entry, hit);
+    return hit;
+}
+
+#endif
+
+/**
+  Returns the number of bits set in a mask of up to eight bits.
+  */
+GAMEMATH_INLINE unsigned int _lane_count(int mask)
+{
+    unsigned int count = 0;
+    for (; mask; mask &= mask - 1)
+        ++count;
+    return count;
+}
+
+GAMEMATH_INLINE unsigned int SphereBatch::intersect(const Ray3d &ray, unsigned int *hitMasks, float *distances,
+                                                    float maximumDistance) const
+{
+    for (unsigned int i = 0; i < (mSize + 31) / 32; ++i)
+        hitMasks[i] = 0;
+
+    const __m128 rayOrigin = ray.origin();
+    const __m128 rayDirection = ray.direction();
+    const float lengthSquared = ray.direction().x() * ray.direction().x() + ray.direction().y() * ray.direction().y()
+        + ray.direction().z() * ray.direction().z();
+
+    __m128 origin[3];
+    __m128 direction[3];
+    origin[0] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(0, 0, 0, 0));
+    origin[1] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(1, 1, 1, 1));
+    origin[2] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(2, 2, 2, 2));
+    direction[0] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(0, 0, 0, 0));
+    direction[1] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(1, 1, 1, 1));
+    direction[2] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 a = _mm_set1_ps(lengthSquared);
+    const __m128 invA = _mm_set1_ps(1.0f / lengthSquared);
+    const __m128 maximum = _mm_set1_ps(maximumDistance);
+
+    unsigned int hits = 0;
+    unsigned int i = 0;
+
+#if defined(__AVX__)
+    __m256 origin8[3];
+    __m256 direction8[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        origin8[axis] = _mm256_insertf128_ps(_mm256_castps128_ps256(origin[axis]), origin[axis], 1);
+        direction8[axis] = _mm256_insertf128_ps(_mm256_castps128_ps256(direction[axis]), direction[axis], 1);
+    }
+    const __m256 a8 = _mm256_set1_ps(lengthSquared);
+    const __m256 invA8 = _mm256_set1_ps(1.0f / lengthSquared);
+    const __m256 maximum8 = _mm256_set1_ps(maximumDistance);
+
+    for (; i + 8 <= mSize; i += 8) {
+        __m256 entry;
+        const int mask = _mm256_movemask_ps(_sphere_batch_intersect8(origin8, direction8, a8, invA8, maximum8,
+            mData + i, mCapacity, entry));
+        _mm256_storeu_ps(distances + i, entry);
+        hitMasks[i / 32] |= (unsigned int)mask << (i % 32);
+        hits += _lane_count(mask);
+    }
+#endif
+
+    // The arrays are padded to a multiple of eight, so the last four spheres can be read at once, but
+    // the padding lanes have to be cut off. Rounding can let them pass for rays far from the origin.
+    for (; i < mSize; i += 4) {
+        __m128 entry;
+        int mask = _mm_movemask_ps(_sphere_batch_intersect4(origin, direction, a, invA, maximum,
+            mData + i, mCapacity, entry));
+
+        if (i + 4 <= mSize) {
+            _mm_storeu_ps(distances + i, entry);
+        } else {
+            mask &= (1 << (mSize - i)) - 1;
+            GAMEMATH_ALIGN float entries[4];
+            _mm_store_ps(entries, entry);
+            for (unsigned int j = i; j < mSize; ++j)
+                distances[j] = entries[j - i];
+        }
+
+        hitMasks[i / 32] |= (unsigned int)mask << (i % 32);
+        hits += _lane_count(mask);
+    }
+
+    return hits;
+}
+
+GAMEMATH_INLINE int SphereBatch::closest(const Ray3d &ray, float *distance, float maximumDistance) const
+{
+    const __m128 rayOrigin = ray.origin();
+    const __m128 rayDirection = ray.direction();
+    const float lengthSquared = ray.direction().x() * ray.direction().x() + ray.direction().y() * ray.direction().y()
+        + ray.direction().z() * ray.direction().z();
+
+    __m128 origin[3];
+    __m128 direction[3];
+    origin[0] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(0, 0, 0, 0));
+    origin[1] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(1, 1, 1, 1));
+    origin[2] = _mm_shuffle_ps(rayOrigin, rayOrigin, _MM_SHUFFLE(2, 2, 2, 2));
+    direction[0] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(0, 0, 0, 0));
+    direction[1] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(1, 1, 1, 1));
+    direction[2] = _mm_shuffle_ps(rayDirection, rayDirection, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 a = _mm_set1_ps(lengthSquared);
+    const __m128 invA = _mm_set1_ps(1.0f / lengthSquared);
+
+    int closestIndex = -1;
+    float closestDistance = maximumDistance;
+
+    // Spheres beyond the closest hit so far are rejected by the kernel itself
+    __m128 maximum = _mm_set1_ps(maximumDistance);
+
+    for (unsigned int i = 0; i < mSize; i += 4) {
+        __m128 entry;
+        int mask = _mm_movemask_ps(_sphere_batch_intersect4(origin, direction, a, invA, maximum,
+            mData + i, mCapacity, entry));
+        if (i + 4 > mSize)
+            mask &= (1 << (mSize - i)) - 1;
+        if (!mask)
+            continue;
+
+        GAMEMATH_ALIGN float entries[4];
+        _mm_store_ps(entries, entry);
+        for (int lane = 0; lane < 4; ++lane) {
+            if ((mask & (1 << lane)) && (closestIndex == -1 || entries[lane] < closestDistance)) {
+                closestIndex = i + lane;
+                closestDistance = entries[lane];
+            }
+        }
+        maximum = _mm_set1_ps(closestDistance);
+    }
+
+    if (distance)
+        *distance = closestIndex == -1 ? std::numeric_limits<float>::infinity() : closestDistance;
+    return closestIndex;
+}
+
+GAMEMATH_NAMESPACE_END
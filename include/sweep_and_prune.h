@@ -0,0 +1,451 @@
+#ifndef SWEEP_AND_PRUNE_H
+#define SWEEP_AND_PRUNE_H
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "box3d.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A pair of proxies whose boxes overlap. proxyA is always smaller than proxyB.
+  */
+struct SweepAndPrunePair {
+    int proxyA;
+    int proxyB;
+};
+
+GAMEMATH_INLINE bool operator <(const SweepAndPrunePair &a, const SweepAndPrunePair &b)
+{
+    return a.proxyA < b.proxyA || (a.proxyA == b.proxyA && a.proxyB < b.proxyB);
+}
+
+GAMEMATH_INLINE bool operator ==(const SweepAndPrunePair &a, const SweepAndPrunePair &b)
+{
+    return a.proxyA == b.proxyA && a.proxyB == b.proxyB;
+}
+
+/**
+  A broadphase that finds overlapping pairs among a set of moving boxes by sorting them along one axis.
+
+  The boxes are stored as structure of arrays, in the order of their minimum along the sort axis.
+  Since boxes move little between two updates, the order is restored with an insertion sort in close
+  to linear time. The sorted boxes are then swept, and the remaining two axes of the boxes that
+  overlap on the sort axis are compared four at a time.
+
+  Each update reports the pairs that started and stopped overlapping since the previous update.
+  */
+class SweepAndPrune {
+public:
+    static const int NullProxy = -1;
+
+    /**
+      Creates an empty broadphase that sorts along the given axis (0 = x, 1 = y, 2 = z).
+      Choose the axis along which the boxes are spread the most.
+      */
+    SweepAndPrune(int axis = 0);
+    ~SweepAndPrune();
+
+    /**
+      Adds a box and returns a handle for it. The box is only considered by the next update.
+      */
+    int createProxy(const Box3d &box);
+
+    /**
+      Removes a box. Its pairs are reported as removed by the next update, and its handle is only
+      reused after that.
+      */
+    void destroyProxy(int proxy);
+
+    /**
+      Changes the box of a proxy. The pairs are only updated by the next call to update.
+      */
+    void moveProxy(int proxy, const Box3d &box);
+
+    /**
+      Restores the sort order and finds all overlapping pairs. Afterwards, addedPairs and
+      removedPairs contain the difference to the previous update.
+      */
+    void update();
+
+    /**
+      Removes all proxies and releases all memory.
+      */
+    void clear();
+
+    Box3d box(int proxy) const;
+
+    int axis() const;
+    int proxyCount() const;
+
+    /**
+      All pairs of overlapping boxes as of the last update, sorted by proxyA and then proxyB.
+      */
+    const std::vector<SweepAndPrunePair> &pairs() const;
+
+    /**
+      The pairs that started overlapping during the last update, sorted like pairs.
+      */
+    const std::vector<SweepAndPrunePair> &addedPairs() const;
+
+    /**
+      The pairs that stopped overlapping or whose proxies were destroyed during the last update,
+      sorted like pairs.
+      */
+    const std::vector<SweepAndPrunePair> &removedPairs() const;
+
+private:
+    SweepAndPrune(const SweepAndPrune&);
+    SweepAndPrune &operator =(const SweepAndPrune&);
+
+    void reserve(int capacity);
+    void store(int position, const Box3d &box);
+    void move(int from, int to);
+    void insertionSort();
+    void fullSort();
+    void sweep();
+
+    int mAxis;
+    int mCount;
+    int mCapacity;
+    int mInserted;
+
+    // The boxes in sorted order. Each array has three more elements than the capacity, so the
+    // sweep can load four elements at any position.
+    float *mStorage;
+    float *mMinimum[3];
+    float *mMaximum[3];
+    int *mProxies;
+
+    // Maps handles to sorted positions, NullProxy for free handles
+    std::vector<int> mPositions;
+    std::vector<int> mFreeHandles;
+    std::vector<int> mDestroyedHandles;
+
+    std::vector<SweepAndPrunePair> mPairs;
+    std::vector<SweepAndPrunePair> mPreviousPairs;
+    std::vector<SweepAndPrunePair> mAddedPairs;
+    std::vector<SweepAndPrunePair> mRemovedPairs;
+};
+
+GAMEMATH_INLINE SweepAndPrune::SweepAndPrune(int axis)
+    : mAxis(axis), mCount(0), mCapacity(0), mInserted(0), mStorage(0), mProxies(0)
+{
+    for (int i = 0; i < 3; ++i) {
+        mMinimum[i] = 0;
+        mMaximum[i] = 0;
+    }
+}
+
+GAMEMATH_INLINE SweepAndPrune::~SweepAndPrune()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void SweepAndPrune::clear()
+{
+    if (mStorage)
+        ALIGNED_FREE(mStorage);
+    delete [] mProxies;
+
+    mStorage = 0;
+    mProxies = 0;
+    for (int i = 0; i < 3; ++i) {
+        mMinimum[i] = 0;
+        mMaximum[i] = 0;
+    }
+    mCount = 0;
+    mCapacity = 0;
+    mInserted = 0;
+
+    std::vector<int>().swap(mPositions);
+    std::vector<int>().swap(mFreeHandles);
+    std::vector<int>().swap(mDestroyedHandles);
+    std::vector<SweepAndPrunePair>().swap(mPairs);
+    std::vector<SweepAndPrunePair>().swap(mPreviousPairs);
+    std::vector<SweepAndPrunePair>().swap(mAddedPairs);
+    std::vector<SweepAndPrunePair>().swap(mRemovedPairs);
+}
+
+GAMEMATH_INLINE void SweepAndPrune::reserve(int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    const size_t stride = capacity + 3;
+    float *storage = static_cast<float*>(ALIGNED_MALLOC(sizeof(float) * stride * 6));
+    if (!storage)
+        throw std::bad_alloc();
+    int *proxies = new int[capacity];
+
+    for (int i = 0; i < 3; ++i) {
+        float *minimum = storage + stride * i;
+        float *maximum = storage + stride * (i + 3);
+        if (mCount) {
+            memcpy(minimum, mMinimum[i], sizeof(float) * mCount);
+            memcpy(maximum, mMaximum[i], sizeof(float) * mCount);
+        }
+        mMinimum[i] = minimum;
+        mMaximum[i] = maximum;
+    }
+    if (mCount)
+        memcpy(proxies, mProxies, sizeof(int) * mCount);
+
+    if (mStorage)
+        ALIGNED_FREE(mStorage);
+    delete [] mProxies;
+
+    mStorage = storage;
+    mProxies = proxies;
+    mCapacity = capacity;
+}
+
+GAMEMATH_INLINE void SweepAndPrune::store(int position, const Box3d &box)
+{
+    for (int i = 0; i < 3; ++i) {
+        mMinimum[i][position] = box.minimum().data()[i];
+        mMaximum[i][position] = box.maximum().data()[i];
+    }
+}
+
+GAMEMATH_INLINE void SweepAndPrune::move(int from, int to)
+{
+    for (int i = 0; i < 3; ++i) {
+        mMinimum[i][to] = mMinimum[i][from];
+        mMaximum[i][to] = mMaximum[i][from];
+    }
+    mProxies[to] = mProxies[from];
+    mPositions[mProxies[to]] = to;
+}
+
+GAMEMATH_INLINE int SweepAndPrune::createProxy(const Box3d &box)
+{
+    if (mCount == mCapacity)
+        reserve(mCapacity ? 2 * mCapacity : 64);
+
+    // New boxes are appended and moved into place by the next update
+    const int position = mCount++;
+
+    int proxy;
+    if (!mFreeHandles.empty()) {
+        proxy = mFreeHandles.back();
+        mFreeHandles.pop_back();
+        mPositions[proxy] = position;
+    } else {
+        proxy = (int)mPositions.size();
+        mPositions.push_back(position);
+    }
+
+    store(position, box);
+    mProxies[position] = proxy;
+    ++mInserted;
+
+    return proxy;
+}
+
+GAMEMATH_INLINE void SweepAndPrune::destroyProxy(int proxy)
+{
+    // Close the gap, which keeps the remaining boxes sorted
+    for (int i = mPositions[proxy] + 1; i < mCount; ++i)
+        move(i, i - 1);
+    --mCount;
+
+    mPositions[proxy] = NullProxy;
+    mDestroyedHandles.push_back(proxy);
+}
+
+GAMEMATH_INLINE void SweepAndPrune::moveProxy(int proxy, const Box3d &box)
+{
+    store(mPositions[proxy], box);
+}
+
+GAMEMATH_INLINE Box3d SweepAndPrune::box(int proxy) const
+{
+    const int position = mPositions[proxy];
+    return Box3d(Vector4(mMinimum[0][position], mMinimum[1][position], mMinimum[2][position], 0),
+        Vector4(mMaximum[0][position], mMaximum[1][position], mMaximum[2][position], 0));
+}
+
+GAMEMATH_INLINE int SweepAndPrune::axis() const
+{
+    return mAxis;
+}
+
+GAMEMATH_INLINE int SweepAndPrune::proxyCount() const
+{
+    return mCount;
+}
+
+GAMEMATH_INLINE const std::vector<SweepAndPrunePair> &SweepAndPrune::pairs() const
+{
+    return mPairs;
+}
+
+GAMEMATH_INLINE const std::vector<SweepAndPrunePair> &SweepAndPrune::addedPairs() const
+{
+    return mAddedPairs;
+}
+
+GAMEMATH_INLINE const std::vector<SweepAndPrunePair> &SweepAndPrune::removedPairs() const
+{
+    return mRemovedPairs;
+}
+
+GAMEMATH_INLINE void SweepAndPrune::insertionSort()
+{
+    const float *keys = mMinimum[mAxis];
+
+    for (int i = 1; i < mCount; ++i) {
+        const float key = keys[i];
+        if (!(key < keys[i - 1]))
+            continue;
+
+        float minimum[3], maximum[3];
+        for (int k = 0; k < 3; ++k) {
+            minimum[k] = mMinimum[k][i];
+            maximum[k] = mMaximum[k][i];
+        }
+        const int proxy = mProxies[i];
+
+        int j = i;
+        do {
+            move(j - 1, j);
+            --j;
+        } while (j > 0 && key < keys[j - 1]);
+
+        for (int k = 0; k < 3; ++k) {
+            mMinimum[k][j] = minimum[k];
+            mMaximum[k][j] = maximum[k];
+        }
+        mProxies[j] = proxy;
+        mPositions[proxy] = j;
+    }
+}
+
+class SweepAndPruneOrder {
+public:
+    SweepAndPruneOrder(const float *keys) : mKeys(keys) {}
+    bool operator()(int a, int b) const { return mKeys[a] < mKeys[b]; }
+private:
+    const float *mKeys;
+};
+
+GAMEMATH_INLINE void SweepAndPrune::fullSort()
+{
+    std::vector<int> order(mCount);
+    for (int i = 0; i < mCount; ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), SweepAndPruneOrder(mMinimum[mAxis]));
+
+    std::vector<float> values(mCount);
+    for (int k = 0; k < 6; ++k) {
+        float *array = (k < 3) ? mMinimum[k] : mMaximum[k - 3];
+        for (int i = 0; i < mCount; ++i)
+            values[i] = array[order[i]];
+        std::copy(values.begin(), values.end(), array);
+    }
+
+    std::vector<int> proxies(mProxies, mProxies + mCount);
+    for (int i = 0; i < mCount; ++i) {
+        mProxies[i] = proxies[order[i]];
+        mPositions[mProxies[i]] = i;
+    }
+}
+
+GAMEMATH_INLINE void SweepAndPrune::sweep()
+{
+    const int u = (mAxis + 1) % 3;
+    const int v = (mAxis + 2) % 3;
+
+    const float *minS = mMinimum[mAxis];
+    const float *maxS = mMaximum[mAxis];
+    const float *minU = mMinimum[u];
+    const float *maxU = mMaximum[u];
+    const float *minV = mMinimum[v];
+    const float *maxV = mMaximum[v];
+
+    for (int i = 0; i < mCount; ++i) {
+        const int proxy = mProxies[i];
+        int j = i + 1;
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+        const __m128 boxMaxS = _mm_set1_ps(maxS[i]);
+        const __m128 boxMinU = _mm_set1_ps(minU[i]);
+        const __m128 boxMaxU = _mm_set1_ps(maxU[i]);
+        const __m128 boxMinV = _mm_set1_ps(minV[i]);
+        const __m128 boxMaxV = _mm_set1_ps(maxV[i]);
+
+        for (; j < mCount; j += 4) {
+            const __m128 candidateMinS = _mm_loadu_ps(minS + j);
+
+            // The boxes are sorted, so if this one starts past the end of the box, so do all following ones
+            const __m128 overlapS = _mm_cmple_ps(candidateMinS, boxMaxS);
+            int mask = _mm_movemask_ps(overlapS);
+            if (!(mask & 1))
+                break;
+
+            __m128 overlap = _mm_and_ps(overlapS, _mm_cmple_ps(_mm_loadu_ps(minU + j), boxMaxU));
+            overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_loadu_ps(maxU + j), boxMinU));
+            overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_loadu_ps(minV + j), boxMaxV));
+            overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_loadu_ps(maxV + j), boxMinV));
+            mask = _mm_movemask_ps(overlap);
+
+            // Mask out the elements past the end of the arrays
+            if (j + 4 > mCount)
+                mask &= (1 << (mCount - j)) - 1;
+
+            while (mask) {
+                const int lane = (mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : 3;
+                mask &= mask - 1;
+
+                const int other = mProxies[j + lane];
+                SweepAndPrunePair pair = { std::min(proxy, other), std::max(proxy, other) };
+                mPairs.push_back(pair);
+            }
+        }
+#else
+        for (; j < mCount && minS[j] <= maxS[i]; ++j) {
+            if (minU[j] <= maxU[i] && maxU[j] >= minU[i] && minV[j] <= maxV[i] && maxV[j] >= minV[i]) {
+                const int other = mProxies[j];
+                SweepAndPrunePair pair = { std::min(proxy, other), std::max(proxy, other) };
+                mPairs.push_back(pair);
+            }
+        }
+#endif
+    }
+}
+
+GAMEMATH_INLINE void SweepAndPrune::update()
+{
+    // Insertion sort degrades to quadratic time if many boxes were appended since the last update
+    if (mInserted > mCount / 8)
+        fullSort();
+    else
+        insertionSort();
+    mInserted = 0;
+
+    mPreviousPairs.swap(mPairs);
+    mPairs.clear();
+    sweep();
+    std::sort(mPairs.begin(), mPairs.end());
+
+    mAddedPairs.clear();
+    mRemovedPairs.clear();
+    std::set_difference(mPairs.begin(), mPairs.end(), mPreviousPairs.begin(), mPreviousPairs.end(),
+        std::back_inserter(mAddedPairs));
+    std::set_difference(mPreviousPairs.begin(), mPreviousPairs.end(), mPairs.begin(), mPairs.end(),
+        std::back_inserter(mRemovedPairs));
+
+    // Handles of destroyed proxies may be reused now that their pairs have been reported as removed
+    mFreeHandles.insert(mFreeHandles.end(), mDestroyedHandles.begin(), mDestroyedHandles.end());
+    mDestroyedHandles.clear();
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // SWEEP_AND_PRUNE_H
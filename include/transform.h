@@ -0,0 +1,182 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstddef>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "quaternion.h"
+#include "matrix4.h"
+#include "matrix3x4.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A transformation that scales, rotates and translates, in that order, stored as its three parts
+  instead of a matrix. This is what Matrix4::transformation builds a matrix from.
+
+  Transforms can be composed, inverted and applied to vectors without building a matrix, which is
+  cheaper when walking a hierarchy. Conversion to matrices should only happen at the end, for example
+  with toMatrices for a whole array.
+
+  Composition and inversion are only exact if the scale is uniform. With a non-uniform scale, the
+  product of two transformations can contain a shear, which a Transform can't represent. The scale
+  is then applied along the axes of the combined rotation instead, which is what most engines do.
+
+  The w components of the translation and the scale are ignored. Like DualQuaternion, this doesn't
+  derive from AlignedAllocation, which would pad it from 48 to 64 bytes.
+  */
+GAMEMATH_ALIGNEDTYPE_PRE class GAMEMATH_ALIGNEDTYPE_MID Transform {
+friend GAMEMATH_INLINE Transform operator *(const Transform &a, const Transform &b);
+public:
+    GAMEMATH_INLINE void* operator new(size_t size)
+    {
+        return AlignedAllocation::operator new(size);
+    }
+
+    GAMEMATH_INLINE void operator delete(void *ptr)
+    {
+        AlignedAllocation::operator delete(ptr);
+    }
+
+    GAMEMATH_INLINE void* operator new[](size_t size)
+    {
+        return AlignedAllocation::operator new[](size);
+    }
+
+    GAMEMATH_INLINE void operator delete[](void *ptr)
+    {
+        AlignedAllocation::operator delete[](ptr);
+    }
+
+    GAMEMATH_INLINE void* operator new(size_t, void *ptr) {
+        return ptr;
+    }
+
+    /**
+      Creates an uninitialized transform.
+      */
+    Transform();
+
+    Transform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale);
+
+    /**
+      Returns the transform that doesn't change anything.
+      */
+    static Transform identity();
+
+    const Vector4 &translation() const;
+    const Quaternion &rotation() const;
+    const Vector4 &scale() const;
+
+    void setTranslation(const Vector4 &translation);
+    void setRotation(const Quaternion &rotation);
+    void setScale(const Vector4 &scale);
+
+    /**
+      Returns the transform that undoes this one. The rotation has to be normalized.
+      */
+    Transform inverted() const;
+
+    /**
+      Scales, rotates and translates the x, y and z components of a position. The w component of the
+      result is one.
+      */
+    Vector4 mapPosition(const Vector4 &position) const;
+
+    /**
+      Scales and rotates the x, y and z components of a direction, without the translation. The w component
+      of the result is zero. Like Matrix4::mapNormal, this doesn't account for non-uniform scaling.
+      */
+    Vector4 mapVector(const Vector4 &vector) const;
+
+    /**
+      Returns the same matrix as Matrix4::transformation(scale(), rotation(), translation()).
+      */
+    Matrix4 toMatrix4() const;
+
+    /**
+      Returns the same matrix as toMatrix4, without the fourth row.
+      */
+    Matrix3x4 toMatrix3x4() const;
+
+    /**
+      Converts an array of transforms to matrices. With SSE, four transforms are converted at once,
+      like the array version of Matrix4::transformation.
+      */
+    static void toMatrices(const Transform *transforms, size_t count, Matrix4 *results);
+
+    /**
+      Converts an array of transforms to 3x4 matrices.
+      */
+    static void toMatrices(const Transform *transforms, size_t count, Matrix3x4 *results);
+
+private:
+    Vector4 mTranslation;
+    Quaternion mRotation;
+    Vector4 mScale;
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+GAMEMATH_INLINE Transform::Transform()
+{
+}
+
+GAMEMATH_INLINE Transform::Transform(const Vector4 &translation, const Quaternion &rotation, const Vector4 &scale)
+    : mTranslation(translation), mRotation(rotation), mScale(scale)
+{
+}
+
+GAMEMATH_INLINE Transform Transform::identity()
+{
+    return Transform(Vector4(0, 0, 0, 0), Quaternion(0, 0, 0, 1), Vector4(1, 1, 1, 0));
+}
+
+GAMEMATH_INLINE const Vector4 &Transform::translation() const
+{
+    return mTranslation;
+}
+
+GAMEMATH_INLINE const Quaternion &Transform::rotation() const
+{
+    return mRotation;
+}
+
+GAMEMATH_INLINE const Vector4 &Transform::scale() const
+{
+    return mScale;
+}
+
+GAMEMATH_INLINE void Transform::setTranslation(const Vector4 &translation)
+{
+    mTranslation = translation;
+}
+
+GAMEMATH_INLINE void Transform::setRotation(const Quaternion &rotation)
+{
+    mRotation = rotation;
+}
+
+GAMEMATH_INLINE void Transform::setScale(const Vector4 &scale)
+{
+    mScale = scale;
+}
+
+GAMEMATH_INLINE Matrix4 Transform::toMatrix4() const
+{
+    return Matrix4::transformation(mScale, mRotation, mTranslation);
+}
+
+GAMEMATH_INLINE Matrix3x4 Transform::toMatrix3x4() const
+{
+    return Matrix3x4::transformation(mScale, mRotation, mTranslation);
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "transform_sse.h"
+#else
+#include "transform_sisd.h"
+#endif
+
+#endif // TRANSFORM_H
@@ -0,0 +1,57 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "transform.h"
+
+#if !defined(TRANSFORM_H)
+#error "Do not include this file directly, only include transform.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE Transform operator *(const Transform &a, const Transform &b)
+{
+    const Vector4 &scale = a.mScale;
+    const Vector4 scaledTranslation(scale.x() * b.mTranslation.x(), scale.y() * b.mTranslation.y(),
+                                    scale.z() * b.mTranslation.z(), 0);
+    const Vector4 rotated = a.mRotation.rotate(scaledTranslation);
+    return Transform(Vector4(rotated.x() + a.mTranslation.x(), rotated.y() + a.mTranslation.y(),
+                             rotated.z() + a.mTranslation.z(), a.mTranslation.w()),
+                     a.mRotation * b.mRotation,
+                     Vector4(scale.x() * b.mScale.x(), scale.y() * b.mScale.y(), scale.z() * b.mScale.z(),
+                             scale.w() * b.mScale.w()));
+}
+
+GAMEMATH_INLINE Transform Transform::inverted() const
+{
+    const Vector4 scale(1 / mScale.x(), 1 / mScale.y(), 1 / mScale.z(), 1);
+    const Quaternion rotation = mRotation.conjugated();
+    const Vector4 rotated = rotation.rotate(Vector4(mTranslation.x(), mTranslation.y(), mTranslation.z(), 0));
+    return Transform(Vector4(-scale.x() * rotated.x(), -scale.y() * rotated.y(), -scale.z() * rotated.z(), 0),
+                     rotation, scale);
+}
+
+GAMEMATH_INLINE Vector4 Transform::mapPosition(const Vector4 &position) const
+{
+    const Vector4 rotated = mapVector(position);
+    return Vector4(rotated.x() + mTranslation.x(), rotated.y() + mTranslation.y(), rotated.z() + mTranslation.z(), 1);
+}
+
+GAMEMATH_INLINE Vector4 Transform::mapVector(const Vector4 &vector) const
+{
+    return mRotation.rotate(Vector4(vector.x() * mScale.x(), vector.y() * mScale.y(), vector.z() * mScale.z(), 0));
+}
+
+GAMEMATH_INLINE void Transform::toMatrices(const Transform *transforms, size_t count, Matrix4 *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = transforms[i].toMatrix4();
+}
+
+GAMEMATH_INLINE void Transform::toMatrices(const Transform *transforms, size_t count, Matrix3x4 *results)
+{
+    for (size_t i = 0; i < count; ++i)
+        results[i] = transforms[i].toMatrix3x4();
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,124 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "transform.h"
+
+#if !defined(TRANSFORM_H)
+#error "Do not include this file directly, only include transform.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE Transform operator *(const Transform &a, const Transform &b)
+{
+    const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+    const __m128 scaledTranslation = _mm_and_ps(_mm_mul_ps(a.mScale, b.mTranslation), maskXYZ);
+    const __m128 translation = _mm_add_ps(a.mRotation.rotate(scaledTranslation), a.mTranslation);
+    return Transform(translation, a.mRotation * b.mRotation, _mm_mul_ps(a.mScale, b.mScale));
+}
+
+GAMEMATH_INLINE Transform Transform::inverted() const
+{
+    const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+    const __m128 one = _mm_load_ps(IdentityCol4);
+
+    // Give the scale a w of one, so its reciprocal stays finite
+    const __m128 scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(_mm_and_ps(mScale, maskXYZ), one));
+    const Quaternion rotation = mRotation.conjugated();
+    const __m128 rotated = rotation.rotate(_mm_and_ps(mTranslation, maskXYZ));
+    const __m128 translation = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(scale, rotated));
+    return Transform(translation, rotation, scale);
+}
+
+GAMEMATH_INLINE Vector4 Transform::mapPosition(const Vector4 &position) const
+{
+    const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+
+    const __m128 scaled = _mm_and_ps(_mm_mul_ps(position, mScale), maskXYZ);
+    const __m128 result = _mm_add_ps(mRotation.rotate(scaled), _mm_and_ps(mTranslation, maskXYZ));
+    return _mm_or_ps(result, _mm_load_ps(IdentityCol4));
+}
+
+GAMEMATH_INLINE Vector4 Transform::mapVector(const Vector4 &vector) const
+{
+    const __m128 scaled = _mm_and_ps(_mm_mul_ps(vector, mScale), _mm_load_ps((const float*)CoordinateMaskXYZ));
+    return mRotation.rotate(scaled);
+}
+
+/**
+  Computes the upper 3x3 elements of the matrices of four transforms, see _matrix4_transformation4.
+  */
+GAMEMATH_INLINE void _transform_elements4(const Transform *transforms, __m128 elements[3][3])
+{
+    __m128 x = _mm_load_ps(transforms[0].rotation().data());
+    __m128 y = _mm_load_ps(transforms[1].rotation().data());
+    __m128 z = _mm_load_ps(transforms[2].rotation().data());
+    __m128 w = _mm_load_ps(transforms[3].rotation().data());
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    __m128 scaleX = transforms[0].scale();
+    __m128 scaleY = transforms[1].scale();
+    __m128 scaleZ = transforms[2].scale();
+    __m128 scaleW = transforms[3].scale();
+    _MM_TRANSPOSE4_PS(scaleX, scaleY, scaleZ, scaleW);
+
+    _matrix4_transformation4(x, y, z, w, scaleX, scaleY, scaleZ, elements);
+}
+
+GAMEMATH_INLINE void Transform::toMatrices(const Transform *transforms, size_t count, Matrix4 *results)
+{
+    const __m128 maskXYZ = _mm_load_ps((const float*)CoordinateMaskXYZ);
+    const __m128 identityCol4 = _mm_load_ps(IdentityCol4);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 elements[3][3];
+        _transform_elements4(transforms + i, elements);
+        _matrix4_store_column4(elements[0][0], elements[0][1], elements[0][2], 0, results + i);
+        _matrix4_store_column4(elements[1][0], elements[1][1], elements[1][2], 1, results + i);
+        _matrix4_store_column4(elements[2][0], elements[2][1], elements[2][2], 2, results + i);
+
+        for (int j = 0; j < 4; ++j) {
+            const __m128 translation = _mm_or_ps(_mm_and_ps(transforms[i + j].mTranslation, maskXYZ), identityCol4);
+            _mm_store_ps(results[i + j].data() + 12, translation);
+        }
+    }
+
+    for (; i < count; ++i)
+        results[i] = transforms[i].toMatrix4();
+}
+
+GAMEMATH_INLINE void Transform::toMatrices(const Transform *transforms, size_t count, Matrix3x4 *results)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 elements[3][3];
+        _transform_elements4(transforms + i, elements);
+
+        __m128 translationX = transforms[i].mTranslation;
+        __m128 translationY = transforms[i + 1].mTranslation;
+        __m128 translationZ = transforms[i + 2].mTranslation;
+        __m128 translationW = transforms[i + 3].mTranslation;
+        _MM_TRANSPOSE4_PS(translationX, translationY, translationZ, translationW);
+        const __m128 translations[3] = { translationX, translationY, translationZ };
+
+        // The elements of a row and the translation along its axis transpose into that row of all four matrices
+        for (int row = 0; row < 3; ++row) {
+            __m128 row0 = elements[0][row];
+            __m128 row1 = elements[1][row];
+            __m128 row2 = elements[2][row];
+            __m128 row3 = translations[row];
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_store_ps(results[i].data() + 4 * row, row0);
+            _mm_store_ps(results[i + 1].data() + 4 * row, row1);
+            _mm_store_ps(results[i + 2].data() + 4 * row, row2);
+            _mm_store_ps(results[i + 3].data() + 4 * row, row3);
+        }
+    }
+
+    for (; i < count; ++i)
+        results[i] = transforms[i].toMatrix3x4();
+}
+
+GAMEMATH_NAMESPACE_END
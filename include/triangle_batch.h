@@ -0,0 +1,194 @@
+#ifndef TRIANGLE_BATCH_H
+#define TRIANGLE_BATCH_H
+
+#include <limits>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "ray3d.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Four triangles in the form used by the Moller-Trumbore test, stored as structure of arrays.
+  Each triangle is stored as its first vertex and the two edges leaving it, so the edges don't
+  have to be recomputed for every ray.
+  */
+GAMEMATH_ALIGNEDTYPE_PRE struct GAMEMATH_ALIGNEDTYPE_MID TriangleBlock {
+    float vertex[3][4];
+    float edge1[3][4];
+    float edge2[3][4];
+
+    /**
+      The index of each triangle in the index buffer the block was built from.
+      Unused slots contain degenerate triangles, which are never hit.
+      */
+    unsigned int triangle[4];
+} GAMEMATH_ALIGNEDTYPE_POST;
+
+/**
+  Intersects a ray with the given triangle blocks and updates result if a hit closer than
+  result.distance is found. Both sides of the triangles are hit. Initialize result.intersects
+  to false and result.distance to the maximum distance before the first call.
+  */
+GAMEMATH_INLINE void intersectTriangleBlocks(const Ray3d &ray, const TriangleBlock *blocks, unsigned int count, IntersectionResult &result);
+
+/**
+  Stores triangles of an indexed mesh in blocks of four for fast ray intersection tests.
+  This is meant for exact picking against the triangles of a mesh after a box test has passed.
+  */
+class TriangleBatch {
+public:
+    TriangleBatch();
+    ~TriangleBatch();
+
+    /**
+      Builds the batch from triangleCount triangles, given by three indices each into positions.
+      This is the format of the 16-bit index buffers in the Faces chunk of models.
+      */
+    void build(const Vector4 *positions, const unsigned short *indices, unsigned int triangleCount);
+
+    void build(const Vector4 *positions, const unsigned int *indices, unsigned int triangleCount);
+
+    void clear();
+
+    unsigned int triangleCount() const;
+    unsigned int blockCount() const;
+    const TriangleBlock *blocks() const;
+
+    /**
+      Finds the closest triangle hit by the given ray within maximumDistance.
+      The triangle index of the result refers to the index buffer passed to build.
+      */
+    IntersectionResult intersect(const Ray3d &ray, float maximumDistance = std::numeric_limits<float>::infinity()) const;
+
+private:
+    TriangleBatch(const TriangleBatch&);
+    TriangleBatch &operator =(const TriangleBatch&);
+
+    template<typename Index>
+    void buildFromIndices(const Vector4 *positions, const Index *indices, unsigned int triangleCount);
+
+    TriangleBlock *mBlocks;
+    unsigned int mBlockCount;
+    unsigned int mTriangleCount;
+};
+
+/**
+  Stores a triangle in a slot of a block.
+  */
+GAMEMATH_INLINE void _store_triangle(TriangleBlock &block, int slot, const Vector4 &a, const Vector4 &b,
+                                     const Vector4 &c, unsigned int triangle)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        block.vertex[axis][slot] = a.data()[axis];
+        block.edge1[axis][slot] = b.data()[axis] - a.data()[axis];
+        block.edge2[axis][slot] = c.data()[axis] - a.data()[axis];
+    }
+    block.triangle[slot] = triangle;
+}
+
+/**
+  Fills a slot of a block with a degenerate triangle, which has a determinant of zero and is never hit.
+  */
+GAMEMATH_INLINE void _store_degenerate_triangle(TriangleBlock &block, int slot)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        block.vertex[axis][slot] = 0;
+        block.edge1[axis][slot] = 0;
+        block.edge2[axis][slot] = 0;
+    }
+    block.triangle[slot] = 0;
+}
+
+GAMEMATH_INLINE TriangleBatch::TriangleBatch()
+    : mBlocks(0), mBlockCount(0), mTriangleCount(0)
+{
+}
+
+GAMEMATH_INLINE TriangleBatch::~TriangleBatch()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void TriangleBatch::clear()
+{
+    if (mBlocks)
+        ALIGNED_FREE(mBlocks);
+    mBlocks = 0;
+    mBlockCount = 0;
+    mTriangleCount = 0;
+}
+
+template<typename Index>
+GAMEMATH_INLINE void TriangleBatch::buildFromIndices(const Vector4 *positions, const Index *indices, unsigned int triangleCount)
+{
+    clear();
+
+    if (!triangleCount)
+        return;
+
+    const unsigned int blockCount = (triangleCount + 3) / 4;
+    mBlocks = static_cast<TriangleBlock*>(ALIGNED_MALLOC(sizeof(TriangleBlock) * blockCount));
+    if (!mBlocks)
+        throw std::bad_alloc();
+    mBlockCount = blockCount;
+    mTriangleCount = triangleCount;
+
+    for (unsigned int i = 0; i < blockCount * 4; ++i) {
+        if (i < triangleCount)
+            _store_triangle(mBlocks[i / 4], i % 4, positions[indices[i * 3]], positions[indices[i * 3 + 1]],
+                positions[indices[i * 3 + 2]], i);
+        else
+            _store_degenerate_triangle(mBlocks[i / 4], i % 4);
+    }
+}
+
+GAMEMATH_INLINE void TriangleBatch::build(const Vector4 *positions, const unsigned short *indices, unsigned int triangleCount)
+{
+    buildFromIndices(positions, indices, triangleCount);
+}
+
+GAMEMATH_INLINE void TriangleBatch::build(const Vector4 *positions, const unsigned int *indices, unsigned int triangleCount)
+{
+    buildFromIndices(positions, indices, triangleCount);
+}
+
+GAMEMATH_INLINE unsigned int TriangleBatch::triangleCount() const
+{
+    return mTriangleCount;
+}
+
+GAMEMATH_INLINE unsigned int TriangleBatch::blockCount() const
+{
+    return mBlockCount;
+}
+
+GAMEMATH_INLINE const TriangleBlock *TriangleBatch::blocks() const
+{
+    return mBlocks;
+}
+
+GAMEMATH_INLINE IntersectionResult TriangleBatch::intersect(const Ray3d &ray, float maximumDistance) const
+{
+    IntersectionResult result;
+    result.intersects = false;
+    result.distance = maximumDistance;
+    result.exitDistance = maximumDistance;
+    result.u = 0;
+    result.v = 0;
+    result.triangle = 0;
+
+    intersectTriangleBlocks(ray, mBlocks, mBlockCount, result);
+    return result;
+}
+
+GAMEMATH_NAMESPACE_END
+
+#if !defined(GAMEMATH_NO_INTRINSICS)
+#include "triangle_batch_sse.h"
+#else
+#include "triangle_batch_sisd.h"
+#endif
+
+#endif // TRIANGLE_BATCH_H
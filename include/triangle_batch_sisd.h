@@ -0,0 +1,67 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "triangle_batch.h"
+
+#if !defined(TRIANGLE_BATCH_H)
+#error "Do not include this file directly, only include triangle_batch.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+GAMEMATH_INLINE void intersectTriangleBlocks(const Ray3d &ray, const TriangleBlock *blocks, unsigned int count, IntersectionResult &result)
+{
+    const float *origin = ray.origin().data();
+    const float *direction = ray.direction().data();
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const TriangleBlock &block = blocks[i];
+
+        for (int slot = 0; slot < 4; ++slot) {
+            float edge1[3], edge2[3], s[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                edge1[axis] = block.edge1[axis][slot];
+                edge2[axis] = block.edge2[axis][slot];
+                s[axis] = origin[axis] - block.vertex[axis][slot];
+            }
+
+            const float p[3] = {
+                direction[1] * edge2[2] - direction[2] * edge2[1],
+                direction[2] * edge2[0] - direction[0] * edge2[2],
+                direction[0] * edge2[1] - direction[1] * edge2[0]
+            };
+
+            const float determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+            if (determinant == 0)
+                continue;
+            const float invDeterminant = 1 / determinant;
+
+            const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDeterminant;
+            if (u < 0 || u > 1)
+                continue;
+
+            const float q[3] = {
+                s[1] * edge1[2] - s[2] * edge1[1],
+                s[2] * edge1[0] - s[0] * edge1[2],
+                s[0] * edge1[1] - s[1] * edge1[0]
+            };
+
+            const float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * invDeterminant;
+            if (v < 0 || u + v > 1)
+                continue;
+
+            const float t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * invDeterminant;
+            if (t < 0 || !(t < result.distance))
+                continue;
+
+            result.intersects = true;
+            result.distance = t;
+            result.exitDistance = t;
+            result.u = u;
+            result.v = v;
+            result.triangle = block.triangle[slot];
+        }
+    }
+}
+
+GAMEMATH_NAMESPACE_END
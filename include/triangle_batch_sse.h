@@ -0,0 +1,103 @@
+
+// This is for IDEs only
+#include "gamemath_internal.h"
+#include "triangle_batch.h"
+
+#if !defined(TRIANGLE_BATCH_H)
+#error "Do not include this file directly, only include triangle_batch.h"
+#endif
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  Returns the index of the lowest set bit of a non-zero four bit mask.
+  */
+GAMEMATH_INLINE int _lowest_lane(int mask)
+{
+    return (mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : 3;
+}
+
+GAMEMATH_INLINE void intersectTriangleBlocks(const Ray3d &ray, const TriangleBlock *blocks, unsigned int count, IntersectionResult &result)
+{
+    const __m128 origin = ray.origin();
+    const __m128 direction = ray.direction();
+
+    const __m128 originX = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 originY = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 originZ = _mm_shuffle_ps(origin, origin, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 directionX = _mm_shuffle_ps(direction, direction, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 directionY = _mm_shuffle_ps(direction, direction, _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 directionZ = _mm_shuffle_ps(direction, direction, _MM_SHUFFLE(2, 2, 2, 2));
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 closest = _mm_set1_ps(result.distance);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const TriangleBlock &block = blocks[i];
+
+        const __m128 edge1X = _mm_load_ps(block.edge1[0]);
+        const __m128 edge1Y = _mm_load_ps(block.edge1[1]);
+        const __m128 edge1Z = _mm_load_ps(block.edge1[2]);
+        const __m128 edge2X = _mm_load_ps(block.edge2[0]);
+        const __m128 edge2Y = _mm_load_ps(block.edge2[1]);
+        const __m128 edge2Z = _mm_load_ps(block.edge2[2]);
+
+        // p = direction x edge2
+        const __m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+        const __m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+        const __m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+
+        const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+        const __m128 invDeterminant = _refined_reciprocal(determinant);
+
+        // s = origin - vertex
+        const __m128 sX = _mm_sub_ps(originX, _mm_load_ps(block.vertex[0]));
+        const __m128 sY = _mm_sub_ps(originY, _mm_load_ps(block.vertex[1]));
+        const __m128 sZ = _mm_sub_ps(originZ, _mm_load_ps(block.vertex[2]));
+
+        const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), invDeterminant);
+
+        // q = s x edge1
+        const __m128 qX = _mm_sub_ps(_mm_mul_ps(sY, edge1Z), _mm_mul_ps(sZ, edge1Y));
+        const __m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, edge1X), _mm_mul_ps(sX, edge1Z));
+        const __m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, edge1Y), _mm_mul_ps(sY, edge1X));
+
+        const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), invDeterminant);
+        const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), invDeterminant);
+
+        // Comparisons involving the NaNs produced by degenerate triangles are false
+        __m128 hit = _mm_cmpneq_ps(determinant, zero);
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(t, zero));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(t, closest));
+
+        if (!_mm_movemask_ps(hit))
+            continue;
+
+        // Find the closest hit within the block and broadcast it
+        __m128 hitDistance = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, _mm_load_ps(PositiveInfinity)));
+        closest = _mm_min_ps(hitDistance, _mm_shuffle_ps(hitDistance, hitDistance, _MM_SHUFFLE(2, 3, 0, 1)));
+        closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        const int lane = _lowest_lane(_mm_movemask_ps(_mm_cmpeq_ps(hitDistance, closest)));
+
+        GAMEMATH_ALIGN float distances[4];
+        GAMEMATH_ALIGN float us[4];
+        GAMEMATH_ALIGN float vs[4];
+        _mm_store_ps(distances, t);
+        _mm_store_ps(us, u);
+        _mm_store_ps(vs, v);
+
+        result.intersects = true;
+        result.distance = distances[lane];
+        result.exitDistance = distances[lane];
+        result.u = us[lane];
+        result.v = vs[lane];
+        result.triangle = block.triangle[lane];
+    }
+}
+
+GAMEMATH_NAMESPACE_END
@@ -0,0 +1,583 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "gamemath_internal.h"
+#include "vector4.h"
+#include "box3d.h"
+#include "ray3d.h"
+#include "bvh.h"
+#include "triangle_batch.h"
+
+GAMEMATH_NAMESPACE_BEGIN
+
+/**
+  A bounding volume hierarchy over the triangles of a single mesh, such as a face group of a model.
+  It uses the same node layout as Bvh, but its leaves reference blocks of four triangles that are
+  tested with intersectTriangleBlocks instead of individual boxes. For leaves, BvhNode::leftFirst is
+  the index of the first block and BvhNode::count is the number of blocks.
+
+  The hierarchy can be written to memory with serialize and loaded with deserialize, so it can be
+  stored in a model file next to the geometry instead of being built when the model is loaded.
+  */
+class TriangleBvh {
+public:
+    /**
+      Nodes with at most this many triangles are not split any further if splitting doesn't pay off.
+      Leaves hold one or two blocks, unless the hierarchy exceeds MaxDepth.
+      */
+    static const unsigned int MaxLeafSize = 8;
+
+    static const unsigned int MaxDepth = 64;
+
+    static const unsigned int TraversalStackSize = 128;
+
+    static const int Bins = 16;
+
+    /**
+      Changes whenever the layout written by serialize changes. deserialize rejects other versions.
+      */
+    static const unsigned int SerializationVersion = 1;
+
+    TriangleBvh();
+    ~TriangleBvh();
+
+    /**
+      Builds the hierarchy over triangleCount triangles, given by three indices each into positions,
+      using the binned surface area heuristic.
+      */
+    void build(const Vector4 *positions, const unsigned short *indices, unsigned int triangleCount);
+
+    void build(const Vector4 *positions, const unsigned int *indices, unsigned int triangleCount);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    /**
+      Returns the bounds of all triangles in this hierarchy.
+      */
+    Box3d bounds() const;
+
+    const BvhNode *nodes() const;
+    unsigned int nodeCount() const;
+
+    const TriangleBlock *blocks() const;
+    unsigned int blockCount() const;
+
+    unsigned int triangleCount() const;
+
+    /**
+      Finds the closest triangle hit by the given ray within maximumDistance. Children are visited
+      front to back, and nodes behind the closest hit found so far are skipped.
+      The triangle index of the result refers to the index buffer passed to build.
+      */
+    IntersectionResult intersect(const Ray3d &ray, float maximumDistance = std::numeric_limits<float>::infinity()) const;
+
+    /**
+      Returns the number of bytes written by serialize. This is always a multiple of 16.
+      */
+    size_t serializedSize() const;
+
+    /**
+      Writes the hierarchy to data, which has to have room for serializedSize() bytes.
+      The data is written in the native layout of the nodes and blocks.
+      */
+    void serialize(void *data) const;
+
+    /**
+      Replaces this hierarchy with one written by serialize.
+
+      @return False if the data is truncated, has a different version or is inconsistent.
+      The hierarchy is empty in that case.
+      */
+    bool deserialize(const void *data, size_t size);
+
+private:
+    TriangleBvh(const TriangleBvh&);
+    TriangleBvh &operator =(const TriangleBvh&);
+
+    struct BuildTask {
+        unsigned int node;
+        unsigned int depth;
+    };
+
+    struct SerializedHeader {
+        unsigned int version;
+        unsigned int nodeCount;
+        unsigned int blockCount;
+        unsigned int triangleCount;
+    };
+
+    static unsigned int blocksFor(unsigned int triangles);
+
+    template<typename Index>
+    void buildFromIndices(const Vector4 *positions, const Index *indices, unsigned int triangleCount);
+
+    void subdivide(const BuildTask &task, const Box3d *boxes, const Vector4 *centers,
+                   std::vector<unsigned int> &order, std::vector<BuildTask> &tasks);
+
+    void allocate(unsigned int nodeCount, unsigned int blockCount);
+
+    BvhNode *mNodes;
+    unsigned int mNodeCount;
+    TriangleBlock *mBlocks;
+    unsigned int mBlockCount;
+    unsigned int mTriangleCount;
+};
+
+GAMEMATH_INLINE TriangleBvh::TriangleBvh()
+    : mNodes(0), mNodeCount(0), mBlocks(0), mBlockCount(0), mTriangleCount(0)
+{
+}
+
+GAMEMATH_INLINE TriangleBvh::~TriangleBvh()
+{
+    clear();
+}
+
+GAMEMATH_INLINE void TriangleBvh::clear()
+{
+    if (mNodes)
+        ALIGNED_FREE(mNodes);
+    if (mBlocks)
+        ALIGNED_FREE(mBlocks);
+    mNodes = 0;
+    mNodeCount = 0;
+    mBlocks = 0;
+    mBlockCount = 0;
+    mTriangleCount = 0;
+}
+
+GAMEMATH_INLINE void TriangleBvh::allocate(unsigned int nodeCount, unsigned int blockCount)
+{
+    clear();
+
+    mNodes = static_cast<BvhNode*>(ALIGNED_MALLOC(sizeof(BvhNode) * nodeCount));
+    if (!mNodes)
+        throw std::bad_alloc();
+    mBlocks = static_cast<TriangleBlock*>(ALIGNED_MALLOC(sizeof(TriangleBlock) * blockCount));
+    if (!mBlocks) {
+        clear();
+        throw std::bad_alloc();
+    }
+}
+
+GAMEMATH_INLINE bool TriangleBvh::isEmpty() const
+{
+    return mNodeCount == 0;
+}
+
+GAMEMATH_INLINE Box3d TriangleBvh::bounds() const
+{
+    if (!mNodeCount)
+        return Box3d();
+    return mNodes[0].bounds();
+}
+
+GAMEMATH_INLINE const BvhNode *TriangleBvh::nodes() const
+{
+    return mNodes;
+}
+
+GAMEMATH_INLINE unsigned int TriangleBvh::nodeCount() const
+{
+    return mNodeCount;
+}
+
+GAMEMATH_INLINE const TriangleBlock *TriangleBvh::blocks() const
+{
+    return mBlocks;
+}
+
+GAMEMATH_INLINE unsigned int TriangleBvh::blockCount() const
+{
+    return mBlockCount;
+}
+
+GAMEMATH_INLINE unsigned int TriangleBvh::triangleCount() const
+{
+    return mTriangleCount;
+}
+
+GAMEMATH_INLINE unsigned int TriangleBvh::blocksFor(unsigned int triangles)
+{
+    return (triangles + 3) / 4;
+}
+
+GAMEMATH_INLINE void TriangleBvh::build(const Vector4 *positions, const unsigned short *indices, unsigned int triangleCount)
+{
+    buildFromIndices(positions, indices, triangleCount);
+}
+
+GAMEMATH_INLINE void TriangleBvh::build(const Vector4 *positions, const unsigned int *indices, unsigned int triangleCount)
+{
+    buildFromIndices(positions, indices, triangleCount);
+}
+
+template<typename Index>
+GAMEMATH_INLINE void TriangleBvh::buildFromIndices(const Vector4 *positions, const Index *indices, unsigned int triangleCount)
+{
+    clear();
+
+    if (!triangleCount)
+        return;
+
+    Box3d *boxes = new Box3d[triangleCount];
+    Vector4 *centers = new Vector4[triangleCount];
+    std::vector<unsigned int> order(triangleCount);
+    for (unsigned int i = 0; i < triangleCount; ++i) {
+        const Vector4 &a = positions[indices[i * 3]];
+        boxes[i] = Box3d(a, a);
+        boxes[i].merge(positions[indices[i * 3 + 1]]);
+        boxes[i].merge(positions[indices[i * 3 + 2]]);
+        centers[i] = boxes[i].center();
+        order[i] = i;
+    }
+
+    // Leaves are packed into blocks afterwards, until then they reference ranges of order
+    mNodes = static_cast<BvhNode*>(ALIGNED_MALLOC(sizeof(BvhNode) * (2 * triangleCount - 1)));
+    if (!mNodes) {
+        delete [] boxes;
+        delete [] centers;
+        throw std::bad_alloc();
+    }
+    mNodeCount = 1;
+    mNodes[0].leftFirst = 0;
+    mNodes[0].count = triangleCount;
+
+    std::vector<BuildTask> tasks;
+    BuildTask root = { 0, 0 };
+    tasks.push_back(root);
+
+    while (!tasks.empty()) {
+        BuildTask task = tasks.back();
+        tasks.pop_back();
+        subdivide(task, boxes, centers, order, tasks);
+    }
+
+    unsigned int blockCount = 0;
+    for (unsigned int i = 0; i < mNodeCount; ++i) {
+        if (mNodes[i].isLeaf())
+            blockCount += blocksFor(mNodes[i].count);
+    }
+
+    mBlocks = static_cast<TriangleBlock*>(ALIGNED_MALLOC(sizeof(TriangleBlock) * blockCount));
+    if (!mBlocks) {
+        delete [] boxes;
+        delete [] centers;
+        clear();
+        throw std::bad_alloc();
+    }
+    mBlockCount = blockCount;
+    mTriangleCount = triangleCount;
+
+    unsigned int block = 0;
+    for (unsigned int i = 0; i < mNodeCount; ++i) {
+        BvhNode &node = mNodes[i];
+        if (!node.isLeaf())
+            continue;
+
+        const unsigned int first = node.leftFirst;
+        const unsigned int count = node.count;
+        const unsigned int blocks = blocksFor(count);
+
+        for (unsigned int j = 0; j < blocks * 4; ++j) {
+            if (j < count) {
+                const unsigned int triangle = order[first + j];
+                _store_triangle(mBlocks[block + j / 4], j % 4, positions[indices[triangle * 3]],
+                    positions[indices[triangle * 3 + 1]], positions[indices[triangle * 3 + 2]], triangle);
+            } else {
+                _store_degenerate_triangle(mBlocks[block + j / 4], j % 4);
+            }
+        }
+
+        node.leftFirst = block;
+        node.count = blocks;
+        block += blocks;
+    }
+
+    delete [] boxes;
+    delete [] centers;
+}
+
+GAMEMATH_INLINE void TriangleBvh::subdivide(const BuildTask &task, const Box3d *boxes, const Vector4 *centers,
+                                            std::vector<unsigned int> &order, std::vector<BuildTask> &tasks)
+{
+    BvhNode &node = mNodes[task.node];
+    const unsigned int first = node.leftFirst;
+    const unsigned int count = node.count;
+
+    Box3d bounds = boxes[order[first]];
+    Box3d centerBounds(centers[order[first]], centers[order[first]]);
+    for (unsigned int i = first + 1; i < first + count; ++i) {
+        bounds.merge(boxes[order[i]]);
+        centerBounds.merge(centers[order[i]]);
+    }
+    node.setBounds(bounds);
+
+    // A single block is tested as fast as a pair of child boxes
+    if (count <= 4 || task.depth + 1 >= MaxDepth)
+        return;
+
+    // Same binned surface area heuristic as Bvh, except that leaves cost one test per block of
+    // four triangles, and traversing a node costs as much as testing a block.
+    float bestCost = blocksFor(count) * bounds.surfaceArea();
+    int bestAxis = -1;
+    int bestSplit = 0;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        const float lower = centerBounds.minimum().data()[axis];
+        const float upper = centerBounds.maximum().data()[axis];
+
+        if (upper <= lower)
+            continue;
+
+        Box3d binBounds[Bins];
+        unsigned int binCounts[Bins];
+        for (int i = 0; i < Bins; ++i)
+            binCounts[i] = 0;
+
+        const float scale = Bins / (upper - lower);
+        for (unsigned int i = first; i < first + count; ++i) {
+            int bin = (int)((centers[order[i]].data()[axis] - lower) * scale);
+            if (bin > Bins - 1)
+                bin = Bins - 1;
+            if (binCounts[bin]++)
+                binBounds[bin].merge(boxes[order[i]]);
+            else
+                binBounds[bin] = boxes[order[i]];
+        }
+
+        float leftAreas[Bins - 1];
+        unsigned int leftCounts[Bins - 1];
+        Box3d accumulated;
+        unsigned int accumulatedCount = 0;
+        for (int i = 0; i < Bins - 1; ++i) {
+            if (binCounts[i]) {
+                if (accumulatedCount)
+                    accumulated.merge(binBounds[i]);
+                else
+                    accumulated = binBounds[i];
+            }
+            accumulatedCount += binCounts[i];
+            leftCounts[i] = accumulatedCount;
+            leftAreas[i] = accumulatedCount ? accumulated.surfaceArea() : 0;
+        }
+
+        accumulatedCount = 0;
+        for (int i = Bins - 1; i > 0; --i) {
+            if (binCounts[i]) {
+                if (accumulatedCount)
+                    accumulated.merge(binBounds[i]);
+                else
+                    accumulated = binBounds[i];
+            }
+            accumulatedCount += binCounts[i];
+
+            if (!accumulatedCount || !leftCounts[i - 1])
+                continue;
+
+            const float cost = bounds.surfaceArea() + blocksFor(leftCounts[i - 1]) * leftAreas[i - 1]
+                + blocksFor(accumulatedCount) * accumulated.surfaceArea();
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    unsigned int leftCount;
+
+    if (bestAxis != -1) {
+        const float lower = centerBounds.minimum().data()[bestAxis];
+        const float scale = Bins / (centerBounds.maximum().data()[bestAxis] - lower);
+
+        unsigned int *left = &order[first];
+        unsigned int *right = &order[first + count - 1];
+        while (left <= right) {
+            int bin = (int)((centers[*left].data()[bestAxis] - lower) * scale);
+            if (bin > Bins - 1)
+                bin = Bins - 1;
+            if (bin < bestSplit) {
+                ++left;
+            } else {
+                std::swap(*left, *right);
+                --right;
+            }
+        }
+        leftCount = (unsigned int)(left - &order[first]);
+    } else if (count > MaxLeafSize) {
+        // Keep the left child a multiple of four triangles, so no block is wasted on it
+        leftCount = (count / 2 + 3) & ~3u;
+    } else {
+        return;
+    }
+
+    const unsigned int leftChild = mNodeCount;
+    mNodeCount += 2;
+
+    mNodes[leftChild].leftFirst = first;
+    mNodes[leftChild].count = leftCount;
+    mNodes[leftChild + 1].leftFirst = first + leftCount;
+    mNodes[leftChild + 1].count = count - leftCount;
+
+    node.leftFirst = leftChild;
+    node.count = 0;
+
+    BuildTask leftTask = { leftChild, task.depth + 1 };
+    BuildTask rightTask = { leftChild + 1, task.depth + 1 };
+    tasks.push_back(rightTask);
+    tasks.push_back(leftTask);
+}
+
+GAMEMATH_INLINE IntersectionResult TriangleBvh::intersect(const Ray3d &ray, float maximumDistance) const
+{
+    IntersectionResult result;
+    result.intersects = false;
+    result.distance = maximumDistance;
+    result.exitDistance = maximumDistance;
+    result.u = 0;
+    result.v = 0;
+    result.triangle = 0;
+
+    if (!mNodeCount)
+        return result;
+
+    const IntersectionResult rootHit = ray.intersect(mNodes[0].bounds());
+    if (!rootHit.intersects || rootHit.distance > maximumDistance)
+        return result;
+
+    // The entry distance of each node is kept on the stack, so nodes can be skipped once
+    // a closer triangle has been found after they were pushed
+    unsigned int stack[TraversalStackSize];
+    float stackDistances[TraversalStackSize];
+    unsigned int stackSize = 0;
+    stack[stackSize] = 0;
+    stackDistances[stackSize++] = rootHit.distance;
+
+    while (stackSize) {
+        --stackSize;
+        if (stackDistances[stackSize] > result.distance)
+            continue;
+
+        const BvhNode &node = mNodes[stack[stackSize]];
+
+        if (node.isLeaf()) {
+            intersectTriangleBlocks(ray, mBlocks + node.leftFirst, node.count, result);
+            continue;
+        }
+
+        const IntersectionResult left = ray.intersect(mNodes[node.leftFirst].bounds());
+        const IntersectionResult right = ray.intersect(mNodes[node.leftFirst + 1].bounds());
+        const bool hitLeft = left.intersects && left.distance <= result.distance;
+        const bool hitRight = right.intersects && right.distance <= result.distance;
+
+        // Push the farther child first, so the closer one is visited next
+        if (hitLeft && hitRight && left.distance > right.distance) {
+            stack[stackSize] = node.leftFirst;
+            stackDistances[stackSize++] = left.distance;
+            stack[stackSize] = node.leftFirst + 1;
+            stackDistances[stackSize++] = right.distance;
+        } else {
+            if (hitRight) {
+                stack[stackSize] = node.leftFirst + 1;
+                stackDistances[stackSize++] = right.distance;
+            }
+            if (hitLeft) {
+                stack[stackSize] = node.leftFirst;
+                stackDistances[stackSize++] = left.distance;
+            }
+        }
+    }
+
+    return result;
+}
+
+GAMEMATH_INLINE size_t TriangleBvh::serializedSize() const
+{
+    return sizeof(SerializedHeader) + sizeof(BvhNode) * mNodeCount + sizeof(TriangleBlock) * mBlockCount;
+}
+
+GAMEMATH_INLINE void TriangleBvh::serialize(void *data) const
+{
+    SerializedHeader header;
+    header.version = SerializationVersion;
+    header.nodeCount = mNodeCount;
+    header.blockCount = mBlockCount;
+    header.triangleCount = mTriangleCount;
+
+    char *ptr = static_cast<char*>(data);
+    memcpy(ptr, &header, sizeof(header));
+    ptr += sizeof(header);
+    if (mNodeCount)
+        memcpy(ptr, mNodes, sizeof(BvhNode) * mNodeCount);
+    ptr += sizeof(BvhNode) * mNodeCount;
+    if (mBlockCount)
+        memcpy(ptr, mBlocks, sizeof(TriangleBlock) * mBlockCount);
+}
+
+GAMEMATH_INLINE bool TriangleBvh::deserialize(const void *data, size_t size)
+{
+    clear();
+
+    SerializedHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    const char *ptr = static_cast<const char*>(data);
+    memcpy(&header, ptr, sizeof(header));
+    ptr += sizeof(header);
+
+    if (header.version != SerializationVersion || !header.nodeCount != !header.blockCount)
+        return false;
+
+    if (size != sizeof(header) + sizeof(BvhNode) * (size_t)header.nodeCount + sizeof(TriangleBlock) * (size_t)header.blockCount)
+        return false;
+
+    if (!header.nodeCount)
+        return true;
+
+    allocate(header.nodeCount, header.blockCount);
+    memcpy(mNodes, ptr, sizeof(BvhNode) * header.nodeCount);
+    ptr += sizeof(BvhNode) * header.nodeCount;
+    memcpy(mBlocks, ptr, sizeof(TriangleBlock) * header.blockCount);
+
+    // Reject references outside of the arrays and hierarchies deeper than the traversal stack allows.
+    // Children are always stored after their parent, which also rules out cycles. A corrupt file can
+    // reference a node from several parents, so it keeps the deepest of them, which is final by the
+    // time the node itself is checked.
+    std::vector<unsigned char> depths(header.nodeCount, 0);
+    for (unsigned int i = 0; i < header.nodeCount; ++i) {
+        const BvhNode &node = mNodes[i];
+        bool valid;
+        if (node.isLeaf()) {
+            valid = node.leftFirst < header.blockCount && node.count <= header.blockCount - node.leftFirst;
+        } else {
+            valid = node.leftFirst > i && node.leftFirst < header.nodeCount - 1 && depths[i] + 1u < MaxDepth;
+            if (valid) {
+                const unsigned char depth = depths[i] + 1;
+                depths[node.leftFirst] = std::max(depths[node.leftFirst], depth);
+                depths[node.leftFirst + 1] = std::max(depths[node.leftFirst + 1], depth);
+            }
+        }
+        if (!valid) {
+            clear();
+            return false;
+        }
+    }
+
+    mNodeCount = header.nodeCount;
+    mBlockCount = header.blockCount;
+    mTriangleCount = header.triangleCount;
+    return true;
+}
+
+GAMEMATH_NAMESPACE_END
+
+#endif // TRIANGLE_BVH_H
@@ -0,0 +1,632 @@
+
+#include "../common/common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GameMath;
+
+static const unsigned int BoneCount = 60;
+
+/**
+  Creates a clip with one track per bone, sampled at 30 frames per second over two seconds. Every
+  seventh bone has a single key, the others have keys at slightly irregular times.
+  */
+static void createClip(AnimationClip &clip)
+{
+	std::vector<AnimationTrack> tracks(BoneCount);
+	std::vector<float> times;
+	std::vector<Vector4> translations;
+	std::vector<Quaternion> rotations;
+	std::vector<Vector4> scales;
+
+	for (unsigned int bone = 0; bone < BoneCount; ++bone) {
+		const unsigned int keyCount = (bone % 7) ? 61 : 1;
+		tracks[bone].firstKey = (unsigned int)times.size();
+		tracks[bone].keyCount = keyCount;
+		tracks[bone].reserved1 = 0;
+		tracks[bone].reserved2 = 0;
+
+		for (unsigned int key = 0; key < keyCount; ++key) {
+			times.push_back(key / 30.0f + (key && key < keyCount - 1 ? randomFloat(0.01f) : 0));
+			translations.push_back(Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1));
+			rotations.push_back(randomRotation());
+			scales.push_back(Vector4(1 + randomFloat(0.1f), 1 + randomFloat(0.1f), 1 + randomFloat(0.1f), 0));
+		}
+	}
+
+	EXPECT(clip.create(&tracks[0], BoneCount, &times[0], &translations[0], &rotations[0], &scales[0],
+		(unsigned int)times.size()));
+}
+
+/**
+  Samples a single track without a cursor, by searching all of its keys.
+  */
+static void sampleTrack(const AnimationClip &clip, unsigned int bone, float time, Vector4 &translation,
+						Quaternion &rotation, Vector4 &scale)
+{
+	const AnimationTrack &track = clip.tracks()[bone];
+	const float *times = clip.times() + track.firstKey;
+
+	unsigned int current = 0;
+	while (current + 2 < track.keyCount && times[current + 1] <= time)
+		++current;
+	const unsigned int next = track.keyCount > 1 ? current + 1 : current;
+
+	float weight = 0;
+	if (next != current)
+		weight = std::min(std::max((time - times[current]) / (times[next] - times[current]), 0.0f), 1.0f);
+
+	const unsigned int first = track.firstKey;
+	const Vector4 *translations = clip.translations() + first;
+	const Vector4 *scales = clip.scales() + first;
+	translation = translations[current] + weight * (translations[next] - translations[current]);
+	scale = scales[current] + weight * (scales[next] - scales[current]);
+	rotation = Quaternion::nlerp(clip.rotations()[first + current], clip.rotations()[first + next], weight);
+}
+
+static void testSampling(const AnimationClip &clip)
+{
+	EXPECT(!clip.isEmpty());
+	EXPECT(clip.trackCount() == BoneCount);
+	EXPECT(fabs(clip.duration() - 2) < 1e-5f);
+
+	Vector4 translations[BoneCount];
+	Quaternion rotations[BoneCount];
+	Vector4 scales[BoneCount];
+
+	AnimationSampler sampler;
+	sampler.setClip(&clip);
+	EXPECT(sampler.clip() == &clip);
+	EXPECT(sampler.rotationInterpolation() == AnimationSampler::Nlerp);
+
+	// Play forward at 60 frames per second, loop twice and seek backwards in the middle
+	const float frames[] = { -1.0f, 0, 0.5f, 0.25f, 3.0f, 1.0f / 30 };
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int frame = 0; frame < 130 + (int)(sizeof(frames) / sizeof(frames[0])); ++frame) {
+			const float time = frame < 130 ? frame / 60.0f : frames[frame - 130];
+			sampler.sample(time, translations, rotations, scales);
+
+			for (unsigned int bone = 0; bone < BoneCount; ++bone) {
+				Vector4 translation, scale;
+				Quaternion rotation;
+				sampleTrack(clip, bone, time, translation, rotation, scale);
+				EXPECT(fuzzyCompare(translations[bone], translation));
+				EXPECT(fuzzyCompare(rotations[bone], rotation));
+				EXPECT(fuzzyCompare(scales[bone], scale));
+			}
+		}
+	}
+
+	// Keys are reproduced exactly at their own time
+	const AnimationTrack &track = clip.tracks()[1];
+	sampler.sample(clip.times()[track.firstKey + 10], translations, rotations, scales);
+	EXPECT(fuzzyCompare(translations[1], clip.translations()[track.firstKey + 10], 1e-6f));
+	EXPECT(fuzzyCompare(rotations[1], clip.rotations()[track.firstKey + 10], 1e-6f));
+
+	// Slerp gives the same result as the scalar version
+	sampler.setRotationInterpolation(AnimationSampler::Slerp);
+	const float time = 0.77f;
+	sampler.sample(time, translations, rotations, scales);
+	const float *times = clip.times() + track.firstKey;
+	unsigned int key = 0;
+	while (times[key + 1] <= time)
+		++key;
+	const float weight = (time - times[key]) / (times[key + 1] - times[key]);
+	EXPECT(fuzzyCompare(rotations[1], Quaternion::slerp(clip.rotations()[track.firstKey + key],
+		clip.rotations()[track.firstKey + key + 1], weight)));
+}
+
+static void testValidation(const AnimationClip &clip)
+{
+	AnimationTrack tracks[2] = { { 0, 2, 0, 0 }, { 2, 2, 0, 0 } };
+	const float times[4] = { 0, 1, 0, 1 };
+	const Vector4 vectors[4] = { Vector4(0, 0, 0, 0), Vector4(1, 1, 1, 0), Vector4(0, 0, 0, 0), Vector4(1, 1, 1, 0) };
+	const Quaternion rotations[4] = { Quaternion(0, 0, 0, 1), Quaternion(0, 0, 0, 1), Quaternion(0, 0, 0, 1),
+		Quaternion(0, 0, 0, 1) };
+
+	AnimationClip invalid;
+	EXPECT(invalid.isEmpty());
+	EXPECT(invalid.create(tracks, 2, times, vectors, rotations, vectors, 4));
+	EXPECT(invalid.trackCount() == 2);
+
+	tracks[1].keyCount = 3;
+	EXPECT(!invalid.create(tracks, 2, times, vectors, rotations, vectors, 4));
+	EXPECT(invalid.isEmpty());
+
+	tracks[1].keyCount = 0;
+	EXPECT(!invalid.create(tracks, 2, times, vectors, rotations, vectors, 4));
+
+	tracks[1].keyCount = 2;
+	const float unordered[4] = { 0, 1, 1, 1 };
+	EXPECT(!invalid.create(tracks, 2, unordered, vectors, rotations, vectors, 4));
+
+	// Round trip through serialize, and reject truncated or versioned data
+	std::vector<char> data(clip.serializedSize());
+	EXPECT(data.size() % 16 == 0);
+	clip.serialize(&data[0]);
+
+	AnimationClip loaded;
+	EXPECT(loaded.deserialize(&data[0], data.size()));
+	EXPECT(loaded.trackCount() == clip.trackCount());
+	EXPECT(loaded.keyCount() == clip.keyCount());
+	EXPECT(loaded.duration() == clip.duration());
+	EXPECT(memcmp(loaded.times(), clip.times(), sizeof(float) * clip.keyCount()) == 0);
+	EXPECT(memcmp(loaded.rotations(), clip.rotations(), sizeof(Quaternion) * clip.keyCount()) == 0);
+	EXPECT(memcmp(loaded.scales(), clip.scales(), sizeof(Vector4) * clip.keyCount()) == 0);
+
+	EXPECT(!loaded.deserialize(&data[0], data.size() - 16));
+	EXPECT(loaded.isEmpty());
+
+	data[0] = 2;
+	EXPECT(!loaded.deserialize(&data[0], data.size()));
+}
+
+/**
+  Computes the model space matrix of a bone by walking up to its root, without reusing the matrices
+  of other bones.
+  */
+static Matrix4 modelMatrix(const Skeleton &skeleton, unsigned int bone, const Vector4 *translations,
+						   const Quaternion *rotations, const Vector4 *scales)
+{
+	Matrix4 result = Matrix4::transformation(scales[bone], rotations[bone], translations[bone]);
+	for (int parent = skeleton.parents()[bone]; parent != Skeleton::NoParent; parent = skeleton.parents()[parent])
+		result = Matrix4::transformation(scales[parent], rotations[parent], translations[parent]) * result;
+	return result;
+}
+
+static void testSkeleton(const AnimationClip &clip)
+{
+	// Two roots, every other bone hangs off a random earlier bone
+	int parents[BoneCount];
+	for (unsigned int bone = 0; bone < BoneCount; ++bone)
+		parents[bone] = bone == 0 || bone == 30 ? Skeleton::NoParent : rand() % bone;
+
+	// The first key of every track is the bind pose
+	Vector4 translations[BoneCount];
+	Quaternion rotations[BoneCount];
+	Vector4 scales[BoneCount];
+	AnimationSampler sampler;
+	sampler.setClip(&clip);
+	sampler.sample(0, translations, rotations, scales);
+
+	Skeleton skeleton;
+	Matrix4 inverseBindMatrices[BoneCount];
+	EXPECT(skeleton.create(parents, inverseBindMatrices, BoneCount));
+	for (unsigned int bone = 0; bone < BoneCount; ++bone)
+		inverseBindMatrices[bone] = modelMatrix(skeleton, bone, translations, rotations, scales).inverted();
+	EXPECT(skeleton.create(parents, inverseBindMatrices, BoneCount));
+	EXPECT(skeleton.boneCount() == BoneCount);
+
+	// The bind pose doesn't move any vertices
+	Matrix4 modelMatrices[BoneCount];
+	Matrix4 palette[BoneCount];
+	const Matrix4 identity = Matrix4::identity();
+	skeleton.evaluate(translations, rotations, scales, modelMatrices, palette);
+	for (unsigned int bone = 0; bone < BoneCount; ++bone)
+		EXPECT(fuzzyCompare(palette[bone], identity, 1e-3f));
+
+	sampler.sample(1.3f, translations, rotations, scales);
+	skeleton.evaluate(translations, rotations, scales, modelMatrices, palette);
+	for (unsigned int bone = 0; bone < BoneCount; ++bone) {
+		const Matrix4 expected = modelMatrix(skeleton, bone, translations, rotations, scales);
+		EXPECT(fuzzyCompare(modelMatrices[bone], expected, 1e-3f));
+		const Matrix4 skinning = expected * inverseBindMatrices[bone];
+		EXPECT(fuzzyCompare(palette[bone], skinning, 1e-3f));
+	}
+
+	// In place
+	skeleton.skinningPalette(modelMatrices, modelMatrices);
+	for (unsigned int bone = 0; bone < BoneCount; ++bone)
+		EXPECT(fuzzyCompare(modelMatrices[bone], palette[bone]));
+
+	// Parents have to come first
+	Skeleton invalid;
+	parents[5] = 5;
+	EXPECT(!invalid.create(parents, inverseBindMatrices, BoneCount));
+	EXPECT(invalid.isEmpty());
+	parents[5] = 7;
+	EXPECT(!invalid.create(parents, inverseBindMatrices, BoneCount));
+	parents[5] = 4;
+
+	std::vector<char> data(skeleton.serializedSize());
+	EXPECT(data.size() % 16 == 0);
+	skeleton.serialize(&data[0]);
+	Skeleton loaded;
+	EXPECT(loaded.deserialize(&data[0], data.size()));
+	EXPECT(loaded.boneCount() == BoneCount);
+	EXPECT(memcmp(loaded.parents(), skeleton.parents(), sizeof(int) * BoneCount) == 0);
+	EXPECT(memcmp(loaded.inverseBindMatrices(), inverseBindMatrices, sizeof(Matrix4) * BoneCount) == 0);
+	EXPECT(!loaded.deserialize(&data[0], data.size() - 16));
+	EXPECT(loaded.isEmpty());
+
+	BENCHMARK("Evaluate the model matrices of 60 bones by walking up to the root.") {
+		for (unsigned int bone = 0; bone < BoneCount; ++bone)
+			modelMatrices[bone] = modelMatrix(skeleton, bone, translations, rotations, scales);
+	}
+
+	BENCHMARK("Evaluate the model matrices and skinning palette of 60 bones.") {
+		skeleton.evaluate(translations, rotations, scales, modelMatrices, palette);
+	}
+}
+
+static void testSkinning()
+{
+	const int VertexCount = 100003;
+
+	Matrix4 palette[BoneCount];
+	for (unsigned int bone = 0; bone < BoneCount; ++bone) {
+		const Vector4 scale(0.8f + randomFloat(0.4f), 0.8f + randomFloat(0.4f), 0.8f + randomFloat(0.4f), 0);
+		const Vector4 translation(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		palette[bone] = Matrix4::transformation(scale, randomRotation(), translation);
+	}
+
+	Vector4 *positions = new Vector4[VertexCount];
+	Vector4 *normals = new Vector4[VertexCount];
+	SkinningInfluences *influences = new SkinningInfluences[VertexCount];
+	for (int i = 0; i < VertexCount; ++i) {
+		positions[i] = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		normals[i] = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0).normalized();
+
+		// Up to four bones, with the unused ones at a weight of zero
+		float total = 0;
+		for (int j = 0; j < 4; ++j) {
+			influences[i].bones[j] = (unsigned short)(rand() % BoneCount);
+			influences[i].weights[j] = j <= i % 4 ? randomFloat(1) + 0.01f : 0;
+			total += influences[i].weights[j];
+		}
+		for (int j = 0; j < 4; ++j)
+			influences[i].weights[j] /= total;
+	}
+
+	Vector4 *skinnedPositions = new Vector4[VertexCount];
+	Vector4 *skinnedNormals = new Vector4[VertexCount];
+	skinVertices(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+
+	for (int i = 0; i < VertexCount; ++i) {
+		Vector4 position(0, 0, 0, 0), normal(0, 0, 0, 0);
+		for (int j = 0; j < 4; ++j) {
+			const Matrix4 &matrix = palette[influences[i].bones[j]];
+			position += influences[i].weights[j] * matrix.mapPosition(positions[i]);
+			normal += influences[i].weights[j] * matrix.mapNormal(normals[i]);
+		}
+		position.setW(1);
+		normal.setW(0);
+		EXPECT(fuzzyCompare(skinnedPositions[i], position));
+		EXPECT(fuzzyCompare(skinnedNormals[i], normal.normalized()));
+	}
+
+	// Positions only, in place and in parallel
+	Vector4 *parallelPositions = new Vector4[VertexCount];
+	memcpy(parallelPositions, positions, sizeof(Vector4) * VertexCount);
+	skinVerticesParallel(palette, influences, parallelPositions, 0, VertexCount, parallelPositions, 0);
+	EXPECT(memcmp(parallelPositions, skinnedPositions, sizeof(Vector4) * VertexCount) == 0);
+
+	// The same palette as 3x4 matrices gives the same result
+	Matrix3x4 compactPalette[BoneCount];
+	Matrix3x4::fromMatrix4(palette, BoneCount, compactPalette);
+	Vector4 *compactPositions = new Vector4[VertexCount];
+	Vector4 *compactNormals = new Vector4[VertexCount];
+	skinVertices(compactPalette, influences, positions, normals, VertexCount, compactPositions, compactNormals);
+	for (int i = 0; i < VertexCount; ++i) {
+		EXPECT(fuzzyCompare(compactPositions[i], skinnedPositions[i], 1e-5f));
+		EXPECT(fuzzyCompare(compactNormals[i], skinnedNormals[i], 1e-5f));
+	}
+
+	skinVerticesParallel(compactPalette, influences, positions, 0, VertexCount, parallelPositions, 0);
+	EXPECT(memcmp(parallelPositions, compactPositions, sizeof(Vector4) * VertexCount) == 0);
+
+	BENCHMARK("Skin 100000 vertices by transforming them with every bone.") {
+		for (int i = 0; i < VertexCount; ++i) {
+			Vector4 position(0, 0, 0, 0), normal(0, 0, 0, 0);
+			for (int j = 0; j < 4; ++j) {
+				const Matrix4 &matrix = palette[influences[i].bones[j]];
+				position += influences[i].weights[j] * matrix.mapPosition(positions[i]);
+				normal += influences[i].weights[j] * matrix.mapNormal(normals[i]);
+			}
+			skinnedPositions[i] = position;
+			skinnedNormals[i] = normal.normalized();
+		}
+	}
+
+	BENCHMARK("Skin 100000 vertices.") {
+		skinVertices(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	}
+
+	BENCHMARK("Skin 100000 vertices with 3x4 matrices.") {
+		skinVertices(compactPalette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	}
+
+	printf("Skinning in parallel uses %d threads.\n", parallelRangeCount(VertexCount, SkinningMinimumGrain));
+	BENCHMARK("Skin 100000 vertices in parallel.") {
+		skinVerticesParallel(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	}
+
+	delete [] compactNormals;
+	delete [] compactPositions;
+	delete [] parallelPositions;
+	delete [] skinnedNormals;
+	delete [] skinnedPositions;
+	delete [] influences;
+	delete [] normals;
+	delete [] positions;
+}
+
+/**
+  Blends the dual quaternions of the bones of a vertex one component at a time, the way dual quaternion
+  skinning is usually described.
+  */
+static DualQuaternion blendDualQuaternions(const DualQuaternion *palette, const SkinningInfluences &influences)
+{
+	const Quaternion &first = palette[influences.bones[0]].real();
+	float real[4] = { 0 }, dual[4] = { 0 };
+	for (int j = 0; j < 4; ++j) {
+		const DualQuaternion &bone = palette[influences.bones[j]];
+		const float cosAngle = first.x() * bone.real().x() + first.y() * bone.real().y() + first.z() * bone.real().z()
+			+ first.w() * bone.real().w();
+		const float weight = cosAngle < 0 ? -influences.weights[j] : influences.weights[j];
+		for (int k = 0; k < 4; ++k) {
+			real[k] += weight * bone.real().data()[k];
+			dual[k] += weight * bone.dual().data()[k];
+		}
+	}
+
+	const float length = sqrt(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3]);
+	return DualQuaternion(Quaternion(real[0] / length, real[1] / length, real[2] / length, real[3] / length),
+		Quaternion(dual[0] / length, dual[1] / length, dual[2] / length, dual[3] / length));
+}
+
+static void testDualQuaternion()
+{
+	const Vector4 one(1, 1, 1, 0);
+
+	// Conversion from a rotation and a translation matches the matrix with unit scale
+	for (int i = 0; i < 100; ++i) {
+		const Quaternion rotation = randomRotation();
+		const Vector4 translation(randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(20) - 10, 1);
+		const DualQuaternion dualQuaternion = DualQuaternion::transformation(rotation, translation);
+		const Matrix4 matrix = Matrix4::transformation(one, rotation, translation);
+
+		EXPECT(fuzzyCompare(dualQuaternion.translation(), Vector4(translation.x(), translation.y(), translation.z(), 0)));
+		EXPECT(fuzzyCompare(dualQuaternion.toMatrix(), matrix));
+
+		const Vector4 point(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		EXPECT(fuzzyCompare(dualQuaternion.mapPosition(point), matrix.mapPosition(point)));
+		const Vector4 normal = Vector4(point.x(), point.y(), point.z(), 0).normalized();
+		EXPECT(fuzzyCompare(dualQuaternion.mapNormal(normal), matrix.mapNormal(normal)));
+
+		// Composition matches the matrix product, and the conjugate undoes the transformation
+		const DualQuaternion other = DualQuaternion::transformation(randomRotation(),
+			Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1));
+		EXPECT(fuzzyCompare((dualQuaternion * other).toMatrix(), matrix * other.toMatrix()));
+		EXPECT(fuzzyCompare(dualQuaternion.conjugated().mapPosition(dualQuaternion.mapPosition(point)), point));
+
+		const DualQuaternion identity = dualQuaternion * dualQuaternion.conjugated();
+		EXPECT(fuzzyCompare(identity.real(), Quaternion(0, 0, 0, 1)) || fuzzyCompare(identity.real(), Quaternion(0, 0, 0, -1)));
+		EXPECT(fuzzyCompare(identity.translation(), Vector4(0, 0, 0, 0)));
+	}
+
+	EXPECT(fuzzyCompare(DualQuaternion::identity().toMatrix(), Matrix4::identity()));
+
+	// Blending hits both ends, including when b has the other sign
+	const int PairCount = 37;
+	DualQuaternion a[PairCount], b[PairCount], results[PairCount];
+	float weights[PairCount];
+	for (int i = 0; i < PairCount; ++i) {
+		a[i] = DualQuaternion::transformation(randomRotation(), Vector4(randomFloat(2), randomFloat(2), randomFloat(2), 1));
+		b[i] = DualQuaternion::transformation(randomRotation(), Vector4(randomFloat(2), randomFloat(2), randomFloat(2), 1));
+		weights[i] = i % 2 ? 1.0f : 0.0f;
+	}
+	DualQuaternion::nlerp(a, b, weights, PairCount, results);
+	for (int i = 0; i < PairCount; ++i) {
+		const Matrix4 expected = i % 2 ? b[i].toMatrix() : a[i].toMatrix();
+		EXPECT(fuzzyCompare(results[i].toMatrix(), expected));
+	}
+
+	const DualQuaternion negated(-1.0f * a[0].real(), -1.0f * a[0].dual());
+	EXPECT(fuzzyCompare(DualQuaternion::nlerp(a[0], negated, 0.5f).toMatrix(), a[0].toMatrix()));
+
+	// Skinning with rigid palettes
+	const int VertexCount = 100003;
+
+	Quaternion rotations[BoneCount];
+	Vector4 translations[BoneCount];
+	Matrix4 matrixPalette[BoneCount];
+	DualQuaternion palette[BoneCount];
+	for (unsigned int bone = 0; bone < BoneCount; ++bone) {
+		rotations[bone] = randomRotation();
+		translations[bone] = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		matrixPalette[bone] = Matrix4::transformation(one, rotations[bone], translations[bone]);
+	}
+	DualQuaternion::transformation(rotations, translations, BoneCount, palette);
+
+	Vector4 *positions = new Vector4[VertexCount];
+	Vector4 *normals = new Vector4[VertexCount];
+	SkinningInfluences *influences = new SkinningInfluences[VertexCount];
+	for (int i = 0; i < VertexCount; ++i) {
+		positions[i] = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		normals[i] = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0).normalized();
+
+		float total = 0;
+		for (int j = 0; j < 4; ++j) {
+			influences[i].bones[j] = (unsigned short)(rand() % BoneCount);
+			influences[i].weights[j] = j <= i % 4 ? randomFloat(1) + 0.01f : 0;
+			total += influences[i].weights[j];
+		}
+		for (int j = 0; j < 4; ++j)
+			influences[i].weights[j] /= total;
+	}
+
+	Vector4 *skinnedPositions = new Vector4[VertexCount];
+	Vector4 *skinnedNormals = new Vector4[VertexCount];
+	Vector4 *blendedPositions = new Vector4[VertexCount];
+	Vector4 *blendedNormals = new Vector4[VertexCount];
+	skinVertices(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	skinVertices(matrixPalette, influences, positions, normals, VertexCount, blendedPositions, blendedNormals);
+
+	for (int i = 0; i < VertexCount; ++i) {
+		const DualQuaternion blended = blendDualQuaternions(palette, influences[i]);
+		Vector4 position = blended.mapPosition(positions[i]);
+		Vector4 normal = blended.mapNormal(normals[i]);
+		position.setW(1);
+		normal.setW(0);
+		EXPECT(fuzzyCompare(skinnedPositions[i], position));
+		EXPECT(fuzzyCompare(skinnedNormals[i], normal));
+		EXPECT(fabs(skinnedNormals[i].length() - 1) < 1e-4f);
+
+		// With a single bone, both kinds of skinning apply the same rigid transformation
+		if (i % 4 == 0) {
+			EXPECT(fuzzyCompare(skinnedPositions[i], blendedPositions[i]));
+			EXPECT(fuzzyCompare(skinnedNormals[i], blendedNormals[i]));
+		}
+	}
+
+	Vector4 *parallelPositions = new Vector4[VertexCount];
+	memcpy(parallelPositions, positions, sizeof(Vector4) * VertexCount);
+	skinVerticesParallel(palette, influences, parallelPositions, 0, VertexCount, parallelPositions, 0);
+	EXPECT(memcmp(parallelPositions, skinnedPositions, sizeof(Vector4) * VertexCount) == 0);
+
+	printf("A palette of %u bones uses %u bytes as matrices and %u bytes as dual quaternions.\n", BoneCount,
+		(unsigned int)sizeof(matrixPalette), (unsigned int)sizeof(palette));
+
+	BENCHMARK("Skin 100000 vertices with dual quaternions.") {
+		skinVertices(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	}
+
+	BENCHMARK("Skin 100000 vertices with dual quaternions in parallel.") {
+		skinVerticesParallel(palette, influences, positions, normals, VertexCount, skinnedPositions, skinnedNormals);
+	}
+
+	delete [] parallelPositions;
+	delete [] blendedNormals;
+	delete [] blendedPositions;
+	delete [] skinnedNormals;
+	delete [] skinnedPositions;
+	delete [] influences;
+	delete [] normals;
+	delete [] positions;
+}
+
+static Transform randomTransform(bool uniformScale)
+{
+	const float scale = 0.5f + randomFloat(1.5f);
+	return Transform(Vector4(randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(20) - 10, 1), randomRotation(),
+		uniformScale ? Vector4(scale, scale, scale, 0)
+			: Vector4(0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), 0));
+}
+
+static void testTransform()
+{
+	const int TransformCount = 1000;
+
+	Transform *transforms = new Transform[TransformCount];
+	Matrix4 *matrices = new Matrix4[TransformCount];
+	Matrix3x4 *compactMatrices = new Matrix3x4[TransformCount];
+	for (int i = 0; i < TransformCount; ++i)
+		transforms[i] = randomTransform(i % 2 == 0);
+	Transform::toMatrices(transforms, TransformCount, matrices);
+	Transform::toMatrices(transforms, TransformCount, compactMatrices);
+
+	EXPECT(fuzzyCompare(Transform::identity().toMatrix4(), Matrix4::identity()));
+
+	for (int i = 0; i < TransformCount; ++i) {
+		const Transform &transform = transforms[i];
+		const Matrix4 &matrix = matrices[i];
+		const int next = (i + 1) % TransformCount;
+
+		EXPECT(fuzzyCompare(matrix, Matrix4::transformation(transform.scale(), transform.rotation(), transform.translation())));
+		EXPECT(fuzzyCompare(compactMatrices[i].toMatrix4(), matrix));
+
+		const Vector4 point(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		const Vector4 vector(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+		EXPECT(fuzzyCompare(transform.mapPosition(point), matrix.mapPosition(point)));
+		EXPECT(fuzzyCompare(transform.mapVector(vector), matrix.mapNormal(vector)));
+
+		// Composition is exact as long as the parent has a uniform scale, which every other one has
+		if (i % 2 == 0) {
+			const Transform composed = transform * transforms[next];
+			EXPECT(fuzzyCompare(composed.toMatrix4(), matrix * matrices[next], 1e-3f));
+			EXPECT(fuzzyCompare(composed.mapPosition(point), transform.mapPosition(transforms[next].mapPosition(point)),
+				1e-3f));
+
+			const Transform inverse = transform.inverted();
+			EXPECT(fuzzyCompare(inverse.toMatrix4(), matrix.inverted()));
+			EXPECT(fuzzyCompare(inverse.mapPosition(transform.mapPosition(point)), point));
+		}
+	}
+
+	// Chains of 60 bones, where every bone is the child of the previous one
+	Transform *modelTransforms = new Transform[TransformCount];
+	BENCHMARK("Concatenate chains of 1000 transforms by building matrices.") {
+		for (int i = 0; i < TransformCount; ++i) {
+			const Matrix4 local = Matrix4::transformation(transforms[i].scale(), transforms[i].rotation(),
+				transforms[i].translation());
+			matrices[i] = i % BoneCount ? matrices[i - 1] * local : local;
+		}
+	}
+
+	BENCHMARK("Concatenate chains of 1000 transforms.") {
+		for (int i = 0; i < TransformCount; ++i)
+			modelTransforms[i] = i % BoneCount ? modelTransforms[i - 1] * transforms[i] : transforms[i];
+	}
+
+	BENCHMARK("Invert 1000 transforms.") {
+		for (int i = 0; i < TransformCount; ++i)
+			transforms[i] = transforms[i].inverted();
+	}
+
+	BENCHMARK("Convert 1000 transforms to 3x4 matrices.") {
+		Transform::toMatrices(transforms, TransformCount, compactMatrices);
+	}
+
+	delete [] modelTransforms;
+	delete [] compactMatrices;
+	delete [] matrices;
+	delete [] transforms;
+}
+
+int main(int argc, char *argv[])
+{
+	AnimationClip clip;
+	createClip(clip);
+
+	testSampling(clip);
+	testValidation(clip);
+	testSkeleton(clip);
+	testSkinning();
+	testDualQuaternion();
+	testTransform();
+
+	printf("A clip with %u tracks and %u keys uses %u bytes, %.1f bytes per key.\n", clip.trackCount(), clip.keyCount(),
+		(unsigned int)clip.memoryUsage(), clip.memoryUsage() / (float)clip.keyCount());
+
+	Vector4 translations[BoneCount];
+	Quaternion rotations[BoneCount];
+	Vector4 scales[BoneCount];
+
+	AnimationSampler sampler;
+	sampler.setClip(&clip);
+
+	// One clip played forward at 60 frames per second, looping, so the cursors mostly advance by one key
+	int frame = 0;
+	BENCHMARK("Sample 60 bones with nlerp, playing forward.") {
+		sampler.sample((frame++ % 120) / 60.0f, translations, rotations, scales);
+	}
+
+	sampler.setRotationInterpolation(AnimationSampler::Slerp);
+	BENCHMARK("Sample 60 bones with slerp, playing forward.") {
+		sampler.sample((frame++ % 120) / 60.0f, translations, rotations, scales);
+	}
+
+	BENCHMARK("Sample 60 bones one by one by searching the keys.") {
+		const float time = (frame++ % 120) / 60.0f;
+		for (unsigned int bone = 0; bone < BoneCount; ++bone)
+			sampleTrack(clip, bone, time, translations[bone], rotations[bone], scales[bone]);
+	}
+
+	printf("Press enter to continue.\n");
+	fgetc(stdin);
+
+	return 0;
+}
@@ -0,0 +1,909 @@
+
+#include "../common/common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+
+using namespace GameMath;
+
+static const int PointCount = 4 * 1024 * 1024;
+static const int BoxCount = 100000;
+
+static Box3d randomBox(float worldSize, float boxSize)
+{
+	Vector4 minimum(randomFloat(worldSize), randomFloat(worldSize), randomFloat(worldSize), 1);
+	Vector4 extent(randomFloat(boxSize), randomFloat(boxSize), randomFloat(boxSize), 0);
+	return Box3d(minimum, minimum + extent);
+}
+
+static Ray3d randomRay(float worldSize)
+{
+	Vector4 origin(randomFloat(worldSize), randomFloat(worldSize), -10, 1);
+	Vector4 direction(randomFloat(2) - 1, randomFloat(2) - 1, 1, 0);
+	return Ray3d(origin, direction.normalize());
+}
+
+static void checkQueries(const Bvh &bvh, const Box3d *boxes)
+{
+	// Every query has to report exactly what a brute-force loop reports
+	std::vector<unsigned int> found;
+	for (int j = 0; j < 100; ++j) {
+		Ray3d ray = randomRay(1000);
+		found.clear();
+		bvh.query(ray, found);
+
+		size_t expected = 0;
+		for (int i = 0; i < BoxCount; ++i) {
+			if (ray.intersects(boxes[i]))
+				++expected;
+		}
+		EXPECT(found.size() == expected);
+
+		Box3d area = randomBox(1000, 50);
+		found.clear();
+		bvh.query(area, found);
+
+		expected = 0;
+		for (int i = 0; i < BoxCount; ++i) {
+			if (area.intersects(boxes[i]))
+				++expected;
+		}
+		EXPECT(found.size() == expected);
+	}
+
+	Frustum frustum;
+	frustum.extract(Matrix4::ortho(0, 100, 0, 100, 0, 100));
+	found.clear();
+	bvh.query(frustum, found);
+	size_t expectedVisible = 0;
+	for (int i = 0; i < BoxCount; ++i) {
+		if (frustum.isVisible(boxes[i]))
+			++expectedVisible;
+	}
+	EXPECT(found.size() == expectedVisible);
+}
+
+/**
+  Extracts the planes of a frustum from a matrix one by one, the way Frustum::extract used to.
+  */
+static void extractPlanes(const Matrix4 &matrix, Vector4 *planes)
+{
+	const Matrix4 transposed = matrix.transposed();
+	planes[Frustum::Plane_Left] = normalizePlane(transposed.column(3) + transposed.column(0));
+	planes[Frustum::Plane_Right] = normalizePlane(transposed.column(3) - transposed.column(0));
+	planes[Frustum::Plane_Top] = normalizePlane(transposed.column(3) - transposed.column(1));
+	planes[Frustum::Plane_Bottom] = normalizePlane(transposed.column(3) + transposed.column(1));
+	planes[Frustum::Plane_Near] = normalizePlane(transposed.column(3) + transposed.column(2));
+	planes[Frustum::Plane_Far] = normalizePlane(transposed.column(3) - transposed.column(2));
+}
+
+static bool comparePlanes(const Vector4 &a, const Vector4 &b)
+{
+	const float tolerance = 1e-4f * (1 + fabs(b.w()));
+	return fabs(a.x() - b.x()) < 1e-4f && fabs(a.y() - b.y()) < 1e-4f && fabs(a.z() - b.z()) < 1e-4f
+		&& fabs(a.w() - b.w()) < tolerance;
+}
+
+static void testFrustum()
+{
+	const Vector4 eye(10, 20, 30, 1);
+	const Quaternion orientation = Quaternion::fromAxisAndAngle(0.6f, 0.8f, 0, 0.7f);
+	const float fovY = 3.14159265f / 3;
+
+	// The camera transform moves the camera from the origin, so the view matrix is its inverse
+	const Matrix4 view = (Matrix4::translation(eye.x(), eye.y(), eye.z()) * Matrix4::rotation(orientation)).inverted();
+	const Matrix4 viewProjection = Matrix4::perspective(fovY, 1.6f, 0.5f, 500) * view;
+
+	Frustum extracted;
+	extracted.extract(viewProjection);
+	const Frustum constructed(eye, orientation, fovY, 1.6f, 0.5f, 500);
+
+	Vector4 expected[6];
+	extractPlanes(viewProjection, expected);
+	for (int i = Frustum::Plane_Left; i <= Frustum::Plane_Far; ++i) {
+		const Frustum::ClippingPlane plane = (Frustum::ClippingPlane)i;
+		EXPECT(comparePlanes(extracted.plane(plane), expected[i]));
+		EXPECT(comparePlanes(constructed.plane(plane), expected[i]));
+	}
+
+	// The eye lies on the side planes and everything in front of it is on their inner side
+	const Vector4 forward = Matrix4::rotation(orientation).mapNormal(Vector4(0, 0, -1, 0));
+	const Vector4 up = Matrix4::rotation(orientation).mapNormal(Vector4(0, 1, 0, 0));
+	EXPECT(fabs(constructed.plane(Frustum::Plane_Left).dot(eye)) < 1e-4f);
+	EXPECT(constructed.plane(Frustum::Plane_Top).dot(eye + 10 * forward) > 0);
+	EXPECT(constructed.plane(Frustum::Plane_Top).dot(eye + 10 * forward + 10 * up) < 0);
+	EXPECT(fabs(constructed.plane(Frustum::Plane_Near).dot(eye + 0.5f * forward)) < 1e-4f);
+	EXPECT(fabs(constructed.plane(Frustum::Plane_Far).dot(eye + 500 * forward)) < 1e-3f);
+
+	EXPECT(constructed.isVisible(Box3d(eye + 50 * forward - Vector4(1, 1, 1, 0), eye + 50 * forward + Vector4(1, 1, 1, 0))));
+	EXPECT(!constructed.isVisible(Box3d(eye - 50 * forward - Vector4(1, 1, 1, 0), eye - 50 * forward + Vector4(1, 1, 1, 0))));
+
+	Vector4 planes[6];
+	BENCHMARK("Extract 1000 frustums with scalar plane normalization.") {
+		for (int i = 0; i < 1000; ++i)
+			extractPlanes(viewProjection, planes);
+	}
+	EXPECT(comparePlanes(planes[0], expected[0]));
+
+	Frustum frustum;
+	BENCHMARK("Extract 1000 frustums with SIMD plane normalization.") {
+		for (int i = 0; i < 1000; ++i)
+			frustum.extract(viewProjection);
+	}
+	EXPECT(comparePlanes(frustum.plane(Frustum::Plane_Left), expected[0]));
+
+	BENCHMARK("Construct 1000 frustums from camera parameters.") {
+		for (int i = 0; i < 1000; ++i)
+			frustum = Frustum(eye, orientation, fovY, 1.6f, 0.5f, 500);
+	}
+	EXPECT(comparePlanes(frustum.plane(Frustum::Plane_Left), expected[0]));
+}
+
+static void testBvh()
+{
+	Box3d *boxes = new Box3d[BoxCount];
+	for (int i = 0; i < BoxCount; ++i) {
+		boxes[i] = randomBox(1000, 5);
+	}
+
+	Bvh bvh;
+	bvh.build(boxes, BoxCount);
+	EXPECT(bvh.primitiveCount() == BoxCount);
+	EXPECT(bvh.nodeCount() <= 2 * BoxCount - 1);
+
+	checkQueries(bvh, boxes);
+
+	std::vector<unsigned int> found;
+
+	BENCHMARK("Build a SAH BVH over 100000 boxes.") {
+		bvh.build(boxes, BoxCount);
+	}
+
+	Ray3d rays[1000];
+	for (int i = 0; i < 1000; ++i) {
+		rays[i] = randomRay(1000);
+	}
+
+	BENCHMARK("Query 1000 rays against a BVH over 100000 boxes.") {
+		for (int i = 0; i < 1000; ++i) {
+			found.clear();
+			bvh.query(rays[i], found);
+		}
+	}
+
+	BENCHMARK("Brute-force 10 rays against 100000 boxes.") {
+		found.clear();
+		for (int i = 0; i < 10; ++i) {
+			for (int j = 0; j < BoxCount; ++j) {
+				if (rays[i].intersects(boxes[j]))
+					found.push_back(j);
+			}
+		}
+	}
+
+	// Move every box a little and refit the hierarchy to the new positions
+	bvh.build(boxes, BoxCount);
+	EXPECT(bvh.costRatio() == 1);
+	for (int i = 0; i < BoxCount; i += 3) {
+		Vector4 offset(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+		boxes[i] = Box3d(boxes[i].minimum() + offset, boxes[i].maximum() + offset);
+		bvh.updatePrimitive(i, boxes[i]);
+	}
+	bvh.refit();
+	checkQueries(bvh, boxes);
+	EXPECT(!bvh.needsRebuild());
+
+	// Scattering the boxes destroys the quality of the hierarchy
+	Box3d *scattered = new Box3d[BoxCount];
+	for (int i = 0; i < BoxCount; ++i) {
+		scattered[i] = randomBox(1000, 5);
+	}
+	bvh.refit(scattered);
+	checkQueries(bvh, scattered);
+	EXPECT(bvh.needsRebuild());
+	EXPECT(bvh.refitOrRebuild(scattered));
+	EXPECT(bvh.costRatio() == 1);
+	checkQueries(bvh, scattered);
+	delete [] scattered;
+
+	BENCHMARK("Refit a SAH BVH over 100000 boxes.") {
+		bvh.refit(boxes);
+	}
+
+	bvh.buildLinear(boxes, BoxCount);
+	checkQueries(bvh, boxes);
+
+	for (int i = 0; i < BoxCount; i += 7) {
+		bvh.updatePrimitive(i, boxes[i]);
+	}
+	bvh.refit();
+	checkQueries(bvh, boxes);
+
+	bvh.buildLinear(boxes, BoxCount, Bvh::Morton63);
+	checkQueries(bvh, boxes);
+
+	// Coinciding centers have to be handled by the tie-breaking of the hierarchy emission
+	Box3d sameBoxes[100];
+	for (int i = 0; i < 100; ++i) {
+		sameBoxes[i] = Box3d(Vector4(0, 0, 0, 1), Vector4(1, 1, 1, 1));
+	}
+	bvh.buildLinear(sameBoxes, 100);
+	found.clear();
+	bvh.query(sameBoxes[0], found);
+	EXPECT(found.size() == 100);
+
+	delete [] boxes;
+
+	const int LargeBoxCount = 1000000;
+	boxes = new Box3d[LargeBoxCount];
+	for (int i = 0; i < LargeBoxCount; ++i) {
+		boxes[i] = randomBox(1000, 1);
+	}
+
+	BENCHMARK("Build a linear BVH over 1000000 boxes.") {
+		bvh.buildLinear(boxes, LargeBoxCount);
+	}
+
+	delete [] boxes;
+}
+
+static void testRayIntersection()
+{
+	// The inverted direction is refined beyond the 12 bits of the reciprocal estimate
+	Ray3d ray(Vector4(0, 0, 0, 1), Vector4(3, 0.3f, 7, 0));
+	EXPECT(fabs(ray.invertedDirection().x() * 3 - 1) < 1e-6f);
+	EXPECT(fabs(ray.invertedDirection().y() * 0.3f - 1) < 1e-6f);
+	EXPECT(fabs(ray.invertedDirection().z() * 7 - 1) < 1e-6f);
+
+	// Axis-aligned rays have infinite inverted components
+	Ray3d forward(Vector4(0, 0, 0, 1), Vector4(0, 0, 1, 0));
+	EXPECT(forward.invertedDirection().x() == std::numeric_limits<float>::infinity());
+
+	Box3d box(Vector4(-1, -1, 4, 1), Vector4(1, 1, 6, 1));
+	// The refined reciprocal of 1 is only accurate to one unit in the last place
+	IntersectionResult result = forward.intersect(box);
+	EXPECT(result.intersects);
+	EXPECT(fabs(result.distance - 4) < 1e-5f);
+	EXPECT(fabs(result.exitDistance - 6) < 1e-5f);
+
+	forward.setOrigin(Vector4(0, 0, 5, 1));
+	result = forward.intersect(box);
+	EXPECT(result.intersects);
+	EXPECT(fabs(result.distance + 1) < 1e-5f);
+	EXPECT(fabs(result.exitDistance - 1) < 1e-5f);
+
+	forward.setOrigin(Vector4(0, 0, 7, 1));
+	EXPECT(!forward.intersect(box).intersects);
+	EXPECT(!forward.intersects(box));
+
+	forward.setOrigin(Vector4(0, 0, 0, 1));
+	result = forward.intersectSphere(Vector4(0, 0, 10, 1), 4);
+	EXPECT(result.intersects);
+	COMPARE(result.distance, 8);
+	COMPARE(result.exitDistance, 12);
+
+	result = forward.intersectSphere(Vector4(0, 0, 1, 1), 4);
+	EXPECT(result.intersects);
+	COMPARE(result.distance, -1);
+	COMPARE(result.exitDistance, 3);
+
+	EXPECT(!forward.intersectSphere(Vector4(0, 0, -10, 1), 4).intersects);
+	EXPECT(!forward.intersectSphere(Vector4(3, 0, 10, 1), 4).intersects);
+
+	// The distances returned for random rays have to be consistent with intersects
+	for (int i = 0; i < 1000; ++i) {
+		Ray3d randomized = randomRay(100);
+		Box3d target = randomBox(100, 20);
+		result = randomized.intersect(target);
+		EXPECT(result.intersects == randomized.intersects(target));
+		if (result.intersects) {
+			EXPECT(result.distance <= result.exitDistance);
+			Vector4 entry = randomized.origin() + std::max(result.distance, 0.0f) * randomized.direction();
+			Box3d grown(target.minimum() - Vector4(0.01f, 0.01f, 0.01f, 0), target.maximum() + Vector4(0.01f, 0.01f, 0.01f, 0));
+			EXPECT(grown.contains(entry));
+		}
+	}
+}
+
+static void testSphereBatch()
+{
+	// intersectsSphere has to agree with the distances of intersectSphere
+	Ray3d forward(Vector4(0, 0, 0, 1), Vector4(0, 0, 1, 0));
+	EXPECT(forward.intersectsSphere(Vector4(0, 0, 10, 1), 4));
+	EXPECT(forward.intersectsSphere(Vector4(0, 0, 1, 1), 4));
+	EXPECT(!forward.intersectsSphere(Vector4(0, 0, -10, 1), 4));
+	EXPECT(!forward.intersectsSphere(Vector4(3, 0, 10, 1), 4));
+
+	SphereBatch batch;
+	EXPECT(batch.add(Vector4(0, 0, 10, 1), 2) == 0);
+	EXPECT(batch.add(Vector4(0, 0, 1, 1), 2) == 1);
+	EXPECT(batch.add(Vector4(0, 0, -10, 1), 2) == 2);
+	EXPECT(batch.add(Vector4(3, 0, 10, 1), 2) == 3);
+	EXPECT(batch.add(Vector4(0, 1, 5, 1), 1.5f) == 4);
+	EXPECT(batch.size() == 5);
+	COMPARE(batch.radius(4), 1.5f);
+
+	unsigned int masks[1];
+	float distances[5];
+	EXPECT(batch.intersect(forward, masks, distances) == 3);
+	EXPECT(masks[0] == (1 | 2 | 16));
+	COMPARE(distances[0], 8);
+	COMPARE(distances[1], 0);
+	EXPECT(distances[2] == std::numeric_limits<float>::infinity());
+	EXPECT(fabs(distances[4] - (5 - sqrt(1.25f))) < 1e-5f);
+
+	float distance;
+	EXPECT(batch.closest(forward, &distance) == 1);
+	COMPARE(distance, 0);
+
+	batch.remove(1);
+	EXPECT(batch.size() == 4);
+	EXPECT(batch.closest(forward, &distance) == 1); // The last sphere took the place of the removed one
+	EXPECT(batch.closest(forward, &distance, 3) == -1);
+	EXPECT(distance == std::numeric_limits<float>::infinity());
+
+	// Far from the origin, rounding lets rays through the origin hit the padding spheres, which must
+	// not be reported
+	SphereBatch single;
+	single.add(Vector4(50, 50, 50, 1), 1);
+	const Ray3d throughOrigin(Vector4(10000, 0, 0, 1), Vector4(-1, 0, 0, 0));
+	EXPECT(single.intersect(throughOrigin, masks, distances) == 0);
+	EXPECT(masks[0] == 0);
+	EXPECT(single.closest(throughOrigin, &distance) == -1);
+
+	// A packet tests its rays against one sphere at a time
+	Ray3d rays[4];
+	rays[0] = forward;
+	rays[1] = Ray3d(Vector4(0, 0, 0, 1), Vector4(0, 0, -1, 0));
+	rays[2] = Ray3d(Vector4(3, 0, 0, 1), Vector4(0, 0, 1, 0));
+	rays[3] = Ray3d(Vector4(0, 0, 20, 1), Vector4(0, 0, -2, 0));
+	RayPacket4 packet(rays);
+	int rayMasks[4];
+	float packetDistances[16];
+	batch.intersect(packet, rayMasks, packetDistances);
+	EXPECT(rayMasks[0] == (1 | 8));
+	EXPECT(rayMasks[1] == (1 | 8));
+	EXPECT(rayMasks[2] == (2 | 8));
+	EXPECT(rayMasks[3] == 4);
+	COMPARE(packetDistances[0 * 4 + 0], 8);
+	COMPARE(packetDistances[0 * 4 + 3], 4);
+	COMPARE(packetDistances[2 * 4 + 1], 8);
+	EXPECT(packetDistances[2 * 4 + 0] == std::numeric_limits<float>::infinity());
+
+	// The batch has to agree with the single-ray test for random spheres
+	const int SphereCount = 10000;
+	SphereBatch spheres;
+	Vector4 *centers = new Vector4[SphereCount];
+	float *radii = new float[SphereCount];
+	for (int i = 0; i < SphereCount; ++i) {
+		centers[i] = Vector4(randomFloat(1000), randomFloat(1000), randomFloat(1000), 1);
+		radii[i] = 1 + randomFloat(10);
+		spheres.add(centers[i], radii[i]);
+	}
+
+	unsigned int *hitMasks = new unsigned int[(SphereCount + 31) / 32];
+	float *hitDistances = new float[SphereCount];
+	for (int i = 0; i < 100; ++i) {
+		Ray3d ray = randomRay(1000);
+		const unsigned int hits = spheres.intersect(ray, hitMasks, hitDistances);
+
+		unsigned int expectedHits = 0;
+		for (int j = 0; j < SphereCount; ++j) {
+			IntersectionResult result = ray.intersectSphere(centers[j], radii[j] * radii[j]);
+			const bool hit = (hitMasks[j / 32] & (1u << (j % 32))) != 0;
+			EXPECT(hit == result.intersects);
+			if (result.intersects) {
+				++expectedHits;
+				// Both solve the same quadratic, which loses precision far from the origin
+				EXPECT(fabs(hitDistances[j] - std::max(result.distance, 0.0f)) <= 1e-4f * result.exitDistance + 1e-3f);
+			}
+		}
+		EXPECT(hits == expectedHits);
+	}
+
+	Ray3d *rays1000 = new Ray3d[1000];
+	for (int i = 0; i < 1000; ++i) {
+		rays1000[i] = randomRay(1000);
+	}
+
+	int closestHits[2] = { 0, 0 };
+	BENCHMARK("Pick the closest of 10000 spheres with 1000 rays, one sphere at a time.") {
+		closestHits[0] = 0;
+		for (int i = 0; i < 1000; ++i) {
+			int closest = -1;
+			float closestDistance = std::numeric_limits<float>::infinity();
+			for (int j = 0; j < SphereCount; ++j) {
+				IntersectionResult result = rays1000[i].intersectSphere(centers[j], radii[j] * radii[j]);
+				if (result.intersects && result.distance < closestDistance) {
+					closest = j;
+					closestDistance = result.distance;
+				}
+			}
+			closestHits[0] += closest != -1;
+		}
+	}
+
+	BENCHMARK("Pick the closest of 10000 spheres with 1000 rays, using a sphere batch.") {
+		closestHits[1] = 0;
+		for (int i = 0; i < 1000; ++i) {
+			closestHits[1] += spheres.closest(rays1000[i]) != -1;
+		}
+	}
+	EXPECT(closestHits[0] == closestHits[1]);
+
+	delete [] rays1000;
+	delete [] hitDistances;
+	delete [] hitMasks;
+	delete [] radii;
+	delete [] centers;
+}
+
+class PacketHitCounter {
+public:
+	PacketHitCounter() : hits(0) {}
+	void operator()(unsigned int, int mask)
+	{
+		for (; mask; mask &= mask - 1)
+			++hits;
+	}
+	size_t hits;
+};
+
+/**
+  Projects the corners of a box one by one, the way projectToScreen replaces.
+  */
+static bool projectCorners(const Matrix4 &viewProjection, const Box3d &box, float *rect, float &depth)
+{
+	rect[0] = rect[1] = depth = std::numeric_limits<float>::infinity();
+	rect[2] = rect[3] = -std::numeric_limits<float>::infinity();
+
+	for (int i = 0; i < 8; ++i) {
+		const Vector4 corner((i & 1) ? box.maximum().x() : box.minimum().x(), (i & 2) ? box.maximum().y() : box.minimum().y(),
+			(i & 4) ? box.maximum().z() : box.minimum().z(), 1);
+		const Vector4 clip = viewProjection * corner;
+		if (clip.w() <= 0)
+			return false;
+
+		rect[0] = std::min(rect[0], clip.x() / clip.w());
+		rect[1] = std::min(rect[1], clip.y() / clip.w());
+		rect[2] = std::max(rect[2], clip.x() / clip.w());
+		rect[3] = std::max(rect[3], clip.y() / clip.w());
+		depth = std::min(depth, clip.z() / clip.w());
+	}
+
+	return rect[0] <= 1 && rect[1] <= 1 && rect[2] >= -1 && rect[3] >= -1 && depth <= 1;
+}
+
+static void testScreenProjection()
+{
+	const Matrix4 viewProjection = Matrix4::perspective(3.14159265f / 2, 1, 1, 100)
+		* Matrix4::lookAt(Vector4(50, 50, -20, 0), Vector4(50, 50, 50, 0), Vector4(0, 1, 0, 0));
+
+	// A box straight ahead, whose nearest face is ten units away
+	Box2d rect;
+	float depth;
+	EXPECT(Box3d(Vector4(49, 49, -10, 1), Vector4(51, 51, -9, 1)).projectToScreen(viewProjection, rect, depth));
+	EXPECT(fabs(rect.left() + 0.1f) < 1e-5f);
+	EXPECT(fabs(rect.top() + 0.1f) < 1e-5f);
+	EXPECT(fabs(rect.right() - 0.1f) < 1e-5f);
+	EXPECT(fabs(rect.bottom() - 0.1f) < 1e-5f);
+	EXPECT(fabs(rect.width() - 0.2f) < 1e-5f);
+	EXPECT(depth > -1 && depth < 1);
+
+	// Boxes beside, behind and beyond the far plane are rejected, boxes around the eye cover the screen
+	EXPECT(!Box3d(Vector4(80, 49, -10, 1), Vector4(81, 51, -9, 1)).projectToScreen(viewProjection, rect, depth));
+	EXPECT(!Box3d(Vector4(49, 49, -40, 1), Vector4(51, 51, -30, 1)).projectToScreen(viewProjection, rect, depth));
+	EXPECT(!Box3d(Vector4(49, 49, 90, 1), Vector4(51, 51, 95, 1)).projectToScreen(viewProjection, rect, depth));
+	EXPECT(Box3d(Vector4(45, 45, -25, 1), Vector4(55, 55, -15, 1)).projectToScreen(viewProjection, rect, depth));
+	COMPARE(rect.width(), 2.0f);
+	COMPARE(rect.height(), 2.0f);
+	EXPECT(depth == -std::numeric_limits<float>::infinity());
+
+	// Compare the batch against projecting every corner on its own
+	Box3d *boxes = new Box3d[BoxCount];
+	for (int i = 0; i < BoxCount; ++i)
+		boxes[i] = randomBox(100, 5);
+
+	Box2d *rects = new Box2d[BoxCount];
+	float *depths = new float[BoxCount];
+	unsigned int *visibleMasks = new unsigned int[(BoxCount + 31) / 32];
+	const size_t visible = Box3d::projectToScreen(viewProjection, boxes, BoxCount, rects, depths, visibleMasks);
+	EXPECT(visible > 0 && visible < (size_t)BoxCount);
+
+	size_t counted = 0;
+	for (int i = 0; i < BoxCount; ++i) {
+		const bool isVisible = (visibleMasks[i / 32] & (1u << (i % 32))) != 0;
+		counted += isVisible;
+
+		float expected[4];
+		float expectedDepth;
+		if (!projectCorners(viewProjection, boxes[i], expected, expectedDepth)) {
+			// Boxes reaching behind the eye or missing the screen only between their corners may pass
+			if (isVisible && depths[i] != -std::numeric_limits<float>::infinity()) {
+				EXPECT(rects[i].left() <= -1 || rects[i].right() >= 1 || rects[i].top() <= -1 || rects[i].bottom() >= 1);
+			}
+			continue;
+		}
+
+		EXPECT(isVisible);
+		if (isVisible) {
+			EXPECT(fabs(rects[i].left() - std::max(expected[0], -1.0f)) < 1e-4f);
+			EXPECT(fabs(rects[i].top() - std::max(expected[1], -1.0f)) < 1e-4f);
+			EXPECT(fabs(rects[i].right() - std::min(expected[2], 1.0f)) < 1e-4f);
+			EXPECT(fabs(rects[i].bottom() - std::min(expected[3], 1.0f)) < 1e-4f);
+			EXPECT(fabs(depths[i] - expectedDepth) < 1e-4f);
+		}
+	}
+	COMPARE(counted, visible);
+
+	BENCHMARK("Project 100000 boxes to the screen, one corner at a time.") {
+		counted = 0;
+		for (int i = 0; i < BoxCount; ++i) {
+			float expected[4];
+			float expectedDepth;
+			counted += projectCorners(viewProjection, boxes[i], expected, expectedDepth);
+		}
+	}
+	EXPECT(counted <= visible);
+
+	BENCHMARK("Project 100000 boxes to the screen in a batch.") {
+		Box3d::projectToScreen(viewProjection, boxes, BoxCount, rects, depths, visibleMasks);
+	}
+
+	delete [] visibleMasks;
+	delete [] depths;
+	delete [] rects;
+	delete [] boxes;
+}
+
+static Ray3d coherentRay(const Vector4 &origin, const Vector4 &direction)
+{
+	Vector4 jitter(randomFloat(0.02f) - 0.01f, randomFloat(0.02f) - 0.01f, 0, 0);
+	return Ray3d(origin, (direction + jitter).normalize());
+}
+
+static void testRayPackets()
+{
+	// A ray packet has to agree with the single-ray slab test
+	Box3d box(Vector4(-1, -1, 4, 1), Vector4(1, 1, 6, 1));
+	Ray3d rays[8];
+	rays[0] = Ray3d(Vector4(0, 0, 0, 1), Vector4(0, 0, 1, 0));
+	rays[1] = Ray3d(Vector4(0, 0, 0, 1), Vector4(0, 0, -1, 0));
+	rays[2] = Ray3d(Vector4(0, 0, 5, 1), Vector4(1, 0, 0, 0));
+	rays[3] = Ray3d(Vector4(5, 0, 0, 1), Vector4(0, 0, 1, 0));
+	rays[4] = Ray3d(Vector4(0, 0, 0, 1), Vector4(0, 0.6f, 0.8f, 0));
+	rays[5] = Ray3d(Vector4(-0.5f, 0, 0, 1), Vector4(0, 0, 1, 0));
+	rays[6] = Ray3d(Vector4(0, 0, 10, 1), Vector4(0, 0, -1, 0));
+	rays[7] = Ray3d(Vector4(0, 2, 0, 1), Vector4(0, 0, 1, 0));
+
+	RayPacket8 packet8(rays);
+	float distances[8];
+	const int mask = packet8.intersect(box, distances);
+	EXPECT(mask == (1 | 4 | 32 | 64));
+	COMPARE(distances[0], 4);
+	COMPARE(distances[2], 0);
+	COMPARE(distances[6], 4);
+	EXPECT(distances[1] == std::numeric_limits<float>::infinity());
+
+	RayPacket4 packet4(rays);
+	EXPECT(packet4.intersects(box) == (1 | 4));
+
+	// Shadow probes stop at the light
+	packet4.setMaximumDistance(0, 3);
+	EXPECT(packet4.intersects(box) == 4);
+
+	Box3d *boxes = new Box3d[BoxCount];
+	for (int i = 0; i < BoxCount; ++i) {
+		boxes[i] = randomBox(1000, 5);
+	}
+
+	Bvh bvh;
+	bvh.build(boxes, BoxCount);
+
+	const int RayCount = 1024;
+	Ray3d *coherentRays = new Ray3d[RayCount];
+	for (int i = 0; i < RayCount; i += 8) {
+		Vector4 origin(randomFloat(1000), randomFloat(1000), -10, 1);
+		Vector4 direction = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, 1, 0).normalize();
+		for (int j = 0; j < 8; ++j) {
+			coherentRays[i + j] = coherentRay(origin, direction);
+		}
+	}
+
+	// The packet traversal has to report the same hits as testing the packet against every box
+	for (int i = 0; i < 64; i += 8) {
+		RayPacket8 packet(coherentRays + i);
+		PacketHitCounter counter;
+		bvh.visit(packet, counter);
+
+		size_t expected = 0;
+		for (int j = 0; j < BoxCount; ++j) {
+			for (int hits = packet.intersects(boxes[j]); hits; hits &= hits - 1)
+				++expected;
+		}
+		EXPECT(counter.hits == expected);
+	}
+
+	std::vector<unsigned int> found;
+	BENCHMARK("Trace 1024 coherent rays one by one through a BVH.") {
+		for (int i = 0; i < RayCount; ++i) {
+			found.clear();
+			bvh.query(coherentRays[i], found);
+		}
+	}
+
+	BENCHMARK("Trace 1024 coherent rays in packets of 4 through a BVH.") {
+		for (int i = 0; i < RayCount; i += 4) {
+			PacketHitCounter counter;
+			bvh.visit(RayPacket4(coherentRays + i), counter);
+		}
+	}
+
+	BENCHMARK("Trace 1024 coherent rays in packets of 8 through a BVH.") {
+		for (int i = 0; i < RayCount; i += 8) {
+			PacketHitCounter counter;
+			bvh.visit(RayPacket8(coherentRays + i), counter);
+		}
+	}
+
+	delete [] coherentRays;
+	delete [] boxes;
+}
+
+static size_t countPairs(const DynamicTree &tree, const int *proxies, int count)
+{
+	size_t pairs = 0;
+	for (int i = 0; i < count; ++i) {
+		for (int j = i + 1; j < count; ++j) {
+			if (proxies[i] != DynamicTree::NullNode && proxies[j] != DynamicTree::NullNode
+				&& tree.fatBox(proxies[i]).intersects(tree.fatBox(proxies[j])))
+				++pairs;
+		}
+	}
+	return pairs;
+}
+
+static void testDynamicTree()
+{
+	const int ProxyCount = 5000;
+
+	Box3d *boxes = new Box3d[ProxyCount];
+	int *proxies = new int[ProxyCount];
+
+	DynamicTree tree;
+	for (int i = 0; i < ProxyCount; ++i) {
+		boxes[i] = randomBox(1000, 5);
+		proxies[i] = tree.createProxy(boxes[i], i);
+	}
+	EXPECT(tree.proxyCount() == ProxyCount);
+	EXPECT(tree.userData(proxies[123]) == 123);
+
+	// Inserting sorted boxes would degenerate into a list without rotations
+	EXPECT(tree.height() < 30);
+
+	std::vector<DynamicTreePair> pairs;
+	tree.queryPairs(pairs);
+	EXPECT(pairs.size() == countPairs(tree, proxies, ProxyCount));
+
+	// Small movements stay within the fattened boxes and don't touch the tree
+	Vector4 nudge(0.05f, 0, 0, 0);
+	Box3d moved(boxes[0].minimum() + nudge, boxes[0].maximum() + nudge);
+	EXPECT(!tree.moveProxy(proxies[0], moved, nudge));
+
+	for (int frame = 0; frame < 10; ++frame) {
+		for (int i = 0; i < ProxyCount; ++i) {
+			Vector4 displacement(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+			boxes[i] = Box3d(boxes[i].minimum() + displacement, boxes[i].maximum() + displacement);
+			tree.moveProxy(proxies[i], boxes[i], displacement);
+			EXPECT(tree.fatBox(proxies[i]).contains(boxes[i]));
+		}
+	}
+
+	// Remove every third proxy. Their handles are reused by new proxies.
+	for (int i = 0; i < ProxyCount; i += 3) {
+		tree.destroyProxy(proxies[i]);
+		proxies[i] = DynamicTree::NullNode;
+	}
+	EXPECT(tree.proxyCount() == ProxyCount - (ProxyCount + 2) / 3);
+
+	pairs.clear();
+	tree.queryPairs(pairs);
+	EXPECT(pairs.size() == countPairs(tree, proxies, ProxyCount));
+
+	std::vector<int> found;
+	Box3d area = randomBox(1000, 50);
+	tree.query(area, found);
+	size_t expected = 0;
+	for (int i = 0; i < ProxyCount; ++i) {
+		if (proxies[i] != DynamicTree::NullNode && area.intersects(tree.fatBox(proxies[i])))
+			++expected;
+	}
+	EXPECT(found.size() == expected);
+
+	for (int i = 0; i < ProxyCount; i += 3) {
+		proxies[i] = tree.createProxy(boxes[i], i);
+	}
+	EXPECT(tree.height() < 30);
+
+	BENCHMARK("Find overlapping pairs among 5000 boxes with a dynamic tree.") {
+		pairs.clear();
+		tree.queryPairs(pairs);
+	}
+
+	size_t bruteForcePairs = 0;
+	BENCHMARK("Find overlapping pairs among 5000 boxes by brute force.") {
+		bruteForcePairs = countPairs(tree, proxies, ProxyCount);
+	}
+	EXPECT(bruteForcePairs == pairs.size());
+
+	BENCHMARK("Move 5000 proxies of a dynamic tree.") {
+		for (int i = 0; i < ProxyCount; ++i) {
+			Vector4 displacement(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+			boxes[i] = Box3d(boxes[i].minimum() + displacement, boxes[i].maximum() + displacement);
+			tree.moveProxy(proxies[i], boxes[i], displacement);
+		}
+	}
+
+	tree.clear();
+	EXPECT(tree.isEmpty());
+
+	delete [] proxies;
+	delete [] boxes;
+}
+
+static void checkSweepAndPrune(const SweepAndPrune &broadphase, const int *proxies, int count)
+{
+	size_t expected = 0;
+	for (int i = 0; i < count; ++i) {
+		if (proxies[i] == SweepAndPrune::NullProxy)
+			continue;
+		for (int j = i + 1; j < count; ++j) {
+			if (proxies[j] != SweepAndPrune::NullProxy
+				&& broadphase.box(proxies[i]).intersects(broadphase.box(proxies[j])))
+				++expected;
+		}
+	}
+	EXPECT(broadphase.pairs().size() == expected);
+}
+
+static void testSweepAndPrune()
+{
+	const int ProxyCount = 5000;
+
+	Box3d *boxes = new Box3d[ProxyCount];
+	int *proxies = new int[ProxyCount];
+
+	SweepAndPrune broadphase;
+	for (int i = 0; i < ProxyCount; ++i) {
+		boxes[i] = randomBox(1000, 5);
+		proxies[i] = broadphase.createProxy(boxes[i]);
+	}
+	broadphase.update();
+	checkSweepAndPrune(broadphase, proxies, ProxyCount);
+	EXPECT(broadphase.addedPairs().size() == broadphase.pairs().size());
+	EXPECT(broadphase.removedPairs().empty());
+
+	// Two boxes that only touch along the sort axis
+	SweepAndPrune touching;
+	int a = touching.createProxy(Box3d(Vector4(0, 0, 0, 1), Vector4(1, 1, 1, 1)));
+	int b = touching.createProxy(Box3d(Vector4(1, 0, 0, 1), Vector4(2, 1, 1, 1)));
+	touching.update();
+	EXPECT(touching.pairs().size() == 1);
+	touching.moveProxy(b, Box3d(Vector4(1, 2, 0, 1), Vector4(2, 3, 1, 1)));
+	touching.update();
+	EXPECT(touching.pairs().empty());
+	EXPECT(touching.removedPairs().size() == 1);
+	EXPECT(touching.removedPairs()[0].proxyA == std::min(a, b));
+
+	for (int frame = 0; frame < 10; ++frame) {
+		std::vector<SweepAndPrunePair> previous = broadphase.pairs();
+
+		for (int i = 0; i < ProxyCount; ++i) {
+			Vector4 displacement(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+			boxes[i] = Box3d(boxes[i].minimum() + displacement, boxes[i].maximum() + displacement);
+			broadphase.moveProxy(proxies[i], boxes[i]);
+		}
+		broadphase.update();
+		checkSweepAndPrune(broadphase, proxies, ProxyCount);
+
+		// Applying the changes to the previous pairs has to yield the current pairs
+		std::vector<SweepAndPrunePair> kept, applied;
+		std::set_difference(previous.begin(), previous.end(), broadphase.removedPairs().begin(),
+			broadphase.removedPairs().end(), std::back_inserter(kept));
+		std::set_union(kept.begin(), kept.end(), broadphase.addedPairs().begin(),
+			broadphase.addedPairs().end(), std::back_inserter(applied));
+		EXPECT(applied == broadphase.pairs());
+	}
+
+	// Destroyed proxies lose all of their pairs
+	for (int i = 0; i < ProxyCount; i += 3) {
+		broadphase.destroyProxy(proxies[i]);
+		proxies[i] = SweepAndPrune::NullProxy;
+	}
+	broadphase.update();
+	checkSweepAndPrune(broadphase, proxies, ProxyCount);
+	EXPECT(broadphase.addedPairs().empty());
+	EXPECT(broadphase.proxyCount() == ProxyCount - (ProxyCount + 2) / 3);
+
+	for (int i = 0; i < ProxyCount; i += 3) {
+		proxies[i] = broadphase.createProxy(boxes[i]);
+	}
+	broadphase.update();
+	checkSweepAndPrune(broadphase, proxies, ProxyCount);
+
+	BENCHMARK("Move 5000 boxes and update the sweep and prune broadphase.") {
+		for (int i = 0; i < ProxyCount; ++i) {
+			Vector4 displacement(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+			boxes[i] = Box3d(boxes[i].minimum() + displacement, boxes[i].maximum() + displacement);
+			broadphase.moveProxy(proxies[i], boxes[i]);
+		}
+		broadphase.update();
+	}
+
+	delete [] proxies;
+	delete [] boxes;
+}
+
+int main(int argc, char *argv[])
+{
+	// Merging a point must grow the minimum and the maximum independently
+	Box3d box(Vector4(0, 0, 0, 1), Vector4(0, 0, 0, 1));
+	box.merge(Vector4(-1, 2, -3, 1));
+	COMPARE(box.minimum().x(), -1);
+	COMPARE(box.minimum().y(), 0);
+	COMPARE(box.minimum().z(), -3);
+	COMPARE(box.maximum().x(), 0);
+	COMPARE(box.maximum().y(), 2);
+	COMPARE(box.maximum().z(), 0);
+
+	Vector4 *points = new Vector4[PointCount];
+	for (int i = 0; i < PointCount; ++i) {
+		points[i] = Vector4(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, 1);
+	}
+	points[12345] = Vector4(-5, 0.5f, 0.5f, 1);
+	points[PointCount - 1] = Vector4(0.5f, 7, 0.5f, 1);
+	points[PointCount / 2] = Vector4(0.5f, 0.5f, -9, 1);
+
+	Box3d bounds = Box3d::fromPoints(points, PointCount);
+	COMPARE(bounds.minimum().x(), -5);
+	COMPARE(bounds.maximum().y(), 7);
+	COMPARE(bounds.minimum().z(), -9);
+
+	Box3d parallelBounds = Box3d::fromPointsParallel(points, PointCount);
+	EXPECT(parallelBounds.minimum() == bounds.minimum());
+	EXPECT(parallelBounds.maximum() == bounds.maximum());
+
+	// Odd counts exercise the remainder loop
+	Box3d smallBounds = Box3d::fromPoints(points + PointCount - 3, 3);
+	COMPARE(smallBounds.maximum().y(), 7);
+
+	EXPECT(Box3d::fromPoints(points, 0).isNull());
+
+	BENCHMARK("Bounding box of 4M points (single thread).") {
+		bounds = Box3d::fromPoints(points, PointCount);
+	}
+
+	BENCHMARK("Bounding box of 4M points (all cores).") {
+		bounds = Box3d::fromPointsParallel(points, PointCount);
+	}
+
+	delete [] points;
+
+	testRayIntersection();
+	testSphereBatch();
+	testScreenProjection();
+	testFrustum();
+	testBvh();
+	testRayPackets();
+	testDynamicTree();
+	testSweepAndPrune();
+
+	printf("Press enter to continue.\n");
+	fgetc(stdin);
+
+	return 0;
+}
@@ -5,6 +5,8 @@
 
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <limits>
 
 typedef unsigned int uint;
@@ -101,6 +103,51 @@ GAMEMATH_INLINE void aCompare(float actual, float expected, const char *actualEx
 #define COMPARE(actual, expected) aCompare(actual, expected, #actual, #expected);
 #define EXPECT(actual) if (!(actual)) { printf("Assertion failed for %s.\n", #actual); }
 
+/**
+ * Returns a random number between 0 and range.
+ */
+GAMEMATH_INLINE float randomFloat(float range)
+{
+	return rand() / (float)RAND_MAX * range;
+}
+
+/**
+ * Returns a normalized rotation around a random axis by a random angle.
+ */
+GAMEMATH_INLINE GameMath::Quaternion randomRotation()
+{
+	const GameMath::Vector4 axis = GameMath::Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0).normalized();
+	return GameMath::Quaternion::fromAxisAndAngle(axis.x(), axis.y(), axis.z(), randomFloat(6.28f));
+}
+
+/**
+ * Compares all four components, which must not differ by epsilon or more.
+ */
+GAMEMATH_INLINE bool fuzzyCompare(const GameMath::Vector4 &a, const GameMath::Vector4 &b, float epsilon = 1e-4f)
+{
+	return fabs(a.x() - b.x()) < epsilon && fabs(a.y() - b.y()) < epsilon && fabs(a.z() - b.z()) < epsilon
+		&& fabs(a.w() - b.w()) < epsilon;
+}
+
+GAMEMATH_INLINE bool fuzzyCompare(const GameMath::Quaternion &a, const GameMath::Quaternion &b, float epsilon = 1e-5f)
+{
+	return fabs(a.x() - b.x()) < epsilon && fabs(a.y() - b.y()) < epsilon && fabs(a.z() - b.z()) < epsilon
+		&& fabs(a.w() - b.w()) < epsilon;
+}
+
+/**
+ * Compares the elements through data(), since Matrix4::column() reinterprets the float array as a Vector4,
+ * which breaks strict aliasing and can read stale values in optimized builds.
+ */
+GAMEMATH_INLINE bool fuzzyCompare(const GameMath::Matrix4 &a, const GameMath::Matrix4 &b, float epsilon = 1e-4f)
+{
+	for (int i = 0; i < 16; ++i) {
+		if (fabs(a.data()[i] - b.data()[i]) >= epsilon)
+			return false;
+	}
+	return true;
+}
+
 static void printVector(const GameMath::Vector4 &v) {
 	printf("%f %f %f %f\n", v.x(), v.y(), v.z(), v.w());	
 }
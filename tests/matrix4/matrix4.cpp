@@ -13,6 +13,397 @@ static Vector4 normalIn[10000];
 static Vector4 positionOut[10000];
 static Vector4 normalOut[10000];
 
+static bool relativeCompare(const Matrix4 &a, const Matrix4 &b, float epsilon)
+{
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			if (fabs(a(row, col) - b(row, col)) > epsilon * (1 + fabs(b(row, col))))
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+  Checks that the inverse of a projection is exact and that a point in view space ends up at the
+  expected depth and back.
+  */
+static void checkProjection(const Matrix4 &projection, const Matrix4 &inverse, float nearDepth, float farDepth,
+							float nearVal, float farVal)
+{
+	EXPECT(relativeCompare(projection * inverse, Matrix4::identity(), 1e-5f));
+	EXPECT(relativeCompare(inverse, projection.inverted(), 1e-3f));
+
+	Vector4 clip = projection * Vector4(0, 0, -nearVal, 1);
+	EXPECT(fabs(clip.z() / clip.w() - nearDepth) < 1e-5f);
+	if (farVal != 0) {
+		clip = projection * Vector4(0, 0, -farVal, 1);
+		EXPECT(fabs(clip.z() / clip.w() - farDepth) < 1e-4f);
+	}
+
+	const Vector4 point(1.5f, -2.5f, -7, 1);
+	clip = projection * point;
+	const Vector4 unprojected = inverse.unproject(Vector4(clip.x() / clip.w(), clip.y() / clip.w(), clip.z() / clip.w(), 1));
+	EXPECT(fabs(unprojected.x() - point.x()) < 1e-3f);
+	EXPECT(fabs(unprojected.y() - point.y()) < 1e-3f);
+	EXPECT(fabs(unprojected.z() - point.z()) < 1e-3f);
+	COMPARE(unprojected.w(), 1);
+}
+
+static void testProjections()
+{
+	const float fovY = (float)M_PI / 3;
+	Matrix4 inverse;
+
+	// gluPerspective(60, 1.5, 0.5, 200), with the angle in radians
+	Matrix4 projection = Matrix4::perspective(fovY, 1.5f, 0.5f, 200, &inverse);
+	const float f = 1 / tan(fovY / 2);
+	COMPARE(projection(0, 0), f / 1.5f);
+	COMPARE(projection(1, 1), f);
+	COMPARE(projection(3, 2), -1);
+	COMPARE(projection(3, 3), 0);
+	checkProjection(projection, inverse, -1, 1, 0.5f, 200);
+
+	// An off-center frustum, the way it is used for stereo rendering
+	projection = Matrix4::frustum(-0.3f, 0.5f, -0.2f, 0.4f, 0.5f, 200, &inverse);
+	COMPARE(projection(0, 2), 0.25f);
+	checkProjection(projection, inverse, -1, 1, 0.5f, 200);
+
+	projection = Matrix4::infinitePerspective(fovY, 1.5f, 0.5f, &inverse);
+	checkProjection(projection, inverse, -1, 1, 0.5f, 0);
+	Vector4 clip = projection * Vector4(0, 0, -1e6f, 1);
+	EXPECT(clip.z() / clip.w() < 1);
+
+	projection = Matrix4::reversedPerspective(fovY, 1.5f, 0.5f, 200, &inverse);
+	checkProjection(projection, inverse, 1, 0, 0.5f, 200);
+
+	projection = Matrix4::reversedInfinitePerspective(fovY, 1.5f, 0.5f, &inverse);
+	checkProjection(projection, inverse, 1, 0, 0.5f, 0);
+	clip = projection * Vector4(0, 0, -1e6f, 1);
+	EXPECT(clip.z() / clip.w() > 0);
+
+	// Picking rays through a grid of screen points, unprojected at the near and far plane
+	const Matrix4 view = Matrix4::lookAt(Vector4(10, 5, 10, 0), Vector4(0, 0, 0, 0), Vector4(0, 1, 0, 0));
+	const Matrix4 inverseView = view.inverted();
+	Matrix4 inverseProjection;
+	projection = Matrix4::perspective(fovY, 1.5f, 0.5f, 200, &inverseProjection);
+	const Matrix4 viewProjection = projection * view;
+	const Matrix4 inverseViewProjection = inverseView * inverseProjection;
+	EXPECT(relativeCompare(inverseViewProjection, viewProjection.inverted(), 1e-3f));
+
+	const int PointCount = 1000;
+	Vector4 *points = new Vector4[2 * PointCount];
+	Vector4 *results = new Vector4[2 * PointCount];
+	for (int i = 0; i < PointCount; ++i) {
+		const float x = (i % 40) / 20.0f - 1;
+		const float y = (i / 40) / 12.5f - 1;
+		points[2 * i] = Vector4(x, y, -1, 1);
+		points[2 * i + 1] = Vector4(x, y, 1, 1);
+	}
+	inverseViewProjection.unproject(points, 2 * PointCount, results);
+
+	for (int i = 0; i < 2 * PointCount; ++i) {
+		const Vector4 expected = inverseViewProjection.unproject(points[i]);
+		EXPECT(fabs(results[i].x() - expected.x()) < 1e-3f && fabs(results[i].y() - expected.y()) < 1e-3f
+			&& fabs(results[i].z() - expected.z()) < 1e-3f);
+
+		const Vector4 clip = viewProjection * results[i];
+		EXPECT(fabs(clip.x() / clip.w() - points[i].x()) < 1e-3f && fabs(clip.y() / clip.w() - points[i].y()) < 1e-3f);
+	}
+
+	// The view stays the same, while the projection changes every frame, e.g. for a zoom
+	BENCHMARK("Invert 1000 view-projection matrices in general.") {
+		for (int i = 0; i < PointCount; ++i) {
+			const Matrix4 inverted = (Matrix4::perspective(fovY + i * 1e-4f, 1.5f, 0.5f, 200) * view).inverted();
+			results[i] = inverted.unproject(points[i]);
+		}
+	}
+
+	BENCHMARK("Invert 1000 view-projection matrices with an analytic projection inverse.") {
+		for (int i = 0; i < PointCount; ++i) {
+			Matrix4 inverse;
+			Matrix4::perspective(fovY + i * 1e-4f, 1.5f, 0.5f, 200, &inverse);
+			results[i] = (inverseView * inverse).unproject(points[i]);
+		}
+	}
+
+	BENCHMARK("Unproject 1000 picking rays in a batch.") {
+		inverseViewProjection.unproject(points, 2 * PointCount, results);
+	}
+
+	delete [] results;
+	delete [] points;
+}
+
+static Matrix4 randomTransformation()
+{
+	const Vector4 axis = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0).normalized();
+	const Quaternion rotation = Quaternion::fromAxisAndAngle(axis.x(), axis.y(), axis.z(), randomFloat(6.28f));
+	const Vector4 scale(0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), 0);
+	const Vector4 translation(randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(20) - 10, 1);
+	return Matrix4::transformation(scale, rotation, translation);
+}
+
+static bool relativeCompare(const Vector4 &a, const Vector4 &b, float epsilon)
+{
+	return fabs(a.x() - b.x()) <= epsilon * (1 + fabs(b.x())) && fabs(a.y() - b.y()) <= epsilon * (1 + fabs(b.y()))
+		&& fabs(a.z() - b.z()) <= epsilon * (1 + fabs(b.z())) && fabs(a.w() - b.w()) <= epsilon * (1 + fabs(b.w()));
+}
+
+/**
+  The elements of a transformation matrix as they are usually written down, computed one at a time.
+  */
+static Matrix4 referenceTransformation(const Vector4 &scale, const Quaternion &rotation, const Vector4 &translation)
+{
+	const float x = rotation.x(), y = rotation.y(), z = rotation.z(), w = rotation.w();
+
+	Matrix4 result;
+	result(0, 0) = scale.x() * (1 - 2 * y * y - 2 * z * z);
+	result(1, 0) = scale.x() * (2 * x * y + 2 * w * z);
+	result(2, 0) = scale.x() * (2 * x * z - 2 * w * y);
+	result(3, 0) = 0;
+
+	result(0, 1) = scale.y() * (2 * x * y - 2 * w * z);
+	result(1, 1) = scale.y() * (1 - 2 * x * x - 2 * z * z);
+	result(2, 1) = scale.y() * (2 * y * z + 2 * w * x);
+	result(3, 1) = 0;
+
+	result(0, 2) = scale.z() * (2 * x * z + 2 * w * y);
+	result(1, 2) = scale.z() * (2 * y * z - 2 * w * x);
+	result(2, 2) = scale.z() * (1 - 2 * x * x - 2 * y * y);
+	result(3, 2) = 0;
+
+	result(0, 3) = translation.x();
+	result(1, 3) = translation.y();
+	result(2, 3) = translation.z();
+	result(3, 3) = 1;
+	return result;
+}
+
+static void testTransformation()
+{
+	// Not a multiple of four, so the remainder of the batch is converted one at a time
+	const int MatrixCount = 1003;
+
+	Vector4 *scales = new Vector4[MatrixCount];
+	Quaternion *rotations = new Quaternion[MatrixCount];
+	Vector4 *translations = new Vector4[MatrixCount];
+	Matrix4 *results = new Matrix4[MatrixCount];
+	for (int i = 0; i < MatrixCount; ++i) {
+		const Vector4 axis = Vector4(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0).normalized();
+		rotations[i] = Quaternion::fromAxisAndAngle(axis.x(), axis.y(), axis.z(), randomFloat(6.28f));
+		scales[i] = Vector4(0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), 0.5f + randomFloat(1.5f), randomFloat(1));
+		translations[i] = Vector4(randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(1));
+	}
+
+	Matrix4::transformation(scales, rotations, translations, MatrixCount, results);
+	for (int i = 0; i < MatrixCount; ++i) {
+		const Matrix4 expected = referenceTransformation(scales[i], rotations[i], translations[i]);
+		EXPECT(relativeCompare(Matrix4::transformation(scales[i], rotations[i], translations[i]), expected, 1e-6f));
+		EXPECT(relativeCompare(results[i], expected, 1e-6f));
+		EXPECT(relativeCompare(Matrix4::rotation(rotations[i]),
+			referenceTransformation(Vector4(1, 1, 1, 0), rotations[i], Vector4(0, 0, 0, 0)), 1e-6f));
+	}
+
+	BENCHMARK("Build 1000 transformation matrices one element at a time.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			results[i] = referenceTransformation(scales[i], rotations[i], translations[i]);
+	}
+
+	BENCHMARK("Build 1000 transformation matrices one by one.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			results[i] = Matrix4::transformation(scales[i], rotations[i], translations[i]);
+	}
+
+	BENCHMARK("Build 1000 transformation matrices in a batch.") {
+		Matrix4::transformation(scales, rotations, translations, MatrixCount, results);
+	}
+
+	delete [] results;
+	delete [] translations;
+	delete [] rotations;
+	delete [] scales;
+}
+
+/**
+  Checks that decompose returned a normalized rotation and that rotation^T * matrix, the stretch left after
+  removing the rotation, is symmetric and has the scale on its diagonal, which makes it a polar decomposition.
+  */
+static bool isPolarDecomposition(const Matrix4 &matrix, const Vector4 &scale, const Quaternion &rotation, float epsilon)
+{
+	if (fabs(rotation.x() * rotation.x() + rotation.y() * rotation.y() + rotation.z() * rotation.z()
+		+ rotation.w() * rotation.w() - 1) > epsilon)
+		return false;
+
+	// A mirroring is part of the orthogonal factor, which decompose returns as a negative x scale
+	Matrix4 orthogonal = Matrix4::rotation(rotation);
+	const float mirror = scale.x() < 0 ? -1.0f : 1.0f;
+	for (int row = 0; row < 3; ++row)
+		orthogonal(row, 0) *= mirror;
+
+	float stretch[3][3];
+	for (int row = 0; row < 3; ++row)
+		for (int col = 0; col < 3; ++col)
+			stretch[row][col] = orthogonal(0, row) * matrix(0, col) + orthogonal(1, row) * matrix(1, col)
+				+ orthogonal(2, row) * matrix(2, col);
+
+	const float diagonal[3] = { mirror * scale.x(), scale.y(), scale.z() };
+	for (int row = 0; row < 3; ++row) {
+		if (fabs(stretch[row][row] - diagonal[row]) > epsilon * (1 + fabs(diagonal[row])))
+			return false;
+		for (int col = row + 1; col < 3; ++col)
+			if (fabs(stretch[row][col] - stretch[col][row]) > epsilon * (1 + fabs(stretch[row][col])))
+				return false;
+	}
+	return true;
+}
+
+static void testDecomposition()
+{
+	Vector4 scale, translation;
+	Quaternion rotation;
+
+	EXPECT(Matrix4::identity().decompose(scale, rotation, translation));
+	EXPECT(relativeCompare(scale, Vector4(1, 1, 1, 0), 1e-6f));
+	EXPECT(relativeCompare(translation, Vector4(0, 0, 0, 0), 1e-6f));
+	COMPARE(rotation.w(), 1);
+
+	// 180 degrees around x has no w component, so the conversion has to start with x
+	EXPECT(Matrix4::transformation(Vector4(2, 3, 4, 0), Quaternion(1, 0, 0, 0), Vector4(1, 2, 3, 1))
+		.decompose(scale, rotation, translation));
+	EXPECT(relativeCompare(scale, Vector4(2, 3, 4, 0), 1e-6f));
+	EXPECT(relativeCompare(translation, Vector4(1, 2, 3, 0), 1e-6f));
+	EXPECT(fabs(fabs(rotation.x()) - 1) <= 1e-6f);
+
+	// Mirroring is returned as a negative x scale
+	EXPECT(Matrix4::scaling(1, -2, 1).decompose(scale, rotation, translation));
+	EXPECT(scale.x() < 0);
+	EXPECT(relativeCompare(Matrix4::transformation(scale, rotation, translation), Matrix4::scaling(1, -2, 1), 1e-5f));
+
+	EXPECT(!Matrix4::scaling(1, 0, 1).decompose(scale, rotation, translation));
+	COMPARE(rotation.w(), 1);
+
+	// Not a multiple of four, so the remainder of the batch is decomposed one at a time
+	const int MatrixCount = 1003;
+
+	Matrix4 *matrices = new Matrix4[MatrixCount];
+	Vector4 *scales = new Vector4[MatrixCount];
+	Quaternion *rotations = new Quaternion[MatrixCount];
+	Vector4 *translations = new Vector4[MatrixCount];
+	for (int i = 0; i < MatrixCount; ++i) {
+		matrices[i] = randomTransformation();
+		if (i % 7 == 0) {
+			// Mirror along y
+			for (int row = 0; row < 3; ++row)
+				matrices[i](row, 1) = -matrices[i](row, 1);
+		}
+		if (i % 5 == 0) {
+			// Shear x along y
+			for (int row = 0; row < 3; ++row)
+				matrices[i](row, 1) += (0.1f + randomFloat(0.4f)) * matrices[i](row, 0);
+		}
+	}
+
+	Matrix4::decompose(matrices, MatrixCount, scales, rotations, translations);
+	for (int i = 0; i < MatrixCount; ++i) {
+		EXPECT(matrices[i].decompose(scale, rotation, translation));
+		EXPECT(relativeCompare(scales[i], scale, 1e-6f));
+		EXPECT(relativeCompare(translations[i], translation, 1e-6f));
+		EXPECT(fabs(rotations[i].x() - rotation.x()) <= 1e-6f && fabs(rotations[i].y() - rotation.y()) <= 1e-6f
+			&& fabs(rotations[i].z() - rotation.z()) <= 1e-6f && fabs(rotations[i].w() - rotation.w()) <= 1e-6f);
+
+		EXPECT(relativeCompare(translation, Vector4(matrices[i](0, 3), matrices[i](1, 3), matrices[i](2, 3), 0), 1e-6f));
+		EXPECT(isPolarDecomposition(matrices[i], scale, rotation, 1e-4f));
+		if (i % 5 != 0)
+			EXPECT(relativeCompare(Matrix4::transformation(scale, rotation, translation), matrices[i], 1e-4f));
+	}
+
+	BENCHMARK("Decompose 1000 transformation matrices one by one.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			matrices[i].decompose(scales[i], rotations[i], translations[i]);
+	}
+
+	BENCHMARK("Decompose 1000 transformation matrices in a batch.") {
+		Matrix4::decompose(matrices, MatrixCount, scales, rotations, translations);
+	}
+
+	delete [] translations;
+	delete [] rotations;
+	delete [] scales;
+	delete [] matrices;
+}
+
+static void testMatrix3x4()
+{
+	const int MatrixCount = 1000;
+
+	Matrix4 *matrices = new Matrix4[MatrixCount];
+	Matrix3x4 *compact = new Matrix3x4[MatrixCount];
+	for (int i = 0; i < MatrixCount; ++i)
+		matrices[i] = randomTransformation();
+	Matrix3x4::fromMatrix4(matrices, MatrixCount, compact);
+
+	const Matrix3x4 identity = Matrix3x4::identity();
+	EXPECT(relativeCompare(identity.toMatrix4(), Matrix4::identity(), 0));
+
+	for (int i = 0; i < MatrixCount; ++i) {
+		const Matrix4 &matrix = matrices[i];
+		const Matrix3x4 &affine = compact[i];
+		const int next = (i + 1) % MatrixCount;
+
+		EXPECT(relativeCompare(affine.toMatrix4(), matrix, 0));
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 4; ++col)
+				COMPARE(affine(row, col), matrix(row, col));
+		}
+
+		const Vector4 point(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 1);
+		const Vector4 normal(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+		EXPECT(relativeCompare(affine.mapPosition(point), matrix.mapPosition(point), 1e-5f));
+		EXPECT(relativeCompare(affine.mapNormal(normal), matrix.mapNormal(normal), 1e-5f));
+		EXPECT(relativeCompare(affine * point, matrix * point, 1e-5f));
+		EXPECT(relativeCompare(affine * normal, matrix * normal, 1e-5f));
+
+		EXPECT(relativeCompare((affine * compact[next]).toMatrix4(), matrix * matrices[next], 1e-5f));
+		EXPECT(relativeCompare(affine.inverted().toMatrix4(), matrix.inverted(), 1e-4f));
+		EXPECT(relativeCompare((affine * affine.inverted()).toMatrix4(), Matrix4::identity(), 1e-5f));
+	}
+
+	const Quaternion rotation = Quaternion::fromAxisAndAngle(0, 1, 0, (float)M_PI_2);
+	const Matrix3x4 boneMatrix = Matrix3x4::transformation(Vector4(2, 3, 4, 0), rotation, Vector4(10, 20, 30, 0));
+	EXPECT(relativeCompare(boneMatrix.toMatrix4(), Matrix4::transformation(Vector4(2, 3, 4, 0), rotation, Vector4(10, 20, 30, 0)),
+		1e-6f));
+
+	Matrix4 *results = new Matrix4[MatrixCount];
+	Matrix3x4 *compactResults = new Matrix3x4[MatrixCount];
+	printf("Matrix4 uses %u bytes, Matrix3x4 uses %u bytes.\n", (unsigned int)sizeof(Matrix4), (unsigned int)sizeof(Matrix3x4));
+
+	BENCHMARK("Concatenate 1000 matrices.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			results[i] = matrices[i] * matrices[(i + 1) % MatrixCount];
+	}
+
+	BENCHMARK("Concatenate 1000 3x4 matrices.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			compactResults[i] = compact[i] * compact[(i + 1) % MatrixCount];
+	}
+
+	BENCHMARK("Invert 1000 matrices.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			results[i] = matrices[i].inverted();
+	}
+
+	BENCHMARK("Invert 1000 3x4 matrices.") {
+		for (int i = 0; i < MatrixCount; ++i)
+			compactResults[i] = compact[i].inverted();
+	}
+
+	delete [] compactResults;
+	delete [] results;
+	delete [] compact;
+	delete [] matrices;
+}
+
 int main(int argc, char *argv[])
 {
 	Matrix4 m = Matrix4::scaling(2, 2, 2);
@@ -51,6 +442,11 @@ int main(int argc, char *argv[])
 	COMPARE(trans1(2, 3), 3);
 	COMPARE(trans1(3, 3), 5); // identity matrix is base
 
+	testProjections();
+	testTransformation();
+	testMatrix3x4();
+	testDecomposition();
+
 	printf("Press enter to continue.\n");
 	fgetc(stdin);
 
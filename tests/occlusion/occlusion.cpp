@@ -0,0 +1,176 @@
+
+#include "../common/common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GameMath;
+
+/**
+  Appends the eight corners and twelve triangles of a box to the given mesh.
+  */
+static void appendBox(const Box3d &box, std::vector<Vector4> &positions, std::vector<unsigned short> &indices)
+{
+	static const unsigned short BoxIndices[36] = {
+		0, 2, 1, 1, 2, 3, // -z
+		4, 5, 6, 5, 7, 6, // +z
+		0, 1, 4, 1, 5, 4, // -y
+		2, 6, 3, 3, 6, 7, // +y
+		0, 4, 2, 2, 4, 6, // -x
+		1, 3, 5, 3, 7, 5  // +x
+	};
+
+	const unsigned short first = (unsigned short)positions.size();
+	for (int i = 0; i < 8; ++i) {
+		positions.push_back(Vector4((i & 1) ? box.maximum().x() : box.minimum().x(),
+			(i & 2) ? box.maximum().y() : box.minimum().y(),
+			(i & 4) ? box.maximum().z() : box.minimum().z(), 1));
+	}
+	for (int i = 0; i < 36; ++i)
+		indices.push_back(first + BoxIndices[i]);
+}
+
+static void testWall()
+{
+	const Matrix4 projection = Matrix4::perspective(3.14159265f / 2, 1, 0.1f, 1000);
+
+	OcclusionBuffer buffer(64, 64);
+	EXPECT(buffer.width() == 64);
+	EXPECT(buffer.height() == 64);
+
+	// A wall filling the center of the screen, ten units in front of the eye
+	Vector4 wall[4] = { Vector4(-5, -5, -10, 1), Vector4(5, -5, -10, 1), Vector4(-5, 5, -10, 1), Vector4(5, 5, -10, 1) };
+	unsigned short wallIndices[6] = { 0, 1, 2, 1, 3, 2 };
+	buffer.addOccluder(projection, wall, 4, wallIndices, 2);
+	buffer.rasterize();
+
+	// The center pixels are covered at a depth of 1 / 10, the corners are empty
+	EXPECT(fabs(buffer.depth()[32 * 64 + 32] - 0.1f) < 1e-4f);
+	EXPECT(buffer.depth()[0] == 0);
+	EXPECT(buffer.tileDepth()[0] == 0);
+	EXPECT(buffer.tileDepth()[4 * 8 + 4] > 0);
+
+	EXPECT(!buffer.isVisible(projection, Box3d(Vector4(-1, -1, -21, 1), Vector4(1, 1, -20, 1))));
+	EXPECT(buffer.isVisible(projection, Box3d(Vector4(-1, -1, -6, 1), Vector4(1, 1, -5, 1))));
+
+	// Boxes reaching past the edge of the wall, crossing the near plane or intersecting the wall are visible
+	EXPECT(buffer.isVisible(projection, Box3d(Vector4(4, -1, -21, 1), Vector4(12, 1, -20, 1))));
+	EXPECT(buffer.isVisible(projection, Box3d(Vector4(-1, -1, -20, 1), Vector4(1, 1, 1, 1))));
+	EXPECT(buffer.isVisible(projection, Box3d(Vector4(-1, -1, -11, 1), Vector4(1, 1, -9, 1))));
+
+	// Boxes behind the eye or outside of the screen are hidden
+	EXPECT(!buffer.isVisible(projection, Box3d(Vector4(-1, -1, 5, 1), Vector4(1, 1, 6, 1))));
+	EXPECT(!buffer.isVisible(projection, Box3d(Vector4(100, -1, -6, 1), Vector4(101, 1, -5, 1))));
+
+	OcclusionStatistics statistics = buffer.statistics();
+	EXPECT(statistics.occluders == 1);
+	EXPECT(statistics.occluderTriangles == 2);
+	EXPECT(statistics.rasterizedTriangles == 2);
+	EXPECT(statistics.occludees == 7);
+	EXPECT(statistics.culled == 3);
+
+	// A wall crossing the near plane is clipped instead of being dropped
+	buffer.clear();
+	buffer.resetStatistics();
+	Vector4 floor[4] = { Vector4(-50, -1, 10, 1), Vector4(50, -1, 10, 1), Vector4(-50, -1, -100, 1), Vector4(50, -1, -100, 1) };
+	buffer.addOccluder(projection, floor, 4, wallIndices, 2);
+	buffer.rasterize();
+	EXPECT(buffer.statistics().rasterizedTriangles >= 2);
+	EXPECT(buffer.depth()[63 * 64 + 32] > 0);
+	EXPECT(buffer.depth()[0] == 0);
+	EXPECT(!buffer.isVisible(projection, Box3d(Vector4(-1, -5, -20, 1), Vector4(1, -4, -19, 1))));
+	EXPECT(buffer.isVisible(projection, Box3d(Vector4(-1, 0, -20, 1), Vector4(1, 1, -19, 1))));
+}
+
+/**
+  Casts a ray from the eye through the center of a box and checks whether it is blocked by a
+  triangle in front of the box.
+  */
+static bool isCenterBlocked(const TriangleBatch &occluders, const Box3d &box)
+{
+	Vector4 center = box.center();
+	center.setW(0);
+	const float distance = center.length();
+	Ray3d ray(Vector4(0, 0, 0, 1), center.normalized());
+	return occluders.intersect(ray, distance).intersects;
+}
+
+int main(int argc, char *argv[])
+{
+	testWall();
+
+	// A city of buildings along the negative z axis, seen from street level
+	std::vector<Vector4> positions;
+	std::vector<unsigned short> indices;
+	for (int x = -5; x < 5; ++x) {
+		for (int z = 1; z <= 20; ++z) {
+			const float height = 10 + randomFloat(30);
+			const Vector4 corner(x * 20.0f + 4, -2, z * -20.0f, 1);
+			appendBox(Box3d(corner, corner + Vector4(12, height, 12, 0)), positions, indices);
+		}
+	}
+	const uint triangleCount = (uint)indices.size() / 3;
+
+	const Matrix4 projection = Matrix4::perspective(3.14159265f / 3, 16 / 9.0f, 0.5f, 1000);
+
+	const int BoxCount = 10000;
+	Box3d *boxes = new Box3d[BoxCount];
+	for (int i = 0; i < BoxCount; ++i) {
+		const Vector4 corner(randomFloat(200) - 100, randomFloat(20) - 2, -randomFloat(400), 1);
+		boxes[i] = Box3d(corner, corner + Vector4(1, 1, 1, 0));
+	}
+
+	OcclusionBuffer buffer(320, 180);
+
+	buffer.resetStatistics();
+	BENCHMARK("Rasterize 200 buildings into a 320x184 occlusion buffer.") {
+		buffer.clear();
+		buffer.addOccluder(projection, &positions[0], (uint)positions.size(), &indices[0], triangleCount);
+		buffer.rasterize();
+	}
+
+	bool *visible = new bool[BoxCount];
+	BENCHMARK("Test 10000 boxes against an occlusion buffer.") {
+		for (int i = 0; i < BoxCount; ++i) {
+			visible[i] = buffer.isVisible(projection, boxes[i]);
+		}
+	}
+
+	int culled = 0;
+	for (int i = 0; i < BoxCount; ++i)
+		culled += !visible[i];
+	printf("%d of %d boxes are hidden.\n", culled, BoxCount);
+	EXPECT(culled > BoxCount / 4);
+
+	OcclusionStatistics statistics = buffer.statistics();
+	EXPECT(statistics.occluders > 0);
+	EXPECT(statistics.occluderTriangles == statistics.occluders * (long)triangleCount);
+	EXPECT(statistics.rasterizedTriangles <= statistics.occluderTriangles);
+	EXPECT(statistics.occludees % BoxCount == 0);
+	EXPECT(statistics.culled == statistics.occludees / BoxCount * culled);
+
+	// Hidden boxes can't be seen through their center either. Boxes straddling the edge of a distant
+	// building may show less than a pixel, which the buffer can't resolve, so allow a few of those.
+	TriangleBatch occluders;
+	occluders.build(&positions[0], &indices[0], triangleCount);
+	int mismatches = 0;
+	for (int i = 0; i < BoxCount; ++i) {
+		if (!visible[i]) {
+			const Vector4 projected = projection * boxes[i].center();
+			const bool onScreen = fabs(projected.x()) < projected.w() && fabs(projected.y()) < projected.w();
+			if (onScreen && !isCenterBlocked(occluders, boxes[i]))
+				++mismatches;
+		}
+	}
+	printf("%d hidden boxes have a visible center.\n", mismatches);
+	EXPECT(mismatches <= culled / 100);
+
+	delete [] visible;
+	delete [] boxes;
+
+	printf("Press enter to continue.\n");
+	fgetc(stdin);
+
+	return 0;
+}
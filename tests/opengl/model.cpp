@@ -18,19 +18,23 @@ enum ChunkTypes {
     BoneAttachments = 7, // Assigns vertices to bones
     BoundingVolumes = 8, // Bounding volumes,
     Animations = 9, // Animations
+    TriangleHierarchies = 10, // Serialized TriangleBvh of each face group, optional
     Metadata = 0xFFFF,  // Last chunk is always metadata
     UserChunk = 0x10000, // This gives plenty of room. 16-bit are reserved for application chunks
 };
 
 Model::Model()
-	: faceGroups(0), positions(0), normals(0), texCoords(0), vertices(0), vertexData(0), faceData(0)
+	: faceGroups(0), faces(0), positions(0), normals(0), texCoords(0), vertices(0), vertexData(0), faceData(0)
 	, positionBuffer(0), normalBuffer(0), texcoordBuffer(0), materialState(0), textureData(0)
+	, influences(0), animations(0), animationCount(0)
 {
 }
 
 Model::~Model()
 {
 	delete [] faceGroups;
+	delete [] influences;
+	delete [] animations;
 	delete [] materialState;
 	if (faceData)
 		ALIGNED_FREE(faceData);
@@ -90,6 +94,7 @@ private:
 
 bool Model::open(const char *filename, const RenderStates &renderState)
 {
+	close();
 	mError.clear();
 
 	FILE *fp = fopen(filename, "rb");
@@ -125,7 +130,9 @@ bool Model::open(const char *filename, const RenderStates &renderState)
 			return false;
 		}
 
-		if (chunkHeader.type < 1 || chunkHeader.type > 4) {
+		if ((chunkHeader.type < 1 || chunkHeader.type > 4) && chunkHeader.type != TriangleHierarchies
+			&& chunkHeader.type != Bones
+			&& chunkHeader.type != BoneAttachments && chunkHeader.type != Animations) {
 			// Skip, unknown chunk
 			mError.append(QString("WARN: Unknown chunk type %1 in model file %2.").arg(chunkHeader.type).arg(filename));
 			fseek(fp, chunkHeader.size, SEEK_CUR);
@@ -224,6 +231,19 @@ bool Model::open(const char *filename, const RenderStates &renderState)
 		} else if (chunkHeader.type == Faces) {
 			faceData = chunkData;
 			loadFaceData();
+		} else if (chunkHeader.type == TriangleHierarchies) {
+			loadTriangleHierarchies(chunkData, chunkHeader.size);
+			ALIGNED_FREE(chunkData);
+		} else if (chunkHeader.type == Bones) {
+			if (!skeleton.deserialize(chunkData, chunkHeader.size))
+				mError.append(QString("WARN: Invalid skeleton in model file %1, it will be skipped.").arg(filename));
+			ALIGNED_FREE(chunkData);
+		} else if (chunkHeader.type == BoneAttachments) {
+			loadBoneAttachments(chunkData, chunkHeader.size);
+			ALIGNED_FREE(chunkData);
+		} else if (chunkHeader.type == Animations) {
+			loadAnimations(chunkData, chunkHeader.size);
+			ALIGNED_FREE(chunkData);
 		} else {
 			ALIGNED_FREE(chunkData); // This should never happen
 		}
@@ -231,6 +251,8 @@ bool Model::open(const char *filename, const RenderStates &renderState)
 
 	fclose(fp);
 
+	buildTriangleHierarchies();
+
 	return true;
 }
 
@@ -256,6 +278,7 @@ void Model::close()
 	
 	delete [] faceGroups;
 	faceGroups = 0;
+	faces = 0;
 
 	if (faceData) {
 		ALIGNED_FREE(faceData);
@@ -266,6 +289,22 @@ void Model::close()
 		ALIGNED_FREE(vertexData);
 		vertexData = 0;
 	}
+
+	// These pointed into the vertex data
+	positions = 0;
+	normals = 0;
+	texCoords = 0;
+	vertices = 0;
+
+	// The influences are sized for the vertices of this model, so they must not survive opening another one
+	delete [] influences;
+	influences = 0;
+
+	delete [] animations;
+	animations = 0;
+	animationCount = 0;
+
+	skeleton.clear();
 }
 
 struct VertexHeader {
@@ -350,6 +389,10 @@ void Model::loadFaceData()
 
 		uint groupSize = groupHeader->elementCount * groupHeader->elementSize;
 
+		if (groupHeader->elementSize == sizeof(unsigned short)) {
+			faceGroup->indices = reinterpret_cast<const unsigned short*>(currentDataPointer);
+		}
+
 		glGenBuffersARB(1, &faceGroup->buffer);
 		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, faceGroup->buffer);
 		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, groupSize, currentDataPointer, GL_STATIC_DRAW_ARB);
@@ -360,6 +403,186 @@ void Model::loadFaceData()
 	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0); // Unbind array buffer
 }
 
+struct TriangleHierarchiesHeader
+{
+	uint groups;
+	uint reserved1;
+	uint reserved2;
+	uint reserved3;
+};
+
+struct TriangleHierarchyHeader
+{
+	uint size;
+	uint reserved1;
+	uint reserved2;
+	uint reserved3;
+};
+
+void Model::loadTriangleHierarchies(const void *data, uint size)
+{
+	// The chunk has to follow the Faces chunk, otherwise the hierarchies are rebuilt
+	if (!faceGroups || size < sizeof(TriangleHierarchiesHeader))
+		return;
+
+	const TriangleHierarchiesHeader *header = reinterpret_cast<const TriangleHierarchiesHeader*>(data);
+	const char *currentDataPointer = reinterpret_cast<const char*>(data) + sizeof(TriangleHierarchiesHeader);
+	const char *end = reinterpret_cast<const char*>(data) + size;
+
+	for (uint i = 0; i < header->groups && i < (uint)faces; ++i) {
+		if ((uint)(end - currentDataPointer) < sizeof(TriangleHierarchyHeader))
+			break;
+
+		const TriangleHierarchyHeader *groupHeader = reinterpret_cast<const TriangleHierarchyHeader*>(currentDataPointer);
+		currentDataPointer += sizeof(TriangleHierarchyHeader);
+
+		if ((uint)(end - currentDataPointer) < groupHeader->size)
+			break;
+
+		if (!faceGroups[i].hierarchy.deserialize(currentDataPointer, groupHeader->size)) {
+			mError.append(QString("WARN: Invalid triangle hierarchy for face group %1, it will be rebuilt.").arg(i));
+		}
+
+		currentDataPointer += groupHeader->size;
+	}
+}
+
+struct BoneAttachmentsHeader
+{
+	uint vertices;
+	uint reserved1;
+	uint reserved2;
+	uint reserved3;
+};
+
+void Model::loadBoneAttachments(const void *data, uint size)
+{
+	// The chunk has to follow the Geometry and Bones chunks, otherwise the model isn't skinned
+	if (!positions || skeleton.isEmpty()) {
+		mError.append(QString("WARN: Bone attachments precede the vertices or bones, the model won't be skinned."));
+		return;
+	}
+
+	if (size < sizeof(BoneAttachmentsHeader)) {
+		mError.append(QString("WARN: Bone attachments are truncated, the model won't be skinned."));
+		return;
+	}
+
+	const BoneAttachmentsHeader *header = reinterpret_cast<const BoneAttachmentsHeader*>(data);
+	const SkinningInfluences *vertexInfluences = reinterpret_cast<const SkinningInfluences*>(
+		reinterpret_cast<const char*>(data) + sizeof(BoneAttachmentsHeader));
+
+	if (header->vertices != (uint)vertices
+		|| size < sizeof(BoneAttachmentsHeader) + sizeof(SkinningInfluences) * header->vertices) {
+		mError.append(QString("WARN: Bone attachments don't match the vertices, the model won't be skinned."));
+		return;
+	}
+
+	// Skinning doesn't check bone indices, so they have to be valid here
+	for (uint i = 0; i < header->vertices; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			if (vertexInfluences[i].bones[j] >= skeleton.boneCount()) {
+				mError.append(QString("WARN: Vertex %1 is attached to an unknown bone, the model won't be skinned.").arg(i));
+				return;
+			}
+		}
+	}
+
+	delete [] influences;
+	influences = new SkinningInfluences[header->vertices];
+	memcpy(influences, vertexInfluences, sizeof(SkinningInfluences) * header->vertices);
+}
+
+struct AnimationsHeader
+{
+	uint clips;
+	uint reserved1;
+	uint reserved2;
+	uint reserved3;
+};
+
+struct AnimationHeader
+{
+	uint size;
+	uint reserved1;
+	uint reserved2;
+	uint reserved3;
+};
+
+void Model::loadAnimations(const void *data, uint size)
+{
+	if (size < sizeof(AnimationsHeader))
+		return;
+
+	const AnimationsHeader *header = reinterpret_cast<const AnimationsHeader*>(data);
+	const char *currentDataPointer = reinterpret_cast<const char*>(data) + sizeof(AnimationsHeader);
+	const char *end = reinterpret_cast<const char*>(data) + size;
+
+	// Every clip needs at least its header, which bounds the allocation for corrupt counts
+	const uint clips = std::min<uint>(header->clips, (uint)((end - currentDataPointer) / sizeof(AnimationHeader)));
+
+	delete [] animations;
+	animations = new AnimationClip[clips];
+	animationCount = 0;
+
+	for (uint i = 0; i < clips; ++i) {
+		if ((uint)(end - currentDataPointer) < sizeof(AnimationHeader))
+			break;
+
+		const AnimationHeader *clipHeader = reinterpret_cast<const AnimationHeader*>(currentDataPointer);
+		currentDataPointer += sizeof(AnimationHeader);
+
+		if ((uint)(end - currentDataPointer) < clipHeader->size)
+			break;
+
+		// Invalid clips are kept empty, so the indices of the others don't change
+		if (!animations[i].deserialize(currentDataPointer, clipHeader->size)) {
+			mError.append(QString("WARN: Invalid animation %1, it will be skipped.").arg(i));
+		}
+
+		currentDataPointer += clipHeader->size;
+		animationCount = i + 1;
+	}
+
+	if (animationCount < (int)header->clips)
+		mError.append(QString("WARN: The animations chunk is truncated after %1 animations.").arg(animationCount));
+}
+
+void Model::buildTriangleHierarchies()
+{
+	if (!positions)
+		return;
+
+	for (int i = 0; i < faces; ++i) {
+		FaceGroup &faceGroup = faceGroups[i];
+		if (faceGroup.indices && faceGroup.hierarchy.isEmpty()) {
+			faceGroup.hierarchy.build(positions, faceGroup.indices, faceGroup.elementCount / 3);
+		}
+	}
+}
+
+IntersectionResult Model::intersect(const Ray3d &ray, int *faceGroup) const
+{
+	IntersectionResult result;
+	result.intersects = false;
+	result.distance = std::numeric_limits<float>::infinity();
+	result.exitDistance = result.distance;
+	result.u = 0;
+	result.v = 0;
+	result.triangle = 0;
+
+	for (int i = 0; i < faces; ++i) {
+		IntersectionResult groupResult = faceGroups[i].hierarchy.intersect(ray, result.distance);
+		if (groupResult.intersects) {
+			result = groupResult;
+			if (faceGroup)
+				*faceGroup = i;
+		}
+	}
+
+	return result;
+}
+
 void Model::drawNormals() const
 {
 	glLineWidth(2);
@@ -379,7 +602,7 @@ void Model::drawNormals() const
 	glEnable(GL_LIGHTING);
 }
 
-FaceGroup::FaceGroup() : buffer(0), material(0), elementCount(0)
+FaceGroup::FaceGroup() : buffer(0), material(0), elementCount(0), indices(0)
 {
 }
 
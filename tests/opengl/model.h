@@ -17,6 +17,12 @@ struct FaceGroup {
 	MaterialState *material;
 	uint elementCount;
 	GLuint buffer;
+
+	// Points into the face data of the model, null if the group doesn't use 16-bit indices
+	const unsigned short *indices;
+
+	// Loaded from the TriangleHierarchies chunk if present, otherwise built when the model is opened
+	TriangleBvh hierarchy;
 	
 	FaceGroup();
 	~FaceGroup();
@@ -42,8 +48,24 @@ public:
 	int faces;	
 	FaceGroup *faceGroups;
 
+	// Loaded from the Bones chunk, empty if the model isn't skinned
+	Skeleton skeleton;
+
+	// Loaded from the BoneAttachments chunk, one per vertex, or null if the model isn't skinned
+	SkinningInfluences *influences;
+
+	// Loaded from the Animations chunk, with one track per bone each
+	AnimationClip *animations;
+	int animationCount;
+
 	void drawNormals() const;
 
+	/**
+	  Finds the closest triangle of this model hit by the given ray. The index of the face group
+	  the triangle belongs to is stored in faceGroup, if given.
+	  */
+	IntersectionResult intersect(const Ray3d &ray, int *faceGroup = 0) const;
+
 	const QString &error() const;
 
 private:
@@ -56,6 +78,10 @@ private:
 	
 	void loadVertexData();
 	void loadFaceData();
+	void loadTriangleHierarchies(const void *data, uint size);
+	void loadBoneAttachments(const void *data, uint size);
+	void loadAnimations(const void *data, uint size);
+	void buildTriangleHierarchies();
 
 	QString mError;
 };
@@ -0,0 +1,190 @@
+
+#include "../common/common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GameMath;
+
+static const int VectorCount = 10001;
+
+static void testProduct()
+{
+	// i * j = k, j * i = -k
+	const Quaternion i(1, 0, 0, 0), j(0, 1, 0, 0), k(0, 0, 1, 0), one(0, 0, 0, 1);
+	EXPECT(fuzzyCompare(i * j, k));
+	EXPECT(fuzzyCompare(j * i, Quaternion(0, 0, -1, 0)));
+	EXPECT(fuzzyCompare(i * i, Quaternion(0, 0, 0, -1)));
+	EXPECT(fuzzyCompare(one * k, k));
+
+	const Quaternion a(1, 2, 3, 4), b(-5, 6, 7, -8);
+	EXPECT(fuzzyCompare(a * b, Quaternion(-32, -14, 20, -60)));
+
+	EXPECT(fuzzyCompare(a.conjugated(), Quaternion(-1, -2, -3, 4)));
+	EXPECT(fuzzyCompare(a * a.inverted(), one));
+	EXPECT(fuzzyCompare(a.inverted() * a, one));
+
+	// Composing rotations is the same as multiplying their matrices
+	for (int n = 0; n < 100; ++n) {
+		const Quaternion p = randomRotation();
+		const Quaternion q = randomRotation();
+		const Matrix4 expected = Matrix4::rotation(p) * Matrix4::rotation(q);
+		const Matrix4 composed = Matrix4::rotation(p * q);
+		EXPECT(fuzzyCompare(composed, expected));
+
+		EXPECT(fuzzyCompare(p * p.conjugated(), one));
+		EXPECT(fuzzyCompare(p.inverted(), p.conjugated()));
+	}
+}
+
+static void testRotate()
+{
+	const Quaternion quarter = Quaternion::fromAxisAndAngle(0, 1, 0, 3.14159265f / 2);
+	EXPECT(fuzzyCompare(quarter.rotate(Vector4(1, 0, 0, 1)), Vector4(0, 0, -1, 1)));
+	EXPECT(fuzzyCompare(quarter.rotate(Vector4(0, 2, 0, 0)), Vector4(0, 2, 0, 0)));
+
+	Vector4 *vectors = new Vector4[VectorCount];
+	Vector4 *results = new Vector4[VectorCount];
+	for (int i = 0; i < VectorCount; ++i)
+		vectors[i] = Vector4(randomFloat(20) - 10, randomFloat(20) - 10, randomFloat(20) - 10, (float)(i & 1));
+
+	const Quaternion rotation = randomRotation();
+	const Matrix4 matrix = Matrix4::rotation(rotation);
+	rotation.rotate(vectors, VectorCount, results);
+	for (int i = 0; i < VectorCount; ++i) {
+		Vector4 expected = matrix.mapNormal(vectors[i]);
+		expected.setW(vectors[i].w());
+		EXPECT(fuzzyCompare(rotation.rotate(vectors[i]), expected));
+		EXPECT(fuzzyCompare(results[i], expected));
+	}
+
+	// Rotating back with the conjugate, in place
+	rotation.conjugated().rotate(results, VectorCount, results);
+	for (int i = 0; i < VectorCount; ++i)
+		EXPECT(fuzzyCompare(results[i], vectors[i], 1e-3f));
+
+	BENCHMARK("Rotate 10000 vectors by converting the quaternion to a matrix each time.") {
+		for (int i = 0; i < VectorCount; ++i)
+			results[i] = Matrix4::rotation(rotation).mapNormal(vectors[i]);
+	}
+
+	BENCHMARK("Rotate 10000 vectors one by one.") {
+		for (int i = 0; i < VectorCount; ++i)
+			results[i] = rotation.rotate(vectors[i]);
+	}
+
+	BENCHMARK("Rotate 10000 vectors in a batch.") {
+		rotation.rotate(vectors, VectorCount, results);
+	}
+
+	Quaternion *a = new Quaternion[VectorCount];
+	Quaternion *b = new Quaternion[VectorCount];
+	Quaternion *products = new Quaternion[VectorCount];
+	for (int i = 0; i < VectorCount; ++i) {
+		a[i] = randomRotation();
+		b[i] = randomRotation();
+	}
+
+	Quaternion::multiply(a, b, VectorCount, products);
+	for (int i = 0; i < VectorCount; ++i)
+		EXPECT(fuzzyCompare(products[i], a[i] * b[i]));
+
+	BENCHMARK("Compose 10000 rotations as matrices.") {
+		for (int i = 0; i < VectorCount; ++i) {
+			const Matrix4 product = Matrix4::rotation(a[i]) * Matrix4::rotation(b[i]);
+			results[i] = Vector4(product(0, 0), product(1, 0), product(2, 0), product(3, 0));
+		}
+	}
+
+	BENCHMARK("Compose 10000 rotations as quaternions.") {
+		Quaternion::multiply(a, b, VectorCount, products);
+	}
+
+	delete [] products;
+	delete [] b;
+	delete [] a;
+	delete [] results;
+	delete [] vectors;
+}
+
+static void testInterpolation()
+{
+	const Quaternion one(0, 0, 0, 1);
+	const Quaternion quarter = Quaternion::fromAxisAndAngle(0, 0, 1, 3.14159265f / 2);
+	EXPECT(fuzzyCompare(Quaternion::slerp(one, quarter, 0.5f), Quaternion::fromAxisAndAngle(0, 0, 1, 3.14159265f / 4)));
+	EXPECT(fuzzyCompare(Quaternion::nlerp(one, quarter, 0.5f), Quaternion::fromAxisAndAngle(0, 0, 1, 3.14159265f / 4)));
+	EXPECT(fuzzyCompare(Quaternion::slerp(one, quarter, 0), one));
+	EXPECT(fuzzyCompare(Quaternion::slerp(one, quarter, 1), quarter));
+
+	// -quarter is the same rotation, so the shorter path leads to quarter again
+	const Quaternion negated(-quarter.x(), -quarter.y(), -quarter.z(), -quarter.w());
+	EXPECT(fuzzyCompare(Quaternion::slerp(one, negated, 0.5f), Quaternion::slerp(one, quarter, 0.5f)));
+	EXPECT(fuzzyCompare(Quaternion::nlerp(one, negated, 0.5f), Quaternion::nlerp(one, quarter, 0.5f)));
+
+	// Slerp turns with constant angular velocity
+	const Quaternion turn = Quaternion::fromAxisAndAngle(0, 1, 0, 2.5f);
+	for (int i = 0; i <= 10; ++i)
+		EXPECT(fuzzyCompare(Quaternion::slerp(one, turn, i / 10.0f), Quaternion::fromAxisAndAngle(0, 1, 0, 0.25f * i)));
+
+	Quaternion *a = new Quaternion[VectorCount];
+	Quaternion *b = new Quaternion[VectorCount];
+	Quaternion *results = new Quaternion[VectorCount];
+	float *weights = new float[VectorCount];
+	for (int i = 0; i < VectorCount; ++i) {
+		a[i] = randomRotation();
+		// Every tenth pair is almost identical, where slerp degenerates
+		b[i] = (i % 10) ? randomRotation() : a[i] * Quaternion::fromAxisAndAngle(1, 0, 0, 1e-3f);
+		weights[i] = randomFloat(1);
+	}
+	weights[0] = 0;
+	weights[1] = 1;
+
+	Quaternion::slerp(a, b, weights, VectorCount, results);
+	for (int i = 0; i < VectorCount; ++i)
+		EXPECT(fuzzyCompare(results[i], Quaternion::slerp(a[i], b[i], weights[i])));
+	EXPECT(fuzzyCompare(results[0], a[0]));
+
+	Quaternion::nlerp(a, b, weights, VectorCount, results);
+	for (int i = 0; i < VectorCount; ++i)
+		EXPECT(fuzzyCompare(results[i], Quaternion::nlerp(a[i], b[i], weights[i])));
+
+	// Counts that aren't a multiple of four leave the rest of the output alone
+	for (int count = 1; count < 8; ++count) {
+		for (int i = 0; i < 8; ++i)
+			results[i] = one;
+		Quaternion::slerp(a, b, weights, count, results);
+		for (int i = 0; i < 8; ++i)
+			EXPECT(fuzzyCompare(results[i], i < count ? Quaternion::slerp(a[i], b[i], weights[i]) : one));
+	}
+
+	BENCHMARK("Slerp 10000 quaternion pairs one by one.") {
+		for (int i = 0; i < VectorCount; ++i)
+			results[i] = Quaternion::slerp(a[i], b[i], weights[i]);
+	}
+
+	BENCHMARK("Slerp 10000 quaternion pairs in a batch.") {
+		Quaternion::slerp(a, b, weights, VectorCount, results);
+	}
+
+	BENCHMARK("Nlerp 10000 quaternion pairs in a batch.") {
+		Quaternion::nlerp(a, b, weights, VectorCount, results);
+	}
+
+	delete [] weights;
+	delete [] results;
+	delete [] b;
+	delete [] a;
+}
+
+int main(int argc, char *argv[])
+{
+	testProduct();
+	testRotate();
+	testInterpolation();
+
+	printf("Press enter to continue.\n");
+	fgetc(stdin);
+
+	return 0;
+}
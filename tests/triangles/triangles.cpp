@@ -0,0 +1,410 @@
+
+#include "../common/common.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace GameMath;
+
+/**
+  The geometry of a model file, read without creating any OpenGL objects.
+  */
+struct ModelGeometry {
+	ModelGeometry() : positions(0), vertexCount(0) {}
+	~ModelGeometry() { delete [] positions; }
+
+	Vector4 *positions;
+	uint vertexCount;
+	std::vector< std::vector<unsigned short> > faceGroups;
+};
+
+struct ModelFileHeader {
+	char magic[4];
+	uint version;
+	uint checksum;
+	uint chunks;
+};
+
+struct ModelChunkHeader {
+	uint type;
+	uint flags;
+	uint reserved;
+	uint size;
+};
+
+struct ModelGroupHeader {
+	int materialId;
+	uint elementCount;
+	uint elementSize;
+	uint reserved;
+};
+
+// test.model was written before the MaterialReferences chunk existed, so Geometry and Faces are chunks 3 and 4
+static const uint GeometryChunk = 3;
+static const uint FacesChunk = 4;
+
+static bool loadGeometry(const char *filename, ModelGeometry &geometry)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (!fp)
+		return false;
+
+	ModelFileHeader header;
+	if (!fread(&header, sizeof(header), 1, fp)) {
+		fclose(fp);
+		return false;
+	}
+
+	for (uint i = 0; i < header.chunks; ++i) {
+		ModelChunkHeader chunkHeader;
+		if (!fread(&chunkHeader, sizeof(chunkHeader), 1, fp))
+			break;
+
+		if (chunkHeader.type != GeometryChunk && chunkHeader.type != FacesChunk) {
+			fseek(fp, chunkHeader.size, SEEK_CUR);
+			continue;
+		}
+
+		std::vector<char> data(chunkHeader.size);
+		if (!fread(&data[0], chunkHeader.size, 1, fp))
+			break;
+
+		const char *ptr = &data[0];
+		const uint count = *reinterpret_cast<const uint*>(ptr);
+		ptr += 16;
+
+		if (chunkHeader.type == GeometryChunk) {
+			geometry.vertexCount = count;
+			geometry.positions = new Vector4[count];
+			memcpy(geometry.positions, ptr, sizeof(Vector4) * count);
+		} else {
+			geometry.faceGroups.resize(count);
+			for (uint j = 0; j < count; ++j) {
+				const ModelGroupHeader *groupHeader = reinterpret_cast<const ModelGroupHeader*>(ptr);
+				ptr += sizeof(ModelGroupHeader);
+
+				const unsigned short *indices = reinterpret_cast<const unsigned short*>(ptr);
+				geometry.faceGroups[j].assign(indices, indices + groupHeader->elementCount);
+				ptr += groupHeader->elementCount * groupHeader->elementSize;
+			}
+		}
+	}
+
+	fclose(fp);
+	return geometry.positions && !geometry.faceGroups.empty();
+}
+
+/**
+  Straightforward Moller-Trumbore test of a single triangle, used as the reference.
+  */
+static bool intersectTriangle(const Ray3d &ray, const Vector4 &a, const Vector4 &b, const Vector4 &c, float &distance)
+{
+	const Vector4 edge1 = b - a;
+	const Vector4 edge2 = c - a;
+	const Vector4 p = ray.direction().cross(edge2);
+	const float determinant = edge1.dot(p);
+	if (determinant == 0)
+		return false;
+
+	const Vector4 s = ray.origin() - a;
+	const float u = s.dot(p) / determinant;
+	if (u < 0 || u > 1)
+		return false;
+
+	const Vector4 q = s.cross(edge1);
+	const float v = ray.direction().dot(q) / determinant;
+	if (v < 0 || u + v > 1)
+		return false;
+
+	distance = edge2.dot(q) / determinant;
+	return distance >= 0;
+}
+
+static void testSingleTriangle()
+{
+	Vector4 positions[3] = { Vector4(0, 0, 5, 1), Vector4(2, 0, 5, 1), Vector4(0, 2, 5, 1) };
+	unsigned short indices[3] = { 0, 1, 2 };
+
+	TriangleBatch batch;
+	batch.build(positions, indices, 1);
+	EXPECT(batch.triangleCount() == 1);
+	EXPECT(batch.blockCount() == 1);
+
+	Ray3d ray(Vector4(0.5f, 0.5f, 0, 1), Vector4(0, 0, 1, 0));
+	IntersectionResult result = batch.intersect(ray);
+	EXPECT(result.intersects);
+	EXPECT(fabs(result.distance - 5) < 1e-5f);
+	EXPECT(fabs(result.u - 0.25f) < 1e-5f);
+	EXPECT(fabs(result.v - 0.25f) < 1e-5f);
+	EXPECT(result.triangle == 0);
+
+	// Triangles are hit from both sides, but not behind the origin or beyond the maximum distance
+	ray.setDirection(Vector4(0, 0, -1, 0));
+	EXPECT(!batch.intersect(ray).intersects);
+	ray.setOrigin(Vector4(0.5f, 0.5f, 10, 1));
+	EXPECT(batch.intersect(ray).intersects);
+	EXPECT(!batch.intersect(ray, 4).intersects);
+
+	ray.setOrigin(Vector4(1.5f, 1.5f, 10, 1));
+	EXPECT(!batch.intersect(ray).intersects);
+}
+
+/**
+  Checks that every triangle is stored in exactly one leaf, that leaves hold at most two blocks
+  and that the bounds of every node enclose its triangles.
+  */
+static void checkTriangleBvh(const TriangleBvh &hierarchy, uint triangleCount)
+{
+	EXPECT(hierarchy.triangleCount() == triangleCount);
+
+	std::vector<int> seen(triangleCount, 0);
+	uint storedTriangles = 0;
+
+	for (uint i = 0; i < hierarchy.nodeCount(); ++i) {
+		const BvhNode &node = hierarchy.nodes()[i];
+		if (!node.isLeaf())
+			continue;
+
+		EXPECT(node.count <= TriangleBvh::MaxLeafSize / 4);
+
+		const Box3d bounds = node.bounds();
+		for (uint j = node.leftFirst; j < node.leftFirst + node.count; ++j) {
+			const TriangleBlock &block = hierarchy.blocks()[j];
+			for (int slot = 0; slot < 4; ++slot) {
+				if (block.edge1[0][slot] == 0 && block.edge1[1][slot] == 0 && block.edge1[2][slot] == 0
+					&& block.edge2[0][slot] == 0 && block.edge2[1][slot] == 0 && block.edge2[2][slot] == 0)
+					continue; // Padding
+
+				seen[block.triangle[slot]]++;
+				storedTriangles++;
+
+				const Vector4 vertex(block.vertex[0][slot], block.vertex[1][slot], block.vertex[2][slot], 0);
+				EXPECT(bounds.contains(vertex));
+			}
+		}
+	}
+
+	// Degenerate triangles of the mesh itself are indistinguishable from padding
+	EXPECT(storedTriangles <= triangleCount);
+	for (uint i = 0; i < triangleCount; ++i)
+		EXPECT(seen[i] <= 1);
+}
+
+/**
+  A corrupt hierarchy can reference the same node from several parents. The node has to be checked
+  against the deepest of them, otherwise a subtree hanging below it can exceed the traversal stack.
+  */
+static void testSharedChildDepth()
+{
+	// A chain of inner nodes 1, 3, 5, ... ends with node 123 at a depth of 62, whose children 127 and
+	// 128 are also the children of node 125 at a depth of 2. Node 127 has children of its own at 64.
+	const uint NodeCount = 131;
+	std::vector<BvhNode> nodes(NodeCount);
+	for (uint i = 0; i < NodeCount; ++i) {
+		memset(&nodes[i], 0, sizeof(BvhNode));
+		nodes[i].count = 1;
+	}
+
+	const uint inner[][2] = { { 0, 1 }, { 2, 125 }, { 123, 127 }, { 125, 127 }, { 127, 129 } };
+	for (size_t i = 0; i < sizeof(inner) / sizeof(inner[0]); ++i) {
+		nodes[inner[i][0]].leftFirst = inner[i][1];
+		nodes[inner[i][0]].count = 0;
+	}
+	for (uint i = 1; i < 123; i += 2) {
+		nodes[i].leftFirst = i + 2;
+		nodes[i].count = 0;
+	}
+
+	TriangleBlock block;
+	memset(&block, 0, sizeof(block));
+
+	const uint header[4] = { TriangleBvh::SerializationVersion, NodeCount, 1, 4 };
+	std::vector<char> data(sizeof(header) + sizeof(BvhNode) * NodeCount + sizeof(TriangleBlock));
+	memcpy(&data[0], header, sizeof(header));
+	memcpy(&data[sizeof(header)], &nodes[0], sizeof(BvhNode) * NodeCount);
+	memcpy(&data[sizeof(header) + sizeof(BvhNode) * NodeCount], &block, sizeof(TriangleBlock));
+
+	TriangleBvh loaded;
+	EXPECT(!loaded.deserialize(&data[0], data.size()));
+	EXPECT(loaded.isEmpty());
+
+	// The same hierarchy with node 127 as a leaf stays within the limit
+	nodes[127].leftFirst = 0;
+	nodes[127].count = 1;
+	memcpy(&data[sizeof(header)], &nodes[0], sizeof(BvhNode) * NodeCount);
+	EXPECT(loaded.deserialize(&data[0], data.size()));
+}
+
+int main(int argc, char *argv[])
+{
+	testSingleTriangle();
+	testSharedChildDepth();
+
+	ModelGeometry geometry;
+	if (!loadGeometry("../opengl/test.model", geometry)) {
+		printf("Unable to load ../opengl/test.model\n");
+		return 1;
+	}
+
+	TriangleBatch *batches = new TriangleBatch[geometry.faceGroups.size()];
+	Box3d bounds = Box3d::fromPoints(geometry.positions, geometry.vertexCount);
+	uint triangleCount = 0;
+	for (size_t i = 0; i < geometry.faceGroups.size(); ++i) {
+		const std::vector<unsigned short> &indices = geometry.faceGroups[i];
+		batches[i].build(geometry.positions, &indices[0], (uint)indices.size() / 3);
+		triangleCount += batches[i].triangleCount();
+	}
+	printf("Loaded %d triangles in %d groups.\n", triangleCount, (int)geometry.faceGroups.size());
+
+	// Aim rays from outside of the model at points inside random triangles, since rays through
+	// vertices or edges may be reported as hit or missed depending on rounding
+	const std::vector<unsigned short> &targetIndices = geometry.faceGroups[0];
+	const int RayCount = 1000;
+	Ray3d *rays = new Ray3d[RayCount];
+	const Vector4 center = bounds.center();
+	const float radius = (bounds.maximum() - bounds.minimum()).length();
+	for (int i = 0; i < RayCount; ++i) {
+		Vector4 offset(randomFloat(2) - 1, randomFloat(2) - 1, randomFloat(2) - 1, 0);
+		Vector4 origin = center + radius * offset.normalized();
+		origin.setW(1);
+		const uint triangle = rand() % (uint)(targetIndices.size() / 3);
+		const Vector4 &a = geometry.positions[targetIndices[triangle * 3]];
+		const Vector4 &b = geometry.positions[targetIndices[triangle * 3 + 1]];
+		const Vector4 &c = geometry.positions[targetIndices[triangle * 3 + 2]];
+		Vector4 target = 0.4f * a + 0.3f * b + 0.3f * c;
+		Vector4 direction = target - origin;
+		direction.setW(0);
+		rays[i] = Ray3d(origin, direction.normalized());
+	}
+
+	// The closest hit has to match the scalar reference
+	int hits = 0;
+	for (int i = 0; i < RayCount; ++i) {
+		float closest = std::numeric_limits<float>::infinity();
+		for (size_t j = 0; j < geometry.faceGroups.size(); ++j) {
+			const std::vector<unsigned short> &indices = geometry.faceGroups[j];
+			for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+				float distance;
+				if (intersectTriangle(rays[i], geometry.positions[indices[k]], geometry.positions[indices[k + 1]],
+					geometry.positions[indices[k + 2]], distance) && distance < closest)
+					closest = distance;
+			}
+		}
+
+		IntersectionResult result;
+		result.intersects = false;
+		result.distance = std::numeric_limits<float>::infinity();
+		for (size_t j = 0; j < geometry.faceGroups.size(); ++j) {
+			intersectTriangleBlocks(rays[i], batches[j].blocks(), batches[j].blockCount(), result);
+		}
+
+		EXPECT(result.intersects == (closest != std::numeric_limits<float>::infinity()));
+		if (result.intersects) {
+			++hits;
+			EXPECT(fabs(result.distance - closest) <= 1e-3f * closest);
+		}
+	}
+	EXPECT(hits > RayCount / 2);
+
+	float *referenceDistances = new float[RayCount];
+	float *batchDistances = new float[RayCount];
+
+	BENCHMARK("Pick 1000 rays against test.model, one triangle at a time.") {
+		for (int i = 0; i < RayCount; ++i) {
+			float &closest = referenceDistances[i];
+			closest = std::numeric_limits<float>::infinity();
+			for (size_t j = 0; j < geometry.faceGroups.size(); ++j) {
+				const std::vector<unsigned short> &indices = geometry.faceGroups[j];
+				for (size_t k = 0; k + 2 < indices.size(); k += 3) {
+					float distance;
+					if (intersectTriangle(rays[i], geometry.positions[indices[k]], geometry.positions[indices[k + 1]],
+						geometry.positions[indices[k + 2]], distance) && distance < closest)
+						closest = distance;
+				}
+			}
+		}
+	}
+
+	BENCHMARK("Pick 1000 rays against test.model, four triangles at a time.") {
+		for (int i = 0; i < RayCount; ++i) {
+			IntersectionResult result;
+			result.intersects = false;
+			result.distance = std::numeric_limits<float>::infinity();
+			for (size_t j = 0; j < geometry.faceGroups.size(); ++j) {
+				intersectTriangleBlocks(rays[i], batches[j].blocks(), batches[j].blockCount(), result);
+			}
+			batchDistances[i] = result.distance;
+		}
+	}
+
+	for (int i = 0; i < RayCount; ++i) {
+		EXPECT(fabs(batchDistances[i] - referenceDistances[i]) <= 1e-3f * referenceDistances[i]
+			|| batchDistances[i] == referenceDistances[i]);
+	}
+
+	TriangleBvh *hierarchies = new TriangleBvh[geometry.faceGroups.size()];
+	for (size_t i = 0; i < geometry.faceGroups.size(); ++i) {
+		const std::vector<unsigned short> &indices = geometry.faceGroups[i];
+		hierarchies[i].build(geometry.positions, &indices[0], (uint)indices.size() / 3);
+		checkTriangleBvh(hierarchies[i], batches[i].triangleCount());
+	}
+
+	// Loading a serialized hierarchy has to give the same results as the one it was written from
+	for (size_t i = 0; i < geometry.faceGroups.size(); ++i) {
+		char *data = static_cast<char*>(ALIGNED_MALLOC(hierarchies[i].serializedSize()));
+		hierarchies[i].serialize(data);
+
+		TriangleBvh loaded;
+		EXPECT(!loaded.deserialize(data, hierarchies[i].serializedSize() - 16));
+		EXPECT(loaded.deserialize(data, hierarchies[i].serializedSize()));
+		EXPECT(loaded.nodeCount() == hierarchies[i].nodeCount());
+		EXPECT(loaded.blockCount() == hierarchies[i].blockCount());
+		EXPECT(loaded.triangleCount() == hierarchies[i].triangleCount());
+
+		for (int j = 0; j < RayCount; ++j) {
+			IntersectionResult expected = hierarchies[i].intersect(rays[j]);
+			IntersectionResult result = loaded.intersect(rays[j]);
+			EXPECT(result.intersects == expected.intersects);
+			EXPECT(!result.intersects || (result.distance == expected.distance && result.triangle == expected.triangle));
+		}
+
+		// Corrupt the first child reference of the root
+		reinterpret_cast<unsigned int*>(data)[4 + 3] = 0;
+		EXPECT(!loaded.deserialize(data, hierarchies[i].serializedSize()));
+		EXPECT(loaded.isEmpty());
+
+		ALIGNED_FREE(data);
+	}
+
+	float *hierarchyDistances = new float[RayCount];
+
+	BENCHMARK("Pick 1000 rays against test.model, using a triangle hierarchy per face group.") {
+		for (int i = 0; i < RayCount; ++i) {
+			float closest = std::numeric_limits<float>::infinity();
+			for (size_t j = 0; j < geometry.faceGroups.size(); ++j) {
+				IntersectionResult result = hierarchies[j].intersect(rays[i], closest);
+				if (result.intersects)
+					closest = result.distance;
+			}
+			hierarchyDistances[i] = closest;
+		}
+	}
+
+	for (int i = 0; i < RayCount; ++i) {
+		EXPECT(hierarchyDistances[i] == batchDistances[i]);
+	}
+
+	delete [] hierarchyDistances;
+	delete [] hierarchies;
+	delete [] batchDistances;
+	delete [] referenceDistances;
+	delete [] rays;
+	delete [] batches;
+
+	printf("Press enter to continue.\n");
+	fgetc(stdin);
+
+	return 0;
+}